@@ -0,0 +1,201 @@
+#!/usr/bin/env python3
+
+# This file is part of RTLib.
+#
+# Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+#
+# RTLib is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# RTLib is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+
+"""Decodes frames produced by util::Telemetry, using the message structures of a schema header.
+
+Each decoded message is printed as one line of JSON.
+"""
+
+import argparse
+import json
+import re
+import struct
+import sys
+
+# Name of C++ type -> (struct format, size)
+TYPES = {
+    'bool': '?',
+    'char': 'b',
+    'int8_t': 'b',
+    'uint8_t': 'B',
+    'int16_t': 'h',
+    'uint16_t': 'H',
+    'int32_t': 'i',
+    'uint32_t': 'I',
+    'int64_t': 'q',
+    'uint64_t': 'Q',
+    'float': 'f',
+    'double': 'd',
+}
+
+STRUCT_RE = re.compile(r'struct\s+(\w+)\s*(?:final\s*)?\{')
+SCHEMA_ID_RE = re.compile(r'static\s+constexpr\s+(?:std::)?uint8_t\s+kSchemaId\s*=\s*(\w+)\s*;')
+MEMBER_RE = re.compile(r'(?:std::)?(\w+)\s+(\w+)\s*(?:\[\s*(\w+)\s*\])?\s*(?:=.*|\{.*\})?', re.S)
+
+
+class Schema:
+    """Layout of one message structure, using the natural alignment of ARM EABI."""
+
+    def __init__(self, name, members):
+        self.name = name
+        self.names = []
+        fmt = '<'
+        offset = 0
+        alignment = 1
+        for type_name, member, count in members:
+            code = TYPES[type_name]
+            size = struct.calcsize('<' + code)
+            padding = -offset % size
+            fmt += 'x' * padding + code * count
+            offset += padding + size * count
+            alignment = max(alignment, size)
+            self.names.append((member, count))
+        fmt += 'x' * (-offset % alignment)
+        self.format = struct.Struct(fmt)
+
+    def decode(self, payload):
+        if len(payload) != self.format.size:
+            raise ValueError('{}: expected {} bytes, got {}'.format(self.name, self.format.size, len(payload)))
+        values = iter(self.format.unpack(payload))
+        message = {}
+        for member, count in self.names:
+            if count == 1:
+                message[member] = next(values)
+            else:
+                message[member] = [next(values) for _ in range(count)]
+        return message
+
+
+def parse_schemas(path):
+    with open(path) as f:
+        source = re.sub(r'//[^\n]*|/\*.*?\*/', '', f.read(), flags=re.S)
+
+    constants = {m.group(1): int(m.group(2), 0)
+                 for m in re.finditer(r'constexpr\s+[\w:]+\s+(\w+)\s*=\s*(\w+)\s*;', source)
+                 if re.fullmatch(r'0[xX][0-9a-fA-F]+|\d+', m.group(2))}
+
+    def value_of(token):
+        return constants[token] if token in constants else int(token, 0)
+
+    schemas = {}
+    for match in STRUCT_RE.finditer(source):
+        # Find the closing brace of the structure, skipping braced initializers of members
+        depth = 1
+        end = match.end()
+        while depth > 0 and end < len(source):
+            depth += {'{': 1, '}': -1}.get(source[end], 0)
+            end += 1
+        body = source[match.end():end - 1]
+        schema_id = SCHEMA_ID_RE.search(body)
+        if schema_id is None:
+            continue
+
+        members = []
+        for statement in SCHEMA_ID_RE.sub('', body).split(';'):
+            statement = statement.strip()
+            if not statement or statement.startswith('static '):
+                continue
+            member = MEMBER_RE.fullmatch(statement)
+            if member is None:
+                raise ValueError('{}: cannot parse member declaration: {}'.format(match.group(1), statement))
+            if member.group(1) not in TYPES:
+                raise ValueError('{}: unsupported type {}'.format(match.group(1), member.group(1)))
+            count = value_of(member.group(3)) if member.group(3) else 1
+            members.append((member.group(1), member.group(2), count))
+
+        schemas[value_of(schema_id.group(1))] = Schema(match.group(1), members)
+    return schemas
+
+
+def cobs_decode(data):
+    out = bytearray()
+    index = 0
+    while index < len(data):
+        code = data[index]
+        if code == 0 or index + code > len(data):
+            return None
+        out += data[index + 1:index + code]
+        index += code
+        if code != 0xFF and index < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def crc16_ccitt(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def frames(stream):
+    buffer = bytearray()
+    while True:
+        chunk = stream.read(256)
+        if not chunk:
+            return
+        buffer += chunk
+        *complete, buffer = buffer.split(b'\0')
+        buffer = bytearray(buffer)
+        yield from complete
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('schema', help='C++ header which declares the message structures')
+    parser.add_argument('input', nargs='?', default='-', help='File or serial port to read from (default: stdin)')
+    parser.add_argument('--baud', type=int, default=115200, help='Baud rate if reading from a serial port')
+    args = parser.parse_args()
+
+    schemas = parse_schemas(args.schema)
+
+    if args.input == '-':
+        stream = sys.stdin.buffer
+    elif args.input.startswith('/dev/') or args.input.upper().startswith('COM'):
+        import serial
+        stream = serial.Serial(args.input, args.baud, timeout=None)
+    else:
+        stream = open(args.input, 'rb')
+
+    for frame in frames(stream):
+        decoded = cobs_decode(frame)
+        if decoded is None or len(decoded) < 3:
+            print('invalid frame', file=sys.stderr)
+            continue
+        if crc16_ccitt(decoded[:-2]) != struct.unpack('<H', decoded[-2:])[0]:
+            print('CRC mismatch', file=sys.stderr)
+            continue
+
+        schema = schemas.get(decoded[0])
+        if schema is None:
+            print('unknown schema {}'.format(decoded[0]), file=sys.stderr)
+            continue
+        try:
+            message = schema.decode(decoded[1:-2])
+        except ValueError as e:
+            print(e, file=sys.stderr)
+            continue
+        print(json.dumps({'type': schema.name, **message}), flush=True)
+
+
+if __name__ == '__main__':
+    main()
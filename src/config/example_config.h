@@ -39,6 +39,27 @@
 // disabled in this file.
 #define LIB_USE_BUTTON 0
 #define LIB_USE_LED 1
+#define LIB_USE_ENCODER 0
+#define LIB_USE_MOTORPWM 0
+#define LIB_USE_CURRENTSENSE 0
+#define LIB_USE_CAN 0
+#define LIB_USE_USBCDC 0
+#define LIB_USE_PARAMSTORE 0
+#define LIB_USE_DMACOPY 0
+#define LIB_USE_SERVO 0
+#define LIB_USE_INPUTCAPTURE 0
+#define LIB_USE_SBUS 0
+#define LIB_USE_PPM 0
+#define LIB_USE_CRC 0
+#define LIB_USE_CONTROLLOOP 0
+#define LIB_USE_IMU 0
+#define LIB_USE_STEPPER 0
+#define LIB_USE_SOFTPWM 0
+#define LIB_USE_BUZZER 0
+#define LIB_USE_RNG 0
+#define LIB_USE_RTC 0
+#define LIB_USE_POWERMANAGER 0
+#define LIB_USE_WATCHDOG 0
 
 // To use wrapper classes for any devices under lib, define all pin outputs here.
 // The format of the macro is
@@ -50,4 +71,12 @@
 // Other devices may require more than one pinout. These will also be defined here.
 // TODO(Derppening): Add example from UART
 
+// Devices which are driven by a peripheral also need the peripheral to be specified. For STM32F1xx devices, specify the
+// remap which connects the peripheral to the pins (if any); For STM32F4xx devices, specify the alternate function
+// number of the pins instead.
+// #define LIB_ENCODER0_TIMER TIM4
+// #define LIB_ENCODER0_CH1_PINOUT {GPIOD, GPIO12}
+// #define LIB_ENCODER0_CH2_PINOUT {GPIOD, GPIO13}
+// #define LIB_ENCODER0_REMAP core::stm32f1::GPIO::PriRemap::kTIM4
+
 #endif  // RTLIB_CONFIG_EXAMPLE_CONFIG_H_
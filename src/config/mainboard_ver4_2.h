@@ -52,4 +52,46 @@
 #define LIB_BUTTON0_PINOUT {GPIOB, GPIO6}
 #define LIB_BUTTON1_PINOUT {GPIOB, GPIO7}
 
+#define LIB_USE_ENCODER 0
+
+#define LIB_USE_MOTORPWM 0
+
+#define LIB_USE_CURRENTSENSE 0
+
+#define LIB_USE_CAN 0
+
+#define LIB_USE_USBCDC 0
+
+#define LIB_USE_PARAMSTORE 0
+
+#define LIB_USE_DMACOPY 0
+
+#define LIB_USE_SERVO 0
+
+#define LIB_USE_INPUTCAPTURE 0
+
+#define LIB_USE_SBUS 0
+
+#define LIB_USE_PPM 0
+
+#define LIB_USE_CRC 0
+
+#define LIB_USE_CONTROLLOOP 0
+
+#define LIB_USE_IMU 0
+
+#define LIB_USE_STEPPER 0
+
+#define LIB_USE_SOFTPWM 0
+
+#define LIB_USE_BUZZER 0
+
+#define LIB_USE_RNG 0
+
+#define LIB_USE_RTC 0
+
+#define LIB_USE_POWERMANAGER 0
+
+#define LIB_USE_WATCHDOG 0
+
 #endif  // RTLIB_CONFIG_MAINBOARD_VER4_2_H_
@@ -14,6 +14,72 @@
  * |          Macro        | MCU Pinout | Mainboard Designation | Active High? |
  * | :-------------------: | :--------: | :-------------------: | :----------: |
  * | @c LIB_BUTTON0_PINOUT |     PE6    |          KEY1         |   @c false   |
+ *
+ * Encoder Configuration:
+ * |   Encoder ID   | Timer | Channel 1 Pinout | Channel 2 Pinout |     Remap    |
+ * | :------------: | :---: | :--------------: | :--------------: | :----------: |
+ * |        0       |  TIM4 |       PD12       |       PD13       | @c kTIM4     |
+ *
+ * Motor PWM Configuration:
+ * | Motor PWM ID | Timer |  CH1 | CH1N |  CH2 | CH2N |  CH3 | CH3N | BKIN |       Remap       |
+ * | :----------: | :---: | :--: | :--: | :--: | :--: | :--: | :--: | :--: | :---------------: |
+ * |       0      |  TIM1 |  PE9 |  PE8 | PE11 | PE10 | PE13 | PE12 | PE15 | @c kTIM1FullRemap |
+ *
+ * Current Sense Configuration:
+ * | Current Sense ID | ADC  | Input 1 | Input 2 | Input 3 |
+ * | :--------------: | :--: | :-----: | :-----: | :-----: |
+ * |         0        | ADC1 |   PC0   |   PC1   |   PC2   |
+ *
+ * CAN Configuration:
+ * | CAN ID | Controller | RX Pinout | TX Pinout |   Remap    |
+ * | :----: | :--------: | :-------: | :-------: | :--------: |
+ * |    0   |    CAN1    |    PD0    |    PD1    | @c kCAN1PD |
+ *
+ * Parameter Store Configuration:
+ * | Parameter Store ID |   Address  | Sector Size | Number of Sectors |
+ * | :----------------: | :--------: | :---------: | :---------------: |
+ * |          0         | 0x0803E000 |     2KB     |         4         |
+ *
+ * Servo Configuration:
+ * | Servo ID | Timer | CH1 | CH2 | CH3 | CH4 |       Remap       |
+ * | :------: | :---: | :-: | :-: | :-: | :-: | :---------------: |
+ * |     0    |  TIM3 | PC6 | PC7 | PC8 | PC9 | @c kTIM3FullRemap |
+ *
+ * Input Capture Configuration:
+ * | Input Capture ID | Timer | Channel | Pinout | Remap |
+ * | :--------------: | :---: | :-----: | :----: | :---: |
+ * |         0        |  TIM5 |    1    |   PA0  |  None |
+ *
+ * SBUS Configuration:
+ * | SBUS ID | USART  | RX Pinout | Remap |
+ * | :-----: | :----: | :-------: | :---: |
+ * |    0    | USART3 |    PB11   |  None |
+ *
+ * Control Loop Configuration:
+ * | Control Loop ID | Timer |
+ * | :-------------: | :---: |
+ * |        0        |  TIM7 |
+ *
+ * IMU Configuration:
+ * | IMU ID | SPI  | SCK  | MISO | MOSI |  CS  | Data Ready | Remap |
+ * | :----: | :--: | :--: | :--: | :--: | :--: | :--------: | :---: |
+ * |    0   | SPI2 | PB13 | PB14 | PB15 | PB12 |     PC4    |  None |
+ *
+ * Stepper Configuration:
+ * | Stepper ID | Timer | Axis | Step Pinout | Direction Pinout |
+ * | :--------: | :---: | :--: | :---------: | :--------------: |
+ * |      0     |  TIM6 |   0  |     PD8     |        PD9       |
+ * |      0     |  TIM6 |   1  |     PD10    |       PD11       |
+ *
+ * Software PWM Configuration:
+ * | Software PWM ID | Timer |
+ * | :-------------: | :---: |
+ * |        0        |  TIM8 |
+ *
+ * Buzzer Configuration:
+ * | Buzzer ID | Timer | Channel | Pinout | Remap |
+ * | :-------: | :---: | :-----: | :----: | :---: |
+ * |     0     |  TIM2 |    2    |   PA1  |  None |
  */
 
 /*
@@ -48,4 +114,102 @@
 #define LIB_USE_BUTTON 1
 #define LIB_BUTTON0_PINOUT {GPIOE, GPIO6}
 
+#define LIB_USE_ENCODER 1
+#define LIB_ENCODER0_TIMER TIM4
+#define LIB_ENCODER0_CH1_PINOUT {GPIOD, GPIO12}
+#define LIB_ENCODER0_CH2_PINOUT {GPIOD, GPIO13}
+#define LIB_ENCODER0_REMAP core::stm32f1::GPIO::PriRemap::kTIM4
+
+#define LIB_USE_MOTORPWM 1
+#define LIB_MOTORPWM0_TIMER TIM1
+#define LIB_MOTORPWM0_CH1_PINOUT {GPIOE, GPIO9}
+#define LIB_MOTORPWM0_CH1N_PINOUT {GPIOE, GPIO8}
+#define LIB_MOTORPWM0_CH2_PINOUT {GPIOE, GPIO11}
+#define LIB_MOTORPWM0_CH2N_PINOUT {GPIOE, GPIO10}
+#define LIB_MOTORPWM0_CH3_PINOUT {GPIOE, GPIO13}
+#define LIB_MOTORPWM0_CH3N_PINOUT {GPIOE, GPIO12}
+#define LIB_MOTORPWM0_BKIN_PINOUT {GPIOE, GPIO15}
+#define LIB_MOTORPWM0_REMAP core::stm32f1::GPIO::PriRemap::kTIM1FullRemap
+
+#define LIB_USE_CURRENTSENSE 1
+#define LIB_CURRENTSENSE0_ADC ADC1
+#define LIB_CURRENTSENSE0_CH1_PINOUT {GPIOC, GPIO0}
+#define LIB_CURRENTSENSE0_CH2_PINOUT {GPIOC, GPIO1}
+#define LIB_CURRENTSENSE0_CH3_PINOUT {GPIOC, GPIO2}
+
+#define LIB_USE_CAN 1
+#define LIB_CAN0_CONTROLLER CAN1
+#define LIB_CAN0_RX_PINOUT {GPIOD, GPIO0}
+#define LIB_CAN0_TX_PINOUT {GPIOD, GPIO1}
+#define LIB_CAN0_REMAP core::stm32f1::GPIO::PriRemap::kCAN1PD
+
+// USB shares its packet memory with CAN on this device
+#define LIB_USE_USBCDC 0
+
+#define LIB_USE_PARAMSTORE 1
+#define LIB_PARAMSTORE0_ADDRESS 0x0803E000
+#define LIB_PARAMSTORE0_SECTOR_SIZE 0x800
+#define LIB_PARAMSTORE0_NUM_SECTORS 4
+
+#define LIB_USE_DMACOPY 1
+
+#define LIB_USE_SERVO 1
+#define LIB_SERVO0_TIMER TIM3
+#define LIB_SERVO0_CH1_PINOUT {GPIOC, GPIO6}
+#define LIB_SERVO0_CH2_PINOUT {GPIOC, GPIO7}
+#define LIB_SERVO0_CH3_PINOUT {GPIOC, GPIO8}
+#define LIB_SERVO0_CH4_PINOUT {GPIOC, GPIO9}
+#define LIB_SERVO0_REMAP core::stm32f1::GPIO::PriRemap::kTIM3FullRemap
+
+#define LIB_USE_INPUTCAPTURE 1
+#define LIB_INPUTCAPTURE0_TIMER TIM5
+#define LIB_INPUTCAPTURE0_CHANNEL 1
+#define LIB_INPUTCAPTURE0_PINOUT {GPIOA, GPIO0}
+
+// Requires an external inverter between the receiver and the RX pin
+#define LIB_USE_SBUS 1
+#define LIB_SBUS0_USART USART3
+#define LIB_SBUS0_RX_PINOUT {GPIOB, GPIO11}
+
+// Decodes PPM from an input capture timer
+#define LIB_USE_PPM 1
+
+#define LIB_USE_CRC 1
+
+#define LIB_USE_CONTROLLOOP 1
+#define LIB_CONTROLLOOP0_TIMER TIM7
+
+#define LIB_USE_IMU 1
+#define LIB_IMU0_SPI SPI2
+#define LIB_IMU0_SCK_PINOUT {GPIOB, GPIO13}
+#define LIB_IMU0_MISO_PINOUT {GPIOB, GPIO14}
+#define LIB_IMU0_MOSI_PINOUT {GPIOB, GPIO15}
+#define LIB_IMU0_CS_PINOUT {GPIOB, GPIO12}
+#define LIB_IMU0_DRDY_PINOUT {GPIOC, GPIO4}
+
+#define LIB_USE_STEPPER 1
+#define LIB_STEPPER0_TIMER TIM6
+#define LIB_STEPPER0_AXIS0_STEP_PINOUT {GPIOD, GPIO8}
+#define LIB_STEPPER0_AXIS0_DIR_PINOUT {GPIOD, GPIO9}
+#define LIB_STEPPER0_AXIS1_STEP_PINOUT {GPIOD, GPIO10}
+#define LIB_STEPPER0_AXIS1_DIR_PINOUT {GPIOD, GPIO11}
+
+#define LIB_USE_SOFTPWM 1
+#define LIB_SOFTPWM0_TIMER TIM8
+
+#define LIB_USE_BUZZER 1
+#define LIB_BUZZER0_TIMER TIM2
+#define LIB_BUZZER0_CHANNEL 2
+#define LIB_BUZZER0_PINOUT {GPIOA, GPIO1}
+
+// Seeds a PRNG from ADC1, since there is no hardware RNG
+#define LIB_USE_RNG 1
+
+// Requires a 32.768kHz crystal on PC14/PC15
+#define LIB_USE_RTC 1
+
+#define LIB_USE_POWERMANAGER 1
+
+#define LIB_USE_WATCHDOG 1
+
 #endif  // RTLIB_CONFIG_STM32F103_DEV_H_
@@ -17,6 +17,77 @@
  * | @c LIB_BUTTON0_PINOUT |     PA0    |          K_UP         |  @c Button::kPullDown |
  * | @c LIB_BUTTON1_PINOUT |     PE4    |           K0          |   @c Button::kPullUp  |
  * | @c LIB_BUTTON2_PINOUT |     PE3    |           K1          |   @c Button::kPullUp  |
+ *
+ * Encoder Configuration:
+ * |   Encoder ID   | Timer | Channel 1 Pinout | Channel 2 Pinout | Alternate Function |
+ * | :------------: | :---: | :--------------: | :--------------: | :----------------: |
+ * |        0       |  TIM4 |        PB6       |        PB7       |     @c GPIO_AF2    |
+ *
+ * Motor PWM Configuration:
+ * | Motor PWM ID | Timer |  CH1 | CH1N |  CH2 | CH2N |  CH3 | CH3N | BKIN | Alternate Function |
+ * | :----------: | :---: | :--: | :--: | :--: | :--: | :--: | :--: | :--: | :----------------: |
+ * |       0      |  TIM1 |  PE9 |  PE8 | PE11 | PE10 | PE13 | PE12 | PE15 |     @c GPIO_AF1    |
+ *
+ * Current Sense Configuration:
+ * | Current Sense ID | ADC  | Input 1 | Input 2 | Input 3 |
+ * | :--------------: | :--: | :-----: | :-----: | :-----: |
+ * |         0        | ADC1 |   PC0   |   PC1   |   PC2   |
+ *
+ * CAN Configuration:
+ * | CAN ID | Controller | RX Pinout | TX Pinout | Alternate Function |
+ * | :----: | :--------: | :-------: | :-------: | :----------------: |
+ * |    0   |    CAN1    |    PD0    |    PD1    |     @c GPIO_AF9    |
+ *
+ * USB CDC Configuration:
+ * | USB CDC ID | Peripheral | D- Pinout | D+ Pinout | Alternate Function |
+ * | :--------: | :--------: | :-------: | :-------: | :----------------: |
+ * |      0     |   OTG_FS   |    PA11   |    PA12   |    @c GPIO_AF10    |
+ *
+ * Parameter Store Configuration:
+ * | Parameter Store ID |   Address  | Sector Size | Number of Sectors |
+ * | :----------------: | :--------: | :---------: | :---------------: |
+ * |          0         | 0x08040000 |    128KB    |         2         |
+ *
+ * Servo Configuration:
+ * | Servo ID | Timer | CH1 | CH2 | CH3 | CH4 | Alternate Function |
+ * | :------: | :---: | :-: | :-: | :-: | :-: | :----------------: |
+ * |     0    |  TIM3 | PC6 | PC7 | PC8 | PC9 |     @c GPIO_AF2    |
+ *
+ * Input Capture Configuration:
+ * | Input Capture ID | Timer | Channel | Pinout | Alternate Function |
+ * | :--------------: | :---: | :-----: | :----: | :----------------: |
+ * |         0        |  TIM2 |    3    |  PB10  |     @c GPIO_AF1    |
+ *
+ * SBUS Configuration:
+ * | SBUS ID | USART  | RX Pinout | Alternate Function |
+ * | :-----: | :----: | :-------: | :----------------: |
+ * |    0    | USART2 |    PA3    |     @c GPIO_AF7    |
+ *
+ * Control Loop Configuration:
+ * | Control Loop ID | Timer |
+ * | :-------------: | :---: |
+ * |        0        |  TIM7 |
+ *
+ * IMU Configuration:
+ * | IMU ID | SPI  | SCK  | MISO | MOSI |  CS  | Data Ready |
+ * | :----: | :--: | :--: | :--: | :--: | :--: | :--------: |
+ * |    0   | SPI2 | PB13 | PB14 | PB15 | PB12 |     PC5    |
+ *
+ * Stepper Configuration:
+ * | Stepper ID | Timer | Axis | Step Pinout | Direction Pinout |
+ * | :--------: | :---: | :--: | :---------: | :--------------: |
+ * |      0     |  TIM6 |   0  |     PD8     |        PD9       |
+ * |      0     |  TIM6 |   1  |     PD10    |       PD11       |
+ *
+ * Software PWM Configuration:
+ * | Software PWM ID | Timer |
+ * | :-------------: | :---: |
+ * |        0        |  TIM5 |
+ *
+ * Buzzer Configuration:
+ * | Buzzer ID | Timer | Channel | Pinout |
+ * | :-------: | :---: | :-----: | :----: |
+ * |     0     | TIM10 |    1    |   PB8  |
  */
 
 /*
@@ -54,4 +125,108 @@
 #define LIB_BUTTON1_PINOUT {GPIOE, GPIO4}
 #define LIB_BUTTON2_PINOUT {GPIOE, GPIO3}
 
+#define LIB_USE_ENCODER 1
+#define LIB_ENCODER0_TIMER TIM4
+#define LIB_ENCODER0_CH1_PINOUT {GPIOB, GPIO6}
+#define LIB_ENCODER0_CH2_PINOUT {GPIOB, GPIO7}
+#define LIB_ENCODER0_ALTFN GPIO_AF2
+
+#define LIB_USE_MOTORPWM 1
+#define LIB_MOTORPWM0_TIMER TIM1
+#define LIB_MOTORPWM0_CH1_PINOUT {GPIOE, GPIO9}
+#define LIB_MOTORPWM0_CH1N_PINOUT {GPIOE, GPIO8}
+#define LIB_MOTORPWM0_CH2_PINOUT {GPIOE, GPIO11}
+#define LIB_MOTORPWM0_CH2N_PINOUT {GPIOE, GPIO10}
+#define LIB_MOTORPWM0_CH3_PINOUT {GPIOE, GPIO13}
+#define LIB_MOTORPWM0_CH3N_PINOUT {GPIOE, GPIO12}
+#define LIB_MOTORPWM0_BKIN_PINOUT {GPIOE, GPIO15}
+#define LIB_MOTORPWM0_ALTFN GPIO_AF1
+
+#define LIB_USE_CURRENTSENSE 1
+#define LIB_CURRENTSENSE0_ADC ADC1
+#define LIB_CURRENTSENSE0_CH1_PINOUT {GPIOC, GPIO0}
+#define LIB_CURRENTSENSE0_CH2_PINOUT {GPIOC, GPIO1}
+#define LIB_CURRENTSENSE0_CH3_PINOUT {GPIOC, GPIO2}
+
+#define LIB_USE_CAN 1
+#define LIB_CAN0_CONTROLLER CAN1
+#define LIB_CAN0_RX_PINOUT {GPIOD, GPIO0}
+#define LIB_CAN0_TX_PINOUT {GPIOD, GPIO1}
+#define LIB_CAN0_ALTFN GPIO_AF9
+
+#define LIB_USE_USBCDC 1
+#define LIB_USBCDC0_DM_PINOUT {GPIOA, GPIO11}
+#define LIB_USBCDC0_DP_PINOUT {GPIOA, GPIO12}
+#define LIB_USBCDC0_ALTFN GPIO_AF10
+
+// Sectors 6 and 7; the firmware must fit into the lower 256KB of flash
+#define LIB_USE_PARAMSTORE 1
+#define LIB_PARAMSTORE0_ADDRESS 0x08040000
+#define LIB_PARAMSTORE0_SECTOR_SIZE 0x20000
+#define LIB_PARAMSTORE0_NUM_SECTORS 2
+
+#define LIB_USE_DMACOPY 1
+
+#define LIB_USE_SERVO 1
+#define LIB_SERVO0_TIMER TIM3
+#define LIB_SERVO0_CH1_PINOUT {GPIOC, GPIO6}
+#define LIB_SERVO0_CH2_PINOUT {GPIOC, GPIO7}
+#define LIB_SERVO0_CH3_PINOUT {GPIOC, GPIO8}
+#define LIB_SERVO0_CH4_PINOUT {GPIOC, GPIO9}
+#define LIB_SERVO0_ALTFN GPIO_AF2
+
+#define LIB_USE_INPUTCAPTURE 1
+#define LIB_INPUTCAPTURE0_TIMER TIM2
+#define LIB_INPUTCAPTURE0_CHANNEL 3
+#define LIB_INPUTCAPTURE0_PINOUT {GPIOB, GPIO10}
+#define LIB_INPUTCAPTURE0_ALTFN GPIO_AF1
+
+// Requires an external inverter between the receiver and the RX pin
+#define LIB_USE_SBUS 1
+#define LIB_SBUS0_USART USART2
+#define LIB_SBUS0_RX_PINOUT {GPIOA, GPIO3}
+#define LIB_SBUS0_ALTFN GPIO_AF7
+
+// Decodes PPM from an input capture timer
+#define LIB_USE_PPM 1
+
+#define LIB_USE_CRC 1
+
+#define LIB_USE_CONTROLLOOP 1
+#define LIB_CONTROLLOOP0_TIMER TIM7
+
+#define LIB_USE_IMU 1
+#define LIB_IMU0_SPI SPI2
+#define LIB_IMU0_SCK_PINOUT {GPIOB, GPIO13}
+#define LIB_IMU0_MISO_PINOUT {GPIOB, GPIO14}
+#define LIB_IMU0_MOSI_PINOUT {GPIOB, GPIO15}
+#define LIB_IMU0_CS_PINOUT {GPIOB, GPIO12}
+#define LIB_IMU0_DRDY_PINOUT {GPIOC, GPIO5}
+#define LIB_IMU0_ALTFN GPIO_AF5
+
+#define LIB_USE_STEPPER 1
+#define LIB_STEPPER0_TIMER TIM6
+#define LIB_STEPPER0_AXIS0_STEP_PINOUT {GPIOD, GPIO8}
+#define LIB_STEPPER0_AXIS0_DIR_PINOUT {GPIOD, GPIO9}
+#define LIB_STEPPER0_AXIS1_STEP_PINOUT {GPIOD, GPIO10}
+#define LIB_STEPPER0_AXIS1_DIR_PINOUT {GPIOD, GPIO11}
+
+#define LIB_USE_SOFTPWM 1
+#define LIB_SOFTPWM0_TIMER TIM5
+
+#define LIB_USE_BUZZER 1
+#define LIB_BUZZER0_TIMER TIM10
+#define LIB_BUZZER0_CHANNEL 1
+#define LIB_BUZZER0_PINOUT {GPIOB, GPIO8}
+#define LIB_BUZZER0_ALTFN GPIO_AF3
+
+#define LIB_USE_RNG 1
+
+// Requires a 32.768kHz crystal on PC14/PC15
+#define LIB_USE_RTC 1
+
+#define LIB_USE_POWERMANAGER 1
+
+#define LIB_USE_WATCHDOG 1
+
 #endif  // RTLIB_CONFIG_STM32F407_DEV_H_
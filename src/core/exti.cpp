@@ -0,0 +1,182 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "core/exti.h"
+
+#include <array>
+#include <cassert>
+
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/stm32/exti.h>
+
+using CORE_NS::Exti;
+
+namespace {
+struct HandlerState {
+  Exti::IrqHandler handler = nullptr;
+  void* context = nullptr;
+  /**
+   * @brief Port which owns the line while a handler is set.
+   */
+  Port port = 0;
+};
+
+/**
+ * @brief Interrupt handler of each EXTI line.
+ */
+std::array<HandlerState, 16> handlers = {};
+
+/**
+ * @return Interrupt vector which serves EXTI line @p line.
+ */
+constexpr uint8_t GetIrq(const uint8_t line) {
+  switch (line) {
+    case 0:
+      return NVIC_EXTI0_IRQ;
+    case 1:
+      return NVIC_EXTI1_IRQ;
+    case 2:
+      return NVIC_EXTI2_IRQ;
+    case 3:
+      return NVIC_EXTI3_IRQ;
+    case 4:
+      return NVIC_EXTI4_IRQ;
+    default:
+      return line < 10 ? NVIC_EXTI9_5_IRQ : NVIC_EXTI15_10_IRQ;
+  }
+}
+
+/**
+ * @return @c true if an interrupt vector is used by a line other than @p line.
+ */
+bool IsIrqShared(const uint8_t line) {
+  for (uint8_t i = 0; i < handlers.size(); ++i) {
+    if (i != line && handlers[i].handler != nullptr && GetIrq(i) == GetIrq(line)) {
+      return true;
+    }
+  }
+  return false;
+}
+}  // namespace
+
+bool Exti::SetIrqHandler(const Pinout& pin,
+                         const Trigger trigger,
+                         const IrqHandler handler,
+                         void* context,
+                         const uint8_t priority) {
+  assert(pin.second != 0 && (pin.second & (pin.second - 1)) == 0);
+
+  // EXTI line masks use the same bit positions as GPIO pin masks
+  const uint32_t exti = pin.second;
+  const auto line = static_cast<uint8_t>(__builtin_ctz(pin.second));
+  const uint8_t irq = GetIrq(line);
+
+  // A line which is used by a pin of another port must neither be taken over nor disabled
+  if (handlers[line].handler != nullptr && handlers[line].port != pin.first) {
+    return false;
+  }
+
+  exti_disable_request(exti);
+  exti_reset_request(exti);
+
+  if (handler == nullptr) {
+    // Shared vectors must stay enabled for the other lines
+    if (!IsIrqShared(line)) {
+      nvic_disable_irq(irq);
+    }
+    handlers[line] = {};
+    return true;
+  }
+
+  SelectPort(pin);
+
+  switch (trigger) {
+    case Trigger::kRising:
+      exti_set_trigger(exti, EXTI_TRIGGER_RISING);
+      break;
+    case Trigger::kFalling:
+      exti_set_trigger(exti, EXTI_TRIGGER_FALLING);
+      break;
+    case Trigger::kBoth:
+      exti_set_trigger(exti, EXTI_TRIGGER_BOTH);
+      break;
+    default:
+      assert(false);
+      break;
+  }
+
+  handlers[line].handler = handler;
+  handlers[line].context = context;
+  handlers[line].port = pin.first;
+  nvic_set_priority(irq, priority);
+  nvic_enable_irq(irq);
+  exti_enable_request(exti);
+  return true;
+}
+
+void Exti::HandleIrq(const uint8_t first, const uint8_t last) {
+  for (uint8_t line = first; line <= last; ++line) {
+    const uint32_t exti = uint32_t{1} << line;
+    if (exti_get_flag_status(exti) == 0) {
+      continue;
+    }
+
+    exti_reset_request(exti);
+    const HandlerState& state = handlers[line];
+    if (state.handler != nullptr) {
+      state.handler(state.context);
+    }
+  }
+}
+
+extern "C" void exti0_isr();
+extern "C" void exti1_isr();
+extern "C" void exti2_isr();
+extern "C" void exti3_isr();
+extern "C" void exti4_isr();
+extern "C" void exti9_5_isr();
+extern "C" void exti15_10_isr();
+
+extern "C" void exti0_isr() {
+  Exti::HandleIrq(0, 0);
+}
+
+extern "C" void exti1_isr() {
+  Exti::HandleIrq(1, 1);
+}
+
+extern "C" void exti2_isr() {
+  Exti::HandleIrq(2, 2);
+}
+
+extern "C" void exti3_isr() {
+  Exti::HandleIrq(3, 3);
+}
+
+extern "C" void exti4_isr() {
+  Exti::HandleIrq(4, 4);
+}
+
+extern "C" void exti9_5_isr() {
+  Exti::HandleIrq(5, 9);
+}
+
+extern "C" void exti15_10_isr() {
+  Exti::HandleIrq(10, 15);
+}
@@ -0,0 +1,358 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "core/stm32f1/dma.h"
+
+#if defined(STM32F1)
+
+#include <algorithm>
+#include <cassert>
+
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/stm32/rcc.h>
+
+namespace core {
+namespace stm32f1 {
+
+namespace {
+constexpr uint8_t kNumDma1Channels = 7;
+constexpr uint8_t kNumDma2Channels = 5;
+
+/**
+ * @brief Runtime state of each channel.
+ */
+struct ChannelState {
+  bool claimed = false;
+  Dma::Mode mode = Dma::Mode::kNormal;
+  /**
+   * @brief Number of data items per buffer.
+   */
+  uint16_t count = 0;
+  Dma::Callback callback = nullptr;
+  void* context = nullptr;
+};
+
+/**
+ * @brief States of DMA1 channels, followed by DMA2 channels.
+ */
+std::array<ChannelState, kNumDma1Channels + kNumDma2Channels> states = {};
+
+constexpr uint8_t kIrqs[kNumDma1Channels + kNumDma2Channels] = {
+    NVIC_DMA1_CHANNEL1_IRQ, NVIC_DMA1_CHANNEL2_IRQ, NVIC_DMA1_CHANNEL3_IRQ,   NVIC_DMA1_CHANNEL4_IRQ,
+    NVIC_DMA1_CHANNEL5_IRQ, NVIC_DMA1_CHANNEL6_IRQ, NVIC_DMA1_CHANNEL7_IRQ,   NVIC_DMA2_CHANNEL1_IRQ,
+    NVIC_DMA2_CHANNEL2_IRQ, NVIC_DMA2_CHANNEL3_IRQ, NVIC_DMA2_CHANNEL4_5_IRQ, NVIC_DMA2_CHANNEL4_5_IRQ,
+};
+
+inline std::size_t GetChannelIndex(const uint32_t dma, const uint8_t channel) {
+  assert(dma == DMA1 || dma == DMA2);
+  if (dma == DMA1) {
+    assert(channel >= 1 && channel <= kNumDma1Channels);
+    return channel - 1u;
+  }
+  assert(channel >= 1 && channel <= kNumDma2Channels);
+  return kNumDma1Channels + channel - 1u;
+}
+
+constexpr uint32_t GetPriorityBits(const Dma::Priority priority) {
+  switch (priority) {
+    case Dma::Priority::kLow:
+      return DMA_CCR_PL_LOW;
+    case Dma::Priority::kMedium:
+      return DMA_CCR_PL_MEDIUM;
+    case Dma::Priority::kHigh:
+      return DMA_CCR_PL_HIGH;
+    case Dma::Priority::kVeryHigh:
+      return DMA_CCR_PL_VERY_HIGH;
+    default:
+      assert(false);
+      break;
+  }
+  return DMA_CCR_PL_LOW;
+}
+
+constexpr uint32_t GetPeripheralSizeBits(const Dma::Width width) {
+  switch (width) {
+    case Dma::Width::kByte:
+      return DMA_CCR_PSIZE_8BIT;
+    case Dma::Width::kHalfWord:
+      return DMA_CCR_PSIZE_16BIT;
+    case Dma::Width::kWord:
+      return DMA_CCR_PSIZE_32BIT;
+    default:
+      assert(false);
+      break;
+  }
+  return DMA_CCR_PSIZE_8BIT;
+}
+
+constexpr uint32_t GetMemorySizeBits(const Dma::Width width) {
+  switch (width) {
+    case Dma::Width::kByte:
+      return DMA_CCR_MSIZE_8BIT;
+    case Dma::Width::kHalfWord:
+      return DMA_CCR_MSIZE_16BIT;
+    case Dma::Width::kWord:
+      return DMA_CCR_MSIZE_32BIT;
+    default:
+      assert(false);
+      break;
+  }
+  return DMA_CCR_MSIZE_8BIT;
+}
+
+constexpr uint32_t GetWidthBytes(const Dma::Width width) {
+  switch (width) {
+    case Dma::Width::kByte:
+      return 1;
+    case Dma::Width::kHalfWord:
+      return 2;
+    case Dma::Width::kWord:
+      return 4;
+    default:
+      assert(false);
+      break;
+  }
+  return 1;
+}
+}  // namespace
+
+std::optional<Dma::Route> Dma::Allocate(const Request request, const Route* reserved, const std::size_t num_reserved) {
+  for (const RequestEntry& entry : kRequestTable) {
+    if (entry.request != request) {
+      continue;
+    }
+
+    const bool is_reserved = std::any_of(reserved, reserved + num_reserved, [&entry](const Route& route) {
+      return entry.route.Conflicts(route);
+    });
+    if (!is_reserved && Claim(entry.route)) {
+      return entry.route;
+    }
+  }
+  return std::nullopt;
+}
+
+bool Dma::Claim(const Route& route) {
+  assert(route.IsValid());
+
+  ChannelState& state = states[GetChannelIndex(route.dma, route.channel)];
+  // Claims may also be made from interrupt handlers, so the check and the update must not be interrupted
+  const bool masked = cm_mask_interrupts(true);
+  if (state.claimed) {
+    cm_mask_interrupts(masked);
+    return false;
+  }
+  state = ChannelState();
+  state.claimed = true;
+  cm_mask_interrupts(masked);
+
+  rcc_periph_clock_enable(route.dma == DMA1 ? RCC_DMA1 : RCC_DMA2);
+  return true;
+}
+
+void Dma::Release(const Route& route) {
+  Stop(route);
+  states[GetChannelIndex(route.dma, route.channel)].claimed = false;
+}
+
+void Dma::Start(const Route& route, const Transfer& transfer) {
+  const std::size_t index = GetChannelIndex(route.dma, route.channel);
+  ChannelState& state = states[index];
+  assert(state.claimed);
+  assert(transfer.direction != Direction::kMemToMem || transfer.mode == Mode::kNormal);
+
+  Stop(route);
+
+  state.mode = transfer.mode;
+  state.count = transfer.count;
+  state.callback = transfer.callback;
+  state.context = transfer.context;
+
+  const uint32_t dma = route.dma;
+  const uint8_t channel = route.channel;
+
+  // For memory-to-memory transfers, the peripheral address is the source
+  if (transfer.direction == Direction::kMemToPeriph) {
+    dma_set_read_from_memory(dma, channel);
+  } else {
+    dma_set_read_from_peripheral(dma, channel);
+  }
+  if (transfer.direction == Direction::kMemToMem) {
+    dma_enable_mem2mem_mode(dma, channel);
+  }
+
+  dma_set_priority(dma, channel, GetPriorityBits(transfer.priority));
+  dma_set_peripheral_size(dma, channel, GetPeripheralSizeBits(transfer.peripheral_width));
+  dma_set_memory_size(dma, channel, GetMemorySizeBits(transfer.memory_width));
+  if (transfer.peripheral_increment) {
+    dma_enable_peripheral_increment_mode(dma, channel);
+  }
+  if (transfer.memory_increment) {
+    dma_enable_memory_increment_mode(dma, channel);
+  }
+
+  dma_set_peripheral_address(dma, channel, transfer.peripheral);
+  dma_set_memory_address(dma, channel, reinterpret_cast<uint32_t>(transfer.memory0));
+
+  switch (transfer.mode) {
+    case Mode::kNormal:
+      dma_set_number_of_data(dma, channel, transfer.count);
+      break;
+    case Mode::kCircular:
+      dma_set_number_of_data(dma, channel, transfer.count);
+      dma_enable_circular_mode(dma, channel);
+      break;
+    case Mode::kDoubleBuffer:
+      // Emulated by a circular transfer over both buffers, which reports each buffer at half and full transfer
+      assert(transfer.count <= 0x7FFF);
+      assert(static_cast<uint8_t*>(transfer.memory1) ==
+          static_cast<uint8_t*>(transfer.memory0) + transfer.count * GetWidthBytes(transfer.memory_width));
+      dma_set_number_of_data(dma, channel, static_cast<uint16_t>(transfer.count * 2));
+      dma_enable_circular_mode(dma, channel);
+      break;
+    default:
+      assert(false);
+      break;
+  }
+
+  if (transfer.callback != nullptr) {
+    dma_enable_transfer_complete_interrupt(dma, channel);
+    dma_enable_transfer_error_interrupt(dma, channel);
+    if (transfer.half_transfer_irq || transfer.mode == Mode::kDoubleBuffer) {
+      dma_enable_half_transfer_interrupt(dma, channel);
+    }
+
+    nvic_set_priority(kIrqs[index], transfer.irq_priority);
+    nvic_enable_irq(kIrqs[index]);
+  }
+
+  dma_enable_channel(dma, channel);
+}
+
+void Dma::Stop(const Route& route) {
+  // The interrupt is left enabled in the NVIC, since channels 4 and 5 of DMA2 share it. Resetting the channel disables
+  // all of its interrupt sources instead.
+  dma_channel_reset(route.dma, route.channel);
+}
+
+bool Dma::IsBusy(const Route& route) {
+  // The enable bit is not cleared at the end of a normal transfer, so check the remaining count as well
+  const uint32_t ccr = DMA_CCR(route.dma, uint32_t{route.channel});
+  return (ccr & DMA_CCR_EN) != 0 && dma_get_number_of_data(route.dma, route.channel) != 0;
+}
+
+uint16_t Dma::GetRemaining(const Route& route) {
+  const ChannelState& state = states[GetChannelIndex(route.dma, route.channel)];
+  const uint16_t remaining = dma_get_number_of_data(route.dma, route.channel);
+  if (state.mode == Mode::kDoubleBuffer && remaining > state.count) {
+    return static_cast<uint16_t>(remaining - state.count);
+  }
+  return remaining;
+}
+
+void Dma::HandleIrq(const uint32_t dma, const uint8_t channel) {
+  const ChannelState& state = states[GetChannelIndex(dma, channel)];
+
+  // Channels without callbacks have no interrupt sources enabled, but may still raise flags
+  if (state.callback == nullptr) {
+    return;
+  }
+
+  if (dma_get_interrupt_flag(dma, channel, DMA_TEIF)) {
+    dma_clear_interrupt_flags(dma, channel, DMA_TEIF | DMA_HTIF | DMA_TCIF | DMA_GIF);
+    state.callback(Event::kError, state.context);
+    return;
+  }
+
+  if (dma_get_interrupt_flag(dma, channel, DMA_HTIF)) {
+    dma_clear_interrupt_flags(dma, channel, DMA_HTIF);
+    state.callback(state.mode == Mode::kDoubleBuffer ? Event::kBuffer0Complete : Event::kHalfTransfer, state.context);
+  }
+
+  if (dma_get_interrupt_flag(dma, channel, DMA_TCIF)) {
+    dma_clear_interrupt_flags(dma, channel, DMA_TCIF);
+    state.callback(state.mode == Mode::kDoubleBuffer ? Event::kBuffer1Complete : Event::kTransferComplete,
+                   state.context);
+  }
+}
+
+}  // namespace stm32f1
+}  // namespace core
+
+using core::stm32f1::Dma;
+
+extern "C" void dma1_channel1_isr();
+extern "C" void dma1_channel2_isr();
+extern "C" void dma1_channel3_isr();
+extern "C" void dma1_channel4_isr();
+extern "C" void dma1_channel5_isr();
+extern "C" void dma1_channel6_isr();
+extern "C" void dma1_channel7_isr();
+extern "C" void dma2_channel1_isr();
+extern "C" void dma2_channel2_isr();
+extern "C" void dma2_channel3_isr();
+extern "C" void dma2_channel4_5_isr();
+
+extern "C" void dma1_channel1_isr() {
+  Dma::HandleIrq(DMA1, 1);
+}
+
+extern "C" void dma1_channel2_isr() {
+  Dma::HandleIrq(DMA1, 2);
+}
+
+extern "C" void dma1_channel3_isr() {
+  Dma::HandleIrq(DMA1, 3);
+}
+
+extern "C" void dma1_channel4_isr() {
+  Dma::HandleIrq(DMA1, 4);
+}
+
+extern "C" void dma1_channel5_isr() {
+  Dma::HandleIrq(DMA1, 5);
+}
+
+extern "C" void dma1_channel6_isr() {
+  Dma::HandleIrq(DMA1, 6);
+}
+
+extern "C" void dma1_channel7_isr() {
+  Dma::HandleIrq(DMA1, 7);
+}
+
+extern "C" void dma2_channel1_isr() {
+  Dma::HandleIrq(DMA2, 1);
+}
+
+extern "C" void dma2_channel2_isr() {
+  Dma::HandleIrq(DMA2, 2);
+}
+
+extern "C" void dma2_channel3_isr() {
+  Dma::HandleIrq(DMA2, 3);
+}
+
+extern "C" void dma2_channel4_5_isr() {
+  Dma::HandleIrq(DMA2, 4);
+  Dma::HandleIrq(DMA2, 5);
+}
+
+#endif  // defined(STM32F1)
@@ -0,0 +1,106 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_CORE_STM32F1_EXTI_H_
+#define RTLIB_CORE_STM32F1_EXTI_H_
+
+#if defined(STM32F1)
+
+#include <cstdint>
+
+#include "core/util.h"
+
+namespace core {
+namespace stm32f1 {
+
+/**
+ * @brief STM32F1xx-specific dispatcher for external interrupts of GPIO pins.
+ *
+ * Each of the 16 EXTI lines serves the pin with the same number on one GPIO port, e.g. line 5 serves PA5 or PB5, but
+ * not both. Lines 5-9 and 10-15 share one interrupt vector each. This class owns all EXTI interrupt vectors and
+ * dispatches each line to its own handler, so that drivers do not need to define the vectors themselves.
+ */
+class Exti final {
+ public:
+  /**
+   * @brief Default constructor for Exti.
+   *
+   * This constructor is disabled to enforce a static class pattern.
+   */
+  Exti() = delete;
+
+  /**
+   * @brief Enumeration of edges which trigger an interrupt.
+   */
+  enum struct Trigger {
+    kRising,
+    kFalling,
+    kBoth
+  };
+
+  /**
+   * @brief Type definition for EXTI interrupt handlers.
+   *
+   * @param context User-defined pointer, as passed to SetIrqHandler().
+   */
+  using IrqHandler = void (*)(void* context);
+
+  /**
+   * @brief Routes the external interrupt of a pin to a handler.
+   *
+   * The pending flag of the line is cleared before the handler is invoked. The pin must already be configured as an
+   * input.
+   *
+   * @param pin Pin to trigger the interrupt. Only one port can use each pin number at a time.
+   * @param trigger Edges which trigger the interrupt
+   * @param handler Function to invoke from the interrupt handler, or @c nullptr to disable the interrupt of @p pin
+   * @param context User-defined pointer which will be passed to @p handler
+   * @param priority NVIC priority of the interrupt line. Lines which share a vector also share its priority.
+   * @return @c false if the line is used by a pin with the same number on another port, in which case the line is left
+   * unchanged.
+   */
+  static bool SetIrqHandler(const Pinout& pin,
+                            Trigger trigger,
+                            IrqHandler handler,
+                            void* context = nullptr,
+                            uint8_t priority = 0x80);
+
+  /**
+   * @brief Handles the pending interrupts of a range of EXTI lines.
+   *
+   * @warning This function is invoked by the EXTI interrupt handlers. Do not call this function directly.
+   *
+   * @param first First line served by the interrupt vector
+   * @param last Last line served by the interrupt vector
+   */
+  static void HandleIrq(uint8_t first, uint8_t last);
+
+ private:
+  /**
+   * @brief Connects the EXTI line of a pin to the port of the pin.
+   */
+  static void SelectPort(const Pinout& pin);
+};
+
+}  // namespace stm32f1
+}  // namespace core
+
+#endif  // defined(STM32F1)
+
+#endif  // RTLIB_CORE_STM32F1_EXTI_H_
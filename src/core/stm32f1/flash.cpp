@@ -0,0 +1,50 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "core/stm32f1/flash.h"
+
+#if defined(STM32F1)
+
+#include <cassert>
+
+#include <libopencm3/stm32/flash.h>
+
+namespace core {
+namespace stm32f1 {
+
+void Flash::Erase(const uint32_t address) {
+  flash_unlock();
+  flash_erase_page(address);
+  flash_lock();
+}
+
+void Flash::Program(const uint32_t address, const uint32_t* data, const std::size_t count) {
+  assert(address % sizeof(uint32_t) == 0);
+
+  flash_unlock();
+  for (std::size_t i = 0; i < count; ++i) {
+    flash_program_word(static_cast<uint32_t>(address + i * sizeof(uint32_t)), data[i]);
+  }
+  flash_lock();
+}
+
+}  // namespace stm32f1
+}  // namespace core
+
+#endif  // defined(STM32F1)
@@ -21,21 +21,61 @@
 
 #if defined(STM32F1)
 
+#include <array>
 #include <cassert>
+#include <cstddef>
+#include <limits>
 #include <utility>
 
+#include <libopencm3/cm3/cortex.h>
 #include <libopencm3/stm32/rcc.h>
 
 namespace core {
 namespace stm32f1 {
 
+namespace {
+/**
+ * @brief Number of GPIO objects which manage a pin of each port.
+ */
+std::array<uint8_t, 7> port_refs = {};
+
+inline std::size_t GetPortIndex(const Port port) {
+  // Port registers are laid out at a fixed stride from GPIOA
+  const std::size_t index = (port - GPIOA) / (GPIOB - GPIOA);
+  assert(index < port_refs.size());
+  return index;
+}
+
+inline rcc_periph_clken GetRcc(const Port port) {
+  switch (port) {
+    case GPIOA:
+      return RCC_GPIOA;
+    case GPIOB:
+      return RCC_GPIOB;
+    case GPIOC:
+      return RCC_GPIOC;
+    case GPIOD:
+      return RCC_GPIOD;
+    case GPIOE:
+      return RCC_GPIOE;
+    case GPIOF:
+      return RCC_GPIOF;
+    case GPIOG:
+      return RCC_GPIOG;
+    default:
+      assert(false);
+      return RCC_GPIOA;
+  }
+}
+}  // namespace
+
 GPIO::GPIO(const Config& config) :
     GPIO(config.pin, config.cnf, config.mode) {}
 
 GPIO::GPIO(Pinout pin, Configuration cnf, Mode mode) :
     pin_(std::move(pin)) {
   // Use external oscillator for RCC
-  rcc_clock_setup_in_hse_8mhz_out_72mhz();
+  InitSysClock();
 
   // Initialize the RCC and enable the GPIO
   InitRcc(pin_.first);
@@ -46,33 +86,48 @@ void GPIO::Init(const Configuration cnf, const Mode mode) const {
   gpio_set_mode(pin_.first, static_cast<uint8_t>(mode), static_cast<uint8_t>(cnf), pin_.second);
 }
 
+GPIO::~GPIO() {
+  if (pin_.first != Port{}) {
+    ReleaseRcc(pin_.first);
+  }
+}
+
+GPIO::GPIO(GPIO&& other) noexcept :
+    pin_(std::exchange(other.pin_, Pinout{})) {}
+
+GPIO& GPIO::operator=(GPIO&& other) noexcept {
+  if (this != &other) {
+    if (pin_.first != Port{}) {
+      ReleaseRcc(pin_.first);
+    }
+    pin_ = std::exchange(other.pin_, Pinout{});
+  }
+  return *this;
+}
+
+void GPIO::InitSysClock() {
+  rcc_clock_setup_in_hse_8mhz_out_72mhz();
+}
+
 void GPIO::InitRcc(const Port port) const {
-  switch (port) {
-    case GPIOA:
-      rcc_periph_clock_enable(RCC_GPIOA);
-      break;
-    case GPIOB:
-      rcc_periph_clock_enable(RCC_GPIOB);
-      break;
-    case GPIOC:
-      rcc_periph_clock_enable(RCC_GPIOC);
-      break;
-    case GPIOD:
-      rcc_periph_clock_enable(RCC_GPIOD);
-      break;
-    case GPIOE:
-      rcc_periph_clock_enable(RCC_GPIOE);
-      break;
-    case GPIOF:
-      rcc_periph_clock_enable(RCC_GPIOF);
-      break;
-    case GPIOG:
-      rcc_periph_clock_enable(RCC_GPIOG);
-      break;
-    default:
-      assert(false);
-      break;
+  // GPIO objects may also be created and destroyed from interrupt handlers
+  const bool masked = cm_mask_interrupts(true);
+  uint8_t& refs = port_refs[GetPortIndex(port)];
+  assert(refs < std::numeric_limits<uint8_t>::max());
+  if (refs++ == 0) {
+    rcc_periph_clock_enable(GetRcc(port));
+  }
+  cm_mask_interrupts(masked);
+}
+
+void GPIO::ReleaseRcc(const Port port) const {
+  const bool masked = cm_mask_interrupts(true);
+  uint8_t& refs = port_refs[GetPortIndex(port)];
+  assert(refs > 0);
+  if (--refs == 0) {
+    rcc_periph_clock_disable(GetRcc(port));
   }
+  cm_mask_interrupts(masked);
 }
 
 bool GPIO::Read() const {
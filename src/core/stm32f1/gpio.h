@@ -698,23 +698,30 @@ class GPIO final {
   GPIO(Pinout pin, Configuration cnf, Mode mode);
 
   /**
-   * Default trivial destructor.
+   * @brief Destructor.
+   *
+   * Disables the clock of the port if no other GPIO object manages a pin of the same port. The pin keeps its
+   * configuration.
    */
-  ~GPIO() = default;
+  ~GPIO();
 
   /**
    * @brief Move constructor.
    *
+   * The moved-from object no longer manages any pin.
+   *
    * @param other GPIO object to move from
    */
-  GPIO(GPIO&& other) noexcept = default;
+  GPIO(GPIO&& other) noexcept;
   /**
    * @brief Move assignment operator.
    *
+   * The moved-from object no longer manages any pin.
+   *
    * @param other GPIO object to move from
    * @return Reference to the moved GPIO.
    */
-  GPIO& operator=(GPIO&& other) noexcept = default;
+  GPIO& operator=(GPIO&& other) noexcept;
 
   /**
    * @brief Copy constructor.
@@ -753,6 +760,14 @@ class GPIO final {
    */
   void Reset() const;
 
+  /**
+   * @brief Configures the system clock to run from the external oscillator through the PLL.
+   *
+   * This function is invoked by every constructor. It must be invoked again after waking up from stop mode, since the
+   * device then runs from the internal oscillator.
+   */
+  static void InitSysClock();
+
   /**
    * @brief Configures the primary remap functionality of all GPIOs.
    *
@@ -826,6 +841,14 @@ class GPIO final {
    * @param port The GPIO port which should be initialized
    */
   void InitRcc(Port port) const;
+  /**
+   * @brief Releases an RCC Clock which was initialized by InitRcc().
+   *
+   * The clock is disabled when the last GPIO object of the port releases it.
+   *
+   * @param port The GPIO port which is no longer used by this object
+   */
+  void ReleaseRcc(Port port) const;
 
   /**
    * @brief Retrieves the GPIO pinout currently managed by this object.
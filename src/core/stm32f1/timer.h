@@ -0,0 +1,119 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_CORE_STM32F1_TIMER_H_
+#define RTLIB_CORE_STM32F1_TIMER_H_
+
+#if defined(STM32F1)
+
+#include <cstdint>
+
+#include <libopencm3/stm32/timer.h>
+
+namespace core {
+namespace stm32f1 {
+
+/**
+ * @brief STM32F1xx-specific helpers for hardware timers.
+ *
+ * This class does not manage any timer by itself. Instead, it provides the device-specific lookups (clocks, counter
+ * widths) which every timer-based driver needs, so that those drivers can be written once for both device families.
+ *
+ * Timers are identified by their libopencm3 base address, e.g. @c TIM1.
+ */
+class Timer final {
+ public:
+  /**
+   * @brief Default constructor for Timer.
+   *
+   * This constructor is disabled to enforce a static class pattern.
+   */
+  Timer() = delete;
+
+  /**
+   * @brief Enables the RCC clock of a timer and resets all of its registers.
+   *
+   * @param timer Timer to initialize. Only @c TIM1 to @c TIM8 are supported.
+   */
+  static void InitRcc(uint32_t timer);
+
+  /**
+   * @brief Retrieves the frequency of the clock which feeds the timer prescaler.
+   *
+   * When the APB prescaler is not 1, the timer clock runs at twice the APB frequency. This function takes that into
+   * account.
+   *
+   * @param timer Timer to query
+   * @return Input clock frequency of the timer, in Hz.
+   */
+  static uint32_t GetClockFreq(uint32_t timer);
+
+  /**
+   * @brief Checks whether a timer has a 32-bit counter.
+   *
+   * @param timer Timer to query
+   * @return Always @c false, since all timers on STM32F1xx devices are 16-bit.
+   */
+  static constexpr bool Is32Bit(uint32_t /* timer */) { return false; }
+
+  /**
+   * @brief Checks whether a timer is an advanced-control timer, i.e. has complementary outputs and break input.
+   *
+   * @param timer Timer to query
+   * @return @c true if @p timer is @c TIM1 or @c TIM8.
+   */
+  static constexpr bool IsAdvanced(uint32_t timer) { return timer == TIM1 || timer == TIM8; }
+
+  /**
+   * @brief Type definition for timer interrupt handlers.
+   *
+   * @param context User-defined pointer, as passed to SetIrqHandler().
+   */
+  using IrqHandler = void (*)(void* context);
+
+  /**
+   * @brief Routes all interrupts of a timer to a handler.
+   *
+   * Each timer can only have one handler, which is responsible for checking and clearing the status flags of the
+   * timer. Advanced-control timers have separate interrupt lines for break, update, trigger and capture/compare
+   * events, which all invoke the same handler.
+   *
+   * @param timer Timer whose interrupts to handle
+   * @param handler Function to invoke from the interrupt handlers, or @c nullptr to disable the interrupts of @p timer
+   * @param context User-defined pointer which will be passed to @p handler
+   * @param priority NVIC priority of the interrupt lines
+   */
+  static void SetIrqHandler(uint32_t timer, IrqHandler handler, void* context = nullptr, uint8_t priority = 0x80);
+
+  /**
+   * @brief Handles an interrupt of a timer.
+   *
+   * @warning This function is invoked by the timer interrupt handlers. Do not call this function directly.
+   *
+   * @param timer Timer which raised the interrupt
+   */
+  static void HandleIrq(uint32_t timer);
+};
+
+}  // namespace stm32f1
+}  // namespace core
+
+#endif  // defined(STM32F1)
+
+#endif  // RTLIB_CORE_STM32F1_TIMER_H_
@@ -0,0 +1,376 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "core/stm32f4/dma.h"
+
+#if defined(STM32F4)
+
+#include <algorithm>
+#include <cassert>
+
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/stm32/rcc.h>
+
+namespace core {
+namespace stm32f4 {
+
+namespace {
+constexpr uint8_t kNumStreams = 8;
+
+/**
+ * @brief Runtime state of each stream.
+ */
+struct StreamState {
+  bool claimed = false;
+  Dma::Mode mode = Dma::Mode::kNormal;
+  Dma::Callback callback = nullptr;
+  void* context = nullptr;
+};
+
+/**
+ * @brief States of DMA1 and DMA2 streams respectively.
+ */
+std::array<std::array<StreamState, kNumStreams>, 2> states = {};
+
+constexpr uint8_t kIrqs[2][kNumStreams] = {
+    {NVIC_DMA1_STREAM0_IRQ, NVIC_DMA1_STREAM1_IRQ, NVIC_DMA1_STREAM2_IRQ, NVIC_DMA1_STREAM3_IRQ,
+     NVIC_DMA1_STREAM4_IRQ, NVIC_DMA1_STREAM5_IRQ, NVIC_DMA1_STREAM6_IRQ, NVIC_DMA1_STREAM7_IRQ},
+    {NVIC_DMA2_STREAM0_IRQ, NVIC_DMA2_STREAM1_IRQ, NVIC_DMA2_STREAM2_IRQ, NVIC_DMA2_STREAM3_IRQ,
+     NVIC_DMA2_STREAM4_IRQ, NVIC_DMA2_STREAM5_IRQ, NVIC_DMA2_STREAM6_IRQ, NVIC_DMA2_STREAM7_IRQ},
+};
+
+inline std::size_t GetDmaIndex(const uint32_t dma) {
+  assert(dma == DMA1 || dma == DMA2);
+  return dma == DMA1 ? 0 : 1;
+}
+
+inline StreamState& GetState(const uint32_t dma, const uint8_t stream) {
+  assert(stream < kNumStreams);
+  return states[GetDmaIndex(dma)][stream];
+}
+
+constexpr uint32_t GetPriorityBits(const Dma::Priority priority) {
+  switch (priority) {
+    case Dma::Priority::kLow:
+      return DMA_SxCR_PL_LOW;
+    case Dma::Priority::kMedium:
+      return DMA_SxCR_PL_MEDIUM;
+    case Dma::Priority::kHigh:
+      return DMA_SxCR_PL_HIGH;
+    case Dma::Priority::kVeryHigh:
+      return DMA_SxCR_PL_VERY_HIGH;
+    default:
+      assert(false);
+      break;
+  }
+  return DMA_SxCR_PL_LOW;
+}
+
+constexpr uint32_t GetPeripheralSizeBits(const Dma::Width width) {
+  switch (width) {
+    case Dma::Width::kByte:
+      return DMA_SxCR_PSIZE_8BIT;
+    case Dma::Width::kHalfWord:
+      return DMA_SxCR_PSIZE_16BIT;
+    case Dma::Width::kWord:
+      return DMA_SxCR_PSIZE_32BIT;
+    default:
+      assert(false);
+      break;
+  }
+  return DMA_SxCR_PSIZE_8BIT;
+}
+
+constexpr uint32_t GetMemorySizeBits(const Dma::Width width) {
+  switch (width) {
+    case Dma::Width::kByte:
+      return DMA_SxCR_MSIZE_8BIT;
+    case Dma::Width::kHalfWord:
+      return DMA_SxCR_MSIZE_16BIT;
+    case Dma::Width::kWord:
+      return DMA_SxCR_MSIZE_32BIT;
+    default:
+      assert(false);
+      break;
+  }
+  return DMA_SxCR_MSIZE_8BIT;
+}
+
+constexpr uint32_t GetDirectionBits(const Dma::Direction direction) {
+  switch (direction) {
+    case Dma::Direction::kPeriphToMem:
+      return DMA_SxCR_DIR_PERIPHERAL_TO_MEM;
+    case Dma::Direction::kMemToPeriph:
+      return DMA_SxCR_DIR_MEM_TO_PERIPHERAL;
+    case Dma::Direction::kMemToMem:
+      return DMA_SxCR_DIR_MEM_TO_MEM;
+    default:
+      assert(false);
+      break;
+  }
+  return DMA_SxCR_DIR_PERIPHERAL_TO_MEM;
+}
+}  // namespace
+
+std::optional<Dma::Route> Dma::Allocate(const Request request, const Route* reserved, const std::size_t num_reserved) {
+  for (const RequestEntry& entry : kRequestTable) {
+    if (entry.request != request) {
+      continue;
+    }
+
+    const bool is_reserved = std::any_of(reserved, reserved + num_reserved, [&entry](const Route& route) {
+      return entry.route.Conflicts(route);
+    });
+    if (!is_reserved && Claim(entry.route)) {
+      return entry.route;
+    }
+  }
+  return std::nullopt;
+}
+
+bool Dma::Claim(const Route& route) {
+  assert(route.IsValid());
+
+  StreamState& state = GetState(route.dma, route.stream);
+  // Claims may also be made from interrupt handlers, so the check and the update must not be interrupted
+  const bool masked = cm_mask_interrupts(true);
+  if (state.claimed) {
+    cm_mask_interrupts(masked);
+    return false;
+  }
+  state = StreamState();
+  state.claimed = true;
+  cm_mask_interrupts(masked);
+
+  rcc_periph_clock_enable(route.dma == DMA1 ? RCC_DMA1 : RCC_DMA2);
+  return true;
+}
+
+void Dma::Release(const Route& route) {
+  Stop(route);
+  GetState(route.dma, route.stream).claimed = false;
+}
+
+void Dma::Start(const Route& route, const Transfer& transfer) {
+  StreamState& state = GetState(route.dma, route.stream);
+  assert(state.claimed);
+  assert(transfer.direction != Direction::kMemToMem || (route.dma == DMA2 && transfer.mode == Mode::kNormal));
+  assert(transfer.mode != Mode::kDoubleBuffer || transfer.memory1 != nullptr);
+
+  Stop(route);
+
+  state.mode = transfer.mode;
+  state.callback = transfer.callback;
+  state.context = transfer.context;
+
+  const uint32_t dma = route.dma;
+  const uint8_t stream = route.stream;
+
+  dma_channel_select(dma, stream, DMA_SxCR_CHSEL(route.channel));
+  dma_set_transfer_mode(dma, stream, GetDirectionBits(transfer.direction));
+  dma_set_priority(dma, stream, GetPriorityBits(transfer.priority));
+  dma_set_peripheral_size(dma, stream, GetPeripheralSizeBits(transfer.peripheral_width));
+  dma_set_memory_size(dma, stream, GetMemorySizeBits(transfer.memory_width));
+  if (transfer.peripheral_increment) {
+    dma_enable_peripheral_increment_mode(dma, stream);
+  }
+  if (transfer.memory_increment) {
+    dma_enable_memory_increment_mode(dma, stream);
+  }
+
+  dma_set_peripheral_address(dma, stream, transfer.peripheral);
+  dma_set_memory_address(dma, stream, reinterpret_cast<uint32_t>(transfer.memory0));
+  dma_set_number_of_data(dma, stream, transfer.count);
+
+  switch (transfer.mode) {
+    case Mode::kNormal:
+      break;
+    case Mode::kCircular:
+      dma_enable_circular_mode(dma, stream);
+      break;
+    case Mode::kDoubleBuffer:
+      dma_set_memory_address_1(dma, stream, reinterpret_cast<uint32_t>(transfer.memory1));
+      dma_enable_double_buffer_mode(dma, stream);
+      break;
+    default:
+      assert(false);
+      break;
+  }
+
+  // Direct mode is not allowed for memory-to-memory transfers, and cannot pack data items of different widths
+  if (transfer.direction == Direction::kMemToMem || transfer.peripheral_width != transfer.memory_width) {
+    dma_enable_fifo_mode(dma, stream);
+    dma_set_fifo_threshold(dma, stream, DMA_SxFCR_FTH_4_4_FIFO);
+  }
+
+  if (transfer.callback != nullptr) {
+    dma_enable_transfer_complete_interrupt(dma, stream);
+    dma_enable_transfer_error_interrupt(dma, stream);
+    if (transfer.half_transfer_irq) {
+      dma_enable_half_transfer_interrupt(dma, stream);
+    }
+
+    const uint8_t irq = kIrqs[GetDmaIndex(dma)][stream];
+    nvic_set_priority(irq, transfer.irq_priority);
+    nvic_enable_irq(irq);
+  }
+
+  dma_enable_stream(dma, stream);
+}
+
+void Dma::Stop(const Route& route) {
+  const uint32_t dma = route.dma;
+  const uint8_t stream = route.stream;
+
+  nvic_disable_irq(kIrqs[GetDmaIndex(dma)][stream]);
+
+  // The stream only stops after the current data item is transferred
+  dma_disable_stream(dma, stream);
+  while ((DMA_SCR(dma, stream) & DMA_SxCR_EN) != 0) {
+  }
+  dma_stream_reset(dma, stream);
+}
+
+bool Dma::IsBusy(const Route& route) { return (DMA_SCR(route.dma, route.stream) & DMA_SxCR_EN) != 0; }
+
+uint16_t Dma::GetRemaining(const Route& route) { return dma_get_number_of_data(route.dma, route.stream); }
+
+void Dma::HandleIrq(const uint32_t dma, const uint8_t stream) {
+  const StreamState& state = GetState(dma, stream);
+
+  if (dma_get_interrupt_flag(dma, stream, DMA_TEIF)) {
+    dma_clear_interrupt_flags(dma, stream, DMA_TEIF | DMA_HTIF | DMA_TCIF);
+    if (state.callback != nullptr) {
+      state.callback(Event::kError, state.context);
+    }
+    return;
+  }
+
+  if (dma_get_interrupt_flag(dma, stream, DMA_HTIF)) {
+    dma_clear_interrupt_flags(dma, stream, DMA_HTIF);
+    if (state.callback != nullptr) {
+      state.callback(Event::kHalfTransfer, state.context);
+    }
+  }
+
+  if (dma_get_interrupt_flag(dma, stream, DMA_TCIF)) {
+    dma_clear_interrupt_flags(dma, stream, DMA_TCIF);
+
+    Event event = Event::kTransferComplete;
+    if (state.mode == Mode::kDoubleBuffer) {
+      // The stream has already switched to the other buffer
+      event = dma_get_target(dma, stream) == 0 ? Event::kBuffer1Complete : Event::kBuffer0Complete;
+    }
+    if (state.callback != nullptr) {
+      state.callback(event, state.context);
+    }
+  }
+
+  // FIFO errors are not fatal, and may occur in direct mode when the stream is started
+  dma_clear_interrupt_flags(dma, stream, DMA_FEIF | DMA_DMEIF);
+}
+
+}  // namespace stm32f4
+}  // namespace core
+
+using core::stm32f4::Dma;
+
+extern "C" void dma1_stream0_isr();
+extern "C" void dma1_stream1_isr();
+extern "C" void dma1_stream2_isr();
+extern "C" void dma1_stream3_isr();
+extern "C" void dma1_stream4_isr();
+extern "C" void dma1_stream5_isr();
+extern "C" void dma1_stream6_isr();
+extern "C" void dma1_stream7_isr();
+extern "C" void dma2_stream0_isr();
+extern "C" void dma2_stream1_isr();
+extern "C" void dma2_stream2_isr();
+extern "C" void dma2_stream3_isr();
+extern "C" void dma2_stream4_isr();
+extern "C" void dma2_stream5_isr();
+extern "C" void dma2_stream6_isr();
+extern "C" void dma2_stream7_isr();
+
+extern "C" void dma1_stream0_isr() {
+  Dma::HandleIrq(DMA1, 0);
+}
+
+extern "C" void dma1_stream1_isr() {
+  Dma::HandleIrq(DMA1, 1);
+}
+
+extern "C" void dma1_stream2_isr() {
+  Dma::HandleIrq(DMA1, 2);
+}
+
+extern "C" void dma1_stream3_isr() {
+  Dma::HandleIrq(DMA1, 3);
+}
+
+extern "C" void dma1_stream4_isr() {
+  Dma::HandleIrq(DMA1, 4);
+}
+
+extern "C" void dma1_stream5_isr() {
+  Dma::HandleIrq(DMA1, 5);
+}
+
+extern "C" void dma1_stream6_isr() {
+  Dma::HandleIrq(DMA1, 6);
+}
+
+extern "C" void dma1_stream7_isr() {
+  Dma::HandleIrq(DMA1, 7);
+}
+
+extern "C" void dma2_stream0_isr() {
+  Dma::HandleIrq(DMA2, 0);
+}
+
+extern "C" void dma2_stream1_isr() {
+  Dma::HandleIrq(DMA2, 1);
+}
+
+extern "C" void dma2_stream2_isr() {
+  Dma::HandleIrq(DMA2, 2);
+}
+
+extern "C" void dma2_stream3_isr() {
+  Dma::HandleIrq(DMA2, 3);
+}
+
+extern "C" void dma2_stream4_isr() {
+  Dma::HandleIrq(DMA2, 4);
+}
+
+extern "C" void dma2_stream5_isr() {
+  Dma::HandleIrq(DMA2, 5);
+}
+
+extern "C" void dma2_stream6_isr() {
+  Dma::HandleIrq(DMA2, 6);
+}
+
+extern "C" void dma2_stream7_isr() {
+  Dma::HandleIrq(DMA2, 7);
+}
+
+#endif  // defined(STM32F4)
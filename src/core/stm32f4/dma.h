@@ -0,0 +1,518 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_CORE_STM32F4_DMA_H_
+#define RTLIB_CORE_STM32F4_DMA_H_
+
+#if defined(STM32F4)
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+
+#include <libopencm3/stm32/dma.h>
+
+namespace core {
+namespace stm32f4 {
+
+/**
+ * @brief STM32F4xx-specific HAL implementation for DMA streams.
+ *
+ * This class owns all DMA streams of the device. Drivers claim a stream for each of their DMA requests, either by
+ * letting this class pick a free stream from the request table (Allocate()), or by claiming a fixed route (Claim()).
+ * Transfers are described by Dma#Transfer, and completion interrupts are dispatched to the callback of the transfer.
+ *
+ * Routes are @c constexpr, so that drivers and board configurations can check at compile time that the routes they
+ * use do not share a stream, using AreExclusive(). Claims are also tracked at runtime, so that conflicting claims from
+ * different drivers are detected when the second driver is constructed.
+ */
+class Dma final {
+ public:
+  /**
+   * @brief Enumeration of DMA requests, i.e. the sources which can trigger DMA transfers.
+   */
+  enum struct Request : uint8_t {
+    kMemToMem,
+    kAdc1,
+    kAdc2,
+    kAdc3,
+    kDac1,
+    kDac2,
+    kSdio,
+    kSpi1Rx,
+    kSpi1Tx,
+    kSpi2Rx,
+    kSpi2Tx,
+    kSpi3Rx,
+    kSpi3Tx,
+    kI2c1Rx,
+    kI2c1Tx,
+    kI2c2Rx,
+    kI2c2Tx,
+    kI2c3Rx,
+    kI2c3Tx,
+    kUsart1Rx,
+    kUsart1Tx,
+    kUsart2Rx,
+    kUsart2Tx,
+    kUsart3Rx,
+    kUsart3Tx,
+    kUart4Rx,
+    kUart4Tx,
+    kUart5Rx,
+    kUart5Tx,
+    kUsart6Rx,
+    kUsart6Tx,
+    kTim1Ch1,
+    kTim1Ch2,
+    kTim1Ch3,
+    kTim1Ch4,
+    kTim1Up,
+    kTim2Ch1,
+    kTim2Ch2,
+    kTim2Ch3,
+    kTim2Ch4,
+    kTim2Up,
+    kTim3Ch1,
+    kTim3Ch2,
+    kTim3Ch3,
+    kTim3Ch4,
+    kTim3Up,
+    kTim4Ch1,
+    kTim4Ch2,
+    kTim4Ch3,
+    kTim4Up,
+    kTim5Ch1,
+    kTim5Ch2,
+    kTim5Ch3,
+    kTim5Ch4,
+    kTim5Up,
+    kTim6Up,
+    kTim7Up,
+    kTim8Ch1,
+    kTim8Ch2,
+    kTim8Ch3,
+    kTim8Ch4,
+    kTim8Up
+  };
+
+  /**
+   * @brief Hardware resources which serve a DMA request.
+   */
+  struct Route {
+    /**
+     * @brief DMA controller, i.e. @c DMA1 or @c DMA2. 0 if the route is invalid.
+     */
+    uint32_t dma = 0;
+    /**
+     * @brief Stream of the DMA controller, from 0 to 7.
+     */
+    uint8_t stream = 0;
+    /**
+     * @brief Channel selection of the stream, from 0 to 7.
+     */
+    uint8_t channel = 0;
+
+    /**
+     * @return @c true if this route refers to a stream.
+     */
+    constexpr bool IsValid() const { return dma != 0; }
+    /**
+     * @param other Route to compare against
+     * @return @c true if both routes use the same stream.
+     */
+    constexpr bool Conflicts(const Route& other) const { return dma == other.dma && stream == other.stream; }
+  };
+
+  /**
+   * @brief Enumeration of transfer directions.
+   */
+  enum struct Direction {
+    kPeriphToMem,
+    kMemToPeriph,
+    /**
+     * @brief Memory-to-memory transfer. Only supported by @c DMA2, and only in normal mode.
+     */
+    kMemToMem
+  };
+
+  /**
+   * @brief Enumeration of transfer modes.
+   */
+  enum struct Mode {
+    /**
+     * @brief The stream stops after transferring all data.
+     */
+    kNormal,
+    /**
+     * @brief The stream restarts from the beginning of the buffer after transferring all data.
+     */
+    kCircular,
+    /**
+     * @brief The stream alternates between two buffers.
+     *
+     * The application can process one buffer while the other is being transferred.
+     */
+    kDoubleBuffer
+  };
+
+  /**
+   * @brief Enumeration of the width of each data item.
+   */
+  enum struct Width {
+    kByte,
+    kHalfWord,
+    kWord
+  };
+
+  /**
+   * @brief Enumeration of stream priorities. Streams of equal priority are served in order of their stream number.
+   */
+  enum struct Priority {
+    kLow,
+    kMedium,
+    kHigh,
+    kVeryHigh
+  };
+
+  /**
+   * @brief Enumeration of events reported to the transfer callback.
+   */
+  enum struct Event {
+    /**
+     * @brief Half of the data has been transferred. Only reported if Transfer#half_transfer_irq is set.
+     */
+    kHalfTransfer,
+    /**
+     * @brief All data has been transferred. In circular mode, the transfer continues from the start of the buffer.
+     */
+    kTransferComplete,
+    /**
+     * @brief The first buffer of a double-buffered transfer has been filled or emptied.
+     */
+    kBuffer0Complete,
+    /**
+     * @brief The second buffer of a double-buffered transfer has been filled or emptied.
+     */
+    kBuffer1Complete,
+    /**
+     * @brief A bus error occurred, and the stream has been stopped.
+     */
+    kError
+  };
+
+  /**
+   * @brief Type definition for transfer callbacks.
+   *
+   * Callbacks are invoked from the DMA interrupt handler.
+   *
+   * @param event Event which occurred
+   * @param context User-defined pointer, as given in Dma#Transfer
+   */
+  using Callback = void (*)(Event event, void* context);
+
+  /**
+   * @brief Description of a DMA transfer.
+   */
+  struct Transfer {
+    Direction direction = Direction::kPeriphToMem;
+    Mode mode = Mode::kNormal;
+    /**
+     * @brief Address of the peripheral data register. For memory-to-memory transfers, this is the source address.
+     */
+    uint32_t peripheral = 0;
+    /**
+     * @brief Memory buffer. For memory-to-memory transfers, this is the destination.
+     */
+    void* memory0 = nullptr;
+    /**
+     * @brief Second memory buffer, only used in double-buffer mode.
+     */
+    void* memory1 = nullptr;
+    /**
+     * @brief Number of data items to transfer, per buffer.
+     */
+    uint16_t count = 0;
+    Width peripheral_width = Width::kByte;
+    Width memory_width = Width::kByte;
+    bool peripheral_increment = false;
+    bool memory_increment = true;
+    Priority priority = Priority::kMedium;
+    /**
+     * @brief Whether to report Event::kHalfTransfer.
+     */
+    bool half_transfer_irq = false;
+    /**
+     * @brief Function to invoke on transfer events, or @c nullptr to disable interrupts of the stream.
+     */
+    Callback callback = nullptr;
+    /**
+     * @brief User-defined pointer which will be passed to @c callback.
+     */
+    void* context = nullptr;
+    /**
+     * @brief Interrupt priority of the stream.
+     */
+    uint8_t irq_priority = 0x80;
+  };
+
+  /**
+   * @brief Default constructor for Dma.
+   *
+   * This constructor is disabled to enforce a static class pattern.
+   */
+  Dma() = delete;
+
+  /**
+   * @brief Looks up a route for a request in the request table.
+   *
+   * @param request DMA request
+   * @param alternative Index of the route, for requests which can be served by more than one stream
+   * @return Route for @p request, or an invalid route if there are no more alternatives.
+   */
+  static constexpr Route GetRoute(const Request request, const uint8_t alternative = 0) {
+    uint8_t index = 0;
+    for (const RequestEntry& entry : kRequestTable) {
+      if (entry.request == request && index++ == alternative) {
+        return entry.route;
+      }
+    }
+    return Route{};
+  }
+
+  /**
+   * @brief Checks whether a set of routes can be used at the same time.
+   *
+   * @param routes Routes to check. Invalid routes are ignored, so that optional requests can be listed.
+   * @return @c true if no two valid routes share a stream.
+   */
+  static constexpr bool AreExclusive(const std::initializer_list<Route> routes) {
+    return AreExclusive(routes.begin(), routes.size());
+  }
+  /**
+   * @brief Checks whether a set of routes can be used at the same time.
+   *
+   * @param routes Routes to check. Invalid routes are ignored, so that optional requests can be listed.
+   * @param count Number of routes
+   * @return @c true if no two valid routes share a stream.
+   */
+  static constexpr bool AreExclusive(const Route* routes, const std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+      if (!routes[i].IsValid()) {
+        continue;
+      }
+      for (std::size_t j = i + 1; j < count; ++j) {
+        if (routes[i].Conflicts(routes[j])) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief Claims the first free stream which can serve a request.
+   *
+   * @param request DMA request
+   * @param reserved Routes which must not be claimed, e.g. the routes of peripherals which are constructed later. Only
+   * useful for requests which can be served by more than one stream.
+   * @param num_reserved Number of routes in @p reserved
+   * @return Claimed route, or @c std::nullopt if all streams serving @p request are claimed or reserved.
+   */
+  static std::optional<Route> Allocate(Request request, const Route* reserved = nullptr, std::size_t num_reserved = 0);
+
+  /**
+   * @brief Claims a fixed route.
+   *
+   * @param route Route to claim
+   * @return @c true if the stream of @p route was free.
+   */
+  static bool Claim(const Route& route);
+
+  /**
+   * @brief Stops any transfer and releases a claimed stream.
+   *
+   * @param route Route to release
+   */
+  static void Release(const Route& route);
+
+  /**
+   * @brief Configures a stream and starts a transfer.
+   *
+   * Any transfer in progress on the stream is stopped first.
+   *
+   * @param route Claimed route
+   * @param transfer Transfer to start
+   */
+  static void Start(const Route& route, const Transfer& transfer);
+
+  /**
+   * @brief Stops the transfer of a stream.
+   *
+   * No callbacks are invoked for the stopped transfer.
+   *
+   * @param route Claimed route
+   */
+  static void Stop(const Route& route);
+
+  /**
+   * @param route Claimed route
+   * @return @c true if the stream is transferring data.
+   */
+  static bool IsBusy(const Route& route);
+
+  /**
+   * @param route Claimed route
+   * @return Number of data items remaining in the current buffer.
+   */
+  static uint16_t GetRemaining(const Route& route);
+
+  /**
+   * @brief Handles the interrupt of a stream.
+   *
+   * @warning This function is invoked by the DMA interrupt handlers. Do not call this function directly.
+   *
+   * @param dma DMA controller
+   * @param stream Stream which raised the interrupt
+   */
+  static void HandleIrq(uint32_t dma, uint8_t stream);
+
+ private:
+  /**
+   * @brief Entry of the request table.
+   */
+  struct RequestEntry {
+    Request request;
+    Route route;
+  };
+
+  /**
+   * @brief Mapping of requests to streams and channels.
+   *
+   * See RM0090, Section 10.3.3 "Channel selection". Requests which can be served by multiple streams are listed once
+   * for each stream.
+   */
+  static constexpr RequestEntry kRequestTable[] = {
+      {Request::kMemToMem, {DMA2, 0, 0}},
+      {Request::kMemToMem, {DMA2, 1, 0}},
+      {Request::kMemToMem, {DMA2, 2, 0}},
+      {Request::kMemToMem, {DMA2, 3, 0}},
+      {Request::kMemToMem, {DMA2, 4, 0}},
+      {Request::kMemToMem, {DMA2, 5, 0}},
+      {Request::kMemToMem, {DMA2, 6, 0}},
+      {Request::kMemToMem, {DMA2, 7, 0}},
+      {Request::kAdc1, {DMA2, 0, 0}},
+      {Request::kAdc1, {DMA2, 4, 0}},
+      {Request::kAdc2, {DMA2, 2, 1}},
+      {Request::kAdc2, {DMA2, 3, 1}},
+      {Request::kAdc3, {DMA2, 0, 2}},
+      {Request::kAdc3, {DMA2, 1, 2}},
+      {Request::kDac1, {DMA1, 5, 7}},
+      {Request::kDac2, {DMA1, 6, 7}},
+      {Request::kSdio, {DMA2, 3, 4}},
+      {Request::kSdio, {DMA2, 6, 4}},
+      {Request::kSpi1Rx, {DMA2, 0, 3}},
+      {Request::kSpi1Rx, {DMA2, 2, 3}},
+      {Request::kSpi1Tx, {DMA2, 3, 3}},
+      {Request::kSpi1Tx, {DMA2, 5, 3}},
+      {Request::kSpi2Rx, {DMA1, 3, 0}},
+      {Request::kSpi2Tx, {DMA1, 4, 0}},
+      {Request::kSpi3Rx, {DMA1, 0, 0}},
+      {Request::kSpi3Rx, {DMA1, 2, 0}},
+      {Request::kSpi3Tx, {DMA1, 5, 0}},
+      {Request::kSpi3Tx, {DMA1, 7, 0}},
+      {Request::kI2c1Rx, {DMA1, 0, 1}},
+      {Request::kI2c1Rx, {DMA1, 5, 1}},
+      {Request::kI2c1Tx, {DMA1, 6, 1}},
+      {Request::kI2c1Tx, {DMA1, 7, 1}},
+      {Request::kI2c2Rx, {DMA1, 2, 7}},
+      {Request::kI2c2Rx, {DMA1, 3, 7}},
+      {Request::kI2c2Tx, {DMA1, 7, 7}},
+      {Request::kI2c3Rx, {DMA1, 2, 3}},
+      {Request::kI2c3Tx, {DMA1, 4, 3}},
+      {Request::kUsart1Rx, {DMA2, 2, 4}},
+      {Request::kUsart1Rx, {DMA2, 5, 4}},
+      {Request::kUsart1Tx, {DMA2, 7, 4}},
+      {Request::kUsart2Rx, {DMA1, 5, 4}},
+      {Request::kUsart2Tx, {DMA1, 6, 4}},
+      {Request::kUsart3Rx, {DMA1, 1, 4}},
+      {Request::kUsart3Tx, {DMA1, 3, 4}},
+      {Request::kUsart3Tx, {DMA1, 4, 7}},
+      {Request::kUart4Rx, {DMA1, 2, 4}},
+      {Request::kUart4Tx, {DMA1, 4, 4}},
+      {Request::kUart5Rx, {DMA1, 0, 4}},
+      {Request::kUart5Tx, {DMA1, 7, 4}},
+      {Request::kUsart6Rx, {DMA2, 1, 5}},
+      {Request::kUsart6Rx, {DMA2, 2, 5}},
+      {Request::kUsart6Tx, {DMA2, 6, 5}},
+      {Request::kUsart6Tx, {DMA2, 7, 5}},
+      {Request::kTim1Ch1, {DMA2, 1, 6}},
+      {Request::kTim1Ch1, {DMA2, 3, 6}},
+      {Request::kTim1Ch1, {DMA2, 6, 0}},
+      {Request::kTim1Ch2, {DMA2, 2, 6}},
+      {Request::kTim1Ch2, {DMA2, 6, 0}},
+      {Request::kTim1Ch3, {DMA2, 6, 6}},
+      {Request::kTim1Ch3, {DMA2, 6, 0}},
+      {Request::kTim1Ch4, {DMA2, 4, 6}},
+      {Request::kTim1Up, {DMA2, 5, 6}},
+      {Request::kTim2Ch1, {DMA1, 5, 3}},
+      {Request::kTim2Ch2, {DMA1, 6, 3}},
+      {Request::kTim2Ch3, {DMA1, 1, 3}},
+      {Request::kTim2Ch4, {DMA1, 6, 3}},
+      {Request::kTim2Ch4, {DMA1, 7, 3}},
+      {Request::kTim2Up, {DMA1, 1, 3}},
+      {Request::kTim2Up, {DMA1, 7, 3}},
+      {Request::kTim3Ch1, {DMA1, 4, 5}},
+      {Request::kTim3Ch2, {DMA1, 5, 5}},
+      {Request::kTim3Ch3, {DMA1, 7, 5}},
+      {Request::kTim3Ch4, {DMA1, 2, 5}},
+      {Request::kTim3Up, {DMA1, 2, 5}},
+      {Request::kTim4Ch1, {DMA1, 0, 2}},
+      {Request::kTim4Ch2, {DMA1, 3, 2}},
+      {Request::kTim4Ch3, {DMA1, 7, 2}},
+      {Request::kTim4Up, {DMA1, 6, 2}},
+      {Request::kTim5Ch1, {DMA1, 2, 6}},
+      {Request::kTim5Ch2, {DMA1, 4, 6}},
+      {Request::kTim5Ch3, {DMA1, 0, 6}},
+      {Request::kTim5Ch4, {DMA1, 1, 6}},
+      {Request::kTim5Ch4, {DMA1, 3, 6}},
+      {Request::kTim5Up, {DMA1, 0, 6}},
+      {Request::kTim5Up, {DMA1, 6, 6}},
+      {Request::kTim6Up, {DMA1, 1, 7}},
+      {Request::kTim7Up, {DMA1, 2, 1}},
+      {Request::kTim7Up, {DMA1, 4, 1}},
+      {Request::kTim8Ch1, {DMA2, 2, 0}},
+      {Request::kTim8Ch1, {DMA2, 2, 7}},
+      {Request::kTim8Ch2, {DMA2, 2, 0}},
+      {Request::kTim8Ch2, {DMA2, 3, 7}},
+      {Request::kTim8Ch3, {DMA2, 2, 0}},
+      {Request::kTim8Ch3, {DMA2, 4, 7}},
+      {Request::kTim8Ch4, {DMA2, 7, 7}},
+      {Request::kTim8Up, {DMA2, 1, 7}},
+  };
+};
+
+}  // namespace stm32f4
+}  // namespace core
+
+#endif  // defined(STM32F4)
+
+#endif  // RTLIB_CORE_STM32F4_DMA_H_
@@ -0,0 +1,39 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "core/stm32f4/exti.h"
+
+#if defined(STM32F4)
+
+#include <libopencm3/stm32/exti.h>
+#include <libopencm3/stm32/rcc.h>
+
+namespace core {
+namespace stm32f4 {
+
+void Exti::SelectPort(const Pinout& pin) {
+  // Port selection of the EXTI lines is part of SYSCFG
+  rcc_periph_clock_enable(RCC_SYSCFG);
+  exti_select_source(pin.second, pin.first);
+}
+
+}  // namespace stm32f4
+}  // namespace core
+
+#endif  // defined(STM32F4)
@@ -0,0 +1,62 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "core/stm32f4/flash.h"
+
+#if defined(STM32F4)
+
+#include <cassert>
+
+#include <libopencm3/stm32/flash.h>
+
+namespace core {
+namespace stm32f4 {
+
+void Flash::Erase(const uint32_t address) {
+  flash_unlock();
+  flash_erase_sector(GetSector(address), FLASH_CR_PROGRAM_X32);
+  flash_lock();
+}
+
+void Flash::Program(const uint32_t address, const uint32_t* data, const std::size_t count) {
+  assert(address % sizeof(uint32_t) == 0);
+
+  flash_unlock();
+  for (std::size_t i = 0; i < count; ++i) {
+    flash_program_word(static_cast<uint32_t>(address + i * sizeof(uint32_t)), data[i]);
+  }
+  flash_lock();
+}
+
+uint8_t Flash::GetSector(const uint32_t address) {
+  // Sectors 0-3 are 16KB, sector 4 is 64KB, and sectors 5-11 are 128KB
+  const uint32_t offset = address - FLASH_BASE;
+  assert(offset < 0x100000);
+  if (offset < 0x10000) {
+    return static_cast<uint8_t>(offset / 0x4000);
+  } else if (offset < 0x20000) {
+    return 4;
+  }
+  return static_cast<uint8_t>(4 + offset / 0x20000);
+}
+
+}  // namespace stm32f4
+}  // namespace core
+
+#endif  // defined(STM32F4)
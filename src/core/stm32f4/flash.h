@@ -0,0 +1,82 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_CORE_STM32F4_FLASH_H_
+#define RTLIB_CORE_STM32F4_FLASH_H_
+
+#if defined(STM32F4)
+
+#include <cstddef>
+#include <cstdint>
+
+namespace core {
+namespace stm32f4 {
+
+/**
+ * @brief STM32F4xx-specific helpers for programming the internal flash.
+ *
+ * Flash is addressed by its memory-mapped address, and is read by dereferencing the address directly. Erasing and
+ * programming stall the CPU if it fetches instructions from flash at the same time.
+ */
+class Flash final {
+ public:
+  /**
+   * @brief Default constructor for Flash.
+   *
+   * This constructor is disabled to enforce a static class pattern.
+   */
+  Flash() = delete;
+
+  /**
+   * @brief Erases the flash sector containing an address.
+   *
+   * All bytes of an erased sector read as @c 0xFF. Sectors are 16KB, 64KB or 128KB depending on their position, and
+   * erasing a 128KB sector takes up to 2 seconds.
+   *
+   * @param address Any address within the sector. Only the first 1MB of flash is supported.
+   */
+  static void Erase(uint32_t address);
+
+  /**
+   * @brief Programs words into erased flash.
+   *
+   * Each word is programmed as two half-words, which is the programming unit of STM32F4xx devices.
+   *
+   * @param address Word-aligned address to program
+   * @param data Words to program
+   * @param count Number of words to program
+   */
+  static void Program(uint32_t address, const uint32_t* data, std::size_t count);
+
+ private:
+  /**
+   * @brief Retrieves the sector number of an address.
+   *
+   * @param address Memory-mapped flash address
+   * @return Sector number containing @p address.
+   */
+  static uint8_t GetSector(uint32_t address);
+};
+
+}  // namespace stm32f4
+}  // namespace core
+
+#endif  // defined(STM32F4)
+
+#endif  // RTLIB_CORE_STM32F4_FLASH_H_
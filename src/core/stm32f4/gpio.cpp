@@ -21,21 +21,69 @@
 
 #if defined(STM32F4)
 
+#include <array>
 #include <cassert>
+#include <cstddef>
+#include <limits>
 #include <utility>
 
+#include <libopencm3/cm3/cortex.h>
 #include <libopencm3/stm32/rcc.h>
 
 namespace core {
 namespace stm32f4 {
 
+namespace {
+/**
+ * @brief Number of GPIO objects which manage a pin of each port.
+ */
+std::array<uint8_t, 11> port_refs = {};
+
+inline std::size_t GetPortIndex(const Port port) {
+  // Port registers are laid out at a fixed stride from GPIOA
+  const std::size_t index = (port - GPIOA) / (GPIOB - GPIOA);
+  assert(index < port_refs.size());
+  return index;
+}
+
+inline rcc_periph_clken GetRcc(const Port port) {
+  switch (port) {
+    case GPIOA:
+      return RCC_GPIOA;
+    case GPIOB:
+      return RCC_GPIOB;
+    case GPIOC:
+      return RCC_GPIOC;
+    case GPIOD:
+      return RCC_GPIOD;
+    case GPIOE:
+      return RCC_GPIOE;
+    case GPIOF:
+      return RCC_GPIOF;
+    case GPIOG:
+      return RCC_GPIOG;
+    case GPIOH:
+      return RCC_GPIOH;
+    case GPIOI:
+      return RCC_GPIOI;
+    case GPIOJ:
+      return RCC_GPIOJ;
+    case GPIOK:
+      return RCC_GPIOK;
+    default:
+      assert(false);
+      return RCC_GPIOA;
+  }
+}
+}  // namespace
+
 GPIO::GPIO(const Config& config) :
     GPIO(config.pin, config.mode, config.pullup, config.speed, config.driver, config.altfn) {}
 
 GPIO::GPIO(Pinout pin, Mode mode, Pullup pullup, Speed speed, DriverType driver, AltFn altfn) :
     pin_(std::move(pin)) {
   // Use external oscillator for RCC
-  rcc_clock_setup_hse_3v3(&rcc_hse_8mhz_3v3[RCC_CLOCK_3V3_168MHZ]);
+  InitSysClock();
 
   // Initialize the RCC and enable the GPIO
   InitRcc(pin_.first);
@@ -52,45 +100,48 @@ void GPIO::Init(const Mode mode, const Pullup pullup, const Speed speed, const D
   gpio_set_output_options(pin_.first, static_cast<uint8_t>(driver), static_cast<uint8_t>(speed), pin_.second);
 }
 
+GPIO::~GPIO() {
+  if (pin_.first != Port{}) {
+    ReleaseRcc(pin_.first);
+  }
+}
+
+GPIO::GPIO(GPIO&& other) noexcept :
+    pin_(std::exchange(other.pin_, Pinout{})) {}
+
+GPIO& GPIO::operator=(GPIO&& other) noexcept {
+  if (this != &other) {
+    if (pin_.first != Port{}) {
+      ReleaseRcc(pin_.first);
+    }
+    pin_ = std::exchange(other.pin_, Pinout{});
+  }
+  return *this;
+}
+
+void GPIO::InitSysClock() {
+  rcc_clock_setup_hse_3v3(&rcc_hse_8mhz_3v3[RCC_CLOCK_3V3_168MHZ]);
+}
+
 void GPIO::InitRcc(const Port port) const {
-  switch (port) {
-    case GPIOA:
-      rcc_periph_clock_enable(RCC_GPIOA);
-      break;
-    case GPIOB:
-      rcc_periph_clock_enable(RCC_GPIOB);
-      break;
-    case GPIOC:
-      rcc_periph_clock_enable(RCC_GPIOC);
-      break;
-    case GPIOD:
-      rcc_periph_clock_enable(RCC_GPIOD);
-      break;
-    case GPIOE:
-      rcc_periph_clock_enable(RCC_GPIOE);
-      break;
-    case GPIOF:
-      rcc_periph_clock_enable(RCC_GPIOF);
-      break;
-    case GPIOG:
-      rcc_periph_clock_enable(RCC_GPIOG);
-      break;
-    case GPIOH:
-      rcc_periph_clock_enable(RCC_GPIOH);
-      break;
-    case GPIOI:
-      rcc_periph_clock_enable(RCC_GPIOI);
-      break;
-    case GPIOJ:
-      rcc_periph_clock_enable(RCC_GPIOJ);
-      break;
-    case GPIOK:
-      rcc_periph_clock_enable(RCC_GPIOK);
-      break;
-    default:
-      assert(false);
-      break;
+  // GPIO objects may also be created and destroyed from interrupt handlers
+  const bool masked = cm_mask_interrupts(true);
+  uint8_t& refs = port_refs[GetPortIndex(port)];
+  assert(refs < std::numeric_limits<uint8_t>::max());
+  if (refs++ == 0) {
+    rcc_periph_clock_enable(GetRcc(port));
+  }
+  cm_mask_interrupts(masked);
+}
+
+void GPIO::ReleaseRcc(const Port port) const {
+  const bool masked = cm_mask_interrupts(true);
+  uint8_t& refs = port_refs[GetPortIndex(port)];
+  assert(refs > 0);
+  if (--refs == 0) {
+    rcc_periph_clock_disable(GetRcc(port));
   }
+  cm_mask_interrupts(masked);
 }
 
 bool GPIO::Read() const {
@@ -236,23 +236,30 @@ class GPIO final {
        AltFn altfn = 0x0);
 
   /**
-   * Default trivial destructor.
+   * @brief Destructor.
+   *
+   * Disables the clock of the port if no other GPIO object manages a pin of the same port. The pin keeps its
+   * configuration.
    */
-  ~GPIO() = default;
+  ~GPIO();
 
   /**
    * @brief Move constructor.
    *
+   * The moved-from object no longer manages any pin.
+   *
    * @param other GPIO object to move from
    */
-  GPIO(GPIO&& other) noexcept = default;
+  GPIO(GPIO&& other) noexcept;
   /**
    * @brief Move assignment operator.
    *
+   * The moved-from object no longer manages any pin.
+   *
    * @param other GPIO object to move from
    * @return Reference to the moved GPIO.
    */
-  GPIO& operator=(GPIO&& other) noexcept = default;
+  GPIO& operator=(GPIO&& other) noexcept;
 
   /**
    * @brief Copy constructor.
@@ -291,6 +298,14 @@ class GPIO final {
    */
   void Reset() const;
 
+  /**
+   * @brief Configures the system clock to run from the external oscillator through the PLL.
+   *
+   * This function is invoked by every constructor. It must be invoked again after waking up from stop mode, since the
+   * device then runs from the internal oscillator.
+   */
+  static void InitSysClock();
+
  private:
   /**
    * @brief Initializes this GPIO to the given configuration for STM32F4xx devices.
@@ -309,6 +324,14 @@ class GPIO final {
    * @param port The GPIO port which should be initialized
    */
   void InitRcc(Port port) const;
+  /**
+   * @brief Releases an RCC Clock which was initialized by InitRcc().
+   *
+   * The clock is disabled when the last GPIO object of the port releases it.
+   *
+   * @param port The GPIO port which is no longer used by this object
+   */
+  void ReleaseRcc(Port port) const;
 
   /**
    * @brief Sets this GPIO to be used as an alternate function.
@@ -0,0 +1,300 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "core/stm32f4/timer.h"
+
+#if defined(STM32F4)
+
+#include <array>
+#include <cassert>
+
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/stm32/rcc.h>
+
+namespace core {
+namespace stm32f4 {
+
+namespace {
+/**
+ * @brief Interrupt lines of each timer.
+ */
+struct TimerIrqs {
+  uint32_t timer;
+  std::array<uint8_t, 4> irqs;
+  uint8_t num_irqs;
+};
+
+constexpr std::array<TimerIrqs, 14> kTimerIrqs = {{
+    {TIM1, {NVIC_TIM1_BRK_TIM9_IRQ, NVIC_TIM1_UP_TIM10_IRQ, NVIC_TIM1_TRG_COM_TIM11_IRQ, NVIC_TIM1_CC_IRQ}, 4},
+    {TIM2, {NVIC_TIM2_IRQ}, 1},
+    {TIM3, {NVIC_TIM3_IRQ}, 1},
+    {TIM4, {NVIC_TIM4_IRQ}, 1},
+    {TIM5, {NVIC_TIM5_IRQ}, 1},
+    {TIM6, {NVIC_TIM6_DAC_IRQ}, 1},
+    {TIM7, {NVIC_TIM7_IRQ}, 1},
+    {TIM8, {NVIC_TIM8_BRK_TIM12_IRQ, NVIC_TIM8_UP_TIM13_IRQ, NVIC_TIM8_TRG_COM_TIM14_IRQ, NVIC_TIM8_CC_IRQ}, 4},
+    {TIM9, {NVIC_TIM1_BRK_TIM9_IRQ}, 1},
+    {TIM10, {NVIC_TIM1_UP_TIM10_IRQ}, 1},
+    {TIM11, {NVIC_TIM1_TRG_COM_TIM11_IRQ}, 1},
+    {TIM12, {NVIC_TIM8_BRK_TIM12_IRQ}, 1},
+    {TIM13, {NVIC_TIM8_UP_TIM13_IRQ}, 1},
+    {TIM14, {NVIC_TIM8_TRG_COM_TIM14_IRQ}, 1},
+}};
+
+struct HandlerState {
+  Timer::IrqHandler handler = nullptr;
+  void* context = nullptr;
+};
+
+/**
+ * @brief Interrupt handler of each timer, in the same order as @c kTimerIrqs.
+ */
+std::array<HandlerState, kTimerIrqs.size()> handlers = {};
+
+inline std::size_t GetTimerIndex(const uint32_t timer) {
+  for (std::size_t i = 0; i < kTimerIrqs.size(); ++i) {
+    if (kTimerIrqs[i].timer == timer) {
+      return i;
+    }
+  }
+
+  assert(false);
+  return 0;
+}
+
+/**
+ * @return @c true if an interrupt line is used by a timer other than the one at @p index.
+ */
+bool IsIrqShared(const std::size_t index, const uint8_t irq) {
+  for (std::size_t i = 0; i < kTimerIrqs.size(); ++i) {
+    if (i == index || handlers[i].handler == nullptr) {
+      continue;
+    }
+
+    for (uint8_t j = 0; j < kTimerIrqs[i].num_irqs; ++j) {
+      if (kTimerIrqs[i].irqs[j] == irq) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+}  // namespace
+
+void Timer::InitRcc(const uint32_t timer) {
+  switch (timer) {
+    case TIM1:
+      rcc_periph_clock_enable(RCC_TIM1);
+      rcc_periph_reset_pulse(RST_TIM1);
+      break;
+    case TIM2:
+      rcc_periph_clock_enable(RCC_TIM2);
+      rcc_periph_reset_pulse(RST_TIM2);
+      break;
+    case TIM3:
+      rcc_periph_clock_enable(RCC_TIM3);
+      rcc_periph_reset_pulse(RST_TIM3);
+      break;
+    case TIM4:
+      rcc_periph_clock_enable(RCC_TIM4);
+      rcc_periph_reset_pulse(RST_TIM4);
+      break;
+    case TIM5:
+      rcc_periph_clock_enable(RCC_TIM5);
+      rcc_periph_reset_pulse(RST_TIM5);
+      break;
+    case TIM6:
+      rcc_periph_clock_enable(RCC_TIM6);
+      rcc_periph_reset_pulse(RST_TIM6);
+      break;
+    case TIM7:
+      rcc_periph_clock_enable(RCC_TIM7);
+      rcc_periph_reset_pulse(RST_TIM7);
+      break;
+    case TIM8:
+      rcc_periph_clock_enable(RCC_TIM8);
+      rcc_periph_reset_pulse(RST_TIM8);
+      break;
+    case TIM9:
+      rcc_periph_clock_enable(RCC_TIM9);
+      rcc_periph_reset_pulse(RST_TIM9);
+      break;
+    case TIM10:
+      rcc_periph_clock_enable(RCC_TIM10);
+      rcc_periph_reset_pulse(RST_TIM10);
+      break;
+    case TIM11:
+      rcc_periph_clock_enable(RCC_TIM11);
+      rcc_periph_reset_pulse(RST_TIM11);
+      break;
+    case TIM12:
+      rcc_periph_clock_enable(RCC_TIM12);
+      rcc_periph_reset_pulse(RST_TIM12);
+      break;
+    case TIM13:
+      rcc_periph_clock_enable(RCC_TIM13);
+      rcc_periph_reset_pulse(RST_TIM13);
+      break;
+    case TIM14:
+      rcc_periph_clock_enable(RCC_TIM14);
+      rcc_periph_reset_pulse(RST_TIM14);
+      break;
+    default:
+      assert(false);
+      break;
+  }
+}
+
+uint32_t Timer::GetClockFreq(const uint32_t timer) {
+  // TIM1 and TIM8-TIM11 sit on APB2, all other timers sit on APB1
+  bool is_apb2 = false;
+  switch (timer) {
+    case TIM1:
+    case TIM8:
+    case TIM9:
+    case TIM10:
+    case TIM11:
+      is_apb2 = true;
+      break;
+    default:
+      break;
+  }
+  const uint32_t apb_freq = is_apb2 ? rcc_apb2_frequency : rcc_apb1_frequency;
+
+  // Timer clocks are doubled whenever the APB prescaler is not 1
+  return apb_freq == rcc_ahb_frequency ? apb_freq : apb_freq * 2;
+}
+
+void Timer::SetIrqHandler(const uint32_t timer, const IrqHandler handler, void* context, const uint8_t priority) {
+  const std::size_t index = GetTimerIndex(timer);
+  const TimerIrqs& irqs = kTimerIrqs[index];
+
+  if (handler == nullptr) {
+    for (uint8_t i = 0; i < irqs.num_irqs; ++i) {
+      // Shared lines must stay enabled for the other timer
+      if (!IsIrqShared(index, irqs.irqs[i])) {
+        nvic_disable_irq(irqs.irqs[i]);
+      }
+    }
+    handlers[index] = {};
+    return;
+  }
+
+  // Mask the interrupts while the handler is being replaced
+  for (uint8_t i = 0; i < irqs.num_irqs; ++i) {
+    nvic_disable_irq(irqs.irqs[i]);
+  }
+  handlers[index].handler = handler;
+  handlers[index].context = context;
+  for (uint8_t i = 0; i < irqs.num_irqs; ++i) {
+    nvic_set_priority(irqs.irqs[i], priority);
+    nvic_enable_irq(irqs.irqs[i]);
+  }
+}
+
+void Timer::HandleIrq(const uint32_t timer) {
+  const HandlerState& state = handlers[GetTimerIndex(timer)];
+  if (state.handler != nullptr) {
+    state.handler(state.context);
+  }
+}
+
+}  // namespace stm32f4
+}  // namespace core
+
+using core::stm32f4::Timer;
+
+extern "C" void tim1_brk_tim9_isr();
+extern "C" void tim1_up_tim10_isr();
+extern "C" void tim1_trg_com_tim11_isr();
+extern "C" void tim1_cc_isr();
+extern "C" void tim2_isr();
+extern "C" void tim3_isr();
+extern "C" void tim4_isr();
+extern "C" void tim5_isr();
+extern "C" void tim6_dac_isr();
+extern "C" void tim7_isr();
+extern "C" void tim8_brk_tim12_isr();
+extern "C" void tim8_up_tim13_isr();
+extern "C" void tim8_trg_com_tim14_isr();
+extern "C" void tim8_cc_isr();
+
+extern "C" void tim1_brk_tim9_isr() {
+  Timer::HandleIrq(TIM1);
+  Timer::HandleIrq(TIM9);
+}
+
+extern "C" void tim1_up_tim10_isr() {
+  Timer::HandleIrq(TIM1);
+  Timer::HandleIrq(TIM10);
+}
+
+extern "C" void tim1_trg_com_tim11_isr() {
+  Timer::HandleIrq(TIM1);
+  Timer::HandleIrq(TIM11);
+}
+
+extern "C" void tim1_cc_isr() {
+  Timer::HandleIrq(TIM1);
+}
+
+extern "C" void tim2_isr() {
+  Timer::HandleIrq(TIM2);
+}
+
+extern "C" void tim3_isr() {
+  Timer::HandleIrq(TIM3);
+}
+
+extern "C" void tim4_isr() {
+  Timer::HandleIrq(TIM4);
+}
+
+extern "C" void tim5_isr() {
+  Timer::HandleIrq(TIM5);
+}
+
+extern "C" void tim6_dac_isr() {
+  Timer::HandleIrq(TIM6);
+}
+
+extern "C" void tim7_isr() {
+  Timer::HandleIrq(TIM7);
+}
+
+extern "C" void tim8_brk_tim12_isr() {
+  Timer::HandleIrq(TIM8);
+  Timer::HandleIrq(TIM12);
+}
+
+extern "C" void tim8_up_tim13_isr() {
+  Timer::HandleIrq(TIM8);
+  Timer::HandleIrq(TIM13);
+}
+
+extern "C" void tim8_trg_com_tim14_isr() {
+  Timer::HandleIrq(TIM8);
+  Timer::HandleIrq(TIM14);
+}
+
+extern "C" void tim8_cc_isr() {
+  Timer::HandleIrq(TIM8);
+}
+
+#endif  // defined(STM32F4)
@@ -0,0 +1,253 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config/config.h"
+
+#if defined(LIB_USE_BUZZER) && LIB_USE_BUZZER > 0
+
+#include "lib/buzzer.h"
+
+#include <cassert>
+
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/timer.h>
+
+#include "core/timer.h"
+
+using CORE_NS::GPIO;
+using CORE_NS::Timer;
+
+namespace {
+constexpr tim_oc_id kOcIds[] = {TIM_OC1, TIM_OC2, TIM_OC3, TIM_OC4};
+
+/**
+ * @brief Frequency of the timer counter. Tones from 16Hz upwards fit into a 16-bit period.
+ */
+constexpr uint32_t kTickFreq = 1000000;
+/**
+ * @brief Timer frequency used to count the duration of rests.
+ */
+constexpr uint32_t kRestFreq = 1000;
+
+/**
+ * @brief Hardware configuration of one buzzer, as read from the board configuration.
+ */
+struct HwConfig {
+  uint32_t timer = 0;
+  uint8_t channel = 0;
+  Pinout pin = {};
+#if defined(STM32F1)
+  std::optional<GPIO::PriRemap> remap = std::nullopt;
+#elif defined(STM32F4)
+  GPIO::AltFn altfn = GPIO_AF0;
+#endif
+};
+
+inline HwConfig GetConfigHw(const uint8_t id) {
+  assert(id < LIB_USE_BUZZER);
+  HwConfig hw;
+  switch (id) {
+    default:
+      // not handled, since assert will catch this error
+      assert(false);
+      break;
+#if LIB_USE_BUZZER > 0
+    case 0:
+      hw.timer = LIB_BUZZER0_TIMER;
+      hw.channel = LIB_BUZZER0_CHANNEL;
+      hw.pin = Pinout(LIB_BUZZER0_PINOUT);
+#if defined(STM32F1) && defined(LIB_BUZZER0_REMAP)
+      hw.remap = LIB_BUZZER0_REMAP;
+#elif defined(STM32F4)
+      hw.altfn = LIB_BUZZER0_ALTFN;
+#endif
+      break;
+#endif  // LIB_USE_BUZZER > 0
+#if LIB_USE_BUZZER > 1
+    case 1:
+      hw.timer = LIB_BUZZER1_TIMER;
+      hw.channel = LIB_BUZZER1_CHANNEL;
+      hw.pin = Pinout(LIB_BUZZER1_PINOUT);
+#if defined(STM32F1) && defined(LIB_BUZZER1_REMAP)
+      hw.remap = LIB_BUZZER1_REMAP;
+#elif defined(STM32F4)
+      hw.altfn = LIB_BUZZER1_ALTFN;
+#endif
+      break;
+#endif  // LIB_USE_BUZZER > 1
+  }
+  return hw;
+}
+}  // namespace
+
+Buzzer::Buzzer(const Config& config) : volume_(config.volume > 100 ? uint8_t{100} : config.volume) {
+  const HwConfig hw = GetConfigHw(config.id);
+  timer_ = hw.timer;
+  assert(hw.channel >= 1 && hw.channel <= 4);
+  channel_ = static_cast<uint8_t>(hw.channel - 1);
+
+#if defined(STM32F1)
+  gpio_.emplace(hw.pin, GPIO::Configuration::kOutputAltFnPushPull, GPIO::Mode::kOutput2MHz);
+  if (hw.remap) {
+    rcc_periph_clock_enable(RCC_AFIO);
+    GPIO::SetPriAltFn(GPIO::JTAGDisables::kNoDisable, *hw.remap);
+  }
+#elif defined(STM32F4)
+  gpio_.emplace(hw.pin, GPIO::Mode::kAF, GPIO::Pullup::kNone, GPIO::Speed::k2MHz, GPIO::DriverType::kPushPull, hw.altfn);
+#endif
+
+  Timer::InitRcc(timer_);
+
+  const uint32_t clock_freq = Timer::GetClockFreq(timer_);
+  const uint32_t prescaler = clock_freq / kTickFreq - 1;
+  tick_freq_ = clock_freq / (prescaler + 1);
+
+  timer_set_mode(timer_, TIM_CR1_CKD_CK_INT, TIM_CR1_CMS_EDGE, TIM_CR1_DIR_UP);
+  timer_set_prescaler(timer_, prescaler);
+  timer_set_period(timer_, tick_freq_ / kRestFreq - 1);
+  timer_enable_preload(timer_);
+
+  timer_set_oc_mode(timer_, kOcIds[channel_], TIM_OCM_PWM1);
+  timer_enable_oc_preload(timer_, kOcIds[channel_]);
+  timer_set_oc_polarity_high(timer_, kOcIds[channel_]);
+  timer_enable_oc_output(timer_, kOcIds[channel_]);
+
+  // Advanced-control timers gate all outputs with the main output enable bit
+  if (Timer::IsAdvanced(timer_)) {
+    timer_enable_break_main_output(timer_);
+  }
+
+  Silence();
+  Timer::SetIrqHandler(timer_, &HandleTimerIrq, this, config.priority);
+}
+
+Buzzer::~Buzzer() {
+  Stop();
+  Timer::SetIrqHandler(timer_, nullptr);
+}
+
+void Buzzer::Beep(const uint16_t frequency, const uint16_t duration_ms) {
+  // Stop first, since the interrupt handler may be reading the previous beep
+  Stop();
+  beep_ = {frequency, duration_ms};
+  Play(&beep_, 1);
+}
+
+void Buzzer::Play(const Note* melody, const std::size_t count, const bool loop) {
+  Stop();
+  if (count == 0) {
+    return;
+  }
+
+  melody_ = melody;
+  count_ = count;
+  index_ = 0;
+  loop_ = loop;
+
+  // Load the first note immediately, and restart the counter
+  periods_left_ = LoadNote(melody_[0]);
+  timer_generate_event(timer_, TIM_EGR_UG);
+  timer_clear_flag(timer_, TIM_SR_UIF);
+  if (periods_left_ == 1) {
+    PreloadNext();
+  }
+
+  playing_ = true;
+  SetIrqEnable(true);
+  timer_enable_counter(timer_);
+}
+
+void Buzzer::Stop() {
+  SetIrqEnable(false);
+  Silence();
+}
+
+void Buzzer::HandleTimerIrq(void* context) {
+  auto& self = *static_cast<Buzzer*>(context);
+  if (!timer_get_flag(self.timer_, TIM_SR_UIF)) {
+    return;
+  }
+  timer_clear_flag(self.timer_, TIM_SR_UIF);
+
+  // The next note is preloaded at the start of the last period of the current note, so that it starts exactly when the
+  // current note ends
+  --self.periods_left_;
+  if (self.periods_left_ == 1) {
+    self.PreloadNext();
+  } else if (self.periods_left_ == 0) {
+    if (self.next_periods_ == 0) {
+      self.SetIrqEnable(false);
+      self.Silence();
+      return;
+    }
+
+    self.periods_left_ = self.next_periods_;
+    if (self.periods_left_ == 1) {
+      self.PreloadNext();
+    }
+  }
+}
+
+uint32_t Buzzer::LoadNote(const Note& note) {
+  const uint32_t frequency = note.frequency == kRest ? kRestFreq : note.frequency;
+  const uint32_t period = tick_freq_ / frequency;
+  assert(period > 0 && period <= 0x10000);
+
+  timer_set_period(timer_, period - 1);
+  timer_set_oc_value(timer_, kOcIds[channel_], note.frequency == kRest ? 0 : period * volume_ / 200);
+
+  const uint32_t periods = note.duration_ms * frequency / 1000;
+  return periods > 0 ? periods : 1;
+}
+
+void Buzzer::PreloadNext() {
+  ++index_;
+  if (index_ == count_) {
+    if (!loop_) {
+      timer_set_oc_value(timer_, kOcIds[channel_], 0);
+      next_periods_ = 0;
+      return;
+    }
+    index_ = 0;
+  }
+
+  next_periods_ = LoadNote(melody_[index_]);
+}
+
+void Buzzer::Silence() {
+  timer_disable_counter(timer_);
+  playing_ = false;
+
+  // Force the output low by loading a duty cycle of 0
+  timer_set_oc_value(timer_, kOcIds[channel_], 0);
+  timer_generate_event(timer_, TIM_EGR_UG);
+  timer_clear_flag(timer_, TIM_SR_UIF);
+}
+
+void Buzzer::SetIrqEnable(const bool flag) const {
+  if (flag) {
+    timer_enable_irq(timer_, TIM_DIER_UIE);
+  } else {
+    timer_disable_irq(timer_, TIM_DIER_UIE);
+  }
+}
+
+#elif !defined(LIB_USE_BUZZER)
+#error "LIB_USE_BUZZER macro not found. (Did you define it in your board configuration?)"
+#endif
@@ -0,0 +1,235 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_LIB_BUZZER_H_
+#define RTLIB_LIB_BUZZER_H_
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "config/config.h"
+#include "core/gpio.h"
+
+static_assert(LIB_USE_BUZZER > 0, "Buzzer library is disabled in your configuration.");
+
+/**
+ * @brief HAL implementation for piezo buzzers driven by a timer PWM channel.
+ *
+ * This abstraction layer generates tones in hardware, and plays melodies in the background: the update interrupt of
+ * the tone timer counts down the periods of the current note, and loads the next note when it expires. Since the
+ * prescaler and period are preloaded, each note starts exactly at the end of the previous one. Melodies are arrays of
+ * notes, and are not copied, so they can be @c constexpr tables in flash.
+ *
+ * One Buzzer object is designed to manage one buzzer on the mainboard.
+ */
+class Buzzer {
+ public:
+  /**
+   * @brief Frequency value which denotes a rest.
+   */
+  static constexpr uint16_t kRest = 0;
+
+  /**
+   * @brief One note of a melody.
+   */
+  struct Note {
+    /**
+     * @brief Frequency of the tone in Hz, or @c kRest for silence.
+     */
+    uint16_t frequency;
+    /**
+     * @brief Duration of the note, in milliseconds.
+     */
+    uint16_t duration_ms;
+  };
+
+  /**
+   * @brief Configuration for buzzer.
+   */
+  struct Config {
+    /**
+     * @brief ID of the buzzer.
+     *
+     * See your device configuration header file to see which id corresponds to which hardware buzzer.
+     */
+    uint8_t id = 0;
+    /**
+     * @brief Volume, in percent. 100 drives the buzzer with a 50% duty cycle, which is the loudest.
+     */
+    uint8_t volume = 100;
+    /**
+     * @brief Priority of the timer interrupt. Lower values have higher priority.
+     */
+    uint8_t priority = 0xC0;
+  };
+
+  /**
+   * @brief Computes the frequency of a note of the equal-tempered scale.
+   *
+   * @param note MIDI note number, from 12 (C0) to 119 (B8). 69 is A4 (440Hz).
+   * @return Frequency of @p note, rounded to the nearest Hz.
+   */
+  static constexpr uint16_t GetPitch(const uint8_t note) {
+    // Notes above B8 would need a negative shift
+    assert(note >= 12 && note <= 119);
+    // Frequencies of the highest octave (C8 to B8), which are halved for each octave below
+    constexpr std::array<uint16_t, 12> kOctave8 = {
+        4186, 4435, 4699, 4978, 5274, 5588, 5920, 6272, 6645, 7040, 7459, 7902};
+    const int shift = 9 - note / 12;
+    return static_cast<uint16_t>((kOctave8[note % 12] + ((1 << shift) >> 1)) >> shift);
+  }
+
+  /**
+   * @brief Default constructor for buzzer.
+   *
+   * @param config Buzzer configuration
+   */
+  explicit Buzzer(const Config& config);
+
+  /**
+   * @brief Destructor.
+   *
+   * Stops any playback.
+   */
+  ~Buzzer();
+
+  /**
+   * @brief Move constructor for buzzer.
+   *
+   * This constructor is deleted because the interrupt handler refers to this object.
+   */
+  Buzzer(Buzzer&&) = delete;
+  /**
+   * @brief Move assignment operator for buzzer.
+   *
+   * This operator is deleted because the interrupt handler refers to this object.
+   */
+  Buzzer& operator=(Buzzer&&) = delete;
+
+  /**
+   * @brief Copy constructor for buzzer.
+   *
+   * This constructor is deleted because there should only be one object managing each buzzer.
+   */
+  Buzzer(const Buzzer&) = delete;
+  /**
+   * @brief Copy assignment operator for buzzer.
+   *
+   * This operator is deleted because there should only be one object managing each buzzer.
+   */
+  Buzzer& operator=(const Buzzer&) = delete;
+
+  /**
+   * @brief Plays a single tone in the background, replacing any playback in progress.
+   *
+   * @param frequency Frequency of the tone, in Hz
+   * @param duration_ms Duration of the tone, in milliseconds
+   */
+  void Beep(uint16_t frequency, uint16_t duration_ms);
+
+  /**
+   * @brief Plays a melody in the background, replacing any playback in progress.
+   *
+   * @param melody Array of notes. The array is not copied, and must remain valid until playback stops.
+   * @param count Number of elements in @p melody
+   * @param loop Whether to repeat the melody until Stop() is called
+   */
+  void Play(const Note* melody, std::size_t count, bool loop = false);
+
+  /**
+   * @brief Plays a melody in the background, replacing any playback in progress.
+   *
+   * @param melody Array of notes. The array is not copied, and must remain valid until playback stops.
+   * @param loop Whether to repeat the melody until Stop() is called
+   */
+  template<std::size_t N>
+  void Play(const std::array<Note, N>& melody, const bool loop = false) {
+    Play(melody.data(), N, loop);
+  }
+
+  /**
+   * @brief Stops playback immediately.
+   */
+  void Stop();
+
+  /**
+   * @return @c true if a tone or melody is playing.
+   */
+  bool IsPlaying() const { return playing_; }
+
+  /**
+   * @brief Sets the volume. Takes effect from the next note.
+   *
+   * @param volume Volume, in percent
+   */
+  void SetVolume(uint8_t volume) { volume_ = volume > 100 ? uint8_t{100} : volume; }
+
+ private:
+  static void HandleTimerIrq(void* context);
+
+  /**
+   * @brief Preloads the period and duty cycle of a note, which take effect at the next update event.
+   *
+   * @return Number of timer periods of the note.
+   */
+  uint32_t LoadNote(const Note& note);
+  /**
+   * @brief Preloads the note after the current one, or silence if the melody ends.
+   */
+  void PreloadNext();
+  /**
+   * @brief Stops the timer with the output low.
+   */
+  void Silence();
+
+  void SetIrqEnable(bool flag) const;
+
+  uint32_t timer_;
+  uint8_t channel_;
+  /**
+   * @brief Frequency of the timer counter, in Hz.
+   */
+  uint32_t tick_freq_;
+  uint8_t volume_;
+
+  const Note* melody_ = nullptr;
+  std::size_t count_ = 0;
+  std::size_t index_ = 0;
+  bool loop_ = false;
+  /**
+   * @brief Number of timer periods until the current note ends.
+   */
+  uint32_t periods_left_ = 0;
+  /**
+   * @brief Number of timer periods of the preloaded note, or 0 if the melody ends with the current note.
+   */
+  uint32_t next_periods_ = 0;
+  volatile bool playing_ = false;
+  /**
+   * @brief Storage for the note played by Beep().
+   */
+  Note beep_ = {};
+
+  std::optional<CORE_NS::GPIO> gpio_;
+};
+
+#endif  // RTLIB_LIB_BUZZER_H_
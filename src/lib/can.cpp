@@ -0,0 +1,598 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config/config.h"
+
+#if defined(LIB_USE_CAN) && LIB_USE_CAN > 0
+
+#include "lib/can.h"
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/stm32/can.h>
+#include <libopencm3/stm32/rcc.h>
+
+using CORE_NS::GPIO;
+
+namespace {
+/**
+ * @brief Objects which handle the interrupts of CAN1 and CAN2 respectively.
+ */
+std::array<Can*, 2> instances = {};
+
+/**
+ * @brief Number of filter banks available to each controller.
+ *
+ * On STM32F4xx devices, the 28 filter banks are split evenly between CAN1 and CAN2 by the reset value of CAN2SB.
+ */
+constexpr uint8_t kNumFilterBanks = 14;
+
+/**
+ * @brief Interrupt priority of all CAN interrupts.
+ *
+ * Both receive FIFOs push into the same queue, so their interrupts must never preempt each other.
+ */
+constexpr uint8_t kIrqPriority = 0x40;
+
+constexpr uint32_t kTsrRqcp[] = {CAN_TSR_RQCP0, CAN_TSR_RQCP1, CAN_TSR_RQCP2};
+constexpr uint32_t kTsrTxok[] = {CAN_TSR_TXOK0, CAN_TSR_TXOK1, CAN_TSR_TXOK2};
+constexpr uint32_t kTsrAbrq[] = {CAN_TSR_ABRQ0, CAN_TSR_ABRQ1, CAN_TSR_ABRQ2};
+
+constexpr uint32_t kStdIdMask = 0x7FF;
+constexpr uint32_t kExtIdMask = 0x1FFFFFFF;
+
+/**
+ * @brief Position of the IDE bit in 16-bit filter registers.
+ */
+constexpr uint32_t kFilter16Ide = 1 << 3;
+/**
+ * @brief Position of the IDE bit in 32-bit filter registers.
+ */
+constexpr uint32_t kFilter32Ide = 1 << 2;
+
+/**
+ * @brief Hardware configuration of one CAN bus, as read from the board configuration.
+ */
+struct HwConfig {
+  uint32_t can = 0;
+  Pinout rx;
+  Pinout tx;
+#if defined(STM32F1)
+  std::optional<GPIO::PriRemap> remap = std::nullopt;
+#elif defined(STM32F4)
+  GPIO::AltFn altfn = GPIO_AF0;
+#endif
+};
+
+inline HwConfig GetConfigHw(const uint8_t id) {
+  assert(id < LIB_USE_CAN);
+  HwConfig hw;
+  switch (id) {
+    default:
+      // not handled, since assert will catch this error
+      assert(false);
+      break;
+#if LIB_USE_CAN > 0
+    case 0:
+      hw.can = LIB_CAN0_CONTROLLER;
+      hw.rx = Pinout(LIB_CAN0_RX_PINOUT);
+      hw.tx = Pinout(LIB_CAN0_TX_PINOUT);
+#if defined(STM32F1) && defined(LIB_CAN0_REMAP)
+      hw.remap = LIB_CAN0_REMAP;
+#elif defined(STM32F4)
+      hw.altfn = LIB_CAN0_ALTFN;
+#endif
+      break;
+#endif  // LIB_USE_CAN > 0
+#if LIB_USE_CAN > 1
+    case 1:
+      hw.can = LIB_CAN1_CONTROLLER;
+      hw.rx = Pinout(LIB_CAN1_RX_PINOUT);
+      hw.tx = Pinout(LIB_CAN1_TX_PINOUT);
+#if defined(STM32F1) && defined(LIB_CAN1_REMAP)
+      hw.remap = LIB_CAN1_REMAP;
+#elif defined(STM32F4)
+      hw.altfn = LIB_CAN1_ALTFN;
+#endif
+      break;
+#endif  // LIB_USE_CAN > 1
+  }
+  return hw;
+}
+
+inline std::size_t GetCanIndex(const uint32_t can) {
+  switch (can) {
+    case CAN1:
+      return 0;
+#if defined(STM32F4)
+    case CAN2:
+      return 1;
+#endif
+    default:
+      assert(false);
+      return 0;
+  }
+}
+
+/**
+ * @brief Bit timing of a CAN controller.
+ */
+struct BitTiming {
+  uint32_t prescaler;
+  uint32_t ts1;
+  uint32_t ts2;
+};
+
+/**
+ * @brief Finds a bit timing which gives an exact bit rate with a sample point close to 87.5%.
+ *
+ * @param clock_freq Clock frequency of the controller
+ * @param bitrate Bit rate of the bus
+ * @return Bit timing for the controller.
+ */
+inline BitTiming GetBitTiming(const uint32_t clock_freq, const uint32_t bitrate) {
+  // Prefer more time quanta per bit, since the sample point can be placed more accurately
+  for (uint32_t tq = 25; tq >= 8; --tq) {
+    if (clock_freq % (bitrate * tq) != 0) {
+      continue;
+    }
+
+    const uint32_t prescaler = clock_freq / (bitrate * tq);
+    const uint32_t ts2 = (tq + 4) / 8;
+    const uint32_t ts1 = tq - 1 - ts2;
+    if (prescaler <= 1024 && ts1 <= 16) {
+      return {prescaler, ts1, ts2};
+    }
+  }
+
+  // no exact bit timing for this bit rate
+  assert(false);
+  return {1, 1, 1};
+}
+
+/**
+ * @brief Configures and enables one filter bank.
+ *
+ * Banks are alternately assigned to FIFO0 and FIFO1, so that both FIFOs share the reception load.
+ *
+ * @param bank Filter bank number
+ * @param scale_32bit Whether the bank uses one 32-bit filter instead of two 16-bit filters
+ * @param list_mode Whether the bank uses identifier list mode instead of mask mode
+ * @param fr1 Value of the first filter bank register
+ * @param fr2 Value of the second filter bank register
+ */
+inline void InitFilterBank(const uint8_t bank, const bool scale_32bit, const bool list_mode,
+                           const uint32_t fr1, const uint32_t fr2) {
+  const uint32_t bit = uint32_t{1} << bank;
+
+  // All filter registers are in CAN1, even for filter banks assigned to CAN2
+  CAN_FA1R(CAN1) &= ~bit;
+  CAN_FM1R(CAN1) = list_mode ? (CAN_FM1R(CAN1) | bit) : (CAN_FM1R(CAN1) & ~bit);
+  CAN_FS1R(CAN1) = scale_32bit ? (CAN_FS1R(CAN1) | bit) : (CAN_FS1R(CAN1) & ~bit);
+  CAN_FFA1R(CAN1) = (bank & 1) != 0 ? (CAN_FFA1R(CAN1) | bit) : (CAN_FFA1R(CAN1) & ~bit);
+  CAN_FiR1(CAN1, bank) = fr1;
+  CAN_FiR2(CAN1, bank) = fr2;
+  CAN_FA1R(CAN1) |= bit;
+}
+
+/**
+ * @brief Allocates filter banks for a list of acceptance filters.
+ *
+ * Filters are packed as densely as the hardware allows: Exact standard identifiers take a quarter of a bank, masked
+ * standard identifiers and exact extended identifiers take half a bank, and masked extended identifiers take a whole
+ * bank.
+ *
+ * @param first_bank First filter bank assigned to the controller
+ * @param filters Array of acceptance filters
+ * @param num_filters Number of elements in @p filters
+ */
+void InitFilters(const uint8_t first_bank, const Can::Filter* filters, const std::size_t num_filters) {
+  const uint32_t bank_mask = ((uint32_t{1} << kNumFilterBanks) - 1) << first_bank;
+  uint8_t bank = first_bank;
+
+  CAN_FMR(CAN1) |= CAN_FMR_FINIT;
+  CAN_FA1R(CAN1) &= ~bank_mask;
+
+  if (num_filters == 0) {
+    // Accept everything
+    InitFilterBank(bank, true, false, 0, 0);
+  }
+
+  // Packs filters of one kind into banks. Each entry is half of a filter bank register for 16-bit list mode, or a whole
+  // filter bank register otherwise. Unused entries are filled with copies of the first entry.
+  const auto pack = [&](const std::size_t entries_per_bank, const bool scale_32bit, const bool list_mode,
+                        const auto& encode) {
+    std::array<uint32_t, 4> entries = {};
+    std::size_t num_entries = 0;
+    const auto flush = [&]() {
+      assert(std::size_t{bank} < std::size_t{first_bank} + kNumFilterBanks);
+      std::fill(entries.begin() + static_cast<std::ptrdiff_t>(num_entries), entries.end(), entries[0]);
+      if (entries_per_bank == 4) {
+        InitFilterBank(bank, scale_32bit, list_mode, entries[0] | entries[1] << 16, entries[2] | entries[3] << 16);
+      } else {
+        InitFilterBank(bank, scale_32bit, list_mode, entries[0], entries[1]);
+      }
+      ++bank;
+      num_entries = 0;
+    };
+
+    for (std::size_t i = 0; i < num_filters; ++i) {
+      if (encode(filters[i], entries.data() + num_entries, num_entries)) {
+        if (num_entries == entries_per_bank) {
+          flush();
+        }
+      }
+    }
+    if (num_entries != 0) {
+      flush();
+    }
+  };
+
+  // Exact standard identifiers: 16-bit list mode
+  pack(4, false, true, [](const Can::Filter& f, uint32_t* entry, std::size_t& n) {
+    if (f.extended || (f.mask & kStdIdMask) != kStdIdMask) {
+      return false;
+    }
+    entry[0] = (f.id & kStdIdMask) << 5;
+    ++n;
+    return true;
+  });
+  // Masked standard identifiers: 16-bit mask mode. The IDE bit is always compared, so that extended frames are
+  // rejected.
+  pack(2, false, false, [](const Can::Filter& f, uint32_t* entry, std::size_t& n) {
+    if (f.extended || (f.mask & kStdIdMask) == kStdIdMask) {
+      return false;
+    }
+    entry[0] = (f.id & kStdIdMask) << 5 | (((f.mask & kStdIdMask) << 5 | kFilter16Ide) << 16);
+    ++n;
+    return true;
+  });
+  // Exact extended identifiers: 32-bit list mode
+  pack(2, true, true, [](const Can::Filter& f, uint32_t* entry, std::size_t& n) {
+    if (!f.extended || (f.mask & kExtIdMask) != kExtIdMask) {
+      return false;
+    }
+    entry[0] = (f.id & kExtIdMask) << 3 | kFilter32Ide;
+    ++n;
+    return true;
+  });
+  // Masked extended identifiers: 32-bit mask mode, taking both registers of the bank
+  pack(2, true, false, [](const Can::Filter& f, uint32_t* entry, std::size_t& n) {
+    if (!f.extended || (f.mask & kExtIdMask) == kExtIdMask) {
+      return false;
+    }
+    entry[0] = (f.id & kExtIdMask) << 3 | kFilter32Ide;
+    entry[1] = (f.mask & kExtIdMask) << 3 | kFilter32Ide;
+    n += 2;
+    return true;
+  });
+
+  CAN_FMR(CAN1) &= ~static_cast<uint32_t>(CAN_FMR_FINIT);
+}
+
+/**
+ * @brief Computes the bus arbitration priority of a frame.
+ *
+ * @param frame CAN frame
+ * @return Arbitration priority of @p frame. Lower values win arbitration.
+ */
+inline uint32_t GetArbitrationPriority(const Can::Frame& frame) {
+  // Standard identifiers are compared against the 11 most significant bits of extended identifiers. If these are
+  // equal, the standard frame wins because its IDE bit is dominant.
+  const uint32_t base = frame.extended ? (frame.id & kExtIdMask) : (frame.id & kStdIdMask) << 18;
+  return base << 2 | (frame.extended ? 2u : 0u) | (frame.remote ? 1u : 0u);
+}
+
+inline void InitRcc(const uint32_t can) {
+  // CAN2 shares the filter banks of CAN1, so CAN1 must be clocked in either case
+  rcc_periph_clock_enable(RCC_CAN1);
+#if defined(STM32F4)
+  if (can == CAN2) {
+    rcc_periph_clock_enable(RCC_CAN2);
+  }
+#endif
+  can_reset(can);
+}
+
+/**
+ * @return Transmit, FIFO0 and FIFO1 interrupt lines of @p can.
+ */
+inline std::array<uint8_t, 3> GetIrqs(const uint32_t can) {
+#if defined(STM32F1)
+  static_cast<void>(can);
+  return {NVIC_USB_HP_CAN_TX_IRQ, NVIC_USB_LP_CAN_RX0_IRQ, NVIC_CAN_RX1_IRQ};
+#elif defined(STM32F4)
+  return can == CAN1 ?
+      std::array<uint8_t, 3>{NVIC_CAN1_TX_IRQ, NVIC_CAN1_RX0_IRQ, NVIC_CAN1_RX1_IRQ} :
+      std::array<uint8_t, 3>{NVIC_CAN2_TX_IRQ, NVIC_CAN2_RX0_IRQ, NVIC_CAN2_RX1_IRQ};
+#endif
+}
+}  // namespace
+
+#if defined(STM32F1)
+extern "C" void usb_hp_can_tx_isr();
+extern "C" void usb_lp_can_rx0_isr();
+extern "C" void can_rx1_isr();
+
+extern "C" void usb_hp_can_tx_isr() {
+  if (instances[0] != nullptr) {
+    instances[0]->HandleTxIrq();
+  }
+}
+
+extern "C" void usb_lp_can_rx0_isr() {
+  if (instances[0] != nullptr) {
+    instances[0]->HandleRxIrq(0);
+  }
+}
+
+extern "C" void can_rx1_isr() {
+  if (instances[0] != nullptr) {
+    instances[0]->HandleRxIrq(1);
+  }
+}
+#elif defined(STM32F4)
+extern "C" void can1_tx_isr();
+extern "C" void can1_rx0_isr();
+extern "C" void can1_rx1_isr();
+extern "C" void can2_tx_isr();
+extern "C" void can2_rx0_isr();
+extern "C" void can2_rx1_isr();
+
+extern "C" void can1_tx_isr() {
+  if (instances[0] != nullptr) {
+    instances[0]->HandleTxIrq();
+  }
+}
+
+extern "C" void can1_rx0_isr() {
+  if (instances[0] != nullptr) {
+    instances[0]->HandleRxIrq(0);
+  }
+}
+
+extern "C" void can1_rx1_isr() {
+  if (instances[0] != nullptr) {
+    instances[0]->HandleRxIrq(1);
+  }
+}
+
+extern "C" void can2_tx_isr() {
+  if (instances[1] != nullptr) {
+    instances[1]->HandleTxIrq();
+  }
+}
+
+extern "C" void can2_rx0_isr() {
+  if (instances[1] != nullptr) {
+    instances[1]->HandleRxIrq(0);
+  }
+}
+
+extern "C" void can2_rx1_isr() {
+  if (instances[1] != nullptr) {
+    instances[1]->HandleRxIrq(1);
+  }
+}
+#endif
+
+Can::Can(const Config& config) {
+  const HwConfig hw = GetConfigHw(config.id);
+  can_ = hw.can;
+
+#if defined(STM32F1)
+  rx_gpio_.emplace(hw.rx, GPIO::Configuration::kInputFloat, GPIO::Mode::kInput);
+  tx_gpio_.emplace(hw.tx, GPIO::Configuration::kOutputAltFnPushPull, GPIO::Mode::kOutput50MHz);
+
+  if (hw.remap) {
+    rcc_periph_clock_enable(RCC_AFIO);
+    GPIO::SetPriAltFn(GPIO::JTAGDisables::kNoDisable, *hw.remap);
+  }
+#elif defined(STM32F4)
+  rx_gpio_.emplace(hw.rx, GPIO::Mode::kAF, GPIO::Pullup::kPullup, GPIO::Speed::k50MHz, GPIO::DriverType::kPushPull,
+                   hw.altfn);
+  tx_gpio_.emplace(hw.tx, GPIO::Mode::kAF, GPIO::Pullup::kNone, GPIO::Speed::k50MHz, GPIO::DriverType::kPushPull,
+                   hw.altfn);
+#endif
+
+  InitRcc(can_);
+
+  const BitTiming timing = GetBitTiming(rcc_apb1_frequency, config.bitrate);
+  const bool loopback = config.mode == Mode::kLoopback || config.mode == Mode::kSilentLoopback;
+  const bool silent = config.mode == Mode::kSilent || config.mode == Mode::kSilentLoopback;
+
+  // Recover from bus-off automatically, and let the mailboxes transmit in identifier order
+  // Automatic wakeup is disabled, so that the controller stays off the bus after the destructor puts it to sleep
+  const int init_result = can_init(can_,
+                                   false,
+                                   true,
+                                   false,
+                                   false,
+                                   false,
+                                   false,
+                                   CAN_BTR_SJW_1TQ,
+                                   (timing.ts1 - 1) << CAN_BTR_TS1_SHIFT,
+                                   (timing.ts2 - 1) << CAN_BTR_TS2_SHIFT,
+                                   timing.prescaler,
+                                   loopback,
+                                   silent);
+  assert(init_result == 0);
+  static_cast<void>(init_result);
+
+  InitFilters(static_cast<uint8_t>(GetCanIndex(can_) * kNumFilterBanks), config.filters, config.num_filters);
+
+  instances[GetCanIndex(can_)] = this;
+  can_enable_irq(can_, CAN_IER_FMPIE0 | CAN_IER_FOVIE0 | CAN_IER_FMPIE1 | CAN_IER_FOVIE1 | CAN_IER_TMEIE);
+
+  for (const uint8_t irqn : GetIrqs(can_)) {
+    nvic_set_priority(irqn, kIrqPriority);
+    nvic_enable_irq(irqn);
+  }
+}
+
+Can::~Can() {
+  can_disable_irq(can_, CAN_IER_FMPIE0 | CAN_IER_FOVIE0 | CAN_IER_FMPIE1 | CAN_IER_FOVIE1 | CAN_IER_TMEIE);
+  for (const uint8_t irqn : GetIrqs(can_)) {
+    nvic_disable_irq(irqn);
+  }
+  instances[GetCanIndex(can_)] = nullptr;
+
+  // Abort pending transmissions and put the controller to sleep, which takes it off the bus. The controller is not
+  // reset, since the filter banks of CAN2 belong to CAN1.
+  CAN_TSR(can_) = CAN_TSR_ABRQ0 | CAN_TSR_ABRQ1 | CAN_TSR_ABRQ2;
+  CAN_MCR(can_) |= CAN_MCR_SLEEP;
+}
+
+bool Can::Transmit(const Frame& frame) {
+  assert(frame.length <= 8);
+
+  // The heap is shared with the transmit interrupt, and this function may be called from other interrupts
+  const bool masked = cm_mask_interrupts(true);
+
+  const bool queued = tx_size_ < kTxQueueSize;
+  if (queued) {
+    tx_heap_[tx_size_++] = {uint64_t{GetArbitrationPriority(frame)} << 32 | tx_sequence_++, frame};
+    std::push_heap(tx_heap_.begin(), tx_heap_.begin() + static_cast<std::ptrdiff_t>(tx_size_), std::greater<>());
+    FillMailboxes();
+  }
+
+  cm_mask_interrupts(masked);
+  return queued;
+}
+
+void Can::HandleRxIrq(const uint8_t fifo) {
+  volatile uint32_t& rfr = fifo == 0 ? CAN_RF0R(can_) : CAN_RF1R(can_);
+
+  // FOVR has the same position in both FIFO registers
+  if ((rfr & CAN_RF0R_FOVR0) != 0) {
+    rfr = CAN_RF0R_FOVR0;
+    ++rx_overruns_;
+  }
+
+  // Drain the whole FIFO, so that a burst of frames only costs one interrupt
+  while ((rfr & CAN_RF0R_FMP0_MASK) != 0) {
+    Frame frame;
+    uint8_t filter_index;
+    uint16_t timestamp;
+    can_receive(can_, fifo, true, &frame.id, &frame.extended, &frame.remote, &filter_index, &frame.length,
+                frame.data.data(), &timestamp);
+
+    if (!rx_queue_.Push(frame)) {
+      ++rx_overruns_;
+    }
+  }
+}
+
+void Can::HandleTxIrq() {
+  const uint32_t tsr = CAN_TSR(can_);
+  for (std::size_t i = 0; i < kNumMailboxes; ++i) {
+    if ((tsr & kTsrRqcp[i]) == 0) {
+      continue;
+    }
+
+    // Writing 1 to RQCP also clears TXOK, ALST and TERR of the mailbox
+    CAN_TSR(can_) = kTsrRqcp[i];
+
+    const auto bit = static_cast<uint8_t>(1 << i);
+    if ((mailbox_busy_ & bit) != 0 && (tsr & kTsrTxok[i]) == 0) {
+      // Aborted by FillMailboxes(). The frame keeps its sequence number, so it is still ahead of later frames with
+      // the same identifier.
+      tx_heap_[tx_size_++] = mailboxes_[i];
+      std::push_heap(tx_heap_.begin(), tx_heap_.begin() + static_cast<std::ptrdiff_t>(tx_size_), std::greater<>());
+    }
+    mailbox_busy_ &= static_cast<uint8_t>(~bit);
+    mailbox_aborting_ &= static_cast<uint8_t>(~bit);
+  }
+
+  FillMailboxes();
+}
+
+void Can::FillMailboxes() {
+  // Frames which cannot be loaded because a frame of the same identifier occupies a mailbox. They are set aside so
+  // that the frames behind them can still be loaded, and are put back into the heap afterwards.
+  std::array<PendingFrame, kTxLookahead> deferred;
+  std::size_t num_deferred = 0;
+
+  while (tx_size_ > 0 && num_deferred < kTxLookahead) {
+    PendingFrame next = tx_heap_[0];
+    const uint32_t next_priority = static_cast<uint32_t>(next.key >> 32);
+
+    // The mailboxes transmit equal identifiers in mailbox order rather than in the order they were loaded, so only one
+    // frame of each identifier may be in the mailboxes at a time. Later frames of a deferred identifier are deferred as
+    // well, so that they stay in order.
+    std::size_t lowest = kNumMailboxes;
+    bool blocked = false;
+    for (std::size_t i = 0; i < kNumMailboxes; ++i) {
+      if ((mailbox_busy_ & (1 << i)) == 0) {
+        continue;
+      }
+      if (static_cast<uint32_t>(mailboxes_[i].key >> 32) == next_priority) {
+        blocked = true;
+      }
+      if (lowest == kNumMailboxes || mailboxes_[i].key > mailboxes_[lowest].key) {
+        lowest = i;
+      }
+    }
+    for (std::size_t i = 0; i < num_deferred; ++i) {
+      if (static_cast<uint32_t>(deferred[i].key >> 32) == next_priority) {
+        blocked = true;
+      }
+    }
+
+    if (blocked) {
+      deferred[num_deferred++] = next;
+      std::pop_heap(tx_heap_.begin(), tx_heap_.begin() + static_cast<std::ptrdiff_t>(tx_size_), std::greater<>());
+      --tx_size_;
+      continue;
+    }
+
+    if (mailbox_busy_ == (1 << kNumMailboxes) - 1) {
+      // All mailboxes are occupied. Evict the lowest priority frame if it would block the next frame, and refill the
+      // mailbox when the abort completes.
+      const auto bit = static_cast<uint8_t>(1 << lowest);
+      if (next.key < mailboxes_[lowest].key && (mailbox_aborting_ & bit) == 0) {
+        mailbox_aborting_ |= bit;
+        CAN_TSR(can_) = kTsrAbrq[lowest];
+      }
+      break;
+    }
+
+    std::pop_heap(tx_heap_.begin(), tx_heap_.begin() + static_cast<std::ptrdiff_t>(tx_size_), std::greater<>());
+    --tx_size_;
+
+    const int mailbox = can_transmit(can_, next.frame.id, next.frame.extended, next.frame.remote, next.frame.length,
+                                     next.frame.data.data());
+    assert(mailbox >= 0);
+    mailboxes_[static_cast<std::size_t>(mailbox)] = next;
+    mailbox_busy_ |= static_cast<uint8_t>(1 << mailbox);
+  }
+
+  for (std::size_t i = 0; i < num_deferred; ++i) {
+    tx_heap_[tx_size_++] = deferred[i];
+    std::push_heap(tx_heap_.begin(), tx_heap_.begin() + static_cast<std::ptrdiff_t>(tx_size_), std::greater<>());
+  }
+}
+
+#elif !defined(LIB_USE_CAN)
+#error "LIB_USE_CAN macro not found. (Did you define it in your board configuration?)"
+#endif
@@ -0,0 +1,325 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_LIB_CAN_H_
+#define RTLIB_LIB_CAN_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "config/config.h"
+#include "core/gpio.h"
+#include "util/spsc_queue.h"
+
+static_assert(LIB_USE_CAN > 0, "CAN library is disabled in your configuration.");
+
+/**
+ * @brief HAL implementation for bxCAN controllers.
+ *
+ * This abstraction layer filters incoming frames in hardware, using filter banks which are allocated automatically
+ * from a list of identifiers and masks. Both receive FIFOs are drained by interrupts into a lock-free queue, which is
+ * read by Receive(). Outgoing frames are held in a software queue ordered by bus priority, and the transmit interrupt
+ * keeps all three transmit mailboxes filled from it, so that the bus never idles while frames are pending.
+ *
+ * One Can object is designed to manage one CAN bus on the mainboard.
+ */
+class Can {
+ public:
+  /**
+   * @brief Number of frames which can be buffered for reception.
+   */
+  static constexpr std::size_t kRxQueueSize = 64;
+  /**
+   * @brief Number of frames which can be buffered for transmission, excluding those already in the mailboxes.
+   */
+  static constexpr std::size_t kTxQueueSize = 32;
+
+  /**
+   * @brief Enumeration of operating modes.
+   */
+  enum struct Mode {
+    /**
+     * @brief Normal operation.
+     */
+    kNormal,
+    /**
+     * @brief Transmitted frames are received internally, and are also sent to the bus.
+     *
+     * Frames from the bus are ignored. Useful for testing without any other node on the bus.
+     */
+    kLoopback,
+    /**
+     * @brief Frames are received from the bus, but the controller never drives the bus (including acknowledgements).
+     *
+     * Useful for monitoring a bus without affecting it.
+     */
+    kSilent,
+    /**
+     * @brief Combination of loopback and silent mode.
+     *
+     * The controller is fully disconnected from the bus. Useful for self-testing.
+     */
+    kSilentLoopback
+  };
+
+  /**
+   * @brief Data structure of a CAN frame.
+   */
+  struct Frame {
+    /**
+     * @brief Identifier of the frame. 11-bit for standard frames, and 29-bit for extended frames.
+     */
+    uint32_t id = 0;
+    /**
+     * @brief Whether the frame uses an extended identifier.
+     */
+    bool extended = false;
+    /**
+     * @brief Whether this is a remote frame.
+     */
+    bool remote = false;
+    /**
+     * @brief Number of data bytes, from 0 to 8.
+     */
+    uint8_t length = 0;
+    /**
+     * @brief Data bytes. Only the first @c length bytes are valid.
+     */
+    std::array<uint8_t, 8> data = {};
+  };
+
+  /**
+   * @brief Acceptance filter for incoming frames.
+   *
+   * A frame is accepted if its identifier matches @c id in all bits which are set in @c mask.
+   *
+   * Filters which match an identifier exactly (i.e. @c mask is @c kExactMatch) are packed into list-mode filter banks,
+   * which hold up to four standard identifiers or two extended identifiers each. These filters only accept data
+   * frames.
+   */
+  struct Filter {
+    /**
+     * @brief Mask value which requires all bits of the identifier to match.
+     */
+    static constexpr uint32_t kExactMatch = 0xFFFFFFFF;
+
+    /**
+     * @brief Identifier to match.
+     */
+    uint32_t id = 0;
+    /**
+     * @brief Bits of the identifier to compare.
+     */
+    uint32_t mask = kExactMatch;
+    /**
+     * @brief Whether this filter matches extended identifiers. Otherwise this filter matches standard identifiers.
+     */
+    bool extended = false;
+  };
+
+  /**
+   * @brief Configuration for CAN.
+   */
+  struct Config {
+    /**
+     * @brief ID of the CAN bus.
+     *
+     * See your device configuration header file to see which id corresponds to which CAN bus.
+     */
+    uint8_t id = 0;
+    /**
+     * @brief Bit rate of the bus, in bit/s.
+     *
+     * The bit rate must be an integer fraction of the APB1 clock. Defaults to 1Mbit/s.
+     */
+    uint32_t bitrate = 1000000;
+    /**
+     * @brief Operating mode of the controller.
+     */
+    Mode mode = Mode::kNormal;
+    /**
+     * @brief Array of acceptance filters.
+     *
+     * If no filters are specified, all frames are accepted. The array is only read by the constructor.
+     */
+    const Filter* filters = nullptr;
+    /**
+     * @brief Number of elements in @c filters.
+     */
+    std::size_t num_filters = 0;
+  };
+
+  /**
+   * @brief Default constructor for CAN.
+   *
+   * @param config CAN configuration
+   */
+  explicit Can(const Config& config);
+
+  /**
+   * @brief Destructor.
+   *
+   * Disables all interrupts of the controller. Frames which have not been transmitted are discarded.
+   */
+  ~Can();
+
+  /**
+   * @brief Move constructor for CAN.
+   *
+   * This constructor is deleted because the interrupt handlers refer to this object.
+   */
+  Can(Can&&) = delete;
+  /**
+   * @brief Move assignment operator for CAN.
+   *
+   * This operator is deleted because the interrupt handlers refer to this object.
+   */
+  Can& operator=(Can&&) = delete;
+
+  /**
+   * @brief Copy constructor for CAN.
+   *
+   * This constructor is deleted because there should only be one object managing each CAN bus.
+   */
+  Can(const Can&) = delete;
+  /**
+   * @brief Copy assignment operator for CAN.
+   *
+   * This operator is deleted because there should only be one object managing each CAN bus.
+   */
+  Can& operator=(const Can&) = delete;
+
+  /**
+   * @brief Queues a frame for transmission.
+   *
+   * Frames are transmitted in the order of their bus priority. Frames with the same identifier are transmitted in the
+   * order they are queued. This function can also be called from interrupt handlers.
+   *
+   * @param frame Frame to transmit
+   * @return @c true if the frame is queued, @c false if the transmit queue is full.
+   */
+  bool Transmit(const Frame& frame);
+
+  /**
+   * @brief Retrieves a received frame.
+   *
+   * This function must only be called from one context.
+   *
+   * @param frame Reference to store the received frame
+   * @return @c true if a frame is retrieved, @c false if no frames are pending.
+   */
+  bool Receive(Frame& frame) { return rx_queue_.Pop(frame); }
+
+  /**
+   * @return Number of received frames pending to be retrieved.
+   */
+  std::size_t GetRxPending() const { return rx_queue_.GetSize(); }
+
+  /**
+   * @return Number of received frames which were dropped because either the hardware FIFOs or the receive queue
+   * overflowed.
+   */
+  uint32_t GetRxOverruns() const { return rx_overruns_; }
+
+  /**
+   * @brief Handles a receive FIFO interrupt.
+   *
+   * @warning This function is invoked by the CAN interrupt handlers. Do not call this function directly.
+   *
+   * @param fifo Receive FIFO which raised the interrupt
+   */
+  void HandleRxIrq(uint8_t fifo);
+  /**
+   * @brief Handles a transmit mailbox empty interrupt.
+   *
+   * @warning This function is invoked by the CAN interrupt handlers. Do not call this function directly.
+   */
+  void HandleTxIrq();
+
+ private:
+  /**
+   * @brief Number of transmit mailboxes of each controller.
+   */
+  static constexpr std::size_t kNumMailboxes = 3;
+  /**
+   * @brief Maximum number of queued frames which FillMailboxes() skips while looking for a frame it can load.
+   */
+  static constexpr std::size_t kTxLookahead = 8;
+
+  /**
+   * @brief A frame waiting for transmission.
+   */
+  struct PendingFrame {
+    /**
+     * @brief Sort key of the frame. Lower keys are transmitted first.
+     *
+     * The upper 32 bits are the bus arbitration priority, and the lower 32 bits are a sequence number which keeps
+     * frames of equal priority in order.
+     */
+    uint64_t key;
+    Frame frame;
+
+    bool operator>(const PendingFrame& other) const noexcept { return key > other.key; }
+  };
+
+  /**
+   * @brief Moves frames from the transmit queue into free mailboxes.
+   *
+   * Frames whose identifier is already in a mailbox are skipped, so that they do not hold back frames of other
+   * identifiers. If all mailboxes are occupied by frames of lower priority than the next loadable frame, the lowest
+   * priority mailbox is aborted, so that it can be refilled in priority order.
+   *
+   * @note This function must be called with the transmit interrupt masked.
+   */
+  void FillMailboxes();
+
+  uint32_t can_;
+
+  util::SpscQueue<Frame, kRxQueueSize> rx_queue_;
+  volatile uint32_t rx_overruns_ = 0;
+
+  /**
+   * @brief Min-heap of frames waiting for a mailbox.
+   *
+   * Aborted frames are pushed back into the heap, so the heap has space for the frames in the mailboxes as well.
+   */
+  std::array<PendingFrame, kTxQueueSize + kNumMailboxes> tx_heap_;
+  std::size_t tx_size_ = 0;
+  uint32_t tx_sequence_ = 0;
+
+  /**
+   * @brief Frames currently loaded in each transmit mailbox.
+   */
+  std::array<PendingFrame, kNumMailboxes> mailboxes_;
+  /**
+   * @brief Bitmask of mailboxes which are loaded by this object.
+   */
+  uint8_t mailbox_busy_ = 0;
+  /**
+   * @brief Bitmask of mailboxes which have a pending abort request.
+   */
+  uint8_t mailbox_aborting_ = 0;
+
+  std::optional<CORE_NS::GPIO> rx_gpio_;
+  std::optional<CORE_NS::GPIO> tx_gpio_;
+};
+
+#endif  // RTLIB_LIB_CAN_H_
@@ -0,0 +1,237 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config/config.h"
+
+#if defined(LIB_USE_CONTROLLOOP) && LIB_USE_CONTROLLOOP > 0
+
+#include "lib/control_loop.h"
+
+#include <cassert>
+#include <limits>
+
+#include <libopencm3/cm3/dwt.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/timer.h>
+
+#include "core/timer.h"
+
+using CORE_NS::Timer;
+
+namespace {
+/**
+ * @brief Hardware configuration of one control loop timer, as read from the board configuration.
+ */
+struct HwConfig {
+  uint32_t timer = 0;
+};
+
+inline HwConfig GetConfigHw(const uint8_t id) {
+  assert(id < LIB_USE_CONTROLLOOP);
+  HwConfig hw;
+  switch (id) {
+    default:
+      // not handled, since assert will catch this error
+      assert(false);
+      break;
+#if LIB_USE_CONTROLLOOP > 0
+    case 0:
+      hw.timer = LIB_CONTROLLOOP0_TIMER;
+      break;
+#endif  // LIB_USE_CONTROLLOOP > 0
+#if LIB_USE_CONTROLLOOP > 1
+    case 1:
+      hw.timer = LIB_CONTROLLOOP1_TIMER;
+      break;
+#endif  // LIB_USE_CONTROLLOOP > 1
+  }
+  return hw;
+}
+}  // namespace
+
+ControlLoop::ControlLoop(const Config& config) {
+  assert(config.frequency > 0);
+
+  const HwConfig hw = GetConfigHw(config.id);
+  timer_ = hw.timer;
+
+  Timer::InitRcc(timer_);
+
+  // Use the smallest prescaler which fits one period into a 16-bit counter, which gives the most accurate frequency
+  const uint32_t clock_freq = Timer::GetClockFreq(timer_);
+  assert(config.frequency > 0);
+  const uint32_t ticks = clock_freq / config.frequency;
+  assert(ticks > 0);
+  const uint32_t prescaler = (ticks - 1) / 0x10000;
+  assert(prescaler <= 0xFFFF);
+  const uint32_t period = ticks / (prescaler + 1);
+  frequency_ = clock_freq / ((prescaler + 1) * period);
+  period_cycles_ = static_cast<uint32_t>(uint64_t{rcc_ahb_frequency} * (prescaler + 1) * period / clock_freq);
+
+  timer_set_mode(timer_, TIM_CR1_CKD_CK_INT, TIM_CR1_CMS_EDGE, TIM_CR1_DIR_UP);
+  timer_set_prescaler(timer_, prescaler);
+  timer_set_period(timer_, period - 1);
+  timer_enable_preload(timer_);
+  timer_generate_event(timer_, TIM_EGR_UG);
+  timer_clear_flag(timer_, TIM_SR_UIF);
+
+  dwt_enable_cycle_counter();
+  ResetStatistics();
+
+  Timer::SetIrqHandler(timer_, &HandleTimerIrq, this, config.priority);
+}
+
+ControlLoop::~ControlLoop() {
+  Stop();
+  Timer::SetIrqHandler(timer_, nullptr);
+}
+
+std::size_t ControlLoop::Register(const Task task, void* context, const uint32_t divider) {
+  assert(task != nullptr);
+  assert(divider > 0);
+
+  if (num_tasks_ == kMaxTasks) {
+    return kMaxTasks;
+  }
+
+  SetIrqEnable(false);
+  const std::size_t index = num_tasks_;
+  tasks_[index] = {task, context, divider, 1, {}};
+  ++num_tasks_;
+  SetIrqEnable(running_);
+
+  return index;
+}
+
+void ControlLoop::Start() {
+  if (running_) {
+    return;
+  }
+
+  // The first tick is one full period after starting
+  timer_set_counter(timer_, 0);
+  timer_clear_flag(timer_, TIM_SR_UIF);
+  running_ = true;
+  SetIrqEnable(true);
+  timer_enable_counter(timer_);
+}
+
+void ControlLoop::Stop() {
+  timer_disable_counter(timer_);
+  SetIrqEnable(false);
+  running_ = false;
+}
+
+ControlLoop::Statistics ControlLoop::GetStatistics() const {
+  SetIrqEnable(false);
+  const Statistics stats = stats_;
+  SetIrqEnable(running_);
+  return stats;
+}
+
+ControlLoop::TaskStatistics ControlLoop::GetTaskStatistics(const std::size_t index) const {
+  assert(index < num_tasks_);
+
+  SetIrqEnable(false);
+  const TaskStatistics stats = tasks_[index].stats;
+  SetIrqEnable(running_);
+  return stats;
+}
+
+void ControlLoop::ResetStatistics() {
+  SetIrqEnable(false);
+  stats_ = {};
+  stats_.min_interval = std::numeric_limits<uint32_t>::max();
+  for (std::size_t i = 0; i < num_tasks_; ++i) {
+    tasks_[i].stats = {};
+  }
+  SetIrqEnable(running_);
+}
+
+void ControlLoop::HandleTimerIrq(void* context) {
+  auto& self = *static_cast<ControlLoop*>(context);
+  if (!timer_get_flag(self.timer_, TIM_SR_UIF)) {
+    return;
+  }
+
+  timer_clear_flag(self.timer_, TIM_SR_UIF);
+  self.Tick();
+}
+
+void ControlLoop::Tick() {
+  const uint32_t start = dwt_read_cycle_counter();
+
+  // The interval is only meaningful if the previous tick was recorded since the last reset
+  if (stats_.ticks != 0) {
+    const uint32_t interval = start - last_start_;
+    const uint32_t jitter = interval > period_cycles_ ? interval - period_cycles_ : period_cycles_ - interval;
+    if (interval < stats_.min_interval) {
+      stats_.min_interval = interval;
+    }
+    if (interval > stats_.max_interval) {
+      stats_.max_interval = interval;
+    }
+    if (jitter > stats_.max_jitter) {
+      stats_.max_jitter = jitter;
+    }
+  }
+  last_start_ = start;
+  ++stats_.ticks;
+
+  for (std::size_t i = 0; i < num_tasks_; ++i) {
+    TaskEntry& entry = tasks_[i];
+    if (--entry.countdown != 0) {
+      continue;
+    }
+    entry.countdown = entry.divider;
+
+    const uint32_t task_start = dwt_read_cycle_counter();
+    entry.task(entry.context);
+    const uint32_t cycles = dwt_read_cycle_counter() - task_start;
+
+    ++entry.stats.runs;
+    entry.stats.last_cycles = cycles;
+    if (cycles > entry.stats.max_cycles) {
+      entry.stats.max_cycles = cycles;
+    }
+  }
+
+  const uint32_t cycles = dwt_read_cycle_counter() - start;
+  stats_.last_cycles = cycles;
+  if (cycles > stats_.max_cycles) {
+    stats_.max_cycles = cycles;
+  }
+
+  // If the next update event has already occurred, the next tick will start late
+  if (cycles >= period_cycles_ || timer_get_flag(timer_, TIM_SR_UIF)) {
+    ++stats_.overruns;
+  }
+}
+
+void ControlLoop::SetIrqEnable(const bool flag) const {
+  if (flag) {
+    timer_enable_irq(timer_, TIM_DIER_UIE);
+  } else {
+    timer_disable_irq(timer_, TIM_DIER_UIE);
+  }
+}
+
+#elif !defined(LIB_USE_CONTROLLOOP)
+#error "LIB_USE_CONTROLLOOP macro not found. (Did you define it in your board configuration?)"
+#endif
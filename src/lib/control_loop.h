@@ -0,0 +1,267 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_LIB_CONTROL_LOOP_H_
+#define RTLIB_LIB_CONTROL_LOOP_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "config/config.h"
+
+static_assert(LIB_USE_CONTROLLOOP > 0, "ControlLoop library is disabled in your configuration.");
+
+/**
+ * @brief Fixed-rate executor for control loops.
+ *
+ * This abstraction layer runs registered tasks from the update interrupt of a hardware timer, so the loop period does
+ * not depend on the rest of the firmware. Each task runs every @c divider ticks, which allows inner loops of a cascade
+ * to run at a higher rate than outer loops. Tasks run in the order they are registered.
+ *
+ * The execution time of every tick and every task is measured with the DWT cycle counter. A tick overruns if it takes
+ * longer than one period, in which case the following tick starts late. The interval between the start of consecutive
+ * ticks is also recorded, and its deviation from the nominal period is reported as jitter. Jitter is caused by
+ * interrupts of higher priority, and by sections of code which mask interrupts.
+ *
+ * The priority of the timer interrupt should be higher than that of all interrupts which may take a long time, but
+ * lower than that of the interrupts which tasks depend on (e.g. DMA completion of sensor reads).
+ *
+ * One ControlLoop object is designed to manage one timer on the mainboard.
+ */
+class ControlLoop {
+ public:
+  /**
+   * @brief Maximum number of registered tasks.
+   */
+  static constexpr std::size_t kMaxTasks = 8;
+
+  /**
+   * @brief Type definition for tasks.
+   *
+   * @param context User-defined pointer, as passed to Register().
+   */
+  using Task = void (*)(void* context);
+
+  /**
+   * @brief Configuration for the control loop executor.
+   */
+  struct Config {
+    /**
+     * @brief ID of the timer.
+     *
+     * See your device configuration header file to see which id corresponds to which timer.
+     */
+    uint8_t id = 0;
+    /**
+     * @brief Tick frequency, in Hz.
+     */
+    uint32_t frequency = 1000;
+    /**
+     * @brief Priority of the timer interrupt. Lower values have higher priority.
+     */
+    uint8_t priority = 0x40;
+  };
+
+  /**
+   * @brief Execution statistics of one task, in CPU cycles.
+   */
+  struct TaskStatistics {
+    /**
+     * @brief Number of times the task has run.
+     */
+    uint32_t runs;
+    /**
+     * @brief Execution time of the latest run.
+     */
+    uint32_t last_cycles;
+    /**
+     * @brief Longest execution time.
+     */
+    uint32_t max_cycles;
+  };
+
+  /**
+   * @brief Execution statistics of the executor, in CPU cycles.
+   */
+  struct Statistics {
+    /**
+     * @brief Number of ticks.
+     */
+    uint32_t ticks;
+    /**
+     * @brief Number of ticks which took longer than one period.
+     */
+    uint32_t overruns;
+    /**
+     * @brief Execution time of all tasks in the latest tick.
+     */
+    uint32_t last_cycles;
+    /**
+     * @brief Longest execution time of all tasks in one tick.
+     */
+    uint32_t max_cycles;
+    /**
+     * @brief Shortest interval between the start of two consecutive ticks.
+     */
+    uint32_t min_interval;
+    /**
+     * @brief Longest interval between the start of two consecutive ticks.
+     */
+    uint32_t max_interval;
+    /**
+     * @brief Largest deviation of the interval between two consecutive ticks from the nominal period.
+     */
+    uint32_t max_jitter;
+  };
+
+  /**
+   * @brief Default constructor for the control loop executor.
+   *
+   * The executor is stopped until Start() is called.
+   *
+   * @param config Executor configuration
+   */
+  explicit ControlLoop(const Config& config);
+
+  /**
+   * @brief Destructor.
+   *
+   * Stops the timer and releases its interrupt.
+   */
+  ~ControlLoop();
+
+  /**
+   * @brief Move constructor for ControlLoop.
+   *
+   * This constructor is deleted because the interrupt handler refers to this object.
+   */
+  ControlLoop(ControlLoop&&) = delete;
+  /**
+   * @brief Move assignment operator for ControlLoop.
+   *
+   * This operator is deleted because the interrupt handler refers to this object.
+   */
+  ControlLoop& operator=(ControlLoop&&) = delete;
+
+  /**
+   * @brief Copy constructor for ControlLoop.
+   *
+   * This constructor is deleted because there should only be one object managing each timer.
+   */
+  ControlLoop(const ControlLoop&) = delete;
+  /**
+   * @brief Copy assignment operator for ControlLoop.
+   *
+   * This operator is deleted because there should only be one object managing each timer.
+   */
+  ControlLoop& operator=(const ControlLoop&) = delete;
+
+  /**
+   * @brief Registers a task.
+   *
+   * @param task Function to run
+   * @param context User-defined pointer which will be passed to @p task
+   * @param divider Number of ticks between consecutive runs of @p task. Must not be 0.
+   * @return Index of the task for GetTaskStatistics(), or @c kMaxTasks if all slots are taken.
+   */
+  std::size_t Register(Task task, void* context = nullptr, uint32_t divider = 1);
+
+  /**
+   * @brief Starts running the tasks.
+   */
+  void Start();
+  /**
+   * @brief Stops running the tasks. A tick which is already running completes normally.
+   */
+  void Stop();
+
+  /**
+   * @return @c true if the executor is running.
+   */
+  bool IsRunning() const { return running_; }
+
+  /**
+   * @return Actual tick frequency, in Hz. May differ slightly from the configured frequency due to the resolution of
+   * the timer.
+   */
+  uint32_t GetFrequency() const { return frequency_; }
+  /**
+   * @return Nominal length of one period, in CPU cycles.
+   */
+  uint32_t GetPeriodCycles() const { return period_cycles_; }
+
+  /**
+   * @return Snapshot of the execution statistics of the executor.
+   */
+  Statistics GetStatistics() const;
+  /**
+   * @param index Index of the task, as returned by Register()
+   * @return Snapshot of the execution statistics of the task.
+   */
+  TaskStatistics GetTaskStatistics(std::size_t index) const;
+  /**
+   * @brief Clears all execution statistics.
+   */
+  void ResetStatistics();
+
+ private:
+  /**
+   * @brief A registered task and its schedule.
+   */
+  struct TaskEntry {
+    Task task;
+    void* context;
+    uint32_t divider;
+    /**
+     * @brief Number of ticks until the next run.
+     */
+    uint32_t countdown;
+    TaskStatistics stats;
+  };
+
+  static void HandleTimerIrq(void* context);
+
+  /**
+   * @brief Runs all tasks which are due, and updates the statistics.
+   */
+  void Tick();
+
+  /**
+   * @brief Enables or disables the update interrupt, to protect state shared with the interrupt handler.
+   */
+  void SetIrqEnable(bool flag) const;
+
+  uint32_t timer_;
+  uint32_t frequency_;
+  uint32_t period_cycles_;
+
+  std::array<TaskEntry, kMaxTasks> tasks_ = {};
+  std::size_t num_tasks_ = 0;
+
+  Statistics stats_ = {};
+  /**
+   * @brief Cycle counter at the start of the latest tick.
+   */
+  uint32_t last_start_ = 0;
+
+  volatile bool running_ = false;
+};
+
+#endif  // RTLIB_LIB_CONTROL_LOOP_H_
@@ -0,0 +1,189 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config/config.h"
+
+#if defined(LIB_USE_CRC) && LIB_USE_CRC > 0
+
+#include "lib/crc.h"
+
+#include <algorithm>
+#include <cassert>
+#include <optional>
+
+#include <libopencm3/stm32/crc.h>
+#include <libopencm3/stm32/rcc.h>
+
+#include "lib/dma_routes.h"
+
+using CORE_NS::Dma;
+
+namespace {
+/**
+ * @brief Maximum number of words in one DMA transfer.
+ */
+constexpr std::size_t kMaxChunkWords = 0xFFFF;
+
+inline bool IsDmaAccessible(const void* address) {
+#if defined(STM32F4)
+  // The core-coupled memory is only connected to the CPU
+  const uint32_t value = reinterpret_cast<uint32_t>(address);
+  return value < 0x10000000 || value >= 0x10010000;
+#else
+  static_cast<void>(address);
+  return true;
+#endif
+}
+
+/**
+ * @brief Feeds words into the CRC unit.
+ *
+ * The loop is unrolled, since the CRC unit accepts one word per cycle and the loop overhead would otherwise dominate.
+ */
+inline void Feed(const uint32_t* data, std::size_t count) {
+  for (; count >= 4; count -= 4, data += 4) {
+    CRC_DR = data[0];
+    CRC_DR = data[1];
+    CRC_DR = data[2];
+    CRC_DR = data[3];
+  }
+  for (; count > 0; --count, ++data) {
+    CRC_DR = *data;
+  }
+}
+}  // namespace
+
+Crc::Crc(const Config& config) : priority_(config.priority), dma_threshold_(config.dma_threshold) {
+  rcc_periph_clock_enable(RCC_CRC);
+  crc_reset();
+
+  const std::optional<Dma::Route> route =
+      Dma::Allocate(Dma::Request::kMemToMem, DmaRoutes::kFixed, std::size(DmaRoutes::kFixed));
+  assert(route);
+  route_ = *route;
+}
+
+Crc::~Crc() { Dma::Release(route_); }
+
+uint32_t Crc::Compute(const uint32_t* data, const std::size_t count) {
+  assert(!busy_);
+  crc_reset();
+  Feed(data, count);
+  return CRC_DR;
+}
+
+uint32_t Crc::Accumulate(const uint32_t* data, const std::size_t count) {
+  assert(!busy_);
+  Feed(data, count);
+  return CRC_DR;
+}
+
+bool Crc::ComputeAsync(const uint32_t* data,
+                       const std::size_t count,
+                       const Callback callback,
+                       void* context,
+                       const bool accumulate) {
+  if (busy_) {
+    return false;
+  }
+
+  if (!accumulate) {
+    crc_reset();
+  }
+
+  data_ = data;
+  words_remaining_ = count;
+  callback_ = callback;
+  context_ = context;
+  error_ = false;
+  busy_ = true;
+
+  if (count < dma_threshold_ || !IsDmaAccessible(data)) {
+    Feed(data, count);
+    Finish();
+  } else {
+    StartChunk();
+  }
+  return true;
+}
+
+uint32_t Crc::Wait() const {
+  while (busy_) {
+  }
+  return CRC_DR;
+}
+
+void Crc::HandleDmaEvent(const Dma::Event event, void* context) {
+  Crc& self = *static_cast<Crc*>(context);
+
+  switch (event) {
+    case Dma::Event::kTransferComplete:
+      self.data_ += self.chunk_words_;
+      self.words_remaining_ -= self.chunk_words_;
+
+      if (self.words_remaining_ > 0) {
+        self.StartChunk();
+      } else {
+        self.Finish();
+      }
+      break;
+    case Dma::Event::kError:
+      self.error_ = true;
+      self.Finish();
+      break;
+    case Dma::Event::kHalfTransfer:
+    case Dma::Event::kBuffer0Complete:
+    case Dma::Event::kBuffer1Complete:
+      // Not enabled for single-buffered transfers without half transfer interrupts
+      break;
+    default:
+      assert(false);
+      break;
+  }
+}
+
+void Crc::StartChunk() {
+  chunk_words_ = static_cast<uint16_t>(std::min(words_remaining_, kMaxChunkWords));
+
+  // The buffer is the source of the memory-to-memory transfer, and every word is written to the data register
+  Dma::Transfer transfer;
+  transfer.direction = Dma::Direction::kMemToMem;
+  transfer.peripheral = reinterpret_cast<uint32_t>(data_);
+  transfer.memory0 = const_cast<uint32_t*>(&CRC_DR);
+  transfer.count = chunk_words_;
+  transfer.peripheral_width = Dma::Width::kWord;
+  transfer.memory_width = Dma::Width::kWord;
+  transfer.peripheral_increment = true;
+  transfer.memory_increment = false;
+  transfer.priority = priority_;
+  transfer.callback = &HandleDmaEvent;
+  transfer.context = this;
+  Dma::Start(route_, transfer);
+}
+
+void Crc::Finish() {
+  busy_ = false;
+  if (callback_ != nullptr) {
+    callback_(CRC_DR, context_);
+  }
+}
+
+#elif !defined(LIB_USE_CRC)
+#error "LIB_USE_CRC macro not found. (Did you define it in your board configuration?)"
+#endif
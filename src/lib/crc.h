@@ -0,0 +1,194 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_LIB_CRC_H_
+#define RTLIB_LIB_CRC_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "config/config.h"
+#include "core/dma.h"
+
+static_assert(LIB_USE_CRC > 0, "Crc library is disabled in your configuration.");
+
+/**
+ * @brief HAL implementation for the CRC calculation unit.
+ *
+ * The CRC unit computes CRC-32/MPEG-2 (polynomial @c 0x04C11DB7, initial value @c 0xFFFFFFFF, no reflection, no final
+ * XOR) over 32-bit words, one word per AHB write. Each word is processed most significant byte first, so the result
+ * equals util::Crc32Mpeg2 over the same words serialized in big-endian order.
+ *
+ * Small buffers are fed by the CPU. Large buffers can be fed by a memory-to-memory DMA stream in the background using
+ * ComputeAsync(), which frees the CPU for other work while firmware images or large packets are checked.
+ *
+ * For other polynomials (e.g. CRC-16/CCITT or CRC-8 used by most framing protocols), use the table-driven software
+ * implementations in util/crc.h.
+ *
+ * There should only be one Crc object, since there is only one CRC unit.
+ */
+class Crc {
+ public:
+  /**
+   * @brief Type definition for completion callbacks.
+   *
+   * @param crc Result of the computation
+   * @param context User-defined pointer, as passed to ComputeAsync().
+   */
+  using Callback = void (*)(uint32_t crc, void* context);
+
+  /**
+   * @brief Configuration for CRC.
+   */
+  struct Config {
+    /**
+     * @brief Number of words below which ComputeAsync() feeds the CPU directly, since setting up the DMA takes longer.
+     */
+    std::size_t dma_threshold = 64;
+    /**
+     * @brief Priority of the DMA stream.
+     */
+    CORE_NS::Dma::Priority priority = CORE_NS::Dma::Priority::kLow;
+  };
+
+  /**
+   * @brief Default constructor for CRC.
+   *
+   * @param config CRC configuration
+   */
+  explicit Crc(const Config& config);
+
+  /**
+   * @brief Destructor.
+   *
+   * Releases the DMA stream.
+   */
+  ~Crc();
+
+  /**
+   * @brief Move constructor for CRC.
+   *
+   * This constructor is deleted because the DMA interrupt handler refers to this object.
+   */
+  Crc(Crc&&) = delete;
+  /**
+   * @brief Move assignment operator for CRC.
+   *
+   * This operator is deleted because the DMA interrupt handler refers to this object.
+   */
+  Crc& operator=(Crc&&) = delete;
+
+  /**
+   * @brief Copy constructor for CRC.
+   *
+   * This constructor is deleted because there should only be one object managing the CRC unit.
+   */
+  Crc(const Crc&) = delete;
+  /**
+   * @brief Copy assignment operator for CRC.
+   *
+   * This operator is deleted because there should only be one object managing the CRC unit.
+   */
+  Crc& operator=(const Crc&) = delete;
+
+  /**
+   * @brief Computes the CRC of a buffer using the CPU.
+   *
+   * Must not be called while an asynchronous computation is in progress.
+   *
+   * @param data Pointer to the buffer
+   * @param count Number of words in the buffer
+   * @return CRC of the buffer.
+   */
+  uint32_t Compute(const uint32_t* data, std::size_t count);
+  /**
+   * @brief Continues the previous computation with another buffer using the CPU.
+   *
+   * Must not be called while an asynchronous computation is in progress.
+   *
+   * @param data Pointer to the buffer
+   * @param count Number of words in the buffer
+   * @return CRC of all buffers fed since the last reset.
+   */
+  uint32_t Accumulate(const uint32_t* data, std::size_t count);
+
+  /**
+   * @brief Starts computing the CRC of a buffer in the background.
+   *
+   * The buffer must not be modified until the computation completes. Buffers which are smaller than
+   * Config#dma_threshold words, or which cannot be accessed by the DMA, are computed immediately by the CPU, and
+   * @p callback is invoked before this function returns.
+   *
+   * @param data Pointer to the buffer
+   * @param count Number of words in the buffer
+   * @param callback Function to invoke from the DMA interrupt when the computation completes, or @c nullptr
+   * @param context User-defined pointer which will be passed to @p callback
+   * @param accumulate Whether to continue the previous computation instead of starting a new one
+   * @return @c true if the computation is started, @c false if another computation is in progress.
+   */
+  bool ComputeAsync(const uint32_t* data,
+                    std::size_t count,
+                    Callback callback = nullptr,
+                    void* context = nullptr,
+                    bool accumulate = false);
+
+  /**
+   * @return @c true if an asynchronous computation is in progress.
+   */
+  bool IsBusy() const { return busy_; }
+
+  /**
+   * @brief Waits for the asynchronous computation to complete.
+   *
+   * @return CRC of all buffers fed since the last reset.
+   */
+  uint32_t Wait() const;
+
+  /**
+   * @return @c true if the last asynchronous computation was aborted by a DMA error.
+   */
+  bool HasError() const { return error_; }
+
+ private:
+  static void HandleDmaEvent(CORE_NS::Dma::Event event, void* context);
+
+  /**
+   * @brief Starts the DMA transfer of the next chunk of the buffer.
+   */
+  void StartChunk();
+  /**
+   * @brief Ends the asynchronous computation, and invokes the callback.
+   */
+  void Finish();
+
+  CORE_NS::Dma::Route route_;
+  CORE_NS::Dma::Priority priority_;
+  std::size_t dma_threshold_;
+
+  const uint32_t* data_ = nullptr;
+  std::size_t words_remaining_ = 0;
+  uint16_t chunk_words_ = 0;
+
+  volatile bool busy_ = false;
+  volatile bool error_ = false;
+  Callback callback_ = nullptr;
+  void* context_ = nullptr;
+};
+
+#endif  // RTLIB_LIB_CRC_H_
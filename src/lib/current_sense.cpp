@@ -0,0 +1,308 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config/config.h"
+
+#if defined(LIB_USE_CURRENTSENSE) && LIB_USE_CURRENTSENSE > 0
+
+#include "lib/current_sense.h"
+
+#include <cassert>
+
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/stm32/adc.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/timer.h>
+
+using CORE_NS::GPIO;
+
+namespace {
+/**
+ * @brief Objects which handle the interrupts of ADC1, ADC2 and ADC3 respectively.
+ */
+std::array<CurrentSense*, 3> instances = {};
+
+/**
+ * @brief Hardware configuration of one current sense, as read from the board configuration.
+ */
+struct HwConfig {
+  uint32_t adc = 0;
+  std::array<std::optional<Pinout>, CurrentSense::kMaxChannels> pins = {};
+};
+
+inline HwConfig GetConfigHw(const uint8_t id) {
+  assert(id < LIB_USE_CURRENTSENSE);
+  HwConfig hw;
+  switch (id) {
+    default:
+      // not handled, since assert will catch this error
+      assert(false);
+      break;
+#if LIB_USE_CURRENTSENSE > 0
+    case 0:
+      hw.adc = LIB_CURRENTSENSE0_ADC;
+      hw.pins[0] = Pinout(LIB_CURRENTSENSE0_CH1_PINOUT);
+#if defined(LIB_CURRENTSENSE0_CH2_PINOUT)
+      hw.pins[1] = Pinout(LIB_CURRENTSENSE0_CH2_PINOUT);
+#endif  // defined(LIB_CURRENTSENSE0_CH2_PINOUT)
+#if defined(LIB_CURRENTSENSE0_CH3_PINOUT)
+      hw.pins[2] = Pinout(LIB_CURRENTSENSE0_CH3_PINOUT);
+#endif  // defined(LIB_CURRENTSENSE0_CH3_PINOUT)
+#if defined(LIB_CURRENTSENSE0_CH4_PINOUT)
+      hw.pins[3] = Pinout(LIB_CURRENTSENSE0_CH4_PINOUT);
+#endif  // defined(LIB_CURRENTSENSE0_CH4_PINOUT)
+      break;
+#endif  // LIB_USE_CURRENTSENSE > 0
+#if LIB_USE_CURRENTSENSE > 1
+    case 1:
+      hw.adc = LIB_CURRENTSENSE1_ADC;
+      hw.pins[0] = Pinout(LIB_CURRENTSENSE1_CH1_PINOUT);
+#if defined(LIB_CURRENTSENSE1_CH2_PINOUT)
+      hw.pins[1] = Pinout(LIB_CURRENTSENSE1_CH2_PINOUT);
+#endif  // defined(LIB_CURRENTSENSE1_CH2_PINOUT)
+#if defined(LIB_CURRENTSENSE1_CH3_PINOUT)
+      hw.pins[2] = Pinout(LIB_CURRENTSENSE1_CH3_PINOUT);
+#endif  // defined(LIB_CURRENTSENSE1_CH3_PINOUT)
+#if defined(LIB_CURRENTSENSE1_CH4_PINOUT)
+      hw.pins[3] = Pinout(LIB_CURRENTSENSE1_CH4_PINOUT);
+#endif  // defined(LIB_CURRENTSENSE1_CH4_PINOUT)
+      break;
+#endif  // LIB_USE_CURRENTSENSE > 1
+  }
+  return hw;
+}
+
+inline std::size_t GetAdcIndex(const uint32_t adc) {
+  switch (adc) {
+    case ADC1:
+      return 0;
+    case ADC2:
+      return 1;
+    case ADC3:
+      return 2;
+    default:
+      assert(false);
+      return 0;
+  }
+}
+
+/**
+ * @brief Retrieves the ADC input channel which is connected to a pin.
+ *
+ * The mapping is the same for all ADCs on both STM32F1xx and STM32F4xx devices.
+ *
+ * @param pin MCU pinout
+ * @return ADC input channel of @p pin.
+ */
+inline uint8_t GetAdcChannel(const Pinout& pin) {
+  uint8_t base = 0;
+  switch (pin.first) {
+    case GPIOA:
+      // PA0-PA7: IN0-IN7
+      base = 0;
+      break;
+    case GPIOB:
+      // PB0-PB1: IN8-IN9
+      base = 8;
+      break;
+    case GPIOC:
+      // PC0-PC5: IN10-IN15
+      base = 10;
+      break;
+    default:
+      assert(false);
+      break;
+  }
+  return static_cast<uint8_t>(base + __builtin_ctz(pin.second));
+}
+
+/**
+ * @brief Selects the injected trigger which corresponds to channel 4 of an advanced-control timer.
+ *
+ * @param adc ADC to trigger
+ * @param timer Timer which generates the trigger
+ * @return Value for the JEXTSEL field of @c ADC_CR2.
+ */
+inline uint32_t GetInjectedTrigger(const uint32_t adc, const uint32_t timer) {
+#if defined(STM32F1)
+  if (timer == TIM1) {
+    return ADC_CR2_JEXTSEL_TIM1_CC4;
+  }
+
+  // TIM8_CC4 can only reach ADC1/ADC2 by remapping their EXTI15 trigger
+  assert(adc == ADC1 || adc == ADC2);
+  rcc_periph_clock_enable(RCC_AFIO);
+  GPIO::SetPriAltFn(GPIO::JTAGDisables::kNoDisable,
+                    adc == ADC1 ? GPIO::PriRemap::kADC1ExtTrigInj : GPIO::PriRemap::kADC2ExtTrigInj);
+  return ADC_CR2_JEXTSEL_EXTI15;
+#elif defined(STM32F4)
+  static_cast<void>(adc);
+  return timer == TIM1 ? ADC_CR2_JEXTSEL_TIM1_CC4 : ADC_CR2_JEXTSEL_TIM8_CC4;
+#endif
+}
+
+inline void InitRcc(const uint32_t adc) {
+  switch (adc) {
+    case ADC1:
+      rcc_periph_clock_enable(RCC_ADC1);
+      break;
+    case ADC2:
+      rcc_periph_clock_enable(RCC_ADC2);
+      break;
+    case ADC3:
+      rcc_periph_clock_enable(RCC_ADC3);
+      break;
+    default:
+      assert(false);
+      break;
+  }
+}
+
+inline void DispatchIrq(const uint32_t adc) {
+  CurrentSense* instance = instances[GetAdcIndex(adc)];
+  if (instance != nullptr && adc_eoc_injected(adc)) {
+    instance->HandleIrq();
+  }
+}
+}  // namespace
+
+#if defined(STM32F1)
+extern "C" void adc1_2_isr();
+extern "C" void adc3_isr();
+
+extern "C" void adc1_2_isr() {
+  DispatchIrq(ADC1);
+  DispatchIrq(ADC2);
+}
+
+extern "C" void adc3_isr() {
+  DispatchIrq(ADC3);
+}
+#elif defined(STM32F4)
+extern "C" void adc_isr();
+
+extern "C" void adc_isr() {
+  DispatchIrq(ADC1);
+  DispatchIrq(ADC2);
+  DispatchIrq(ADC3);
+}
+#endif
+
+CurrentSense::CurrentSense(const Config& config) :
+    callback_(config.callback),
+    context_(config.context) {
+  assert(config.pwm != nullptr);
+  assert(config.pwm->IsCenterAligned());
+
+  const HwConfig hw = GetConfigHw(config.id);
+  adc_ = hw.adc;
+
+  std::array<uint8_t, kMaxChannels> channels = {};
+  for (std::size_t i = 0; i < hw.pins.size() && hw.pins[i]; ++i) {
+#if defined(STM32F1)
+    gpios_[i].emplace(*hw.pins[i], GPIO::Configuration::kInputAnalog, GPIO::Mode::kInput);
+#elif defined(STM32F4)
+    gpios_[i].emplace(*hw.pins[i], GPIO::Mode::kAnalog, GPIO::Pullup::kNone);
+#endif
+    channels[i] = GetAdcChannel(*hw.pins[i]);
+    ++num_channels_;
+  }
+
+  InitRcc(adc_);
+  adc_power_off(adc_);
+
+#if defined(STM32F1)
+  // ADC clock must not exceed 14MHz
+  rcc_set_adcpre(RCC_CFGR_ADCPRE_PCLK2_DIV6);
+  adc_set_sample_time_on_all_channels(adc_, ADC_SMPR_SMP_7DOT5CYC);
+#elif defined(STM32F4)
+  // ADC clock must not exceed 36MHz
+  adc_set_clk_prescale(ADC_CCR_ADCPRE_BY4);
+  adc_set_sample_time_on_all_channels(adc_, ADC_SMPR_SMP_15CYC);
+#endif
+
+  adc_enable_scan_mode(adc_);
+  adc_set_single_conversion_mode(adc_);
+  adc_set_right_aligned(adc_);
+  adc_set_injected_sequence(adc_, num_channels_, channels.data());
+
+  const uint32_t trigger = GetInjectedTrigger(adc_, config.pwm->GetTimer());
+#if defined(STM32F1)
+  adc_enable_external_trigger_injected(adc_, trigger);
+#elif defined(STM32F4)
+  adc_enable_external_trigger_injected(adc_, trigger, ADC_CR2_JEXTEN_RISING_EDGE);
+#endif
+
+  instances[GetAdcIndex(adc_)] = this;
+  adc_enable_eoc_interrupt_injected(adc_);
+
+  adc_power_on(adc_);
+
+#if defined(STM32F1)
+  // Wait for the ADC to stabilize before calibrating
+  for (uint32_t i = 0; i < 1000; ++i) {
+    __asm__("nop");
+  }
+  adc_reset_calibration(adc_);
+  adc_calibrate(adc_);
+#endif
+
+  // Current loop should preempt everything else
+#if defined(STM32F1)
+  const uint8_t irqn = adc_ == ADC3 ? NVIC_ADC3_IRQ : NVIC_ADC1_2_IRQ;
+#elif defined(STM32F4)
+  const uint8_t irqn = NVIC_ADC_IRQ;
+#endif
+  nvic_set_priority(irqn, 0);
+  nvic_enable_irq(irqn);
+
+  // Sample at the center of the PWM period
+  config.pwm->EnableAdcTrigger(config.pwm->GetPeriod() - 1);
+}
+
+CurrentSense::~CurrentSense() {
+  adc_disable_eoc_interrupt_injected(adc_);
+  adc_disable_external_trigger_injected(adc_);
+  instances[GetAdcIndex(adc_)] = nullptr;
+}
+
+void CurrentSense::SetOffset(const uint8_t index, const uint16_t offset) {
+  assert(index < num_channels_);
+  adc_set_injected_offset(adc_, static_cast<uint8_t>(index + 1), offset);
+}
+
+void CurrentSense::HandleIrq() {
+  // JEOC is cleared by writing 0 to it, while writing 1 to the other flags has no effect
+  ADC_SR(adc_) = ~static_cast<uint32_t>(ADC_SR_JEOC);
+
+  // When offsets are used, the results are sign-extended in the lower 16 bits
+  std::array<int16_t, kMaxChannels> samples;
+  const volatile uint32_t* jdr = &ADC_JDR1(adc_);
+  for (uint8_t i = 0; i < num_channels_; ++i) {
+    samples[i] = static_cast<int16_t>(jdr[i]);
+  }
+
+  if (callback_ != nullptr) {
+    callback_(samples.data(), num_channels_, context_);
+  }
+}
+
+#elif !defined(LIB_USE_CURRENTSENSE)
+#error "LIB_USE_CURRENTSENSE macro not found. (Did you define it in your board configuration?)"
+#endif
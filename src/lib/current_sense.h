@@ -0,0 +1,161 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_LIB_CURRENT_SENSE_H_
+#define RTLIB_LIB_CURRENT_SENSE_H_
+
+#include <array>
+#include <cstdint>
+#include <optional>
+
+#include "config/config.h"
+#include "core/gpio.h"
+#include "lib/motor_pwm.h"
+
+static_assert(LIB_USE_CURRENTSENSE > 0, "CurrentSense library is disabled in your configuration.");
+
+/**
+ * @brief HAL implementation for PWM-synchronized phase current sampling.
+ *
+ * This abstraction layer samples up to four analog inputs using the injected channels of an ADC. Conversions are
+ * triggered in hardware by channel 4 of a MotorPwm, so that the samples are always taken at the center of the PWM
+ * period, away from the switching edges. When all injected conversions complete, the results are passed to a callback
+ * from a high priority interrupt, so that the current loop can run within microseconds of sampling.
+ *
+ * One CurrentSense object is designed to manage one set of current sensing inputs on the mainboard.
+ */
+class CurrentSense {
+ public:
+  /**
+   * @brief Maximum number of inputs per ADC.
+   */
+  static constexpr uint8_t kMaxChannels = 4;
+
+  /**
+   * @brief Type definition for the sample callback.
+   *
+   * @param samples Conversion results, with the offsets set by SetOffset() subtracted. Only the first @p num_samples
+   * entries are valid.
+   * @param num_samples Number of inputs sampled
+   * @param context User-defined pointer, see CurrentSense#Config#context.
+   */
+  using Callback = void (*)(const int16_t* samples, uint8_t num_samples, void* context);
+
+  /**
+   * @brief Configuration for current sense.
+   */
+  struct Config {
+    /**
+     * @brief ID of the current sense.
+     *
+     * See your device configuration header file to see which id corresponds to which set of inputs.
+     */
+    uint8_t id = 0;
+    /**
+     * @brief Motor PWM which triggers the conversions.
+     *
+     * The trigger channel of the motor PWM will be configured by the constructor. The motor PWM must be
+     * center-aligned, since edge-aligned PWM has no fixed point in the period which is away from the switching edges.
+     */
+    MotorPwm* pwm = nullptr;
+    /**
+     * @brief Function to invoke when a set of samples is ready.
+     *
+     * The callback is invoked from the ADC interrupt, which runs at the highest priority.
+     */
+    Callback callback = nullptr;
+    /**
+     * @brief User-defined pointer which will be passed to the callback.
+     */
+    void* context = nullptr;
+  };
+
+  /**
+   * @brief Default constructor for current sense.
+   *
+   * @param config Current sense configuration
+   */
+  explicit CurrentSense(const Config& config);
+
+  /**
+   * @brief Destructor.
+   *
+   * Stops the conversions and disables the interrupt, so that the callback will no longer be invoked.
+   */
+  ~CurrentSense();
+
+  /**
+   * @brief Move constructor for current sense.
+   *
+   * This constructor is deleted because the interrupt handler refers to this object.
+   */
+  CurrentSense(CurrentSense&&) = delete;
+  /**
+   * @brief Move assignment operator for current sense.
+   *
+   * This operator is deleted because the interrupt handler refers to this object.
+   */
+  CurrentSense& operator=(CurrentSense&&) = delete;
+
+  /**
+   * @brief Copy constructor for current sense.
+   *
+   * This constructor is deleted because there should only be one object managing each ADC.
+   */
+  CurrentSense(const CurrentSense&) = delete;
+  /**
+   * @brief Copy assignment operator for current sense.
+   *
+   * This operator is deleted because there should only be one object managing each ADC.
+   */
+  CurrentSense& operator=(const CurrentSense&) = delete;
+
+  /**
+   * @brief Sets the offset which the ADC subtracts from an input.
+   *
+   * The subtraction is done in hardware. Usually this is set to the reading at zero current, so that the samples passed
+   * to the callback are signed.
+   *
+   * @param index Index of the input, in the order defined by the board configuration
+   * @param offset Raw ADC reading to subtract
+   */
+  void SetOffset(uint8_t index, uint16_t offset);
+
+  /**
+   * @return Number of inputs sampled.
+   */
+  uint8_t GetNumChannels() const { return num_channels_; }
+
+  /**
+   * @brief Handles an injected end-of-conversion interrupt.
+   *
+   * @warning This function is invoked by the ADC interrupt handler. Do not call this function directly.
+   */
+  void HandleIrq();
+
+ private:
+  uint32_t adc_;
+  uint8_t num_channels_ = 0;
+  Callback callback_;
+  void* context_;
+
+  std::array<std::optional<CORE_NS::GPIO>, kMaxChannels> gpios_;
+};
+
+#endif  // RTLIB_LIB_CURRENT_SENSE_H_
@@ -0,0 +1,266 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config/config.h"
+
+#if defined(LIB_USE_DMACOPY) && LIB_USE_DMACOPY > 0
+
+#include "lib/dma_copy.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include <libopencm3/cm3/dwt.h>
+
+#include "lib/dma_routes.h"
+
+using CORE_NS::Dma;
+
+namespace {
+/**
+ * @brief Maximum number of data items in one DMA transfer.
+ */
+constexpr std::size_t kMaxChunkItems = 0xFFFF;
+
+inline bool IsDmaAccessible(const void* address) {
+#if defined(STM32F4)
+  // The core-coupled memory is only connected to the CPU
+  const uint32_t value = reinterpret_cast<uint32_t>(address);
+  return value < 0x10000000 || value >= 0x10010000;
+#else
+  static_cast<void>(address);
+  return true;
+#endif
+}
+
+constexpr std::size_t GetWidthBytes(const Dma::Width width) {
+  switch (width) {
+    case Dma::Width::kByte:
+      return 1;
+    case Dma::Width::kHalfWord:
+      return 2;
+    case Dma::Width::kWord:
+      return 4;
+    default:
+      assert(false);
+      break;
+  }
+  return 1;
+}
+}  // namespace
+
+DmaCopy::DmaCopy(const Config& config) : priority_(config.priority), cpu_threshold_(config.cpu_threshold) {
+  const std::optional<Dma::Route> route =
+      Dma::Allocate(Dma::Request::kMemToMem, DmaRoutes::kFixed, std::size(DmaRoutes::kFixed));
+  assert(route);
+  route_ = *route;
+}
+
+DmaCopy::~DmaCopy() { Dma::Release(route_); }
+
+bool DmaCopy::Copy(void* dest, const void* src, const std::size_t size, Callback callback, void* context) {
+  if (busy_) {
+    return false;
+  }
+
+  if (size < cpu_threshold_ || !IsDmaAccessible(dest) || !IsDmaAccessible(src)) {
+    std::memcpy(dest, src, size);
+    if (callback != nullptr) {
+      callback(context);
+    }
+    return true;
+  }
+
+  dest_ = static_cast<uint8_t*>(dest);
+  src_ = static_cast<const uint8_t*>(src);
+  fill_ = false;
+  Start(size, callback, context);
+  return true;
+}
+
+bool DmaCopy::Fill(void* dest, const uint8_t value, const std::size_t size, Callback callback, void* context) {
+  if (busy_) {
+    return false;
+  }
+
+  if (size < cpu_threshold_ || !IsDmaAccessible(dest) || !IsDmaAccessible(&fill_word_)) {
+    std::memset(dest, value, size);
+    if (callback != nullptr) {
+      callback(context);
+    }
+    return true;
+  }
+
+  fill_word_ = value * 0x01010101u;
+  dest_ = static_cast<uint8_t*>(dest);
+  src_ = reinterpret_cast<const uint8_t*>(&fill_word_);
+  fill_ = true;
+  Start(size, callback, context);
+  return true;
+}
+
+void DmaCopy::Wait() const {
+  while (busy_) {
+  }
+}
+
+std::size_t DmaCopy::Benchmark(uint8_t* buffer,
+                               const std::size_t size,
+                               BenchmarkResult* results,
+                               const std::size_t max_results) {
+  assert(!busy_);
+  // Copies from or to memory which the DMA cannot access fall back to the CPU, which would not measure the DMA
+  assert(IsDmaAccessible(buffer) && IsDmaAccessible(buffer + size - 1));
+
+  dwt_enable_cycle_counter();
+
+  // DMA is forced for all sizes while measuring
+  const std::size_t threshold = cpu_threshold_;
+  cpu_threshold_ = 0;
+
+  uint8_t* dest = buffer + size / 2;
+  std::size_t count = 0;
+  for (std::size_t length = 16; length <= size / 2 && count < max_results; length *= 2) {
+    uint32_t start = dwt_read_cycle_counter();
+    std::memcpy(dest, buffer, length);
+    const uint32_t cpu_cycles = dwt_read_cycle_counter() - start;
+
+    start = dwt_read_cycle_counter();
+    Copy(dest, buffer, length);
+    Wait();
+    const uint32_t dma_cycles = dwt_read_cycle_counter() - start;
+
+    results[count++] = {length, cpu_cycles, dma_cycles};
+  }
+
+  cpu_threshold_ = threshold;
+  return count;
+}
+
+void DmaCopy::HandleDmaEvent(const Dma::Event event, void* context) {
+  DmaCopy& self = *static_cast<DmaCopy*>(context);
+
+  switch (event) {
+    case Dma::Event::kTransferComplete: {
+      const std::size_t bytes = self.chunk_items_ * GetWidthBytes(self.width_);
+      self.dest_ += bytes;
+      if (!self.fill_) {
+        self.src_ += bytes;
+      }
+      self.items_remaining_ -= self.chunk_items_;
+
+      if (self.items_remaining_ > 0) {
+        self.StartChunk();
+      } else {
+        self.Finish();
+      }
+      break;
+    }
+    case Dma::Event::kError:
+      self.error_ = true;
+      self.Finish();
+      break;
+    case Dma::Event::kHalfTransfer:
+    case Dma::Event::kBuffer0Complete:
+    case Dma::Event::kBuffer1Complete:
+      // Not enabled for single-buffered transfers without half transfer interrupts
+      break;
+    default:
+      assert(false);
+      break;
+  }
+}
+
+void DmaCopy::Start(std::size_t size, Callback callback, void* context) {
+  const auto move_cpu = [this](uint8_t* dest, const uint8_t* src, const std::size_t n) {
+    if (fill_) {
+      std::memset(dest, static_cast<uint8_t>(fill_word_), n);
+    } else {
+      std::memcpy(dest, src, n);
+    }
+  };
+
+  // Align the destination to a word boundary
+  const std::size_t head = std::min<std::size_t>(size, (4 - reinterpret_cast<uint32_t>(dest_) % 4) % 4);
+  move_cpu(dest_, src_, head);
+  dest_ += head;
+  if (!fill_) {
+    src_ += head;
+  }
+  size -= head;
+
+  // The DMA reads and writes data items of the same width, so the source must be aligned to the same boundary
+  switch (fill_ ? 0 : reinterpret_cast<uint32_t>(src_) % 4) {
+    case 0:
+      width_ = Dma::Width::kWord;
+      break;
+    case 2:
+      width_ = Dma::Width::kHalfWord;
+      break;
+    default:
+      width_ = Dma::Width::kByte;
+      break;
+  }
+
+  const std::size_t width = GetWidthBytes(width_);
+  items_remaining_ = size / width;
+  const std::size_t body = items_remaining_ * width;
+  move_cpu(dest_ + body, fill_ ? src_ : src_ + body, size - body);
+
+  callback_ = callback;
+  context_ = context;
+  error_ = false;
+  busy_ = true;
+
+  if (items_remaining_ == 0) {
+    Finish();
+  } else {
+    StartChunk();
+  }
+}
+
+void DmaCopy::StartChunk() {
+  chunk_items_ = static_cast<uint16_t>(std::min(items_remaining_, kMaxChunkItems));
+
+  Dma::Transfer transfer;
+  transfer.direction = Dma::Direction::kMemToMem;
+  transfer.peripheral = reinterpret_cast<uint32_t>(src_);
+  transfer.memory0 = dest_;
+  transfer.count = chunk_items_;
+  transfer.peripheral_width = width_;
+  transfer.memory_width = width_;
+  transfer.peripheral_increment = !fill_;
+  transfer.memory_increment = true;
+  transfer.priority = priority_;
+  transfer.callback = &HandleDmaEvent;
+  transfer.context = this;
+  Dma::Start(route_, transfer);
+}
+
+void DmaCopy::Finish() {
+  busy_ = false;
+  if (callback_ != nullptr) {
+    callback_(context_);
+  }
+}
+
+#elif !defined(LIB_USE_DMACOPY)
+#error "LIB_USE_DMACOPY macro not found. (Did you define it in your board configuration?)"
+#endif
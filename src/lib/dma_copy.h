@@ -0,0 +1,237 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_LIB_DMA_COPY_H_
+#define RTLIB_LIB_DMA_COPY_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "config/config.h"
+#include "core/dma.h"
+
+static_assert(LIB_USE_DMACOPY > 0, "DmaCopy library is disabled in your configuration.");
+
+/**
+ * @brief HAL implementation for asynchronous memory copies and fills using memory-to-memory DMA.
+ *
+ * This abstraction layer offloads large memory operations to a DMA channel, so that the CPU is free to run other code
+ * while the data is moved. Operations smaller than a threshold are done with @c std::memcpy or @c std::memset
+ * instead, since setting up the DMA channel and handling its interrupt costs more than copying a few bytes.
+ *
+ * Bytes up to the first word-aligned destination address, and bytes after the last whole data item, are copied by the
+ * CPU before the DMA transfer is started. The rest is transferred in words if the source and destination are equally
+ * aligned, and in half-words or bytes otherwise.
+ *
+ * Each DmaCopy object claims one DMA channel (@c DMA2 on STM32F4xx devices) for its lifetime, and runs one operation
+ * at a time.
+ */
+class DmaCopy {
+ public:
+  /**
+   * @brief Type definition for completion callbacks.
+   *
+   * @param context User-defined pointer, as passed to Copy() or Fill().
+   */
+  using Callback = void (*)(void* context);
+
+  /**
+   * @brief Configuration for DMA copy.
+   */
+  struct Config {
+    /**
+     * @brief Operations smaller than this number of bytes are done by the CPU.
+     *
+     * Use Benchmark() to find a suitable value for your application.
+     */
+    std::size_t cpu_threshold = 128;
+    /**
+     * @brief Priority of the DMA channel.
+     *
+     * Defaults to low priority, so that peripheral transfers on the same controller are served first.
+     */
+    CORE_NS::Dma::Priority priority = CORE_NS::Dma::Priority::kLow;
+  };
+
+  /**
+   * @brief Throughput measurement for one transfer size.
+   */
+  struct BenchmarkResult {
+    /**
+     * @brief Number of bytes copied.
+     */
+    std::size_t size;
+    /**
+     * @brief CPU cycles taken by @c std::memcpy.
+     */
+    uint32_t cpu_cycles;
+    /**
+     * @brief CPU cycles from starting the DMA copy until its completion.
+     */
+    uint32_t dma_cycles;
+  };
+
+  /**
+   * @brief Default constructor for DMA copy.
+   *
+   * @param config DMA copy configuration
+   */
+  explicit DmaCopy(const Config& config);
+
+  /**
+   * @brief Destructor.
+   *
+   * Stops any pending operation and releases the DMA channel.
+   */
+  ~DmaCopy();
+
+  /**
+   * @brief Move constructor for DMA copy.
+   *
+   * This constructor is deleted because the interrupt handler refers to this object.
+   */
+  DmaCopy(DmaCopy&&) = delete;
+  /**
+   * @brief Move assignment operator for DMA copy.
+   *
+   * This operator is deleted because the interrupt handler refers to this object.
+   */
+  DmaCopy& operator=(DmaCopy&&) = delete;
+
+  /**
+   * @brief Copy constructor for DMA copy.
+   *
+   * This constructor is deleted because there should only be one object managing each DMA channel.
+   */
+  DmaCopy(const DmaCopy&) = delete;
+  /**
+   * @brief Copy assignment operator for DMA copy.
+   *
+   * This operator is deleted because there should only be one object managing each DMA channel.
+   */
+  DmaCopy& operator=(const DmaCopy&) = delete;
+
+  /**
+   * @brief Starts copying memory.
+   *
+   * Neither buffer may be accessed until the operation completes. The buffers must not overlap.
+   *
+   * @param dest Destination buffer
+   * @param src Source buffer
+   * @param size Number of bytes to copy
+   * @param callback Function to invoke when the copy completes, or @c nullptr. If the copy is done by the CPU, this is
+   * invoked before this function returns; otherwise it is invoked from the DMA interrupt.
+   * @param context User-defined pointer which will be passed to @p callback
+   * @return @c true if the copy is started, @c false if another operation is pending.
+   */
+  bool Copy(void* dest, const void* src, std::size_t size, Callback callback = nullptr, void* context = nullptr);
+
+  /**
+   * @brief Starts filling memory with a byte value.
+   *
+   * @param dest Destination buffer
+   * @param value Value to fill
+   * @param size Number of bytes to fill
+   * @param callback Function to invoke when the fill completes, or @c nullptr. If the fill is done by the CPU, this is
+   * invoked before this function returns; otherwise it is invoked from the DMA interrupt.
+   * @param context User-defined pointer which will be passed to @p callback
+   * @return @c true if the fill is started, @c false if another operation is pending.
+   */
+  bool Fill(void* dest, uint8_t value, std::size_t size, Callback callback = nullptr, void* context = nullptr);
+
+  /**
+   * @return @c true if an operation is pending.
+   */
+  bool IsBusy() const { return busy_; }
+
+  /**
+   * @brief Blocks until the pending operation completes.
+   */
+  void Wait() const;
+
+  /**
+   * @return @c true if the last DMA operation was aborted by a bus error, e.g. because a buffer is not accessible by
+   * DMA.
+   */
+  bool HasError() const { return error_; }
+
+  /**
+   * @return Size below which operations are done by the CPU.
+   */
+  std::size_t GetCpuThreshold() const { return cpu_threshold_; }
+  /**
+   * @param threshold Size below which operations are done by the CPU
+   */
+  void SetCpuThreshold(std::size_t threshold) { cpu_threshold_ = threshold; }
+
+  /**
+   * @brief Measures the time taken by CPU and DMA copies of increasing sizes.
+   *
+   * Sizes start from 16 bytes and double until half of @p buffer, or until @p max_results sizes are measured. Times
+   * are measured with the DWT cycle counter, with interrupts enabled, so results may vary between runs.
+   *
+   * @param buffer Scratch buffer. The first half is copied into the second half. Must be accessible by the DMA, i.e.
+   * not in the core-coupled memory of STM32F4xx devices.
+   * @param size Size of @p buffer
+   * @param results Array to store the results
+   * @param max_results Size of @p results
+   * @return Number of results stored.
+   */
+  std::size_t Benchmark(uint8_t* buffer, std::size_t size, BenchmarkResult* results, std::size_t max_results);
+
+ private:
+  static void HandleDmaEvent(CORE_NS::Dma::Event event, void* context);
+
+  /**
+   * @brief Starts the operation which has been prepared in the member variables.
+   *
+   * Bytes before the first aligned destination address and after the last whole data item are handled by the CPU.
+   */
+  void Start(std::size_t size, Callback callback, void* context);
+  /**
+   * @brief Starts the DMA transfer of the next chunk, which is limited by the size of the transfer counter.
+   */
+  void StartChunk();
+  /**
+   * @brief Marks the operation as done, and invokes the callback.
+   */
+  void Finish();
+
+  CORE_NS::Dma::Route route_;
+  CORE_NS::Dma::Priority priority_;
+  std::size_t cpu_threshold_;
+
+  uint8_t* dest_ = nullptr;
+  const uint8_t* src_ = nullptr;
+  /**
+   * @brief Source of fill operations, which contains the fill value in every byte.
+   */
+  uint32_t fill_word_ = 0;
+  bool fill_ = false;
+  CORE_NS::Dma::Width width_ = CORE_NS::Dma::Width::kByte;
+  std::size_t items_remaining_ = 0;
+  uint16_t chunk_items_ = 0;
+
+  volatile bool busy_ = false;
+  volatile bool error_ = false;
+  Callback callback_ = nullptr;
+  void* context_ = nullptr;
+};
+
+#endif  // RTLIB_LIB_DMA_COPY_H_
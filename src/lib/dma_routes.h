@@ -0,0 +1,262 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_LIB_DMA_ROUTES_H_
+#define RTLIB_LIB_DMA_ROUTES_H_
+
+#include <cstdint>
+#include <iterator>
+#include <optional>
+
+#include <libopencm3/stm32/spi.h>
+#include <libopencm3/stm32/timer.h>
+#include <libopencm3/stm32/usart.h>
+
+#include "config/config.h"
+#include "core/dma.h"
+
+/**
+ * @brief DMA requests of the peripherals used by the library, and the DMA routes of the board configuration.
+ *
+ * Peripherals which are assigned in the board configuration (e.g. the USART of an SBUS receiver) can only use the
+ * channels or streams which their DMA requests are mapped to. These routes are collected in @c kFixed, and checked
+ * for conflicts at compile time. Drivers which can use any channel, i.e. memory-to-memory transfers, pass @c kFixed
+ * to Dma::Allocate() so that they never take a channel from a peripheral which is constructed later.
+ *
+ * On STM32F4xx devices, @c kFixed lists the first stream of each request, which is the stream Dma::Allocate() picks
+ * as long as no other driver claims it.
+ */
+class DmaRoutes final {
+ public:
+  /**
+   * @brief Default constructor for DmaRoutes.
+   *
+   * This constructor is disabled to enforce a static class pattern.
+   */
+  DmaRoutes() = delete;
+
+  /**
+   * @param usart USART to query
+   * @return DMA request of the receiver of @p usart, or @c std::nullopt if the receiver cannot trigger DMA transfers.
+   */
+  static constexpr std::optional<CORE_NS::Dma::Request> GetUsartRxRequest(const uint32_t usart) {
+    using Request = CORE_NS::Dma::Request;
+    switch (usart) {
+      case USART1:
+        return Request::kUsart1Rx;
+      case USART2:
+        return Request::kUsart2Rx;
+      case USART3:
+        return Request::kUsart3Rx;
+      case UART4:
+        return Request::kUart4Rx;
+#if defined(STM32F4)
+      case UART5:
+        return Request::kUart5Rx;
+      case USART6:
+        return Request::kUsart6Rx;
+#endif  // defined(STM32F4)
+      default:
+        return std::nullopt;
+    }
+  }
+
+  /**
+   * @param spi SPI to query
+   * @return DMA request of the receiver of @p spi, or @c std::nullopt if @p spi is not supported.
+   */
+  static constexpr std::optional<CORE_NS::Dma::Request> GetSpiRxRequest(const uint32_t spi) {
+    using Request = CORE_NS::Dma::Request;
+    switch (spi) {
+      case SPI1:
+        return Request::kSpi1Rx;
+      case SPI2:
+        return Request::kSpi2Rx;
+      case SPI3:
+        return Request::kSpi3Rx;
+      default:
+        return std::nullopt;
+    }
+  }
+  /**
+   * @param spi SPI to query
+   * @return DMA request of the transmitter of @p spi, or @c std::nullopt if @p spi is not supported.
+   */
+  static constexpr std::optional<CORE_NS::Dma::Request> GetSpiTxRequest(const uint32_t spi) {
+    using Request = CORE_NS::Dma::Request;
+    switch (spi) {
+      case SPI1:
+        return Request::kSpi1Tx;
+      case SPI2:
+        return Request::kSpi2Tx;
+      case SPI3:
+        return Request::kSpi3Tx;
+      default:
+        return std::nullopt;
+    }
+  }
+
+  /**
+   * @param timer Timer to query
+   * @param channel Index of capture channel, from 0 to 3
+   * @return DMA request of the capture channel, or @c std::nullopt if the channel cannot trigger DMA transfers.
+   */
+  static constexpr std::optional<CORE_NS::Dma::Request> GetTimerCaptureRequest(const uint32_t timer,
+                                                                               const uint8_t channel) {
+    using Request = CORE_NS::Dma::Request;
+    switch (timer) {
+      case TIM1:
+        switch (channel) {
+          case 0:
+            return Request::kTim1Ch1;
+          case 1:
+            return Request::kTim1Ch2;
+          case 2:
+            return Request::kTim1Ch3;
+          case 3:
+            return Request::kTim1Ch4;
+          default:
+            return std::nullopt;
+        }
+      case TIM2:
+        switch (channel) {
+          case 0:
+            return Request::kTim2Ch1;
+          case 1:
+            return Request::kTim2Ch2;
+          case 2:
+            return Request::kTim2Ch3;
+          case 3:
+            return Request::kTim2Ch4;
+          default:
+            return std::nullopt;
+        }
+      case TIM3:
+        switch (channel) {
+          case 0:
+            return Request::kTim3Ch1;
+#if defined(STM32F4)
+          case 1:
+            return Request::kTim3Ch2;
+#endif  // defined(STM32F4)
+          case 2:
+            return Request::kTim3Ch3;
+          case 3:
+            return Request::kTim3Ch4;
+          default:
+            return std::nullopt;
+        }
+      case TIM4:
+        switch (channel) {
+          case 0:
+            return Request::kTim4Ch1;
+          case 1:
+            return Request::kTim4Ch2;
+          case 2:
+            return Request::kTim4Ch3;
+          default:
+            return std::nullopt;
+        }
+      case TIM5:
+        switch (channel) {
+          case 0:
+            return Request::kTim5Ch1;
+          case 1:
+            return Request::kTim5Ch2;
+          case 2:
+            return Request::kTim5Ch3;
+          case 3:
+            return Request::kTim5Ch4;
+          default:
+            return std::nullopt;
+        }
+      case TIM8:
+        switch (channel) {
+          case 0:
+            return Request::kTim8Ch1;
+          case 1:
+            return Request::kTim8Ch2;
+          case 2:
+            return Request::kTim8Ch3;
+          case 3:
+            return Request::kTim8Ch4;
+          default:
+            return std::nullopt;
+        }
+      default:
+        return std::nullopt;
+    }
+  }
+
+  /**
+   * @param request DMA request, or @c std::nullopt
+   * @return First route of @p request, or an invalid route if there is no request.
+   */
+  static constexpr CORE_NS::Dma::Route GetRoute(const std::optional<CORE_NS::Dma::Request> request) {
+    return request ? CORE_NS::Dma::GetRoute(*request) : CORE_NS::Dma::Route{};
+  }
+
+  /**
+   * @brief Routes of the peripherals in the board configuration.
+   *
+   * Both capture channels of each input capture timer are listed, since DMA can be enabled at runtime. Channels
+   * without a DMA request are listed as invalid routes, which are ignored. The list ends with an invalid route, so
+   * that it is never empty.
+   */
+  static const CORE_NS::Dma::Route kFixed[];
+};
+
+inline constexpr CORE_NS::Dma::Route DmaRoutes::kFixed[] = {
+#if defined(LIB_USE_SBUS) && LIB_USE_SBUS > 0
+    GetRoute(GetUsartRxRequest(LIB_SBUS0_USART)),
+#endif
+#if defined(LIB_USE_SBUS) && LIB_USE_SBUS > 1
+    GetRoute(GetUsartRxRequest(LIB_SBUS1_USART)),
+#endif
+#if defined(LIB_USE_IMU) && LIB_USE_IMU > 0
+    GetRoute(GetSpiRxRequest(LIB_IMU0_SPI)),
+    GetRoute(GetSpiTxRequest(LIB_IMU0_SPI)),
+#endif
+#if defined(LIB_USE_IMU) && LIB_USE_IMU > 1
+    GetRoute(GetSpiRxRequest(LIB_IMU1_SPI)),
+    GetRoute(GetSpiTxRequest(LIB_IMU1_SPI)),
+#endif
+#if defined(LIB_USE_INPUTCAPTURE) && LIB_USE_INPUTCAPTURE > 0
+    GetRoute(GetTimerCaptureRequest(LIB_INPUTCAPTURE0_TIMER, LIB_INPUTCAPTURE0_CHANNEL - 1)),
+    GetRoute(GetTimerCaptureRequest(LIB_INPUTCAPTURE0_TIMER, (LIB_INPUTCAPTURE0_CHANNEL - 1) ^ 1)),
+#endif
+#if defined(LIB_USE_INPUTCAPTURE) && LIB_USE_INPUTCAPTURE > 1
+    GetRoute(GetTimerCaptureRequest(LIB_INPUTCAPTURE1_TIMER, LIB_INPUTCAPTURE1_CHANNEL - 1)),
+    GetRoute(GetTimerCaptureRequest(LIB_INPUTCAPTURE1_TIMER, (LIB_INPUTCAPTURE1_CHANNEL - 1) ^ 1)),
+#endif
+#if defined(LIB_USE_INPUTCAPTURE) && LIB_USE_INPUTCAPTURE > 2
+    GetRoute(GetTimerCaptureRequest(LIB_INPUTCAPTURE2_TIMER, LIB_INPUTCAPTURE2_CHANNEL - 1)),
+    GetRoute(GetTimerCaptureRequest(LIB_INPUTCAPTURE2_TIMER, (LIB_INPUTCAPTURE2_CHANNEL - 1) ^ 1)),
+#endif
+#if defined(LIB_USE_INPUTCAPTURE) && LIB_USE_INPUTCAPTURE > 3
+    GetRoute(GetTimerCaptureRequest(LIB_INPUTCAPTURE3_TIMER, LIB_INPUTCAPTURE3_CHANNEL - 1)),
+    GetRoute(GetTimerCaptureRequest(LIB_INPUTCAPTURE3_TIMER, (LIB_INPUTCAPTURE3_CHANNEL - 1) ^ 1)),
+#endif
+    CORE_NS::Dma::Route{},
+};
+
+static_assert(CORE_NS::Dma::AreExclusive(DmaRoutes::kFixed, std::size(DmaRoutes::kFixed)),
+              "Peripherals in the board configuration share a DMA channel. (Check your board configuration.)");
+
+#endif  // RTLIB_LIB_DMA_ROUTES_H_
@@ -0,0 +1,244 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config/config.h"
+
+#if defined(LIB_USE_ENCODER) && LIB_USE_ENCODER > 0
+
+#include "lib/encoder.h"
+
+#include <cassert>
+
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/timer.h>
+
+#include "core/timer.h"
+
+using CORE_NS::GPIO;
+using CORE_NS::Timer;
+
+namespace {
+inline uint32_t GetConfigTimer(const uint8_t id) {
+  assert(id < LIB_USE_ENCODER);
+  switch (id) {
+    default:
+      // not handled, since assert will catch this error
+      assert(false);
+      break;
+#if LIB_USE_ENCODER > 0
+    case 0:
+      return LIB_ENCODER0_TIMER;
+#endif  // LIB_USE_ENCODER > 0
+#if LIB_USE_ENCODER > 1
+    case 1:
+      return LIB_ENCODER1_TIMER;
+#endif  // LIB_USE_ENCODER > 1
+#if LIB_USE_ENCODER > 2
+    case 2:
+      return LIB_ENCODER2_TIMER;
+#endif  // LIB_USE_ENCODER > 2
+#if LIB_USE_ENCODER > 3
+    case 3:
+      return LIB_ENCODER3_TIMER;
+#endif  // LIB_USE_ENCODER > 3
+  }
+}
+
+inline Pinout GetConfigPinout(const uint8_t id, const bool is_ch2) {
+  assert(id < LIB_USE_ENCODER);
+  switch (id) {
+    default:
+      // not handled, since assert will catch this error
+      assert(false);
+      break;
+#if LIB_USE_ENCODER > 0
+    case 0:
+      return is_ch2 ? Pinout(LIB_ENCODER0_CH2_PINOUT) : Pinout(LIB_ENCODER0_CH1_PINOUT);
+#endif  // LIB_USE_ENCODER > 0
+#if LIB_USE_ENCODER > 1
+    case 1:
+      return is_ch2 ? Pinout(LIB_ENCODER1_CH2_PINOUT) : Pinout(LIB_ENCODER1_CH1_PINOUT);
+#endif  // LIB_USE_ENCODER > 1
+#if LIB_USE_ENCODER > 2
+    case 2:
+      return is_ch2 ? Pinout(LIB_ENCODER2_CH2_PINOUT) : Pinout(LIB_ENCODER2_CH1_PINOUT);
+#endif  // LIB_USE_ENCODER > 2
+#if LIB_USE_ENCODER > 3
+    case 3:
+      return is_ch2 ? Pinout(LIB_ENCODER3_CH2_PINOUT) : Pinout(LIB_ENCODER3_CH1_PINOUT);
+#endif  // LIB_USE_ENCODER > 3
+  }
+}
+
+#if defined(STM32F1)
+inline void InitConfigRemap(const uint8_t id) {
+  assert(id < LIB_USE_ENCODER);
+  switch (id) {
+    default:
+      break;
+#if LIB_USE_ENCODER > 0 && defined(LIB_ENCODER0_REMAP)
+    case 0:
+      rcc_periph_clock_enable(RCC_AFIO);
+      GPIO::SetPriAltFn(GPIO::JTAGDisables::kNoDisable, LIB_ENCODER0_REMAP);
+      break;
+#endif  // LIB_USE_ENCODER > 0 && defined(LIB_ENCODER0_REMAP)
+#if LIB_USE_ENCODER > 1 && defined(LIB_ENCODER1_REMAP)
+    case 1:
+      rcc_periph_clock_enable(RCC_AFIO);
+      GPIO::SetPriAltFn(GPIO::JTAGDisables::kNoDisable, LIB_ENCODER1_REMAP);
+      break;
+#endif  // LIB_USE_ENCODER > 1 && defined(LIB_ENCODER1_REMAP)
+#if LIB_USE_ENCODER > 2 && defined(LIB_ENCODER2_REMAP)
+    case 2:
+      rcc_periph_clock_enable(RCC_AFIO);
+      GPIO::SetPriAltFn(GPIO::JTAGDisables::kNoDisable, LIB_ENCODER2_REMAP);
+      break;
+#endif  // LIB_USE_ENCODER > 2 && defined(LIB_ENCODER2_REMAP)
+#if LIB_USE_ENCODER > 3 && defined(LIB_ENCODER3_REMAP)
+    case 3:
+      rcc_periph_clock_enable(RCC_AFIO);
+      GPIO::SetPriAltFn(GPIO::JTAGDisables::kNoDisable, LIB_ENCODER3_REMAP);
+      break;
+#endif  // LIB_USE_ENCODER > 3 && defined(LIB_ENCODER3_REMAP)
+  }
+}
+#elif defined(STM32F4)
+inline GPIO::AltFn GetConfigAltFn(const uint8_t id) {
+  assert(id < LIB_USE_ENCODER);
+  switch (id) {
+    default:
+      // not handled, since assert will catch this error
+      assert(false);
+      break;
+#if LIB_USE_ENCODER > 0
+    case 0:
+      return LIB_ENCODER0_ALTFN;
+#endif  // LIB_USE_ENCODER > 0
+#if LIB_USE_ENCODER > 1
+    case 1:
+      return LIB_ENCODER1_ALTFN;
+#endif  // LIB_USE_ENCODER > 1
+#if LIB_USE_ENCODER > 2
+    case 2:
+      return LIB_ENCODER2_ALTFN;
+#endif  // LIB_USE_ENCODER > 2
+#if LIB_USE_ENCODER > 3
+    case 3:
+      return LIB_ENCODER3_ALTFN;
+#endif  // LIB_USE_ENCODER > 3
+  }
+}
+#endif
+}  // namespace
+
+Encoder::Encoder(const Config& config) :
+    timer_(GetConfigTimer(config.id)),
+#if defined(STM32F1)
+    ch1_gpio_(GetConfigPinout(config.id, false), GPIO::Configuration::kInputFloat, GPIO::Mode::kInput),
+    ch2_gpio_(GetConfigPinout(config.id, true), GPIO::Configuration::kInputFloat, GPIO::Mode::kInput),
+#elif defined(STM32F4)
+    ch1_gpio_(GetConfigPinout(config.id, false),
+              GPIO::Mode::kAF,
+              GPIO::Pullup::kNone,
+              GPIO::Speed::k50MHz,
+              GPIO::DriverType::kPushPull,
+              GetConfigAltFn(config.id)),
+    ch2_gpio_(GetConfigPinout(config.id, true),
+              GPIO::Mode::kAF,
+              GPIO::Pullup::kNone,
+              GPIO::Speed::k50MHz,
+              GPIO::DriverType::kPushPull,
+              GetConfigAltFn(config.id)),
+#endif
+    is_32bit_(Timer::Is32Bit(timer_)),
+    sample_rate_(static_cast<int32_t>(config.sample_rate)) {
+#if defined(STM32F1)
+  InitConfigRemap(config.id);
+#endif
+
+  Timer::InitRcc(timer_);
+
+  // Count on both edges of both channels, and let the counter wrap around its full range
+  timer_set_period(timer_, is_32bit_ ? 0xFFFFFFFF : 0xFFFF);
+  timer_slave_set_mode(timer_, TIM_SMCR_SMS_EM3);
+  timer_ic_set_input(timer_, TIM_IC1, TIM_IC_IN_TI1);
+  timer_ic_set_input(timer_, TIM_IC2, TIM_IC_IN_TI2);
+  timer_ic_set_filter(timer_, TIM_IC1, TIM_IC_CK_INT_N_8);
+  timer_ic_set_filter(timer_, TIM_IC2, TIM_IC_CK_INT_N_8);
+
+  // Inverting one input swaps the counting direction
+  timer_ic_set_polarity(timer_, TIM_IC1, config.reverse ? TIM_IC_FALLING : TIM_IC_RISING);
+  timer_ic_set_polarity(timer_, TIM_IC2, TIM_IC_RISING);
+
+  timer_enable_counter(timer_);
+
+  Reset();
+}
+
+uint32_t Encoder::GetCount() const {
+  return TIM_CNT(timer_);
+}
+
+int64_t Encoder::GetPosition() const {
+  const uint32_t count = TIM_CNT(timer_);
+
+  // Retry if Update() has modified the latched state while we are reading it
+  uint32_t seq;
+  int64_t position;
+  uint32_t last_count;
+  do {
+    seq = seq_;
+    position = position_;
+    last_count = last_count_;
+  } while ((seq & 1U) != 0 || seq != seq_);
+
+  return position + GetDelta(count, last_count);
+}
+
+void Encoder::Update() {
+  const uint32_t count = TIM_CNT(timer_);
+  const int32_t delta = GetDelta(count, last_count_);
+
+  seq_ = seq_ + 1;
+  position_ = position_ + delta;
+  last_count_ = count;
+  seq_ = seq_ + 1;
+
+  velocity_ = delta * sample_rate_;
+}
+
+void Encoder::Reset() {
+  seq_ = seq_ + 1;
+  position_ = 0;
+  last_count_ = TIM_CNT(timer_);
+  seq_ = seq_ + 1;
+
+  velocity_ = 0;
+}
+
+int32_t Encoder::GetDelta(const uint32_t count, const uint32_t last) const {
+  if (is_32bit_) {
+    return static_cast<int32_t>(count - last);
+  }
+  return static_cast<int16_t>(static_cast<uint16_t>(count - last));
+}
+
+#elif !defined(LIB_USE_ENCODER)
+#error "LIB_USE_ENCODER macro not found. (Did you define it in your board configuration?)"
+#endif
@@ -0,0 +1,170 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_LIB_ENCODER_H_
+#define RTLIB_LIB_ENCODER_H_
+
+#include <cstdint>
+
+#include "config/config.h"
+#include "core/gpio.h"
+
+static_assert(LIB_USE_ENCODER > 0, "Encoder library is disabled in your configuration.");
+
+/**
+ * @brief HAL implementation for quadrature encoders.
+ *
+ * This abstraction layer counts quadrature encoder edges using a hardware timer in encoder mode, so that no CPU time
+ * is spent per edge. One encoder object is designed to manage one encoder (and its timer) on the mainboard.
+ *
+ * The hardware counter is extended to 64 bits in software: Every call to Update() folds the counts since the previous
+ * call into the extended position, and latches the velocity over that period. Therefore Update() must be called at
+ * the fixed rate given in Encoder#Config#sample_rate, and frequently enough that the 16-bit hardware counter never
+ * moves by more than 32767 counts between two calls.
+ */
+class Encoder {
+ public:
+  /**
+   * @brief Configuration for encoder.
+   */
+  struct Config {
+    /**
+     * @brief ID of the encoder.
+     *
+     * See your device configuration header file to see which id corresponds to which hardware encoder.
+     */
+    uint8_t id = 0;
+    /**
+     * @brief If true, the counting direction is inverted.
+     *
+     * The inversion is done by the timer input polarity, so it does not have any runtime cost.
+     */
+    bool reverse = false;
+    /**
+     * @brief Rate at which Update() will be invoked, in Hz.
+     *
+     * This is used to scale the velocity returned by GetVelocity(). Defaults to 1000Hz.
+     */
+    uint32_t sample_rate = 1000;
+  };
+
+  /**
+   * @brief Default constructor for encoder.
+   *
+   * @param config Encoder configuration
+   */
+  explicit Encoder(const Config& config);
+
+  /**
+   * @brief Default trivial destructor.
+   */
+  ~Encoder() = default;
+
+  /**
+   * @brief Move constructor for encoder.
+   *
+   * @param other Encoder object to move from
+   */
+  Encoder(Encoder&& other) noexcept = default;
+  /**
+   * @brief Move assignment operator for encoder.
+   *
+   * @param other Encoder object to move from
+   * @return Reference to the moved encoder.
+   */
+  Encoder& operator=(Encoder&& other) noexcept = default;
+
+  /**
+   * @brief Copy constructor for encoder.
+   *
+   * This constructor is deleted because there should only be one object managing each encoder, similar to @c
+   * std::unique_ptr.
+   */
+  Encoder(const Encoder&) = delete;
+  /**
+   * @brief Copy assignment operator for encoder.
+   *
+   * This constructor is deleted because there should only be one object managing each encoder, similar to @c
+   * std::unique_ptr.
+   */
+  Encoder& operator=(const Encoder&) = delete;
+
+  /**
+   * @brief Reads the raw hardware counter.
+   *
+   * @return Current value of the timer counter, which wraps around at 16 or 32 bits depending on the timer.
+   */
+  uint32_t GetCount() const;
+  /**
+   * @brief Reads the extended position of the encoder.
+   *
+   * This function only reads the hardware counter once; the rest of the position comes from the value latched by the
+   * last Update().
+   *
+   * @note If Update() is called from an interrupt, this function must not be called from a higher priority
+   * interrupt.
+   *
+   * @return Number of counts since construction or the last Reset().
+   */
+  int64_t GetPosition() const;
+  /**
+   * @brief Retrieves the velocity latched by the last Update().
+   *
+   * @return Velocity of the encoder, in counts per second.
+   */
+  int32_t GetVelocity() const { return velocity_; }
+
+  /**
+   * @brief Latches the position and velocity of the encoder.
+   *
+   * This function should be invoked at the rate specified in Encoder#Config#sample_rate, for example from a fixed-rate
+   * control loop.
+   */
+  void Update();
+  /**
+   * @brief Resets the position and velocity of the encoder to zero.
+   */
+  void Reset();
+
+ private:
+  /**
+   * @brief Computes the signed difference between two hardware counter values.
+   *
+   * @param count New counter value
+   * @param last Old counter value
+   * @return Number of counts moved from @p last to @p count, taking counter wrap-around into account.
+   */
+  int32_t GetDelta(uint32_t count, uint32_t last) const;
+
+  uint32_t timer_;
+  CORE_NS::GPIO ch1_gpio_;
+  CORE_NS::GPIO ch2_gpio_;
+  bool is_32bit_;
+  int32_t sample_rate_;
+
+  /**
+   * @brief Sequence counter guarding the latched state. Odd values indicate an Update() is in progress.
+   */
+  volatile uint32_t seq_ = 0;
+  volatile uint32_t last_count_ = 0;
+  volatile int64_t position_ = 0;
+  volatile int32_t velocity_ = 0;
+};
+
+#endif  // RTLIB_LIB_ENCODER_H_
@@ -0,0 +1,452 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config/config.h"
+
+#if defined(LIB_USE_IMU) && LIB_USE_IMU > 0
+
+#include "lib/imu.h"
+
+#include <cassert>
+#include <type_traits>
+
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/spi.h>
+
+#include "core/exti.h"
+#include "lib/dma_routes.h"
+#include "lib/system.h"
+#include "util/fast_math.h"
+
+using CORE_NS::Dma;
+using CORE_NS::Exti;
+using CORE_NS::GPIO;
+
+namespace {
+/**
+ * @brief Register addresses of the sensor.
+ */
+constexpr uint8_t kRegSmplrtDiv = 0x19;
+constexpr uint8_t kRegConfig = 0x1A;
+constexpr uint8_t kRegGyroConfig = 0x1B;
+constexpr uint8_t kRegAccelConfig = 0x1C;
+constexpr uint8_t kRegIntPinCfg = 0x37;
+constexpr uint8_t kRegIntEnable = 0x38;
+constexpr uint8_t kRegAccelXoutH = 0x3B;
+constexpr uint8_t kRegUserCtrl = 0x6A;
+constexpr uint8_t kRegPwrMgmt1 = 0x6B;
+constexpr uint8_t kRegWhoAmI = 0x75;
+
+/**
+ * @brief Bit of the address byte which selects a read access.
+ */
+constexpr uint8_t kReadFlag = 0x80;
+
+constexpr uint8_t kPwrMgmt1DeviceReset = 0x80;
+constexpr uint8_t kPwrMgmt1ClkSelPll = 0x01;
+constexpr uint8_t kUserCtrlI2cIfDis = 0x10;
+constexpr uint8_t kIntEnableDataRdy = 0x01;
+/**
+ * @brief Digital low-pass filter setting with the lowest delay at a 1kHz internal sample rate.
+ */
+constexpr uint8_t kConfigDlpf = 0x01;
+
+/**
+ * @brief Known values of the WHO_AM_I register: MPU-6000, MPU-6500, ICM-20602, ICM-20608-G and ICM-20689.
+ */
+constexpr std::array<uint8_t, 5> kWhoAmIValues = {0x68, 0x70, 0x12, 0xAF, 0x98};
+
+/**
+ * @brief SPI clock for configuration registers, which are limited to 1MHz.
+ */
+constexpr uint32_t kSlowClock = 1000000;
+/**
+ * @brief SPI clock for burst reads. Sensor and interrupt registers can be read at up to 20MHz.
+ */
+constexpr uint32_t kFastClock = 20000000;
+
+/**
+ * @brief Peripheral resources of each supported SPI.
+ */
+struct SpiInfo {
+  uint32_t spi;
+  rcc_periph_clken rcc;
+};
+
+constexpr std::array<SpiInfo, 3> kSpis = {{
+    {SPI1, RCC_SPI1},
+    {SPI2, RCC_SPI2},
+    {SPI3, RCC_SPI3},
+}};
+
+inline const SpiInfo& GetSpiInfo(const uint32_t spi) {
+  for (const SpiInfo& info : kSpis) {
+    if (info.spi == spi) {
+      return info;
+    }
+  }
+
+  assert(false);
+  return kSpis[0];
+}
+
+/**
+ * @brief Hardware configuration of one IMU, as read from the board configuration.
+ */
+struct HwConfig {
+  uint32_t spi = 0;
+  Pinout sck = {};
+  Pinout miso = {};
+  Pinout mosi = {};
+  Pinout cs = {};
+  Pinout drdy = {};
+#if defined(STM32F1)
+  std::optional<GPIO::PriRemap> remap = std::nullopt;
+#elif defined(STM32F4)
+  GPIO::AltFn altfn = GPIO_AF0;
+#endif
+};
+
+inline HwConfig GetConfigHw(const uint8_t id) {
+  assert(id < LIB_USE_IMU);
+  HwConfig hw;
+  switch (id) {
+    default:
+      // not handled, since assert will catch this error
+      assert(false);
+      break;
+#if LIB_USE_IMU > 0
+    case 0:
+      hw.spi = LIB_IMU0_SPI;
+      hw.sck = Pinout(LIB_IMU0_SCK_PINOUT);
+      hw.miso = Pinout(LIB_IMU0_MISO_PINOUT);
+      hw.mosi = Pinout(LIB_IMU0_MOSI_PINOUT);
+      hw.cs = Pinout(LIB_IMU0_CS_PINOUT);
+      hw.drdy = Pinout(LIB_IMU0_DRDY_PINOUT);
+#if defined(STM32F1) && defined(LIB_IMU0_REMAP)
+      hw.remap = LIB_IMU0_REMAP;
+#elif defined(STM32F4)
+      hw.altfn = LIB_IMU0_ALTFN;
+#endif
+      break;
+#endif  // LIB_USE_IMU > 0
+#if LIB_USE_IMU > 1
+    case 1:
+      hw.spi = LIB_IMU1_SPI;
+      hw.sck = Pinout(LIB_IMU1_SCK_PINOUT);
+      hw.miso = Pinout(LIB_IMU1_MISO_PINOUT);
+      hw.mosi = Pinout(LIB_IMU1_MOSI_PINOUT);
+      hw.cs = Pinout(LIB_IMU1_CS_PINOUT);
+      hw.drdy = Pinout(LIB_IMU1_DRDY_PINOUT);
+#if defined(STM32F1) && defined(LIB_IMU1_REMAP)
+      hw.remap = LIB_IMU1_REMAP;
+#elif defined(STM32F4)
+      hw.altfn = LIB_IMU1_ALTFN;
+#endif
+      break;
+#endif  // LIB_USE_IMU > 1
+  }
+  return hw;
+}
+
+/**
+ * @param spi SPI peripheral
+ * @return Clock frequency of the bus which @p spi is connected to.
+ */
+inline uint32_t GetBusClock(const uint32_t spi) { return spi == SPI1 ? rcc_apb2_frequency : rcc_apb1_frequency; }
+
+/**
+ * @param data Big-endian register pair
+ * @return Signed value of the register pair.
+ */
+inline int16_t ReadInt16(const uint8_t* data) {
+  return static_cast<int16_t>(static_cast<uint16_t>(data[0] << 8 | data[1]));
+}
+
+/**
+ * @brief Converts a raw gyroscope reading to rad/s.
+ *
+ * In fixed-point, the product of the raw reading and the raw scale fits into 32 bits for all ranges, so no conversion
+ * through @c float is needed.
+ */
+template<typename T>
+inline T ToRate(const int16_t raw, const T scale) {
+  if constexpr (std::is_floating_point_v<T>) {
+    return static_cast<T>(raw) * scale;
+  } else {
+    return T::FromRaw(raw * scale.GetRaw());
+  }
+}
+
+/**
+ * @brief Converts a raw accelerometer reading for sensor fusion.
+ *
+ * The accelerometer is normalized by the fusion filters, so the unit does not matter. In fixed-point, readings are
+ * scaled up so that normalization does not lose precision, while staying well within the range of the scalar type.
+ */
+template<typename T>
+inline T ToAccel(const int16_t raw) {
+  if constexpr (std::is_floating_point_v<T>) {
+    return static_cast<T>(raw);
+  } else {
+    return T::FromRaw(raw * 4096);
+  }
+}
+}  // namespace
+
+Imu::Imu(const Config& config) :
+    algorithm_(config.algorithm),
+    priority_(config.priority),
+    madgwick_({config.gain, 1.0f / static_cast<float>(config.sample_rate)}),
+    mahony_({config.gain, config.integral_gain, 1.0f / static_cast<float>(config.sample_rate)}) {
+  assert(config.sample_rate > 0 && config.sample_rate <= 1000 && 1000 % config.sample_rate == 0);
+
+  const HwConfig hw = GetConfigHw(config.id);
+  spi_ = hw.spi;
+  drdy_pin_ = hw.drdy;
+  const SpiInfo& info = GetSpiInfo(spi_);
+
+#if defined(STM32F1)
+  if (hw.remap) {
+    rcc_periph_clock_enable(RCC_AFIO);
+    GPIO::SetPriAltFn(GPIO::JTAGDisables::kNoDisable, *hw.remap);
+  }
+  cs_gpio_.emplace(hw.cs, GPIO::Configuration::kOutputPushPull, GPIO::Mode::kOutput50MHz);
+  drdy_gpio_.emplace(hw.drdy, GPIO::Configuration::kInputFloat, GPIO::Mode::kInput);
+  spi_gpios_[0].emplace(hw.sck, GPIO::Configuration::kOutputAltFnPushPull, GPIO::Mode::kOutput50MHz);
+  spi_gpios_[1].emplace(hw.miso, GPIO::Configuration::kInputFloat, GPIO::Mode::kInput);
+  spi_gpios_[2].emplace(hw.mosi, GPIO::Configuration::kOutputAltFnPushPull, GPIO::Mode::kOutput50MHz);
+#elif defined(STM32F4)
+  cs_gpio_.emplace(hw.cs, GPIO::Mode::kOutput, GPIO::Pullup::kNone, GPIO::Speed::k50MHz);
+  drdy_gpio_.emplace(hw.drdy, GPIO::Mode::kInput, GPIO::Pullup::kNone);
+  spi_gpios_[0].emplace(hw.sck, GPIO::Mode::kAF, GPIO::Pullup::kNone, GPIO::Speed::k50MHz, GPIO::DriverType::kPushPull,
+                        hw.altfn);
+  spi_gpios_[1].emplace(hw.miso, GPIO::Mode::kAF, GPIO::Pullup::kNone, GPIO::Speed::k50MHz, GPIO::DriverType::kPushPull,
+                        hw.altfn);
+  spi_gpios_[2].emplace(hw.mosi, GPIO::Mode::kAF, GPIO::Pullup::kNone, GPIO::Speed::k50MHz, GPIO::DriverType::kPushPull,
+                        hw.altfn);
+#endif
+  cs_gpio_->Set(true);
+
+  // Mode 3, MSB first, 8-bit frames, with the chip select driven in software
+  rcc_periph_clock_enable(info.rcc);
+  SPI_CR1(spi_) = SPI_CR1_MSTR | SPI_CR1_SSM | SPI_CR1_SSI | SPI_CR1_CPOL | SPI_CR1_CPHA;
+  SetClock(kSlowClock);
+
+  detected_ = false;
+  const uint8_t who_am_i = ReadRegister(kRegWhoAmI);
+  for (const uint8_t value : kWhoAmIValues) {
+    detected_ |= who_am_i == value;
+  }
+  if (!detected_) {
+    return;
+  }
+
+  WriteRegister(kRegPwrMgmt1, kPwrMgmt1DeviceReset);
+  System::DelayMs(100);
+  WriteRegister(kRegPwrMgmt1, kPwrMgmt1ClkSelPll);
+  WriteRegister(kRegUserCtrl, kUserCtrlI2cIfDis);
+  WriteRegister(kRegConfig, kConfigDlpf);
+  WriteRegister(kRegSmplrtDiv, static_cast<uint8_t>(1000 / config.sample_rate - 1));
+  WriteRegister(kRegGyroConfig, static_cast<uint8_t>(static_cast<uint8_t>(config.gyro_range) << 3));
+  WriteRegister(kRegAccelConfig, static_cast<uint8_t>(static_cast<uint8_t>(config.accel_range) << 3));
+  // Active high, push-pull pulse which is cleared automatically
+  WriteRegister(kRegIntPinCfg, 0x00);
+
+  const auto gyro_fs = static_cast<float>(250 << static_cast<uint8_t>(config.gyro_range));
+  const auto accel_fs = static_cast<float>(2 << static_cast<uint8_t>(config.accel_range));
+  gyro_scale_ = gyro_fs / 32768.0f * static_cast<float>(util::math::kPi) / 180.0f;
+  accel_scale_ = accel_fs / 32768.0f;
+  fusion_gyro_scale_ = Scalar(gyro_scale_);
+
+  const std::optional<Dma::Route> rx_route = Dma::Allocate(*DmaRoutes::GetSpiRxRequest(spi_));
+  const std::optional<Dma::Route> tx_route = Dma::Allocate(*DmaRoutes::GetSpiTxRequest(spi_));
+  assert(rx_route && tx_route);
+  rx_route_ = *rx_route;
+  tx_route_ = *tx_route;
+
+  tx_buffer_[0] = kRegAccelXoutH | kReadFlag;
+
+  SetClock(kFastClock);
+  SPI_CR2(spi_) |= SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN;
+
+  const bool drdy_claimed = Exti::SetIrqHandler(drdy_pin_, Exti::Trigger::kRising, &HandleDataReady, this, priority_);
+  assert(drdy_claimed);
+  static_cast<void>(drdy_claimed);
+  WriteRegister(kRegIntEnable, kIntEnableDataRdy);
+}
+
+Imu::~Imu() {
+  if (!detected_) {
+    spi_disable(spi_);
+    return;
+  }
+
+  Exti::SetIrqHandler(drdy_pin_, Exti::Trigger::kRising, nullptr);
+  Dma::Release(rx_route_);
+  Dma::Release(tx_route_);
+  cs_gpio_->Set(true);
+  SPI_CR2(spi_) &= ~static_cast<uint32_t>(SPI_CR2_RXDMAEN | SPI_CR2_TXDMAEN);
+  spi_disable(spi_);
+}
+
+void Imu::HandleDataReady(void* context) {
+  Imu& self = *static_cast<Imu*>(context);
+
+  if (self.busy_) {
+    ++self.missed_samples_;
+    return;
+  }
+  self.busy_ = true;
+  self.timestamp_ = System::GetUs();
+
+  self.cs_gpio_->Reset();
+
+  // The receive stream is started first, so that no byte is missed once the transmit stream starts clocking
+  Dma::Transfer transfer;
+  transfer.direction = Dma::Direction::kPeriphToMem;
+  transfer.peripheral = reinterpret_cast<uint32_t>(&SPI_DR(self.spi_));
+  transfer.memory0 = self.rx_buffer_.data();
+  transfer.count = kBurstSize;
+  transfer.priority = Dma::Priority::kVeryHigh;
+  transfer.callback = &HandleDmaEvent;
+  transfer.context = &self;
+  transfer.irq_priority = self.priority_;
+  Dma::Start(self.rx_route_, transfer);
+
+  transfer.direction = Dma::Direction::kMemToPeriph;
+  transfer.memory0 = self.tx_buffer_.data();
+  transfer.priority = Dma::Priority::kHigh;
+  transfer.callback = &HandleTxDmaEvent;
+  Dma::Start(self.tx_route_, transfer);
+}
+
+void Imu::HandleDmaEvent(const Dma::Event event, void* context) {
+  Imu& self = *static_cast<Imu*>(context);
+
+  switch (event) {
+    case Dma::Event::kTransferComplete:
+      // The last byte is received after it has been clocked out, so the bus is idle by now
+      self.cs_gpio_->Set(true);
+      self.ProcessBurst();
+      self.busy_ = false;
+      break;
+    case Dma::Event::kError:
+      Dma::Stop(self.tx_route_);
+      self.AbortBurst();
+      break;
+    case Dma::Event::kHalfTransfer:
+    case Dma::Event::kBuffer0Complete:
+    case Dma::Event::kBuffer1Complete:
+      // Not enabled for single-buffered transfers without half transfer interrupts
+      break;
+    default:
+      assert(false);
+      break;
+  }
+}
+
+void Imu::HandleTxDmaEvent(const Dma::Event event, void* context) {
+  Imu& self = *static_cast<Imu*>(context);
+
+  // Completion is reported by the receive stream, so only errors are handled here
+  if (event == Dma::Event::kError) {
+    Dma::Stop(self.rx_route_);
+    self.AbortBurst();
+  }
+}
+
+void Imu::AbortBurst() {
+  cs_gpio_->Set(true);
+  ++missed_samples_;
+  busy_ = false;
+}
+
+void Imu::ProcessBurst() {
+  // The first byte was received while the address was sent
+  const uint8_t* data = rx_buffer_.data() + 1;
+
+  Sample sample;
+  sample.timestamp = timestamp_;
+  for (std::size_t i = 0; i < 3; ++i) {
+    sample.accel[i] = ReadInt16(data + 2 * i);
+    sample.gyro[i] = ReadInt16(data + 8 + 2 * i);
+  }
+  sample.temperature = ReadInt16(data + 6);
+  samples_.Write(sample);
+
+  const std::array<Scalar, 3> gyro = {ToRate(sample.gyro[0], fusion_gyro_scale_),
+                                      ToRate(sample.gyro[1], fusion_gyro_scale_),
+                                      ToRate(sample.gyro[2], fusion_gyro_scale_)};
+  const std::array<Scalar, 3> accel = {ToAccel<Scalar>(sample.accel[0]),
+                                       ToAccel<Scalar>(sample.accel[1]),
+                                       ToAccel<Scalar>(sample.accel[2])};
+
+  Attitude attitude;
+  attitude.timestamp = timestamp_;
+  switch (algorithm_) {
+    case Algorithm::kMadgwick:
+      madgwick_.Update(gyro, accel);
+      attitude.quaternion = madgwick_.GetQuaternion();
+      break;
+    case Algorithm::kMahony:
+      mahony_.Update(gyro, accel);
+      attitude.quaternion = mahony_.GetQuaternion();
+      break;
+    default:
+      assert(false);
+      break;
+  }
+  attitudes_.Write(attitude);
+}
+
+void Imu::SetClock(const uint32_t max_frequency) const {
+  // Baud rate prescalers range from 2 (0) to 256 (7)
+  const uint32_t bus_clock = GetBusClock(spi_);
+  uint8_t prescaler = 0;
+  while (prescaler < 7 && (bus_clock >> (prescaler + 1)) > max_frequency) {
+    ++prescaler;
+  }
+
+  spi_disable(spi_);
+  spi_set_baudrate_prescaler(spi_, prescaler);
+  spi_enable(spi_);
+}
+
+uint8_t Imu::ReadRegister(const uint8_t reg) const {
+  cs_gpio_->Reset();
+  spi_xfer(spi_, reg | kReadFlag);
+  const auto value = static_cast<uint8_t>(spi_xfer(spi_, 0x00));
+  cs_gpio_->Set(true);
+  return value;
+}
+
+void Imu::WriteRegister(const uint8_t reg, const uint8_t value) const {
+  cs_gpio_->Reset();
+  spi_xfer(spi_, reg);
+  spi_xfer(spi_, value);
+  cs_gpio_->Set(true);
+
+  // Configuration registers take some time to latch
+  System::DelayUs(10);
+}
+
+#elif !defined(LIB_USE_IMU)
+#error "LIB_USE_IMU macro not found. (Did you define it in your board configuration?)"
+#endif
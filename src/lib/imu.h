@@ -0,0 +1,311 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_LIB_IMU_H_
+#define RTLIB_LIB_IMU_H_
+
+#include <array>
+#include <cstdint>
+#include <optional>
+
+#include "config/config.h"
+#include "core/dma.h"
+#include "core/gpio.h"
+#include "util/ahrs.h"
+#include "util/double_buffer.h"
+
+static_assert(LIB_USE_IMU > 0, "Imu library is disabled in your configuration.");
+
+/**
+ * @brief HAL implementation for InvenSense MPU-6000/MPU-6500/ICM-20602 6-axis IMUs connected via SPI.
+ *
+ * This abstraction layer runs the whole sampling pipeline in interrupts. The data-ready output of the sensor triggers
+ * an external interrupt, which timestamps the sample and starts a DMA burst read of all sensor registers. When the
+ * read completes, the sample is converted and fused into an attitude estimate, and both are published through double
+ * buffers, so the application can read the latest sample and attitude at any time without disabling interrupts.
+ *
+ * The attitude is estimated in @c float on devices with an FPU, and in fixed-point otherwise (see util#AhrsScalar).
+ * Since the sensor has no magnetometer, heading is only integrated from the gyroscope and drifts over time.
+ *
+ * One Imu object is designed to manage one IMU on the mainboard, and claims its SPI bus exclusively.
+ */
+class Imu {
+ public:
+  /**
+   * @brief Scalar type used for sensor fusion.
+   */
+  using Scalar = util::AhrsScalar;
+
+  /**
+   * @brief Enumeration of gyroscope full-scale ranges.
+   */
+  enum struct GyroRange : uint8_t {
+    k250Dps,
+    k500Dps,
+    k1000Dps,
+    k2000Dps
+  };
+
+  /**
+   * @brief Enumeration of accelerometer full-scale ranges.
+   */
+  enum struct AccelRange : uint8_t {
+    k2G,
+    k4G,
+    k8G,
+    k16G
+  };
+
+  /**
+   * @brief Enumeration of sensor fusion algorithms.
+   */
+  enum struct Algorithm {
+    /**
+     * @brief Madgwick's gradient-descent filter. See util::Madgwick.
+     */
+    kMadgwick,
+    /**
+     * @brief Mahony's complementary filter. See util::Mahony.
+     */
+    kMahony
+  };
+
+  /**
+   * @brief Configuration for IMU.
+   */
+  struct Config {
+    /**
+     * @brief ID of the IMU.
+     *
+     * See your device configuration header file to see which id corresponds to which IMU.
+     */
+    uint8_t id = 0;
+    /**
+     * @brief Gyroscope full-scale range. Defaults to 2000 degrees per second.
+     */
+    GyroRange gyro_range = GyroRange::k2000Dps;
+    /**
+     * @brief Accelerometer full-scale range. Defaults to 16g.
+     */
+    AccelRange accel_range = AccelRange::k16G;
+    /**
+     * @brief Output data rate, in Hz. Must be a divisor of 1kHz. Defaults to 1kHz.
+     */
+    uint16_t sample_rate = 1000;
+    /**
+     * @brief Sensor fusion algorithm.
+     */
+    Algorithm algorithm = Algorithm::kMahony;
+    /**
+     * @brief Gain of the accelerometer correction, i.e. @c beta for Madgwick, or @c kp for Mahony.
+     */
+    float gain = 1.0f;
+    /**
+     * @brief Integral gain for Mahony. Ignored for Madgwick.
+     */
+    float integral_gain = 0.0f;
+    /**
+     * @brief Interrupt priority of the data-ready interrupt and the DMA streams.
+     *
+     * Sensor fusion runs in the DMA interrupt, so this should be lower (i.e. numerically higher) than interrupts which
+     * are more time-critical.
+     */
+    uint8_t priority = 0x40;
+  };
+
+  /**
+   * @brief Raw readings of one sample.
+   */
+  struct Sample {
+    /**
+     * @brief Time of the data-ready interrupt, in microseconds since System::Init().
+     */
+    uint64_t timestamp = 0;
+    /**
+     * @brief Acceleration along the X, Y and Z axes. Multiply by GetAccelScale() to convert to g.
+     */
+    std::array<int16_t, 3> accel = {};
+    /**
+     * @brief Angular rate around the X, Y and Z axes. Multiply by GetGyroScale() to convert to rad/s.
+     */
+    std::array<int16_t, 3> gyro = {};
+    /**
+     * @brief Raw die temperature.
+     */
+    int16_t temperature = 0;
+  };
+
+  /**
+   * @brief Attitude estimate after one sample.
+   */
+  struct Attitude {
+    /**
+     * @brief Timestamp of the sample which produced this estimate, in microseconds since System::Init().
+     */
+    uint64_t timestamp = 0;
+    /**
+     * @brief Rotation from the sensor frame to the earth frame.
+     */
+    util::Quaternion<Scalar> quaternion = {};
+  };
+
+  /**
+   * @brief Default constructor for IMU.
+   *
+   * Resets and configures the sensor, then starts sampling. System::Init() must be called beforehand.
+   *
+   * @param config IMU configuration
+   */
+  explicit Imu(const Config& config);
+
+  /**
+   * @brief Destructor.
+   *
+   * Stops sampling and releases the DMA streams.
+   */
+  ~Imu();
+
+  /**
+   * @brief Move constructor for IMU.
+   *
+   * This constructor is deleted because the interrupt handlers refer to this object.
+   */
+  Imu(Imu&&) = delete;
+  /**
+   * @brief Move assignment operator for IMU.
+   *
+   * This operator is deleted because the interrupt handlers refer to this object.
+   */
+  Imu& operator=(Imu&&) = delete;
+
+  /**
+   * @brief Copy constructor for IMU.
+   *
+   * This constructor is deleted because there should only be one object managing each IMU.
+   */
+  Imu(const Imu&) = delete;
+  /**
+   * @brief Copy assignment operator for IMU.
+   *
+   * This operator is deleted because there should only be one object managing each IMU.
+   */
+  Imu& operator=(const Imu&) = delete;
+
+  /**
+   * @return @c true if the sensor responded with a known device ID during construction. If @c false, no samples will
+   * be produced.
+   */
+  bool IsDetected() const { return detected_; }
+
+  /**
+   * @brief Reads the latest sample.
+   *
+   * This function must only be called from one context.
+   *
+   * @param sample Reference to store the sample
+   * @return @c true if a new sample has been published since the last call.
+   */
+  bool ReadSample(Sample& sample) { return samples_.Read(sample); }
+
+  /**
+   * @brief Reads the latest attitude estimate.
+   *
+   * This function must only be called from one context.
+   *
+   * @param attitude Reference to store the attitude
+   * @return @c true if a new estimate has been published since the last call.
+   */
+  bool ReadAttitude(Attitude& attitude) { return attitudes_.Read(attitude); }
+
+  /**
+   * @return Conversion factor from raw gyroscope readings to rad/s.
+   */
+  float GetGyroScale() const { return gyro_scale_; }
+  /**
+   * @return Conversion factor from raw accelerometer readings to g.
+   */
+  float GetAccelScale() const { return accel_scale_; }
+
+  /**
+   * @return Number of samples which were dropped because the previous sample was still being read.
+   */
+  uint32_t GetMissedSamples() const { return missed_samples_; }
+
+ private:
+  /**
+   * @brief Number of bytes in a burst read, including the address byte.
+   */
+  static constexpr std::size_t kBurstSize = 15;
+
+  static void HandleDataReady(void* context);
+  static void HandleDmaEvent(CORE_NS::Dma::Event event, void* context);
+  static void HandleTxDmaEvent(CORE_NS::Dma::Event event, void* context);
+
+  /**
+   * @brief Ends a burst which failed, and counts its sample as missed.
+   */
+  void AbortBurst();
+
+  /**
+   * @brief Converts the received burst and runs sensor fusion.
+   */
+  void ProcessBurst();
+
+  /**
+   * @brief Sets the fastest SPI clock which does not exceed a frequency.
+   *
+   * @param max_frequency Maximum SPI clock, in Hz
+   */
+  void SetClock(uint32_t max_frequency) const;
+  uint8_t ReadRegister(uint8_t reg) const;
+  void WriteRegister(uint8_t reg, uint8_t value) const;
+
+  uint32_t spi_;
+  Pinout drdy_pin_;
+  Algorithm algorithm_;
+  uint8_t priority_;
+  bool detected_ = false;
+
+  float gyro_scale_ = 0.0f;
+  float accel_scale_ = 0.0f;
+  /**
+   * @brief Conversion factor from raw gyroscope readings to rad/s, in the scalar type used for sensor fusion.
+   */
+  Scalar fusion_gyro_scale_;
+
+  util::Madgwick<Scalar> madgwick_;
+  util::Mahony<Scalar> mahony_;
+
+  CORE_NS::Dma::Route rx_route_;
+  CORE_NS::Dma::Route tx_route_;
+  std::array<uint8_t, kBurstSize> rx_buffer_ = {};
+  std::array<uint8_t, kBurstSize> tx_buffer_ = {};
+  volatile bool busy_ = false;
+  uint64_t timestamp_ = 0;
+  volatile uint32_t missed_samples_ = 0;
+
+  util::DoubleBuffer<Sample> samples_;
+  util::DoubleBuffer<Attitude> attitudes_;
+
+  std::optional<CORE_NS::GPIO> cs_gpio_;
+  std::optional<CORE_NS::GPIO> drdy_gpio_;
+  std::array<std::optional<CORE_NS::GPIO>, 3> spi_gpios_;
+};
+
+#endif  // RTLIB_LIB_IMU_H_
@@ -0,0 +1,420 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config/config.h"
+
+#if defined(LIB_USE_INPUTCAPTURE) && LIB_USE_INPUTCAPTURE > 0
+
+#include "lib/input_capture.h"
+
+#include <cassert>
+
+#include <libopencm3/stm32/rcc.h>
+
+#include "core/timer.h"
+#include "lib/dma_routes.h"
+
+using CORE_NS::Dma;
+using CORE_NS::GPIO;
+using CORE_NS::Timer;
+
+namespace {
+constexpr tim_ic_id kIcIds[] = {TIM_IC1, TIM_IC2, TIM_IC3, TIM_IC4};
+constexpr tim_ic_input kIcInputs[] = {TIM_IC_IN_TI1, TIM_IC_IN_TI2, TIM_IC_IN_TI3, TIM_IC_IN_TI4};
+constexpr uint32_t kCcIrqs[] = {TIM_DIER_CC1IE, TIM_DIER_CC2IE, TIM_DIER_CC3IE, TIM_DIER_CC4IE};
+constexpr uint32_t kCcDmas[] = {TIM_DIER_CC1DE, TIM_DIER_CC2DE, TIM_DIER_CC3DE, TIM_DIER_CC4DE};
+constexpr uint32_t kCcFlags[] = {TIM_SR_CC1IF, TIM_SR_CC2IF, TIM_SR_CC3IF, TIM_SR_CC4IF};
+constexpr uint32_t kOcFlags[] = {TIM_SR_CC1OF, TIM_SR_CC2OF, TIM_SR_CC3OF, TIM_SR_CC4OF};
+
+/**
+ * @brief Index of rising and falling edges in InputCapture#dma_routes_ and InputCapture#dma_rings_.
+ */
+constexpr std::size_t kRising = 0;
+constexpr std::size_t kFalling = 1;
+
+/**
+ * @brief Hardware configuration of one input capture timer, as read from the board configuration.
+ */
+struct HwConfig {
+  uint32_t timer = 0;
+  /**
+   * @brief Channel which the pin is connected to, from 1 to 4.
+   */
+  uint8_t channel = 0;
+  Pinout pin = {};
+#if defined(STM32F1)
+  std::optional<GPIO::PriRemap> remap = std::nullopt;
+#elif defined(STM32F4)
+  GPIO::AltFn altfn = GPIO_AF0;
+#endif
+};
+
+inline HwConfig GetConfigHw(const uint8_t id) {
+  assert(id < LIB_USE_INPUTCAPTURE);
+  HwConfig hw;
+  switch (id) {
+    default:
+      // not handled, since assert will catch this error
+      assert(false);
+      break;
+#if LIB_USE_INPUTCAPTURE > 0
+    case 0:
+      hw.timer = LIB_INPUTCAPTURE0_TIMER;
+      hw.channel = LIB_INPUTCAPTURE0_CHANNEL;
+      hw.pin = Pinout(LIB_INPUTCAPTURE0_PINOUT);
+#if defined(STM32F1) && defined(LIB_INPUTCAPTURE0_REMAP)
+      hw.remap = LIB_INPUTCAPTURE0_REMAP;
+#elif defined(STM32F4)
+      hw.altfn = LIB_INPUTCAPTURE0_ALTFN;
+#endif
+      break;
+#endif  // LIB_USE_INPUTCAPTURE > 0
+#if LIB_USE_INPUTCAPTURE > 1
+    case 1:
+      hw.timer = LIB_INPUTCAPTURE1_TIMER;
+      hw.channel = LIB_INPUTCAPTURE1_CHANNEL;
+      hw.pin = Pinout(LIB_INPUTCAPTURE1_PINOUT);
+#if defined(STM32F1) && defined(LIB_INPUTCAPTURE1_REMAP)
+      hw.remap = LIB_INPUTCAPTURE1_REMAP;
+#elif defined(STM32F4)
+      hw.altfn = LIB_INPUTCAPTURE1_ALTFN;
+#endif
+      break;
+#endif  // LIB_USE_INPUTCAPTURE > 1
+#if LIB_USE_INPUTCAPTURE > 2
+    case 2:
+      hw.timer = LIB_INPUTCAPTURE2_TIMER;
+      hw.channel = LIB_INPUTCAPTURE2_CHANNEL;
+      hw.pin = Pinout(LIB_INPUTCAPTURE2_PINOUT);
+#if defined(STM32F1) && defined(LIB_INPUTCAPTURE2_REMAP)
+      hw.remap = LIB_INPUTCAPTURE2_REMAP;
+#elif defined(STM32F4)
+      hw.altfn = LIB_INPUTCAPTURE2_ALTFN;
+#endif
+      break;
+#endif  // LIB_USE_INPUTCAPTURE > 2
+#if LIB_USE_INPUTCAPTURE > 3
+    case 3:
+      hw.timer = LIB_INPUTCAPTURE3_TIMER;
+      hw.channel = LIB_INPUTCAPTURE3_CHANNEL;
+      hw.pin = Pinout(LIB_INPUTCAPTURE3_PINOUT);
+#if defined(STM32F1) && defined(LIB_INPUTCAPTURE3_REMAP)
+      hw.remap = LIB_INPUTCAPTURE3_REMAP;
+#elif defined(STM32F4)
+      hw.altfn = LIB_INPUTCAPTURE3_ALTFN;
+#endif
+      break;
+#endif  // LIB_USE_INPUTCAPTURE > 3
+  }
+  return hw;
+}
+
+/**
+ * @param timer Timer to query
+ * @param channel Index of capture channel, from 0 to 3
+ * @return Capture register of the channel.
+ */
+volatile uint32_t& GetCcr(const uint32_t timer, const uint8_t channel) {
+  switch (channel) {
+    case 1:
+      return TIM_CCR2(timer);
+    case 2:
+      return TIM_CCR3(timer);
+    case 3:
+      return TIM_CCR4(timer);
+    default:
+      assert(channel == 0);
+      return TIM_CCR1(timer);
+  }
+}
+}  // namespace
+
+InputCapture::InputCapture(const Config& config) :
+    use_dma_(config.use_dma),
+    callback_(config.callback),
+    context_(config.context) {
+  const HwConfig hw = GetConfigHw(config.id);
+  assert(hw.channel >= 1 && hw.channel <= 4);
+  timer_ = hw.timer;
+  channel_ = static_cast<uint8_t>(hw.channel - 1);
+  const uint8_t partner = channel_ ^ 1u;
+
+#if defined(STM32F1)
+  gpio_.emplace(hw.pin, GPIO::Configuration::kInputFloat, GPIO::Mode::kInput);
+  if (hw.remap) {
+    rcc_periph_clock_enable(RCC_AFIO);
+    GPIO::SetPriAltFn(GPIO::JTAGDisables::kNoDisable, *hw.remap);
+  }
+#elif defined(STM32F4)
+  gpio_.emplace(hw.pin,
+                GPIO::Mode::kAF,
+                GPIO::Pullup::kNone,
+                GPIO::Speed::k2MHz,
+                GPIO::DriverType::kPushPull,
+                hw.altfn);
+#endif
+
+  Timer::InitRcc(timer_);
+
+  const uint32_t clock_freq = Timer::GetClockFreq(timer_);
+  const uint32_t prescaler = (clock_freq + config.tick_frequency / 2) / config.tick_frequency - 1;
+  assert(prescaler <= 0xFFFF);
+  tick_freq_ = clock_freq / (prescaler + 1);
+
+  // Let the counter run through its full range, so that timestamps only wrap around at the counter width
+  counter_mask_ = Timer::Is32Bit(timer_) ? 0xFFFFFFFF : 0xFFFF;
+  timestamp_mask_ = use_dma_ ? counter_mask_ : 0xFFFFFFFF;
+  timer_set_mode(timer_, TIM_CR1_CKD_CK_INT, TIM_CR1_CMS_EDGE, TIM_CR1_DIR_UP);
+  timer_set_prescaler(timer_, prescaler);
+  timer_set_period(timer_, counter_mask_);
+  timer_generate_event(timer_, TIM_EGR_UG);
+  timer_clear_flag(timer_, TIM_SR_UIF);
+
+  // Both channels of the pair sample the same pin, one on each edge
+  timer_ic_set_input(timer_, kIcIds[channel_], kIcInputs[channel_]);
+  timer_ic_set_input(timer_, kIcIds[partner], kIcInputs[channel_]);
+  timer_ic_set_polarity(timer_, kIcIds[channel_], TIM_IC_RISING);
+  timer_ic_set_polarity(timer_, kIcIds[partner], TIM_IC_FALLING);
+  for (const uint8_t channel : {channel_, partner}) {
+    timer_ic_set_filter(timer_, kIcIds[channel], config.filter);
+    timer_ic_set_prescaler(timer_, kIcIds[channel], TIM_IC_PSC_OFF);
+    timer_ic_enable(timer_, kIcIds[channel]);
+  }
+
+  if (use_dma_) {
+    for (const std::size_t edge : {kRising, kFalling}) {
+      const uint8_t channel = edge == kRising ? channel_ : partner;
+      const std::optional<Dma::Request> request = DmaRoutes::GetTimerCaptureRequest(timer_, channel);
+      assert(request);
+      dma_routes_[edge] = Dma::Allocate(*request);
+      assert(dma_routes_[edge]);
+
+      Dma::Transfer transfer;
+      transfer.direction = Dma::Direction::kPeriphToMem;
+      transfer.mode = Dma::Mode::kCircular;
+      transfer.peripheral = reinterpret_cast<uint32_t>(&GetCcr(timer_, channel));
+      transfer.memory0 = dma_rings_[edge].data();
+      transfer.count = kDmaRingSize;
+      transfer.peripheral_width = Dma::Width::kWord;
+      transfer.memory_width = Dma::Width::kWord;
+      transfer.priority = Dma::Priority::kHigh;
+      Dma::Start(*dma_routes_[edge], transfer);
+    }
+
+    timer_enable_irq(timer_, kCcDmas[channel_] | kCcDmas[partner]);
+  } else {
+    Timer::SetIrqHandler(timer_, &HandleTimerIrq, this);
+
+    uint32_t irqs = kCcIrqs[channel_] | kCcIrqs[partner];
+    // Counter overflows are only needed to extend 16-bit timestamps
+    if (!Timer::Is32Bit(timer_)) {
+      irqs |= TIM_DIER_UIE;
+    }
+    timer_enable_irq(timer_, irqs);
+  }
+
+  timer_enable_counter(timer_);
+}
+
+InputCapture::~InputCapture() {
+  timer_disable_counter(timer_);
+  timer_disable_irq(timer_, TIM_DIER_UIE | kCcIrqs[channel_] | kCcIrqs[channel_ ^ 1u] | kCcDmas[channel_] |
+                                kCcDmas[channel_ ^ 1u]);
+
+  if (use_dma_) {
+    for (const std::optional<Dma::Route>& route : dma_routes_) {
+      if (route) {
+        Dma::Release(*route);
+      }
+    }
+  } else {
+    Timer::SetIrqHandler(timer_, nullptr);
+  }
+}
+
+bool InputCapture::ReadEdge(Edge& edge) {
+  if (use_dma_) {
+    PollDma();
+  }
+  return edges_.Pop(edge);
+}
+
+bool InputCapture::GetPulse(Pulse& pulse) {
+  if (use_dma_) {
+    PollDma();
+  } else {
+    SetIrqEnable(false);
+  }
+
+  pulse = pulse_;
+  const bool updated = pulse_updated_;
+  pulse_updated_ = false;
+
+  if (!use_dma_) {
+    SetIrqEnable(true);
+  }
+  return updated;
+}
+
+uint32_t InputCapture::GetTimestamp() const {
+  if (use_dma_ || Timer::Is32Bit(timer_)) {
+    return timer_get_counter(timer_);
+  }
+
+  // Retry if the counter overflowed while being read, since the overflow count would not match the counter value
+  uint32_t overflows;
+  uint32_t counter;
+  do {
+    overflows = overflows_;
+    counter = timer_get_counter(timer_);
+  } while (overflows != overflows_ || (timer_get_flag(timer_, TIM_SR_UIF) && counter < 0x8000));
+  return overflows << 16 | counter;
+}
+
+uint32_t InputCapture::TicksToNs(const uint32_t ticks) const {
+  const uint64_t ns = uint64_t{ticks} * 1000000000 / tick_freq_;
+  return ns > 0xFFFFFFFF ? 0xFFFFFFFF : static_cast<uint32_t>(ns);
+}
+
+void InputCapture::HandleTimerIrq(void* context) {
+  static_cast<InputCapture*>(context)->HandleIrq();
+}
+
+void InputCapture::HandleIrq() {
+  const uint8_t partner = channel_ ^ 1u;
+  const uint32_t status = TIM_SR(timer_);
+  CheckOverruns();
+
+  // If the counter overflowed since the last interrupt, captures from the first half of the counter range happened
+  // after the overflow, since the interrupt latency is much shorter than half of the counter range
+  const bool overflowed = (status & TIM_SR_UIF) != 0 && !Timer::Is32Bit(timer_);
+  if (overflowed) {
+    timer_clear_flag(timer_, TIM_SR_UIF);
+  }
+  const auto extend = [this, overflowed](const uint32_t counter) {
+    if (Timer::Is32Bit(timer_)) {
+      return counter;
+    }
+    const uint32_t overflows = overflowed && counter < 0x8000 ? overflows_ + 1 : overflows_;
+    return overflows << 16 | counter;
+  };
+
+  // Reading the capture registers clears the capture flags
+  std::optional<uint32_t> rising;
+  std::optional<uint32_t> falling;
+  if ((status & kCcFlags[channel_]) != 0) {
+    rising = extend(GetCcr(timer_, channel_));
+  }
+  if ((status & kCcFlags[partner]) != 0) {
+    falling = extend(GetCcr(timer_, partner));
+  }
+
+  if (rising && falling && GetElapsed(*rising, *falling) > timestamp_mask_ / 2) {
+    // Falling edge occurred first
+    ProcessEdge(*falling, false);
+    ProcessEdge(*rising, true);
+  } else {
+    if (rising) {
+      ProcessEdge(*rising, true);
+    }
+    if (falling) {
+      ProcessEdge(*falling, false);
+    }
+  }
+
+  if (overflowed) {
+    ++overflows_;
+  }
+}
+
+void InputCapture::ProcessEdge(const uint32_t timestamp, const bool rising) {
+  // The queue is allowed to fill up if the application only uses GetPulse()
+  const Edge edge = {timestamp, rising};
+  edges_.Push(edge);
+  if (callback_ != nullptr) {
+    callback_(edge, context_);
+  }
+
+  if (rising) {
+    period_ = has_rising_ ? GetElapsed(last_rising_, timestamp) : 0;
+    last_rising_ = timestamp;
+    has_rising_ = true;
+  } else if (has_rising_) {
+    pulse_.timestamp = last_rising_;
+    pulse_.width = GetElapsed(last_rising_, timestamp);
+    pulse_.period = period_;
+    pulse_updated_ = true;
+  }
+}
+
+void InputCapture::PollDma() {
+  CheckOverruns();
+
+  std::array<std::size_t, 2> write_indices;
+  for (const std::size_t edge : {kRising, kFalling}) {
+    write_indices[edge] = (kDmaRingSize - Dma::GetRemaining(*dma_routes_[edge])) % kDmaRingSize;
+  }
+
+  // Merge both rings in the order of the timestamps
+  while (true) {
+    const bool has_rising = dma_read_indices_[kRising] != write_indices[kRising];
+    const bool has_falling = dma_read_indices_[kFalling] != write_indices[kFalling];
+    if (!has_rising && !has_falling) {
+      break;
+    }
+
+    std::size_t edge = has_rising ? kRising : kFalling;
+    if (has_rising && has_falling) {
+      const uint32_t rising = dma_rings_[kRising][dma_read_indices_[kRising]];
+      const uint32_t falling = dma_rings_[kFalling][dma_read_indices_[kFalling]];
+      if (GetElapsed(rising, falling) > timestamp_mask_ / 2) {
+        edge = kFalling;
+      }
+    }
+
+    ProcessEdge(dma_rings_[edge][dma_read_indices_[edge]] & counter_mask_, edge == kRising);
+    dma_read_indices_[edge] = (dma_read_indices_[edge] + 1) % kDmaRingSize;
+  }
+}
+
+void InputCapture::CheckOverruns() {
+  for (const uint8_t channel : {channel_, static_cast<uint8_t>(channel_ ^ 1u)}) {
+    if (timer_get_flag(timer_, kOcFlags[channel])) {
+      timer_clear_flag(timer_, kOcFlags[channel]);
+      overruns_ = overruns_ + 1;
+    }
+  }
+}
+
+void InputCapture::SetIrqEnable(const bool flag) {
+  uint32_t irqs = kCcIrqs[channel_] | kCcIrqs[channel_ ^ 1u];
+  if (!Timer::Is32Bit(timer_)) {
+    irqs |= TIM_DIER_UIE;
+  }
+
+  if (flag) {
+    timer_enable_irq(timer_, irqs);
+  } else {
+    timer_disable_irq(timer_, irqs);
+  }
+}
+
+#elif !defined(LIB_USE_INPUTCAPTURE)
+#error "LIB_USE_INPUTCAPTURE macro not found. (Did you define it in your board configuration?)"
+#endif
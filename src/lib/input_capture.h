@@ -0,0 +1,307 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_LIB_INPUT_CAPTURE_H_
+#define RTLIB_LIB_INPUT_CAPTURE_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include <libopencm3/stm32/timer.h>
+
+#include "config/config.h"
+#include "core/dma.h"
+#include "core/gpio.h"
+#include "util/spsc_queue.h"
+
+static_assert(LIB_USE_INPUTCAPTURE > 0, "InputCapture library is disabled in your configuration.");
+
+/**
+ * @brief HAL implementation for timer input capture.
+ *
+ * This abstraction layer timestamps the edges of a digital signal with a hardware timer, so that pulses can be measured
+ * without busy-waiting and with the resolution of the timer clock instead of the system tick. Typical uses are echo
+ * pins of ultrasonic sensors, RC PWM inputs and tachometers.
+ *
+ * The input pin is connected to a pair of capture channels: the configured channel captures rising edges, and its
+ * neighbour (channel 1 with 2, or channel 3 with 4) captures falling edges of the same pin. Timestamps are collected
+ * either by the capture interrupt, or by DMA into ring buffers without any interrupts.
+ *
+ * In interrupt mode, timestamps of 16-bit timers are extended to 32 bits by counting counter overflows. In DMA mode,
+ * timestamps wrap around at the range of the counter, so intervals longer than the counter range cannot be measured,
+ * and the edges must be read (by ReadEdge() or GetPulse()) before the ring buffers are overwritten.
+ *
+ * One InputCapture object is designed to manage one timer.
+ */
+class InputCapture {
+ public:
+  /**
+   * @brief Number of edges which can be buffered for ReadEdge().
+   */
+  static constexpr std::size_t kQueueSize = 32;
+  /**
+   * @brief Number of timestamps in each DMA ring buffer.
+   */
+  static constexpr std::size_t kDmaRingSize = 32;
+
+  /**
+   * @brief Data structure of a captured edge.
+   */
+  struct Edge {
+    /**
+     * @brief Counter value when the edge occurred, in ticks.
+     */
+    uint32_t timestamp;
+    /**
+     * @brief Whether this is a rising edge.
+     */
+    bool rising;
+  };
+
+  /**
+   * @brief Type definition for edge callbacks.
+   *
+   * @param edge Captured edge
+   * @param context User-defined pointer, as passed in Config.
+   */
+  using Callback = void (*)(const Edge& edge, void* context);
+
+  /**
+   * @brief Configuration for input capture.
+   */
+  struct Config {
+    /**
+     * @brief ID of the input capture timer.
+     *
+     * See your device configuration header file to see which id corresponds to which input capture timer.
+     */
+    uint8_t id = 0;
+    /**
+     * @brief Frequency of the timer counter, in Hz.
+     *
+     * The actual frequency is the closest integer fraction of the timer clock, and can be retrieved using
+     * GetTickFrequency(). Defaults to 4MHz, i.e. 250ns resolution.
+     */
+    uint32_t tick_frequency = 4000000;
+    /**
+     * @brief Digital filter applied to the input, which rejects glitches on noisy signals.
+     */
+    tim_ic_filter filter = TIM_IC_OFF;
+    /**
+     * @brief Whether timestamps are collected by DMA instead of interrupts.
+     */
+    bool use_dma = false;
+    /**
+     * @brief Function to invoke for each captured edge, or @c nullptr.
+     *
+     * In interrupt mode, the callback is invoked from the timer interrupt as soon as the edge is captured. In DMA mode,
+     * the callback is invoked from ReadEdge() and GetPulse().
+     */
+    Callback callback = nullptr;
+    /**
+     * @brief User-defined pointer which will be passed to @c callback.
+     */
+    void* context = nullptr;
+  };
+
+  /**
+   * @brief Data structure of a measured pulse.
+   */
+  struct Pulse {
+    /**
+     * @brief Counter value of the rising edge of the pulse, in ticks.
+     */
+    uint32_t timestamp = 0;
+    /**
+     * @brief Time between the rising and falling edge, in ticks.
+     */
+    uint32_t width = 0;
+    /**
+     * @brief Time between the rising edge of the previous pulse and this pulse, in ticks, or 0 if this is the first
+     * pulse.
+     */
+    uint32_t period = 0;
+  };
+
+  /**
+   * @brief Default constructor for input capture.
+   *
+   * Capturing starts immediately.
+   *
+   * @param config Input capture configuration
+   */
+  explicit InputCapture(const Config& config);
+
+  /**
+   * @brief Destructor.
+   *
+   * Stops the timer, and releases its interrupt or DMA streams.
+   */
+  ~InputCapture();
+
+  /**
+   * @brief Move constructor for input capture.
+   *
+   * This constructor is deleted because the interrupt handler refers to this object.
+   */
+  InputCapture(InputCapture&&) = delete;
+  /**
+   * @brief Move assignment operator for input capture.
+   *
+   * This operator is deleted because the interrupt handler refers to this object.
+   */
+  InputCapture& operator=(InputCapture&&) = delete;
+
+  /**
+   * @brief Copy constructor for input capture.
+   *
+   * This constructor is deleted because there should only be one object managing each input capture timer.
+   */
+  InputCapture(const InputCapture&) = delete;
+  /**
+   * @brief Copy assignment operator for input capture.
+   *
+   * This operator is deleted because there should only be one object managing each input capture timer.
+   */
+  InputCapture& operator=(const InputCapture&) = delete;
+
+  /**
+   * @brief Retrieves the oldest captured edge.
+   *
+   * Edges are discarded when they are not read fast enough, so this function is only needed if the application
+   * processes every edge. This function must only be called from one context.
+   *
+   * @param edge Reference to store the edge
+   * @return @c true if an edge is retrieved, @c false if no edges are pending.
+   */
+  bool ReadEdge(Edge& edge);
+
+  /**
+   * @brief Retrieves the most recently completed pulse.
+   *
+   * This function must only be called from one context.
+   *
+   * @param pulse Reference to store the pulse
+   * @return @c true if a pulse has completed since the last call.
+   */
+  bool GetPulse(Pulse& pulse);
+
+  /**
+   * @return Current counter value, in ticks, in the same time base as the captured timestamps.
+   */
+  uint32_t GetTimestamp() const;
+
+  /**
+   * @brief Computes the time between two timestamps, taking wrap-around of the counter into account.
+   *
+   * @param from Earlier timestamp
+   * @param to Later timestamp
+   * @return Elapsed time in ticks.
+   */
+  uint32_t GetElapsed(uint32_t from, uint32_t to) const { return (to - from) & timestamp_mask_; }
+
+  /**
+   * @return Frequency of the timer counter, in Hz.
+   */
+  uint32_t GetTickFrequency() const { return tick_freq_; }
+  /**
+   * @brief Converts a duration from ticks to nanoseconds.
+   *
+   * @param ticks Duration in ticks
+   * @return Duration in nanoseconds, saturated to the range of @c uint32_t.
+   */
+  uint32_t TicksToNs(uint32_t ticks) const;
+
+  /**
+   * @return Number of edges which were lost because the previous capture had not been read.
+   */
+  uint32_t GetOverruns() const { return overruns_; }
+
+ private:
+  static void HandleTimerIrq(void* context);
+  /**
+   * @brief Handles a capture or update interrupt of the timer.
+   */
+  void HandleIrq();
+
+  /**
+   * @brief Records a captured edge, and updates the pulse measurement.
+   */
+  void ProcessEdge(uint32_t timestamp, bool rising);
+  /**
+   * @brief Processes all timestamps which were written by DMA since the last call, in the order of their occurrence.
+   */
+  void PollDma();
+  /**
+   * @brief Checks and clears the overcapture flags of both channels.
+   */
+  void CheckOverruns();
+
+  /**
+   * @brief Enables or disables the timer interrupt, to protect state shared with the interrupt handler.
+   */
+  void SetIrqEnable(bool flag);
+
+  uint32_t timer_;
+  /**
+   * @brief Index of the channel which captures rising edges. Falling edges are captured by the neighbouring channel.
+   */
+  uint8_t channel_;
+  uint32_t tick_freq_ = 0;
+  /**
+   * @brief Mask of valid counter bits.
+   */
+  uint32_t counter_mask_ = 0;
+  /**
+   * @brief Mask of valid timestamp bits. Wider than the counter if timestamps are extended by counting overflows.
+   */
+  uint32_t timestamp_mask_ = 0;
+  bool use_dma_;
+  Callback callback_;
+  void* context_;
+
+  util::SpscQueue<Edge, kQueueSize> edges_;
+
+  /**
+   * @brief Number of counter overflows, for extending timestamps of 16-bit timers.
+   */
+  uint32_t overflows_ = 0;
+  uint32_t last_rising_ = 0;
+  bool has_rising_ = false;
+  uint32_t period_ = 0;
+  Pulse pulse_;
+  volatile bool pulse_updated_ = false;
+  volatile uint32_t overruns_ = 0;
+
+  std::array<std::optional<CORE_NS::Dma::Route>, 2> dma_routes_;
+  /**
+   * @brief DMA ring buffers of rising and falling edge timestamps.
+   */
+  std::array<std::array<uint32_t, kDmaRingSize>, 2> dma_rings_;
+  /**
+   * @brief Index of the next timestamp to process in each DMA ring buffer.
+   */
+  std::array<std::size_t, 2> dma_read_indices_ = {};
+
+  std::optional<CORE_NS::GPIO> gpio_;
+};
+
+#endif  // RTLIB_LIB_INPUT_CAPTURE_H_
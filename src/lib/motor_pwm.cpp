@@ -0,0 +1,280 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config/config.h"
+
+#if defined(LIB_USE_MOTORPWM) && LIB_USE_MOTORPWM > 0
+
+#include "lib/motor_pwm.h"
+
+#include <cassert>
+
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/timer.h>
+
+#include "core/timer.h"
+
+using CORE_NS::GPIO;
+using CORE_NS::Timer;
+
+namespace {
+/**
+ * @brief Index of the break input in MotorPwm#gpios_.
+ */
+constexpr std::size_t kBreakIndex = 6;
+
+constexpr tim_oc_id kOcIds[] = {TIM_OC1, TIM_OC2, TIM_OC3};
+constexpr tim_oc_id kOcnIds[] = {TIM_OC1N, TIM_OC2N, TIM_OC3N};
+
+/**
+ * @brief Hardware configuration of one motor PWM, as read from the board configuration.
+ */
+struct HwConfig {
+  uint32_t timer = 0;
+  std::array<std::optional<Pinout>, 7> pins = {};
+#if defined(STM32F1)
+  std::optional<GPIO::PriRemap> remap = std::nullopt;
+#elif defined(STM32F4)
+  GPIO::AltFn altfn = GPIO_AF0;
+#endif
+};
+
+inline HwConfig GetConfigHw(const uint8_t id) {
+  assert(id < LIB_USE_MOTORPWM);
+  HwConfig hw;
+  switch (id) {
+    default:
+      // not handled, since assert will catch this error
+      assert(false);
+      break;
+#if LIB_USE_MOTORPWM > 0
+    case 0:
+      hw.timer = LIB_MOTORPWM0_TIMER;
+      hw.pins[0] = Pinout(LIB_MOTORPWM0_CH1_PINOUT);
+      hw.pins[1] = Pinout(LIB_MOTORPWM0_CH1N_PINOUT);
+      hw.pins[2] = Pinout(LIB_MOTORPWM0_CH2_PINOUT);
+      hw.pins[3] = Pinout(LIB_MOTORPWM0_CH2N_PINOUT);
+#if defined(LIB_MOTORPWM0_CH3_PINOUT)
+      hw.pins[4] = Pinout(LIB_MOTORPWM0_CH3_PINOUT);
+      hw.pins[5] = Pinout(LIB_MOTORPWM0_CH3N_PINOUT);
+#endif  // defined(LIB_MOTORPWM0_CH3_PINOUT)
+#if defined(LIB_MOTORPWM0_BKIN_PINOUT)
+      hw.pins[kBreakIndex] = Pinout(LIB_MOTORPWM0_BKIN_PINOUT);
+#endif  // defined(LIB_MOTORPWM0_BKIN_PINOUT)
+#if defined(STM32F1) && defined(LIB_MOTORPWM0_REMAP)
+      hw.remap = LIB_MOTORPWM0_REMAP;
+#elif defined(STM32F4)
+      hw.altfn = LIB_MOTORPWM0_ALTFN;
+#endif
+      break;
+#endif  // LIB_USE_MOTORPWM > 0
+#if LIB_USE_MOTORPWM > 1
+    case 1:
+      hw.timer = LIB_MOTORPWM1_TIMER;
+      hw.pins[0] = Pinout(LIB_MOTORPWM1_CH1_PINOUT);
+      hw.pins[1] = Pinout(LIB_MOTORPWM1_CH1N_PINOUT);
+      hw.pins[2] = Pinout(LIB_MOTORPWM1_CH2_PINOUT);
+      hw.pins[3] = Pinout(LIB_MOTORPWM1_CH2N_PINOUT);
+#if defined(LIB_MOTORPWM1_CH3_PINOUT)
+      hw.pins[4] = Pinout(LIB_MOTORPWM1_CH3_PINOUT);
+      hw.pins[5] = Pinout(LIB_MOTORPWM1_CH3N_PINOUT);
+#endif  // defined(LIB_MOTORPWM1_CH3_PINOUT)
+#if defined(LIB_MOTORPWM1_BKIN_PINOUT)
+      hw.pins[kBreakIndex] = Pinout(LIB_MOTORPWM1_BKIN_PINOUT);
+#endif  // defined(LIB_MOTORPWM1_BKIN_PINOUT)
+#if defined(STM32F1) && defined(LIB_MOTORPWM1_REMAP)
+      hw.remap = LIB_MOTORPWM1_REMAP;
+#elif defined(STM32F4)
+      hw.altfn = LIB_MOTORPWM1_ALTFN;
+#endif
+      break;
+#endif  // LIB_USE_MOTORPWM > 1
+  }
+  return hw;
+}
+}  // namespace
+
+MotorPwm::MotorPwm(const Config& config) {
+  const HwConfig hw = GetConfigHw(config.id);
+  timer_ = hw.timer;
+  channels_ = hw.pins[4] ? 3 : 2;
+  center_aligned_ = config.center_aligned;
+
+  // Only advanced-control timers have complementary outputs
+  assert(Timer::IsAdvanced(timer_));
+
+  // Configure all pins as alternate function
+  for (std::size_t i = 0; i < gpios_.size(); ++i) {
+    if (!hw.pins[i]) {
+      continue;
+    }
+
+#if defined(STM32F1)
+    if (i == kBreakIndex) {
+      gpios_[i].emplace(*hw.pins[i], GPIO::Configuration::kInputFloat, GPIO::Mode::kInput);
+    } else {
+      gpios_[i].emplace(*hw.pins[i], GPIO::Configuration::kOutputAltFnPushPull, GPIO::Mode::kOutput50MHz);
+    }
+#elif defined(STM32F4)
+    gpios_[i].emplace(*hw.pins[i],
+                      GPIO::Mode::kAF,
+                      GPIO::Pullup::kNone,
+                      GPIO::Speed::k50MHz,
+                      GPIO::DriverType::kPushPull,
+                      hw.altfn);
+#endif
+  }
+
+#if defined(STM32F1)
+  if (hw.remap) {
+    rcc_periph_clock_enable(RCC_AFIO);
+    GPIO::SetPriAltFn(GPIO::JTAGDisables::kNoDisable, *hw.remap);
+  }
+#endif
+
+  Timer::InitRcc(timer_);
+
+  // Find the smallest prescaler which allows the period to fit in the 16-bit counter. Center-aligned mode counts up
+  // and down in one PWM period, so it needs twice as many ticks, and its period is written to ARR without subtracting
+  // one.
+  const uint32_t clock_freq = Timer::GetClockFreq(timer_);
+  const uint32_t ticks = clock_freq / (config.center_aligned ? 2 * config.frequency : config.frequency);
+  const uint32_t max_period = config.center_aligned ? 0xFFFF : 0x10000;
+  const uint32_t prescaler = (ticks - 1) / max_period;
+  assert(prescaler <= 0xFFFF);
+  period_ = ticks / (prescaler + 1);
+  assert(period_ <= max_period);
+
+  timer_set_mode(timer_,
+                 TIM_CR1_CKD_CK_INT,
+                 config.center_aligned ? TIM_CR1_CMS_CENTER_1 : TIM_CR1_CMS_EDGE,
+                 TIM_CR1_DIR_UP);
+  timer_set_prescaler(timer_, prescaler);
+  timer_set_period(timer_, config.center_aligned ? period_ : period_ - 1);
+  timer_enable_preload(timer_);
+
+  // Center-aligned mode generates an update event at both ends of the period. Skip one of them so that duty cycles
+  // are only updated when the counter reaches zero.
+  timer_set_repetition_counter(timer_, config.center_aligned ? 1 : 0);
+
+  for (uint8_t i = 0; i < channels_; ++i) {
+    timer_set_oc_mode(timer_, kOcIds[i], TIM_OCM_PWM1);
+    timer_enable_oc_preload(timer_, kOcIds[i]);
+    timer_set_oc_value(timer_, kOcIds[i], 0);
+
+    // Idle states are absolute pin levels, so they have to follow the polarity to turn the switches off
+    if (config.high_side_active_low) {
+      timer_set_oc_polarity_low(timer_, kOcIds[i]);
+      timer_set_oc_idle_state_set(timer_, kOcIds[i]);
+    } else {
+      timer_set_oc_polarity_high(timer_, kOcIds[i]);
+      timer_set_oc_idle_state_unset(timer_, kOcIds[i]);
+    }
+    if (config.low_side_active_low) {
+      timer_set_oc_polarity_low(timer_, kOcnIds[i]);
+      timer_set_oc_idle_state_set(timer_, kOcnIds[i]);
+    } else {
+      timer_set_oc_polarity_high(timer_, kOcnIds[i]);
+      timer_set_oc_idle_state_unset(timer_, kOcnIds[i]);
+    }
+
+    timer_enable_oc_output(timer_, kOcIds[i]);
+    timer_enable_oc_output(timer_, kOcnIds[i]);
+  }
+
+  // Dead-time generator runs at the undivided timer clock
+  const auto deadtime_ticks =
+      static_cast<uint32_t>((uint64_t{config.deadtime_ns} * clock_freq + 999999999) / 1000000000);
+  timer_set_deadtime(timer_, EncodeDeadtime(deadtime_ticks));
+
+  // Keep driving the inactive levels when the outputs are disabled, instead of leaving the gates floating
+  timer_set_enabled_off_state_in_run_mode(timer_);
+  timer_set_enabled_off_state_in_idle_mode(timer_);
+
+  if (gpios_[kBreakIndex]) {
+    if (config.break_active_high) {
+      timer_set_break_polarity_high(timer_);
+    } else {
+      timer_set_break_polarity_low(timer_);
+    }
+    timer_enable_break(timer_);
+  }
+
+  // Load the preloaded registers before starting the counter
+  timer_generate_event(timer_, TIM_EGR_UG);
+  timer_clear_flag(timer_, TIM_SR_UIF | TIM_SR_BIF);
+  timer_enable_counter(timer_);
+}
+
+void MotorPwm::SetDuty(const Channel channel, const uint32_t compare) {
+  assert(static_cast<uint8_t>(channel) < channels_);
+  timer_set_oc_value(timer_, kOcIds[static_cast<uint8_t>(channel)], compare);
+}
+
+void MotorPwm::SetDuty(const uint32_t ch1, const uint32_t ch2, const uint32_t ch3) {
+  // Inhibit update events while writing, so that all channels are latched at the same update event
+  TIM_CR1(timer_) |= TIM_CR1_UDIS;
+  TIM_CCR1(timer_) = ch1;
+  TIM_CCR2(timer_) = ch2;
+  if (channels_ > 2) {
+    TIM_CCR3(timer_) = ch3;
+  }
+  TIM_CR1(timer_) &= ~static_cast<uint32_t>(TIM_CR1_UDIS);
+}
+
+void MotorPwm::SetEnable(const bool flag) {
+  if (flag) {
+    timer_enable_break_main_output(timer_);
+  } else {
+    timer_disable_break_main_output(timer_);
+  }
+}
+
+void MotorPwm::EnableAdcTrigger(const uint32_t compare) {
+  // PWM mode 2 gives a rising edge on OC4REF when the counter reaches the compare value
+  timer_set_oc_mode(timer_, TIM_OC4, TIM_OCM_PWM2);
+  timer_enable_oc_preload(timer_, TIM_OC4);
+  timer_set_oc_value(timer_, TIM_OC4, compare);
+  timer_enable_oc_output(timer_, TIM_OC4);
+}
+
+bool MotorPwm::IsFaulted() const {
+  return timer_get_flag(timer_, TIM_SR_BIF);
+}
+
+void MotorPwm::ClearFault() {
+  timer_clear_flag(timer_, TIM_SR_BIF);
+}
+
+uint32_t MotorPwm::EncodeDeadtime(const uint32_t ticks) {
+  // See the description of the DTG field of TIMx_BDTR in the reference manual
+  if (ticks <= 127) {
+    return ticks;
+  } else if (ticks <= 2 * (64 + 63)) {
+    return 0x80 | ((ticks + 1) / 2 - 64);
+  } else if (ticks <= 8 * (32 + 31)) {
+    return 0xC0 | ((ticks + 7) / 8 - 32);
+  }
+  assert(ticks <= 16 * (32 + 31));
+  return 0xE0 | ((ticks + 15) / 16 - 32);
+}
+
+#elif !defined(LIB_USE_MOTORPWM)
+#error "LIB_USE_MOTORPWM macro not found. (Did you define it in your board configuration?)"
+#endif
@@ -0,0 +1,243 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_LIB_MOTOR_PWM_H_
+#define RTLIB_LIB_MOTOR_PWM_H_
+
+#include <array>
+#include <cstdint>
+#include <optional>
+
+#include "config/config.h"
+#include "core/gpio.h"
+
+static_assert(LIB_USE_MOTORPWM > 0, "MotorPwm library is disabled in your configuration.");
+
+/**
+ * @brief HAL implementation for complementary motor PWM outputs.
+ *
+ * This abstraction layer drives up to three half-bridges from one advanced-control timer (@c TIM1 or @c TIM8). Each
+ * channel outputs a complementary pair of signals with hardware dead-time insertion, and the break input shuts all
+ * outputs down without any CPU intervention (e.g. when an over-current comparator trips). One MotorPwm object is
+ * designed to manage one motor driver on the mainboard.
+ *
+ * All compare registers are preloaded, so new duty cycles only take effect at the next update event. In
+ * center-aligned mode, the update event happens once per PWM period when the counter reaches zero.
+ */
+class MotorPwm {
+ public:
+  /**
+   * @brief Enumeration of complementary PWM channels.
+   */
+  enum struct Channel : uint8_t {
+    /**
+     * @brief Timer channel 1, i.e. CH1 and CH1N.
+     */
+    k1 = 0,
+    /**
+     * @brief Timer channel 2, i.e. CH2 and CH2N.
+     */
+    k2,
+    /**
+     * @brief Timer channel 3, i.e. CH3 and CH3N.
+     */
+    k3
+  };
+
+  /**
+   * @brief Configuration for motor PWM.
+   */
+  struct Config {
+    /**
+     * @brief ID of the motor PWM.
+     *
+     * See your device configuration header file to see which id corresponds to which motor driver.
+     */
+    uint8_t id = 0;
+    /**
+     * @brief PWM frequency, in Hz.
+     *
+     * Defaults to 20kHz.
+     */
+    uint32_t frequency = 20000;
+    /**
+     * @brief Dead-time inserted between turning off one switch and turning on its complement, in nanoseconds.
+     *
+     * The dead-time will be rounded up to the nearest value supported by the hardware, and must not exceed 1008 timer
+     * clock ticks (14us at 72MHz). Defaults to 500ns.
+     */
+    uint32_t deadtime_ns = 500;
+    /**
+     * @brief If true, the counter counts up and down, generating symmetric PWM.
+     *
+     * Center-aligned PWM halves the switching harmonics, and is required for sampling phase currents at the center of
+     * the PWM period.
+     */
+    bool center_aligned = true;
+    /**
+     * @brief If true, the high-side outputs (CHx) are active low.
+     */
+    bool high_side_active_low = false;
+    /**
+     * @brief If true, the low-side outputs (CHxN) are active low.
+     */
+    bool low_side_active_low = false;
+    /**
+     * @brief If true, the break input trips on logic high. Otherwise the break input trips on logic low.
+     */
+    bool break_active_high = false;
+  };
+
+  /**
+   * @brief Default constructor for motor PWM.
+   *
+   * All outputs will be in their inactive state after the constructor is called. Call SetEnable() to start driving
+   * the motor.
+   *
+   * @param config Motor PWM configuration
+   */
+  explicit MotorPwm(const Config& config);
+
+  /**
+   * @brief Default destructor.
+   */
+  ~MotorPwm() = default;
+
+  /**
+   * @brief Move constructor for motor PWM.
+   *
+   * @param other MotorPwm object to move from
+   */
+  MotorPwm(MotorPwm&& other) noexcept = default;
+  /**
+   * @brief Move assignment operator for motor PWM.
+   *
+   * @param other MotorPwm object to move from
+   * @return Reference to the moved motor PWM.
+   */
+  MotorPwm& operator=(MotorPwm&& other) noexcept = default;
+
+  /**
+   * @brief Copy constructor for motor PWM.
+   *
+   * This constructor is deleted because there should only be one object managing each motor driver, similar to @c
+   * std::unique_ptr.
+   */
+  MotorPwm(const MotorPwm&) = delete;
+  /**
+   * @brief Copy assignment operator for motor PWM.
+   *
+   * This constructor is deleted because there should only be one object managing each motor driver, similar to @c
+   * std::unique_ptr.
+   */
+  MotorPwm& operator=(const MotorPwm&) = delete;
+
+  /**
+   * @brief Retrieves the compare value which corresponds to 100% duty cycle.
+   *
+   * @return Timer period, in timer ticks.
+   */
+  uint32_t GetPeriod() const { return period_; }
+  /**
+   * @return @c true if the timer generates center-aligned PWM.
+   */
+  bool IsCenterAligned() const { return center_aligned_; }
+
+  /**
+   * @brief Sets the duty cycle of one channel.
+   *
+   * The new duty cycle will be applied at the next update event.
+   *
+   * @param channel Channel to modify
+   * @param compare Duty cycle, from 0 (always low-side on) to GetPeriod() (always high-side on).
+   */
+  void SetDuty(Channel channel, uint32_t compare);
+  /**
+   * @brief Sets the duty cycle of all channels.
+   *
+   * As opposed to SetDuty(Channel,uint32_t), this function guarantees that all channels apply their new duty cycle at
+   * the same update event.
+   *
+   * @param ch1 Duty cycle of channel 1
+   * @param ch2 Duty cycle of channel 2
+   * @param ch3 Duty cycle of channel 3. Ignored if the channel is not present.
+   */
+  void SetDuty(uint32_t ch1, uint32_t ch2, uint32_t ch3 = 0);
+
+  /**
+   * @brief Enables or disables all outputs.
+   *
+   * Disabling the outputs puts all switches in their inactive state.
+   *
+   * @param flag True if the outputs should be enabled
+   */
+  void SetEnable(bool flag);
+
+  /**
+   * @brief Checks whether the break input has tripped.
+   *
+   * Once the break input trips, all outputs stay disabled until ClearFault() is called.
+   *
+   * @return @c true if the break input has tripped since the last ClearFault().
+   */
+  bool IsFaulted() const;
+  /**
+   * @brief Clears the break flag.
+   *
+   * @note The outputs will not be enabled automatically. Call SetEnable() to re-enable the outputs.
+   */
+  void ClearFault();
+
+  /**
+   * @brief Enables channel 4 as a trigger source for ADC conversions.
+   *
+   * Channel 4 is not connected to any pin. Its compare event is used to start ADC conversions at a fixed point of the
+   * PWM period, e.g. the injected conversions of CurrentSense. In center-aligned mode, a compare value just below
+   * GetPeriod() places the conversion at the center of the PWM period.
+   *
+   * @param compare Counter value at which the trigger fires
+   */
+  void EnableAdcTrigger(uint32_t compare);
+
+  /**
+   * @return Timer which generates the PWM signals.
+   */
+  uint32_t GetTimer() const { return timer_; }
+
+ private:
+  /**
+   * @brief Encodes a dead-time into the DTG field of the @c TIMx_BDTR register.
+   *
+   * @param ticks Dead-time in timer clock ticks. Must not exceed 1008.
+   * @return DTG field which gives the shortest dead-time not shorter than @p ticks.
+   */
+  static uint32_t EncodeDeadtime(uint32_t ticks);
+
+  uint32_t timer_;
+  uint8_t channels_;
+  uint32_t period_ = 0;
+  bool center_aligned_ = true;
+
+  /**
+   * @brief GPIOs managed by this object, in the order of CH1/CH1N/CH2/CH2N/CH3/CH3N/BKIN.
+   */
+  std::array<std::optional<CORE_NS::GPIO>, 7> gpios_;
+};
+
+#endif  // RTLIB_LIB_MOTOR_PWM_H_
@@ -0,0 +1,98 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config/config.h"
+
+#if defined(LIB_USE_PARAMSTORE) && LIB_USE_PARAMSTORE > 0
+
+#include "lib/param_store.h"
+
+#include <cassert>
+
+#include "core/flash.h"
+
+using CORE_NS::Flash;
+
+namespace {
+/**
+ * @brief Hardware configuration of one flash region, as read from the board configuration.
+ */
+struct HwConfig {
+  uint32_t address = 0;
+  uint32_t sector_size = 0;
+  uint8_t num_sectors = 0;
+};
+
+inline HwConfig GetConfigHw(const uint8_t id) {
+  assert(id < LIB_USE_PARAMSTORE);
+  HwConfig hw;
+  switch (id) {
+    default:
+      // not handled, since assert will catch this error
+      assert(false);
+      break;
+#if LIB_USE_PARAMSTORE > 0
+    case 0:
+      hw.address = LIB_PARAMSTORE0_ADDRESS;
+      hw.sector_size = LIB_PARAMSTORE0_SECTOR_SIZE;
+      hw.num_sectors = LIB_PARAMSTORE0_NUM_SECTORS;
+      break;
+#endif  // LIB_USE_PARAMSTORE > 0
+#if LIB_USE_PARAMSTORE > 1
+    case 1:
+      hw.address = LIB_PARAMSTORE1_ADDRESS;
+      hw.sector_size = LIB_PARAMSTORE1_SECTOR_SIZE;
+      hw.num_sectors = LIB_PARAMSTORE1_NUM_SECTORS;
+      break;
+#endif  // LIB_USE_PARAMSTORE > 1
+  }
+  return hw;
+}
+}  // namespace
+
+ParamStore::FlashBackend::FlashBackend(const uint8_t id) {
+  const HwConfig hw = GetConfigHw(id);
+  address_ = hw.address;
+  sector_size_ = hw.sector_size;
+  num_sectors_ = hw.num_sectors;
+}
+
+const uint8_t* ParamStore::FlashBackend::GetSector(const uint8_t sector) const {
+  assert(sector < num_sectors_);
+  return reinterpret_cast<const uint8_t*>(address_ + sector * sector_size_);
+}
+
+void ParamStore::FlashBackend::Program(const uint8_t sector,
+                                       const uint32_t offset,
+                                       const uint32_t* data,
+                                       const std::size_t count) {
+  assert(sector < num_sectors_);
+  Flash::Program(address_ + sector * sector_size_ + offset, data, count);
+}
+
+void ParamStore::FlashBackend::Erase(const uint8_t sector) {
+  assert(sector < num_sectors_);
+  Flash::Erase(address_ + sector * sector_size_);
+}
+
+ParamStore::ParamStore(const Config& config) : backend_(config.id), store_(backend_) {}
+
+#elif !defined(LIB_USE_PARAMSTORE)
+#error "LIB_USE_PARAMSTORE macro not found. (Did you define it in your board configuration?)"
+#endif
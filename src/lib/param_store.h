@@ -0,0 +1,200 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_LIB_PARAM_STORE_H_
+#define RTLIB_LIB_PARAM_STORE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "config/config.h"
+#include "util/kv_store.h"
+
+static_assert(LIB_USE_PARAMSTORE > 0, "ParamStore library is disabled in your configuration.");
+
+/**
+ * @brief HAL implementation for a persistent parameter store in internal flash.
+ *
+ * This abstraction layer stores parameters such as controller gains and calibration values in a region of internal
+ * flash reserved by the board configuration, using util::KvStore. Parameters are identified by numeric keys, and are
+ * read from a RAM index without searching flash.
+ *
+ * Writing a parameter only programs a few words of flash. Sectors are erased by Maintain(), which should be called
+ * when the CPU can afford to stall, e.g. while motors are disabled: programs execute from the same flash bank, so the
+ * CPU is halted for the whole erase (up to about a second for 128KB sectors of STM32F4xx devices).
+ *
+ * One ParamStore object is designed to manage one flash region. The region must not overlap the firmware.
+ */
+class ParamStore {
+ public:
+  /**
+   * @brief Configuration for parameter store.
+   */
+  struct Config {
+    /**
+     * @brief ID of the parameter store.
+     *
+     * See your device configuration header file to see which id corresponds to which flash region.
+     */
+    uint8_t id = 0;
+  };
+
+  /**
+   * @brief Default constructor for parameter store.
+   *
+   * Scans the flash region to rebuild the index of parameters.
+   *
+   * @param config Parameter store configuration
+   */
+  explicit ParamStore(const Config& config);
+
+  /**
+   * @brief Default trivial destructor.
+   */
+  ~ParamStore() = default;
+
+  /**
+   * @brief Move constructor for parameter store.
+   *
+   * This constructor is deleted because the store refers to its flash backend.
+   */
+  ParamStore(ParamStore&&) = delete;
+  /**
+   * @brief Move assignment operator for parameter store.
+   *
+   * This operator is deleted because the store refers to its flash backend.
+   */
+  ParamStore& operator=(ParamStore&&) = delete;
+
+  /**
+   * @brief Copy constructor for parameter store.
+   *
+   * This constructor is deleted because there should only be one object managing each flash region.
+   */
+  ParamStore(const ParamStore&) = delete;
+  /**
+   * @brief Copy assignment operator for parameter store.
+   *
+   * This operator is deleted because there should only be one object managing each flash region.
+   */
+  ParamStore& operator=(const ParamStore&) = delete;
+
+  /**
+   * @param key Key to query
+   * @return @c true if @p key has a value.
+   */
+  bool Contains(uint16_t key) const { return store_.Contains(key); }
+  /**
+   * @param key Key to query
+   * @return Size of the value of @p key, or 0 if @p key has no value.
+   */
+  uint16_t GetSize(uint16_t key) const { return store_.GetSize(key); }
+
+  /**
+   * @brief Reads a parameter.
+   *
+   * @param key Key to read
+   * @param data Buffer to store the value
+   * @param size Size of @p data
+   * @return @c true if @p key has a value.
+   */
+  bool Read(uint16_t key, void* data, std::size_t size) const { return store_.Read(key, data, size); }
+  /**
+   * @brief Reads a parameter into an object.
+   *
+   * @tparam T Trivially copyable type
+   * @param key Key to read
+   * @param value Object to store the value
+   * @return @c true if @p key has a value of the same size as @p T.
+   */
+  template<typename T>
+  bool Read(uint16_t key, T& value) const { return store_.Read(key, value); }
+
+  /**
+   * @brief Writes a parameter.
+   *
+   * Nothing is written if the value is unchanged.
+   *
+   * @param key Key to write
+   * @param data Value to write
+   * @param size Size of the value
+   * @return @c true if the value is written. @c false if the store is out of space, in which case Maintain() should be
+   * called before retrying.
+   */
+  bool Write(uint16_t key, const void* data, std::size_t size) { return store_.Write(key, data, size); }
+  /**
+   * @brief Writes a parameter from an object.
+   *
+   * @tparam T Trivially copyable type
+   * @param key Key to write
+   * @param value Object to write
+   * @return @c true if the value is written.
+   */
+  template<typename T>
+  bool Write(uint16_t key, const T& value) { return store_.Write(key, value); }
+
+  /**
+   * @brief Removes a parameter.
+   *
+   * @param key Key to remove
+   * @return @c true if the key is removed or has no value.
+   */
+  bool Remove(uint16_t key) { return store_.Remove(key); }
+
+  /**
+   * @return @c true if Maintain() should be called to free up space.
+   */
+  bool IsMaintenanceNeeded() const { return store_.IsMaintenanceNeeded(); }
+  /**
+   * @brief Performs one step of compacting the flash region.
+   *
+   * @warning This function may erase a flash sector, which stalls the CPU including all interrupts.
+   *
+   * @return @c true if more maintenance is needed.
+   */
+  bool Maintain() { return store_.Maintain(); }
+
+ private:
+  /**
+   * @brief Backend which maps the store onto internal flash.
+   */
+  class FlashBackend final : public util::KvStore::Backend {
+   public:
+    /**
+     * @param id ID of the flash region in the board configuration
+     */
+    explicit FlashBackend(uint8_t id);
+
+    uint8_t GetNumSectors() const override { return num_sectors_; }
+    uint32_t GetSectorSize() const override { return sector_size_; }
+    const uint8_t* GetSector(uint8_t sector) const override;
+    void Program(uint8_t sector, uint32_t offset, const uint32_t* data, std::size_t count) override;
+    void Erase(uint8_t sector) override;
+
+   private:
+    uint32_t address_;
+    uint32_t sector_size_;
+    uint8_t num_sectors_;
+  };
+
+  FlashBackend backend_;
+  util::KvStore store_;
+};
+
+#endif  // RTLIB_LIB_PARAM_STORE_H_
@@ -0,0 +1,230 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config/config.h"
+
+#if defined(LIB_USE_POWERMANAGER) && LIB_USE_POWERMANAGER > 0
+
+#include "lib/power_manager.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/cm3/scb.h>
+#include <libopencm3/stm32/pwr.h>
+#include <libopencm3/stm32/rcc.h>
+
+#include "core/gpio.h"
+#include "lib/system.h"
+#if LIB_USE_RTC > 0
+#include "lib/rtc.h"
+#endif  // LIB_USE_RTC > 0
+#if LIB_USE_WATCHDOG > 0
+#include "lib/watchdog.h"
+#endif  // LIB_USE_WATCHDOG > 0
+
+using CORE_NS::Exti;
+using CORE_NS::GPIO;
+
+#if LIB_USE_RTC > 0
+namespace {
+/**
+ * @brief Sets an alarm again after it was set aside for stop mode.
+ */
+void RestoreAlarm(Rtc& rtc, const std::optional<Rtc::Alarm>& alarm) {
+  if (!alarm) {
+    return;
+  }
+
+  // The saved alarm expires after the deadline alarm, but may have been reached while waking up, in which case it
+  // expires in the next second rather than never
+  const uint32_t time = std::max(alarm->time, rtc.GetTime() + 1);
+  rtc.SetAlarm(time, alarm->callback, alarm->context);
+}
+}  // namespace
+#endif  // LIB_USE_RTC > 0
+
+PowerManager::PowerManager(const Config& config) :
+    rtc_(config.rtc),
+    min_stop_ms_(config.min_stop_ms),
+    watchdog_(config.watchdog),
+    priority_(config.priority) {
+#if LIB_USE_RTC > 0
+  assert(min_stop_ms_ >= 1000);
+#else
+  assert(rtc_ == nullptr);
+#endif  // LIB_USE_RTC > 0
+#if LIB_USE_WATCHDOG == 0
+  assert(watchdog_ == nullptr);
+#endif  // LIB_USE_WATCHDOG == 0
+
+  // Stop mode is selected by SLEEPDEEP, so these settings have no effect on sleep mode
+  rcc_periph_clock_enable(RCC_PWR);
+  pwr_set_stop_mode();
+  pwr_voltage_regulator_low_power_in_stop();
+}
+
+PowerManager::~PowerManager() {
+  for (const WakePin& wake_pin : wake_pins_) {
+    if (wake_pin.pin.second != 0) {
+      Exti::SetIrqHandler(wake_pin.pin, Exti::Trigger::kRising, nullptr);
+    }
+  }
+}
+
+bool PowerManager::AddWakePin(const Pinout& pin,
+                              const Exti::Trigger trigger,
+                              const Callback callback,
+                              void* context) {
+  assert(pin.second != 0);
+  WakePin& wake_pin = wake_pins_[static_cast<std::size_t>(__builtin_ctz(pin.second))];
+  if (wake_pin.pin.second != 0) {
+    return false;
+  }
+
+  wake_pin.pin = pin;
+  wake_pin.callback = callback;
+  wake_pin.context = context;
+  if (!Exti::SetIrqHandler(pin, trigger, &HandleWakePin, &wake_pin, priority_)) {
+    wake_pin = {};
+    return false;
+  }
+  ++num_wake_pins_;
+  return true;
+}
+
+void PowerManager::RemoveWakePin(const Pinout& pin) {
+  assert(pin.second != 0);
+  WakePin& wake_pin = wake_pins_[static_cast<std::size_t>(__builtin_ctz(pin.second))];
+  if (wake_pin.pin != pin) {
+    return;
+  }
+
+  Exti::SetIrqHandler(pin, Exti::Trigger::kRising, nullptr);
+  wake_pin = {};
+  --num_wake_pins_;
+}
+
+PowerManager::Mode PowerManager::SelectMode(const uint64_t deadline_ms) const {
+  if (stop_locks_ > 0) {
+    return Mode::kSleep;
+  }
+
+  const uint64_t limited_ms = LimitDeadline(deadline_ms);
+
+  if (limited_ms == kNoDeadline) {
+    // Without any EXTI wake source, the device would never leave stop mode
+    bool has_alarm = false;
+#if LIB_USE_RTC > 0
+    has_alarm = rtc_ != nullptr && rtc_->IsAlarmPending();
+#endif  // LIB_USE_RTC > 0
+    return num_wake_pins_ > 0 || has_alarm ? Mode::kStop : Mode::kSleep;
+  }
+
+  if (rtc_ == nullptr) {
+    return Mode::kSleep;
+  }
+  const uint64_t now_ms = System::GetMs();
+  return limited_ms > now_ms && limited_ms - now_ms >= min_stop_ms_ ? Mode::kStop : Mode::kSleep;
+}
+
+PowerManager::Mode PowerManager::Idle(const uint64_t deadline_ms) {
+  // WFI still wakes up on interrupts which are masked, so masking closes the race between selecting the mode and
+  // entering it, and delays the handlers until the clocks are restored
+  const bool masked = cm_mask_interrupts(true);
+
+  Mode mode = SelectMode(deadline_ms);
+  if (mode == Mode::kStop && !EnterStop(LimitDeadline(deadline_ms))) {
+    mode = Mode::kSleep;
+  }
+  if (mode == Mode::kSleep) {
+    __asm__("wfi");
+  }
+
+  cm_mask_interrupts(masked);
+  return mode;
+}
+
+void PowerManager::HandleWakePin(void* context) {
+  const WakePin& wake_pin = *static_cast<WakePin*>(context);
+  if (wake_pin.callback != nullptr) {
+    wake_pin.callback(wake_pin.context);
+  }
+}
+
+bool PowerManager::EnterStop(const uint64_t deadline_ms) {
+#if LIB_USE_RTC > 0
+  bool uses_alarm = false;
+  std::optional<Rtc::Alarm> saved_alarm;
+  if (rtc_ != nullptr) {
+    if (deadline_ms != kNoDeadline) {
+      // The alarm has one-second resolution, so wake up at the last full second before the deadline
+      const uint64_t wake_ms = rtc_->GetTimeMs() + (deadline_ms - System::GetMs());
+      const auto wake_time = static_cast<uint32_t>(wake_ms / 1000);
+
+      // An alarm which expires first already wakes the device up in time
+      const std::optional<Rtc::Alarm> alarm = rtc_->GetAlarm();
+      if (!alarm || alarm->time > wake_time) {
+        saved_alarm = alarm;
+        if (!rtc_->SetAlarm(wake_time)) {
+          RestoreAlarm(*rtc_, saved_alarm);
+          return false;
+        }
+        uses_alarm = true;
+      }
+    }
+    rtc_->Suspend();
+  }
+#else
+  static_cast<void>(deadline_ms);
+#endif  // LIB_USE_RTC > 0
+
+  SCB_SCR |= SCB_SCR_SLEEPDEEP;
+  __asm__("wfi");
+  SCB_SCR &= ~static_cast<uint32_t>(SCB_SCR_SLEEPDEEP);
+
+  // The device wakes up running from the internal oscillator
+  GPIO::InitSysClock();
+
+#if LIB_USE_RTC > 0
+  if (rtc_ != nullptr) {
+    rtc_->Resume();
+    if (uses_alarm) {
+      // Also discards the pending interrupt of the deadline alarm, since it has no callback
+      rtc_->CancelAlarm();
+      RestoreAlarm(*rtc_, saved_alarm);
+    }
+  }
+#endif  // LIB_USE_RTC > 0
+  return true;
+}
+
+uint64_t PowerManager::LimitDeadline(const uint64_t deadline_ms) const {
+#if LIB_USE_WATCHDOG > 0
+  if (watchdog_ != nullptr) {
+    return std::min(deadline_ms, watchdog_->GetRefreshDeadline());
+  }
+#endif  // LIB_USE_WATCHDOG > 0
+  return deadline_ms;
+}
+
+#elif !defined(LIB_USE_POWERMANAGER)
+#error "LIB_USE_POWERMANAGER macro not found. (Did you define it in your board configuration?)"
+#endif
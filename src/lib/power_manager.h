@@ -0,0 +1,254 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_LIB_POWER_MANAGER_H_
+#define RTLIB_LIB_POWER_MANAGER_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+
+#include "config/config.h"
+#include "core/exti.h"
+#include "core/util.h"
+
+static_assert(LIB_USE_POWERMANAGER > 0, "PowerManager library is disabled in your configuration.");
+
+class Rtc;
+class Watchdog;
+
+/**
+ * @brief Power management for idle periods.
+ *
+ * Idle() puts the device into the deepest low-power mode which is safe at the time of the call:
+ *
+ * - In sleep mode, only the CPU is stopped. Every interrupt wakes the device, including SysTick, so this mode is always
+ *   safe.
+ * - In stop mode, all clocks except the low-speed oscillators are stopped. Only EXTI lines wake the device, i.e. the
+ *   pins registered with AddWakePin() and the RTC alarm. The PLL is restored after waking up, and the time spent in
+ *   stop mode is added to the System clock using the RTC.
+ *
+ * Stop mode is only used when something will wake the device: either a wake pin or RTC alarm is registered, or the
+ * deadline is far enough away to be reached by the one-second RTC alarm. Peripherals which need their clocks to keep
+ * running (e.g. a UART which is receiving, a running ControlLoop) must hold LockStop() while they are active.
+ *
+ * The independent watchdog keeps running in stop mode. If a Watchdog is given, every deadline is limited to its refresh
+ * deadline, so that Idle() returns in time for Watchdog::Service() to be called.
+ *
+ * Clocks of GPIO ports are gated by the GPIO objects themselves, so ports which have no pins in use do not draw
+ * current in run and sleep mode.
+ *
+ * There should only be one PowerManager object.
+ */
+class PowerManager {
+ public:
+  /**
+   * @brief Deadline value which indicates that there is no deadline.
+   */
+  static constexpr uint64_t kNoDeadline = std::numeric_limits<uint64_t>::max();
+
+  /**
+   * @brief Enumeration of low-power modes.
+   */
+  enum struct Mode {
+    /**
+     * @brief Sleep mode. Only the CPU is stopped.
+     */
+    kSleep,
+    /**
+     * @brief Stop mode. All high-speed clocks are stopped.
+     */
+    kStop
+  };
+
+  /**
+   * @brief Type definition for wake pin callbacks.
+   *
+   * @param context User-defined pointer, as passed to AddWakePin().
+   */
+  using Callback = void (*)(void* context);
+
+  /**
+   * @brief Configuration for power management.
+   */
+  struct Config {
+    /**
+     * @brief RTC which wakes the device at deadlines, and measures the time spent in stop mode.
+     *
+     * If @c nullptr, stop mode is only used when no deadline is given, and the System clock does not advance while in
+     * stop mode.
+     */
+    Rtc* rtc = nullptr;
+    /**
+     * @brief Shortest time until the deadline for which stop mode is used, in milliseconds.
+     *
+     * The RTC alarm wakes the device up to one second before the deadline, after which sleep mode is used, so this
+     * value must be at least 1000.
+     */
+    uint32_t min_stop_ms = 2000;
+    /**
+     * @brief Watchdog which must be serviced while idling, or @c nullptr.
+     */
+    Watchdog* watchdog = nullptr;
+    /**
+     * @brief Priority of the wake pin interrupts.
+     */
+    uint8_t priority = 0x80;
+  };
+
+  /**
+   * @brief Default constructor for power management.
+   *
+   * @param config Power management configuration
+   */
+  explicit PowerManager(const Config& config);
+
+  /**
+   * @brief Destructor.
+   *
+   * Removes all wake pins.
+   */
+  ~PowerManager();
+
+  /**
+   * @brief Move constructor for power management.
+   *
+   * This constructor is deleted because the interrupt handlers refer to this object.
+   */
+  PowerManager(PowerManager&&) = delete;
+  /**
+   * @brief Move assignment operator for power management.
+   *
+   * This operator is deleted because the interrupt handlers refer to this object.
+   */
+  PowerManager& operator=(PowerManager&&) = delete;
+
+  /**
+   * @brief Copy constructor for power management.
+   *
+   * This constructor is deleted because there should only be one object managing the power modes.
+   */
+  PowerManager(const PowerManager&) = delete;
+  /**
+   * @brief Copy assignment operator for power management.
+   *
+   * This operator is deleted because there should only be one object managing the power modes.
+   */
+  PowerManager& operator=(const PowerManager&) = delete;
+
+  /**
+   * @brief Registers a pin whose edge wakes the device from stop mode.
+   *
+   * The pin must be configured as an input by another object, e.g. a Button, or the RX pin of a UART so that incoming
+   * data wakes the device. In the latter case, the first bytes are lost while the clocks are restarted. The EXTI line
+   * of the pin must not be used by other drivers.
+   *
+   * @param pin MCU pinout
+   * @param trigger Edge which wakes the device
+   * @param callback Function to invoke from the EXTI interrupt, or @c nullptr
+   * @param context User-defined pointer which will be passed to @p callback
+   * @return @c true if the pin is registered, @c false if another wake pin or a pin of another port uses the same EXTI
+   * line.
+   */
+  bool AddWakePin(const Pinout& pin,
+                  CORE_NS::Exti::Trigger trigger,
+                  Callback callback = nullptr,
+                  void* context = nullptr);
+  /**
+   * @brief Unregisters a wake pin.
+   *
+   * @param pin MCU pinout, as passed to AddWakePin()
+   */
+  void RemoveWakePin(const Pinout& pin);
+
+  /**
+   * @brief Prevents stop mode until UnlockStop() is called.
+   *
+   * Calls are counted, so each user can lock and unlock independently. This function can also be called from
+   * interrupt handlers.
+   */
+  void LockStop() { ++stop_locks_; }
+  /**
+   * @brief Releases a lock acquired by LockStop().
+   */
+  void UnlockStop() { --stop_locks_; }
+
+  /**
+   * @brief Selects the deepest low-power mode which is safe.
+   *
+   * @param deadline_ms System time at which the device must be awake, in milliseconds
+   * @return Mode which Idle() would enter.
+   */
+  Mode SelectMode(uint64_t deadline_ms = kNoDeadline) const;
+
+  /**
+   * @brief Idles until an interrupt occurs, in the deepest low-power mode which is safe.
+   *
+   * The device may wake up before the deadline, so this function should be called in a loop which checks for pending
+   * work. Interrupts which occur while the device is entering the low-power mode are not missed, and their handlers
+   * only run after the clocks are restored.
+   *
+   * @param deadline_ms System time at which the device must be awake, in milliseconds. If a deadline is given and stop
+   * mode is entered, an RTC alarm which expires after the deadline is set aside while in stop mode, and is restored
+   * with its callback after waking up.
+   * @return Mode which was entered.
+   */
+  Mode Idle(uint64_t deadline_ms = kNoDeadline);
+
+ private:
+  /**
+   * @brief Registration of one wake pin.
+   */
+  struct WakePin {
+    Pinout pin = {};
+    Callback callback = nullptr;
+    void* context = nullptr;
+  };
+
+  static void HandleWakePin(void* context);
+
+  /**
+   * @brief Enters stop mode, and restores the clocks after waking up.
+   *
+   * @param deadline_ms System time at which the device must be awake, in milliseconds
+   * @return @c false if stop mode is not entered, because the RTC alarm cannot be set before the deadline.
+   */
+  bool EnterStop(uint64_t deadline_ms);
+
+  /**
+   * @return The earlier of @p deadline_ms and the refresh deadline of the watchdog.
+   */
+  uint64_t LimitDeadline(uint64_t deadline_ms) const;
+
+  Rtc* rtc_;
+  uint32_t min_stop_ms_;
+  Watchdog* watchdog_;
+  uint8_t priority_;
+
+  /**
+   * @brief Wake pins indexed by EXTI line.
+   */
+  std::array<WakePin, 16> wake_pins_ = {};
+  uint8_t num_wake_pins_ = 0;
+
+  std::atomic<uint8_t> stop_locks_ = 0;
+};
+
+#endif  // RTLIB_LIB_POWER_MANAGER_H_
@@ -0,0 +1,87 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config/config.h"
+
+#if defined(LIB_USE_PPM) && LIB_USE_PPM > 0
+
+#include "lib/ppm.h"
+
+#include "lib/system.h"
+
+Ppm::Ppm(const Config& config) :
+    sync_gap_us_(config.sync_gap_us),
+    min_channels_(config.min_channels),
+    input_capture_(GetInputCaptureConfig(config, this)) {}
+
+InputCapture::Config Ppm::GetInputCaptureConfig(const Config& config, Ppm* ppm) {
+  InputCapture::Config ic_config;
+  ic_config.id = config.input_capture_id;
+  ic_config.callback = &HandleEdge;
+  ic_config.context = ppm;
+  return ic_config;
+}
+
+void Ppm::HandleEdge(const InputCapture::Edge& edge, void* context) {
+  // Channel values are measured between rising edges, so that the polarity of the pulses does not matter
+  if (edge.rising) {
+    static_cast<Ppm*>(context)->DecodeEdge(edge.timestamp);
+  }
+}
+
+void Ppm::DecodeEdge(const uint32_t timestamp) {
+  if (!has_rising_) {
+    last_rising_ = timestamp;
+    has_rising_ = true;
+    return;
+  }
+
+  const uint32_t interval_us = input_capture_.TicksToNs(input_capture_.GetElapsed(last_rising_, timestamp)) / 1000;
+  last_rising_ = timestamp;
+
+  if (interval_us >= sync_gap_us_) {
+    if (frame_valid_ && frame_.num_channels >= min_channels_) {
+      frame_.timestamp = System::GetMs();
+      frames_.Write(frame_);
+    } else if (frame_valid_) {
+      errors_ = errors_ + 1;
+    }
+
+    frame_ = {};
+    frame_valid_ = true;
+    return;
+  }
+
+  if (!frame_valid_) {
+    return;
+  }
+
+  if (interval_us < kMinPulseUs || interval_us > kMaxPulseUs || frame_.num_channels >= RcFrame::kMaxChannels) {
+    // Discard the rest of the frame until the next synchronization gap
+    errors_ = errors_ + 1;
+    frame_valid_ = false;
+    return;
+  }
+
+  frame_.channels[frame_.num_channels++] = static_cast<uint16_t>(interval_us);
+}
+
+#elif !defined(LIB_USE_PPM)
+#error "LIB_USE_PPM macro not found. (Did you define it in your board configuration?)"
+#endif
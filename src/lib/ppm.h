@@ -0,0 +1,161 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_LIB_PPM_H_
+#define RTLIB_LIB_PPM_H_
+
+#include <cstdint>
+
+#include "config/config.h"
+#include "lib/input_capture.h"
+#include "lib/rc_frame.h"
+#include "util/double_buffer.h"
+
+static_assert(LIB_USE_PPM > 0, "PPM library is disabled in your configuration.");
+
+/**
+ * @brief Decoder for PPM (pulse-position modulated) RC receivers.
+ *
+ * A PPM frame is a train of pulses, where each channel value is the time between the rising edges of two consecutive
+ * pulses, and frames are separated by a long gap without pulses. Edges are timestamped by an InputCapture timer, and
+ * each edge is decoded from the capture interrupt, so a frame is published to a double buffer as soon as its
+ * synchronization gap is detected.
+ *
+ * PPM has no failsafe indication; receivers either stop sending pulses or send preset values when the transmitter is
+ * lost. Use RcFrame#timestamp to detect the former.
+ */
+class Ppm {
+ public:
+  /**
+   * @brief Configuration for PPM.
+   */
+  struct Config {
+    /**
+     * @brief ID of the input capture timer which the receiver is connected to.
+     *
+     * The input capture timer must not be used by any other object.
+     */
+    uint8_t input_capture_id = 0;
+    /**
+     * @brief Minimum time between rising edges which marks the end of a frame, in microseconds. Defaults to 3000us.
+     */
+    uint32_t sync_gap_us = 3000;
+    /**
+     * @brief Minimum number of channels in a valid frame. Defaults to 4.
+     */
+    uint8_t min_channels = 4;
+  };
+
+  /**
+   * @brief Default constructor for PPM.
+   *
+   * Decoding starts immediately.
+   *
+   * @param config PPM configuration
+   */
+  explicit Ppm(const Config& config);
+
+  /**
+   * @brief Default destructor.
+   */
+  ~Ppm() = default;
+
+  /**
+   * @brief Move constructor for PPM.
+   *
+   * This constructor is deleted because the interrupt handler refers to this object.
+   */
+  Ppm(Ppm&&) = delete;
+  /**
+   * @brief Move assignment operator for PPM.
+   *
+   * This operator is deleted because the interrupt handler refers to this object.
+   */
+  Ppm& operator=(Ppm&&) = delete;
+
+  /**
+   * @brief Copy constructor for PPM.
+   *
+   * This constructor is deleted because there should only be one object managing each PPM receiver.
+   */
+  Ppm(const Ppm&) = delete;
+  /**
+   * @brief Copy assignment operator for PPM.
+   *
+   * This operator is deleted because there should only be one object managing each PPM receiver.
+   */
+  Ppm& operator=(const Ppm&) = delete;
+
+  /**
+   * @brief Reads the latest frame.
+   *
+   * This function must only be called from one context.
+   *
+   * @param frame Reference to store the frame
+   * @return @c true if a new frame has been received since the last call.
+   */
+  bool Read(RcFrame& frame) { return frames_.Read(frame); }
+
+  /**
+   * @return Number of frames received since construction.
+   */
+  uint32_t GetFrameCount() const { return frames_.GetSequence(); }
+  /**
+   * @return Number of malformed frames, which were discarded.
+   */
+  uint32_t GetErrorCount() const { return errors_; }
+
+ private:
+  /**
+   * @brief Shortest and longest accepted channel pulse, in microseconds.
+   */
+  static constexpr uint32_t kMinPulseUs = 700;
+  static constexpr uint32_t kMaxPulseUs = 2300;
+
+  static InputCapture::Config GetInputCaptureConfig(const Config& config, Ppm* ppm);
+  static void HandleEdge(const InputCapture::Edge& edge, void* context);
+  /**
+   * @brief Decodes a rising edge.
+   */
+  void DecodeEdge(uint32_t timestamp);
+
+  uint32_t sync_gap_us_;
+  uint8_t min_channels_;
+
+  /**
+   * @brief Frame being decoded.
+   */
+  RcFrame frame_;
+  /**
+   * @brief Whether the frame being decoded is valid. Frames are invalid until the first synchronization gap.
+   */
+  bool frame_valid_ = false;
+  uint32_t last_rising_ = 0;
+  bool has_rising_ = false;
+
+  util::DoubleBuffer<RcFrame> frames_;
+  volatile uint32_t errors_ = 0;
+
+  /**
+   * @brief Input capture timer. Declared last, so that the decoder state is initialized before capturing starts.
+   */
+  InputCapture input_capture_;
+};
+
+#endif  // RTLIB_LIB_PPM_H_
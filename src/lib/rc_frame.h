@@ -0,0 +1,62 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_LIB_RC_FRAME_H_
+#define RTLIB_LIB_RC_FRAME_H_
+
+#include <array>
+#include <cstdint>
+
+/**
+ * @brief Data structure of a decoded RC receiver frame.
+ *
+ * This structure is shared by all RC receiver decoders (Sbus and Ppm), so that control code does not depend on the
+ * protocol of the receiver.
+ */
+struct RcFrame {
+  /**
+   * @brief Maximum number of channels in a frame.
+   */
+  static constexpr uint8_t kMaxChannels = 18;
+
+  /**
+   * @brief Channel values as pulse widths in microseconds, nominally from 1000 to 2000 with 1500 at the center.
+   *
+   * Only the first @c num_channels values are valid.
+   */
+  std::array<uint16_t, kMaxChannels> channels = {};
+  /**
+   * @brief Number of valid channels.
+   */
+  uint8_t num_channels = 0;
+  /**
+   * @brief Whether the receiver has lost the transmitter and reports failsafe values.
+   */
+  bool failsafe = false;
+  /**
+   * @brief Whether the receiver reported that the previous frame from the transmitter was lost.
+   */
+  bool frame_lost = false;
+  /**
+   * @brief Time when the frame was received, in milliseconds since System::Init().
+   */
+  uint64_t timestamp = 0;
+};
+
+#endif  // RTLIB_LIB_RC_FRAME_H_
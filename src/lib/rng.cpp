@@ -0,0 +1,272 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config/config.h"
+
+#if defined(LIB_USE_RNG) && LIB_USE_RNG > 0
+
+#include "lib/rng.h"
+
+#include <cassert>
+#include <cstring>
+
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/stm32/rcc.h>
+#if defined(STM32F1)
+#include <libopencm3/stm32/adc.h>
+#include <libopencm3/stm32/desig.h>
+#elif defined(STM32F4)
+#include <libopencm3/stm32/rng.h>
+#endif
+
+namespace {
+#if defined(STM32F1)
+/**
+ * @brief Number of ADC samples which are mixed into the seed.
+ *
+ * Only the lowest bits of each sample are noisy, so many samples are needed to collect enough entropy.
+ */
+constexpr uint32_t kSeedSamples = 256;
+
+constexpr uint32_t Rotl(const uint32_t x, const int k) { return (x << k) | (x >> (32 - k)); }
+
+/**
+ * @brief Finalizer of MurmurHash3, which spreads every input bit over all output bits.
+ */
+constexpr uint32_t Mix(uint32_t x) {
+  x ^= x >> 16;
+  x *= 0x85EBCA6B;
+  x ^= x >> 13;
+  x *= 0xC2B2AE35;
+  x ^= x >> 16;
+  return x;
+}
+
+inline uint16_t ReadAdc(uint8_t channel) {
+  adc_set_regular_sequence(ADC1, 1, &channel);
+  adc_start_conversion_regular(ADC1);
+  while (!adc_eoc(ADC1)) {
+  }
+  return static_cast<uint16_t>(adc_read_regular(ADC1));
+}
+#elif defined(STM32F4)
+/**
+ * @brief Object which handles the RNG interrupt.
+ */
+Rng* instance = nullptr;
+#endif
+}  // namespace
+
+#if defined(STM32F4)
+extern "C" void hash_rng_isr();
+
+extern "C" void hash_rng_isr() {
+  if (instance != nullptr) {
+    instance->HandleIrq();
+  }
+}
+#endif  // defined(STM32F4)
+
+#if defined(STM32F1)
+Rng::Rng(const Config& config) {
+  static_cast<void>(config);
+  Seed();
+}
+
+Rng::~Rng() = default;
+
+uint32_t Rng::Get() {
+  // xoroshiro64**
+  const uint32_t s0 = state_[0];
+  uint32_t s1 = state_[1];
+  const uint32_t result = Rotl(s0 * 0x9E3779BB, 5) * 5;
+
+  s1 ^= s0;
+  state_[0] = Rotl(s0, 26) ^ s1 ^ (s1 << 9);
+  state_[1] = Rotl(s1, 13);
+  return result;
+}
+
+bool Rng::TryGet(uint32_t& value) {
+  value = Get();
+  return true;
+}
+
+void Rng::Seed() {
+  rcc_periph_clock_enable(RCC_ADC1);
+
+  // ADC1 may already be in use (e.g. by CurrentSense), so the registers touched below are restored afterwards. The ADC
+  // prescaler is left alone, as the clock setup already keeps the ADC clock below 14MHz.
+  const uint32_t sqr1 = ADC_SQR1(ADC1);
+  const uint32_t sqr2 = ADC_SQR2(ADC1);
+  const uint32_t sqr3 = ADC_SQR3(ADC1);
+  const uint32_t smpr1 = ADC_SMPR1(ADC1);
+  const uint32_t cr2 = ADC_CR2(ADC1) & ~static_cast<uint32_t>(ADC_CR2_SWSTART | ADC_CR2_JSWSTART);
+  if ((cr2 & ADC_CR2_ADON) == 0) {
+    adc_power_on(ADC1);
+
+    // Wait for the ADC to stabilize
+    for (uint32_t i = 0; i < 1000; ++i) {
+      __asm__("nop");
+    }
+  }
+
+  adc_enable_temperature_sensor();
+  // The shortest sample time leaves the most noise in the result
+  adc_set_sample_time(ADC1, ADC_CHANNEL_TEMP, ADC_SMPR_SMP_1DOT5CYC);
+  adc_set_sample_time(ADC1, ADC_CHANNEL_VREF, ADC_SMPR_SMP_1DOT5CYC);
+  adc_enable_external_trigger_regular(ADC1, ADC_CR2_EXTSEL_SWSTART);
+
+  std::array<uint32_t, 3> id;
+  desig_get_unique_id(id.data());
+
+  // FNV-1a over the samples, alternating between the two channels and the two state words
+  std::array<uint32_t, 2> hash = {0x811C9DC5 ^ id[0], 0x811C9DC5 ^ id[1]};
+  for (uint32_t i = 0; i < kSeedSamples; ++i) {
+    uint32_t& h = hash[i & 1];
+    h = (h ^ ReadAdc((i & 2) != 0 ? ADC_CHANNEL_VREF : ADC_CHANNEL_TEMP)) * 0x01000193;
+  }
+
+  state_[0] = Mix(hash[0] ^ id[2]);
+  state_[1] = Mix(hash[1] ^ Rotl(id[2], 16));
+  if (state_[0] == 0 && state_[1] == 0) {
+    // The all-zero state is a fixed point of the generator
+    state_[0] = 1;
+  }
+
+  ADC_SQR1(ADC1) = sqr1;
+  ADC_SQR2(ADC1) = sqr2;
+  ADC_SQR3(ADC1) = sqr3;
+  ADC_SMPR1(ADC1) = smpr1;
+  // Writing ADON while it is set starts a conversion unless another bit changes at the same time
+  if (ADC_CR2(ADC1) != cr2) {
+    ADC_CR2(ADC1) = cr2;
+  }
+}
+#elif defined(STM32F4)
+Rng::Rng(const Config& config) {
+  rcc_periph_clock_enable(RCC_RNG);
+
+  instance = this;
+  nvic_set_priority(NVIC_HASH_RNG_IRQ, config.priority);
+  nvic_enable_irq(NVIC_HASH_RNG_IRQ);
+
+  rng_interrupt_enable();
+  rng_enable();
+}
+
+Rng::~Rng() {
+  rng_interrupt_disable();
+  rng_disable();
+  nvic_disable_irq(NVIC_HASH_RNG_IRQ);
+  instance = nullptr;
+}
+
+uint32_t Rng::Get() {
+  uint32_t value;
+  while (!TryGet(value)) {
+  }
+  return value;
+}
+
+bool Rng::TryGet(uint32_t& value) {
+  if (!pool_.Pop(value)) {
+    return false;
+  }
+
+  // The interrupt is only disabled by the handler while the pool is full, so there is no race here
+  if ((RNG_CR & RNG_CR_IE) == 0) {
+    rng_interrupt_enable();
+  }
+  return true;
+}
+
+void Rng::HandleIrq() {
+  const uint32_t status = RNG_SR;
+
+  if ((status & RNG_SR_SEIS) != 0) {
+    ++errors_;
+    Restart();
+    return;
+  }
+  if ((status & RNG_SR_CEIS) != 0) {
+    // The RNG clock is too slow; generation resumes by itself once the clock recovers
+    RNG_SR = ~static_cast<uint32_t>(RNG_SR_CEIS);
+    ++errors_;
+  }
+
+  if ((status & RNG_SR_DRDY) == 0) {
+    return;
+  }
+  if (pool_.GetSize() == pool_.GetCapacity()) {
+    // Leave the word in the data register until there is space
+    rng_interrupt_disable();
+    return;
+  }
+
+  const uint32_t word = RNG_DR;
+  if (has_last_word_ && word == last_word_) {
+    ++errors_;
+  } else if (has_last_word_) {
+    pool_.Push(word);
+  }
+  last_word_ = word;
+  has_last_word_ = true;
+}
+
+void Rng::Restart() {
+  // SEIS is cleared by writing 0 to it, while writing 1 to the other flags has no effect
+  RNG_SR = ~static_cast<uint32_t>(RNG_SR_SEIS);
+  rng_disable();
+  rng_enable();
+  has_last_word_ = false;
+}
+#endif
+
+uint32_t Rng::GetBounded(const uint32_t bound) {
+  assert(bound > 0);
+
+  uint64_t product = static_cast<uint64_t>(Get()) * bound;
+  uint32_t low = static_cast<uint32_t>(product);
+  if (low < bound) {
+    // Reject the values which would make some results more likely than others
+    const uint32_t threshold = (0 - bound) % bound;
+    while (low < threshold) {
+      product = static_cast<uint64_t>(Get()) * bound;
+      low = static_cast<uint32_t>(product);
+    }
+  }
+  return static_cast<uint32_t>(product >> 32);
+}
+
+void Rng::Fill(void* data, std::size_t size) {
+  auto* bytes = static_cast<uint8_t*>(data);
+  for (; size >= sizeof(uint32_t); size -= sizeof(uint32_t), bytes += sizeof(uint32_t)) {
+    const uint32_t word = Get();
+    std::memcpy(bytes, &word, sizeof(word));
+  }
+  if (size > 0) {
+    const uint32_t word = Get();
+    std::memcpy(bytes, &word, size);
+  }
+}
+
+#elif !defined(LIB_USE_RNG)
+#error "LIB_USE_RNG macro not found. (Did you define it in your board configuration?)"
+#endif
@@ -0,0 +1,190 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_LIB_RNG_H_
+#define RTLIB_LIB_RNG_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "config/config.h"
+#include "util/spsc_queue.h"
+
+static_assert(LIB_USE_RNG > 0, "Rng library is disabled in your configuration.");
+
+/**
+ * @brief HAL implementation for random number generation.
+ *
+ * On STM32F4xx devices, random words come from the true random number generator. Each word takes about 40 RNG clock
+ * cycles to generate, so the data-ready interrupt keeps a pool of words filled in the background, and callers draw from
+ * the pool without waiting. The interrupt is disabled while the pool is full. Consecutive words are compared with each
+ * other as required by FIPS 140-2, and repeated words are discarded.
+ *
+ * STM32F1xx devices have no random number generator, so a xoroshiro64** generator is used instead. It is seeded from
+ * the noise of the internal temperature sensor and voltage reference of ADC1, together with the unique device ID. The
+ * output is fast and statistically random, but is not suitable for cryptographic keys.
+ *
+ * There should only be one Rng object.
+ */
+class Rng {
+ public:
+  /**
+   * @brief Number of random words which are buffered on STM32F4xx devices.
+   */
+  static constexpr std::size_t kPoolSize = 32;
+
+  /**
+   * @brief Configuration for RNG.
+   */
+  struct Config {
+    /**
+     * @brief Priority of the data-ready interrupt. Only used on STM32F4xx devices.
+     */
+    uint8_t priority = 0xF0;
+  };
+
+  /**
+   * @brief Default constructor for RNG.
+   *
+   * On STM32F1xx devices, ADC1 is used briefly for seeding. Injected conversions of ADC1 (e.g. by CurrentSense) are not
+   * affected, and the regular channel configuration of ADC1 is restored afterwards.
+   *
+   * @param config RNG configuration
+   */
+  explicit Rng(const Config& config);
+
+  /**
+   * @brief Destructor.
+   *
+   * Disables the random number generator.
+   */
+  ~Rng();
+
+  /**
+   * @brief Move constructor for RNG.
+   *
+   * This constructor is deleted because the interrupt handler refers to this object.
+   */
+  Rng(Rng&&) = delete;
+  /**
+   * @brief Move assignment operator for RNG.
+   *
+   * This operator is deleted because the interrupt handler refers to this object.
+   */
+  Rng& operator=(Rng&&) = delete;
+
+  /**
+   * @brief Copy constructor for RNG.
+   *
+   * This constructor is deleted because there should only be one object managing the random number generator.
+   */
+  Rng(const Rng&) = delete;
+  /**
+   * @brief Copy assignment operator for RNG.
+   *
+   * This operator is deleted because there should only be one object managing the random number generator.
+   */
+  Rng& operator=(const Rng&) = delete;
+
+  /**
+   * @brief Retrieves a random word.
+   *
+   * If the pool is empty, waits for the next word from the hardware. This function must only be called from one
+   * context.
+   *
+   * @return Random word.
+   */
+  uint32_t Get();
+
+  /**
+   * @brief Retrieves a random word without waiting.
+   *
+   * This function must only be called from one context.
+   *
+   * @param value Reference to store the random word
+   * @return @c true if a word is retrieved, @c false if the pool is empty. Always @c true on STM32F1xx devices.
+   */
+  bool TryGet(uint32_t& value);
+
+  /**
+   * @brief Retrieves a uniformly distributed random number in a range.
+   *
+   * The number is scaled by multiplication instead of taking the remainder, and values which would bias the result are
+   * rejected, so a division is only needed in rare cases.
+   *
+   * @param bound Upper bound of the range, exclusive. Must not be 0.
+   * @return Random number from 0 to @p bound - 1.
+   */
+  uint32_t GetBounded(uint32_t bound);
+
+  /**
+   * @brief Fills a buffer with random bytes, e.g. for nonces.
+   *
+   * @param data Buffer to fill
+   * @param size Number of bytes to fill
+   */
+  void Fill(void* data, std::size_t size);
+
+  /**
+   * @return Number of seed errors and repeated words which were detected by the random number generator. Always 0 on
+   * STM32F1xx devices.
+   */
+  uint32_t GetErrorCount() const { return errors_; }
+
+#if defined(STM32F4)
+  /**
+   * @brief Handles a RNG interrupt.
+   *
+   * @warning This function is invoked by the RNG interrupt handler. Do not call this function directly.
+   */
+  void HandleIrq();
+#endif  // defined(STM32F4)
+
+ private:
+#if defined(STM32F1)
+  /**
+   * @brief Seeds the generator from ADC noise and the unique device ID.
+   */
+  void Seed();
+
+  std::array<uint32_t, 2> state_ = {};
+#elif defined(STM32F4)
+  /**
+   * @brief Restarts the random number generator after a seed error.
+   *
+   * The next word is only used for comparison.
+   */
+  void Restart();
+
+  util::SpscQueue<uint32_t, kPoolSize> pool_;
+  /**
+   * @brief Previous word from the hardware, for the continuous random number generator test.
+   */
+  uint32_t last_word_ = 0;
+  /**
+   * @brief Whether @c last_word_ holds a word. Otherwise the next word is only used for comparison.
+   */
+  bool has_last_word_ = false;
+#endif
+
+  volatile uint32_t errors_ = 0;
+};
+
+#endif  // RTLIB_LIB_RNG_H_
@@ -0,0 +1,349 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config/config.h"
+
+#if defined(LIB_USE_RTC) && LIB_USE_RTC > 0
+
+#include "lib/rtc.h"
+
+#include <cassert>
+
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/stm32/exti.h>
+#include <libopencm3/stm32/pwr.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/rtc.h>
+#if defined(STM32F1)
+#include <libopencm3/stm32/f1/bkp.h>
+#endif
+
+#include "lib/system.h"
+
+namespace {
+/**
+ * @brief Object which handles the RTC alarm interrupt.
+ */
+Rtc* instance = nullptr;
+
+/**
+ * @brief Value of the backup register which indicates that the time has been set.
+ */
+constexpr uint32_t kTimeSetMagic = 0x5254;
+
+#if defined(STM32F1)
+/**
+ * @brief Prescaler value which divides the 32.768kHz oscillator into 1Hz counter ticks.
+ */
+constexpr uint32_t kPrescaler = 0x7FFF;
+#elif defined(STM32F4)
+/**
+ * @brief Asynchronous prescaler value. Divides the 32.768kHz oscillator into 1024Hz sub-second ticks.
+ */
+constexpr uint32_t kAsyncPrescaler = 31;
+/**
+ * @brief Synchronous prescaler value. Divides the sub-second ticks into 1Hz calendar ticks.
+ */
+constexpr uint32_t kSyncPrescaler = 1023;
+
+/**
+ * @brief Unix time of 2000-01-01 00:00:00, which is the earliest time the calendar can represent.
+ */
+constexpr uint32_t kEpoch2000 = 946684800;
+
+constexpr uint32_t kSecondsPerDay = 86400;
+
+/**
+ * @brief Number of days before the alarm matches an earlier date with the same day of month.
+ */
+constexpr uint32_t kMaxAlarmDays = 28;
+
+/**
+ * @brief Data structure of a calendar date.
+ */
+struct Date {
+  uint32_t year;
+  uint32_t month;
+  uint32_t day;
+};
+
+/**
+ * @brief Converts a date into the number of days since 1970-01-01.
+ *
+ * See http://howardhinnant.github.io/date_algorithms.html for the derivation, which counts years from March so that
+ * the leap day is the last day of the year.
+ */
+constexpr uint32_t DaysFromCivil(uint32_t year, const uint32_t month, const uint32_t day) {
+  year -= month <= 2 ? 1 : 0;
+  const uint32_t era = year / 400;
+  const uint32_t year_of_era = year - era * 400;
+  const uint32_t day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+  const uint32_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+  return era * 146097 + day_of_era - 719468;
+}
+
+/**
+ * @brief Converts the number of days since 1970-01-01 into a date. Inverse of DaysFromCivil().
+ */
+constexpr Date CivilFromDays(uint32_t days) {
+  days += 719468;
+  const uint32_t era = days / 146097;
+  const uint32_t day_of_era = days - era * 146097;
+  const uint32_t year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+  const uint32_t day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+  const uint32_t month_index = (5 * day_of_year + 2) / 153;
+  const uint32_t day = day_of_year - (153 * month_index + 2) / 5 + 1;
+  const uint32_t month = month_index < 10 ? month_index + 3 : month_index - 9;
+  return {year_of_era + era * 400 + (month <= 2 ? 1 : 0), month, day};
+}
+
+static_assert(DaysFromCivil(2000, 1, 1) * kSecondsPerDay == kEpoch2000, "Date conversion is incorrect");
+static_assert(CivilFromDays(DaysFromCivil(2024, 2, 29)).day == 29, "Date conversion is incorrect");
+
+constexpr uint32_t ToBcd(const uint32_t value) { return ((value / 10) << 4) | (value % 10); }
+constexpr uint32_t FromBcd(const uint32_t bcd) { return (bcd >> 4) * 10 + (bcd & 0xF); }
+
+/**
+ * @brief Encodes a time of day in the layout shared by @c RTC_TR and @c RTC_ALRMAR, in 24-hour format.
+ */
+constexpr uint32_t EncodeTimeOfDay(const uint32_t seconds) {
+  return (ToBcd(seconds / 3600) << 16) | (ToBcd(seconds / 60 % 60) << 8) | ToBcd(seconds % 60);
+}
+#endif
+}  // namespace
+
+extern "C" void rtc_alarm_isr();
+
+extern "C" void rtc_alarm_isr() {
+  // The alarm reaches the NVIC through EXTI line 17
+  exti_reset_request(EXTI17);
+
+  if (instance != nullptr) {
+    instance->HandleIrq();
+  }
+}
+
+Rtc::Rtc(const Config& config) {
+  rcc_periph_clock_enable(RCC_PWR);
+#if defined(STM32F1)
+  rcc_periph_clock_enable(RCC_BKP);
+#endif
+  pwr_disable_backup_domain_write_protect();
+
+#if defined(STM32F1)
+  // Only initializes the RTC if it is not running yet
+  rtc_auto_awake(RCC_LSE, kPrescaler);
+#elif defined(STM32F4)
+  if ((RCC_BDCR & RCC_BDCR_RTCEN) == 0) {
+    rcc_osc_on(RCC_LSE);
+    rcc_wait_for_osc_ready(RCC_LSE);
+    RCC_BDCR = (RCC_BDCR & ~static_cast<uint32_t>(RCC_BDCR_RTCSEL_MASK << RCC_BDCR_RTCSEL_SHIFT)) |
+        (RCC_BDCR_RTCSEL_LSE << RCC_BDCR_RTCSEL_SHIFT) | RCC_BDCR_RTCEN;
+
+    rtc_unlock();
+    RTC_ISR |= RTC_ISR_INIT;
+    while ((RTC_ISR & RTC_ISR_INITF) == 0) {
+    }
+    rtc_set_prescaler(kSyncPrescaler, kAsyncPrescaler);
+    RTC_ISR &= ~static_cast<uint32_t>(RTC_ISR_INIT);
+    rtc_lock();
+  }
+#endif
+  Synchronize();
+
+  instance = this;
+  exti_set_trigger(EXTI17, EXTI_TRIGGER_RISING);
+  exti_enable_request(EXTI17);
+  nvic_set_priority(NVIC_RTC_ALARM_IRQ, config.priority);
+  nvic_enable_irq(NVIC_RTC_ALARM_IRQ);
+}
+
+Rtc::~Rtc() {
+  CancelAlarm();
+  exti_disable_request(EXTI17);
+  nvic_disable_irq(NVIC_RTC_ALARM_IRQ);
+  instance = nullptr;
+}
+
+bool Rtc::IsTimeSet() const {
+#if defined(STM32F1)
+  return (BKP_DR1 & 0xFFFF) == kTimeSetMagic;
+#elif defined(STM32F4)
+  return RTC_BKPXR(0) == kTimeSetMagic;
+#endif
+}
+
+void Rtc::SetTime(const uint32_t time) {
+#if defined(STM32F1)
+  rtc_set_counter_val(time);
+  BKP_DR1 = kTimeSetMagic;
+#elif defined(STM32F4)
+  assert(time >= kEpoch2000);
+
+  const uint32_t days = time / kSecondsPerDay;
+  const Date date = CivilFromDays(days);
+  // 1970-01-01 is a Thursday, and the RTC numbers weekdays from Monday = 1
+  const uint32_t weekday = (days + 3) % 7 + 1;
+
+  rtc_unlock();
+  RTC_ISR |= RTC_ISR_INIT;
+  while ((RTC_ISR & RTC_ISR_INITF) == 0) {
+  }
+  RTC_TR = EncodeTimeOfDay(time % kSecondsPerDay);
+  RTC_DR = (ToBcd(date.year - 2000) << 16) | (weekday << 13) | (ToBcd(date.month) << 8) | ToBcd(date.day);
+  RTC_CR &= ~static_cast<uint32_t>(RTC_CR_FMT);
+  RTC_ISR &= ~static_cast<uint32_t>(RTC_ISR_INIT);
+  rtc_lock();
+
+  RTC_BKPXR(0) = kTimeSetMagic;
+  Synchronize();
+#endif
+}
+
+uint64_t Rtc::GetTimeUs() const {
+#if defined(STM32F1)
+  // The divider reloads when the counter increments, so both must be read within the same second
+  uint32_t seconds;
+  uint32_t divider;
+  do {
+    seconds = rtc_get_counter_val();
+    divider = rtc_get_prescale_div_val();
+  } while (seconds != rtc_get_counter_val());
+
+  const uint64_t fraction = static_cast<uint64_t>(kPrescaler - divider) * 1000000 / (kPrescaler + 1);
+  return static_cast<uint64_t>(seconds) * 1000000 + fraction;
+#elif defined(STM32F4)
+  // Reading the sub-seconds locks the time and date shadow registers until the date is read
+  const uint32_t ssr = RTC_SSR & 0xFFFF;
+  const uint32_t tr = RTC_TR;
+  const uint32_t dr = RTC_DR;
+
+  const uint32_t days = DaysFromCivil(2000 + FromBcd((dr >> 16) & 0xFF), FromBcd((dr >> 8) & 0x1F), FromBcd(dr & 0x3F));
+  const uint32_t seconds = FromBcd((tr >> 16) & 0x3F) * 3600 + FromBcd((tr >> 8) & 0x7F) * 60 + FromBcd(tr & 0x7F);
+  const uint64_t fraction = static_cast<uint64_t>(kSyncPrescaler - ssr) * 1000000 / (kSyncPrescaler + 1);
+  return (static_cast<uint64_t>(days) * kSecondsPerDay + seconds) * 1000000 + fraction;
+#endif
+}
+
+bool Rtc::SetAlarm(const uint32_t time, const Callback callback, void* context) {
+  CancelAlarm();
+  const uint32_t now = GetTime();
+  if (time <= now) {
+    return false;
+  }
+#if defined(STM32F4)
+  // The alarm only matches the day of month, so it must expire before the day of month occurs again
+  if (time - now >= kMaxAlarmDays * kSecondsPerDay) {
+    return false;
+  }
+#endif
+
+  alarm_time_ = time;
+  callback_ = callback;
+  context_ = context;
+  alarm_pending_ = true;
+
+#if defined(STM32F1)
+  rtc_set_alarm_time(time);
+  rtc_interrupt_enable(RTC_ALR);
+#elif defined(STM32F4)
+  const Date date = CivilFromDays(time / kSecondsPerDay);
+
+  rtc_unlock();
+  while ((RTC_ISR & RTC_ISR_ALRAWF) == 0) {
+  }
+  // Match the day of month, hours, minutes and seconds, but not the sub-seconds
+  RTC_ALRMAR = (ToBcd(date.day) << 24) | EncodeTimeOfDay(time % kSecondsPerDay);
+  RTC_ALRMASSR = 0;
+  RTC_CR |= RTC_CR_ALRAE | RTC_CR_ALRAIE;
+  rtc_lock();
+#endif
+  return true;
+}
+
+void Rtc::CancelAlarm() {
+#if defined(STM32F1)
+  rtc_interrupt_disable(RTC_ALR);
+  rtc_clear_flag(RTC_ALR);
+#elif defined(STM32F4)
+  rtc_unlock();
+  RTC_CR &= ~static_cast<uint32_t>(RTC_CR_ALRAE | RTC_CR_ALRAIE);
+  rtc_lock();
+  // ALRAF is cleared by writing 0 to it, while writing 1 to the other flags has no effect
+  RTC_ISR = ~static_cast<uint32_t>(RTC_ISR_ALRAF | RTC_ISR_INIT);
+#endif
+  exti_reset_request(EXTI17);
+  alarm_pending_ = false;
+}
+
+std::optional<Rtc::Alarm> Rtc::GetAlarm() const {
+  if (!alarm_pending_) {
+    return std::nullopt;
+  }
+  return Alarm{alarm_time_, callback_, context_};
+}
+
+void Rtc::Suspend() {
+  suspend_rtc_us_ = GetTimeUs();
+  suspend_system_us_ = System::GetUs();
+}
+
+void Rtc::Resume() {
+  // The shadow registers are not updated in stop mode
+  Synchronize();
+
+  const uint64_t rtc_us = GetTimeUs();
+  const uint64_t rtc_elapsed = rtc_us > suspend_rtc_us_ ? rtc_us - suspend_rtc_us_ : 0;
+  const uint64_t system_elapsed = System::GetUs() - suspend_system_us_;
+  if (rtc_elapsed > system_elapsed) {
+    System::Compensate(rtc_elapsed - system_elapsed);
+  }
+}
+
+void Rtc::HandleIrq() {
+#if defined(STM32F1)
+  if (rtc_check_flag(RTC_ALR) == 0) {
+    return;
+  }
+#elif defined(STM32F4)
+  if ((RTC_ISR & RTC_ISR_ALRAF) == 0) {
+    return;
+  }
+#endif
+
+  // Alarms only fire once. On STM32F4xx devices, the alarm would otherwise fire again in the next month.
+  CancelAlarm();
+  if (callback_ != nullptr) {
+    callback_(context_);
+  }
+}
+
+void Rtc::Synchronize() const {
+#if defined(STM32F1)
+  RTC_CRL &= ~static_cast<uint32_t>(RTC_CRL_RSF);
+  while ((RTC_CRL & RTC_CRL_RSF) == 0) {
+  }
+#elif defined(STM32F4)
+  rtc_wait_for_synchro();
+#endif
+}
+
+#elif !defined(LIB_USE_RTC)
+#error "LIB_USE_RTC macro not found. (Did you define it in your board configuration?)"
+#endif
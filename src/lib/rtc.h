@@ -0,0 +1,213 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_LIB_RTC_H_
+#define RTLIB_LIB_RTC_H_
+
+#include <cstdint>
+#include <optional>
+
+#include "config/config.h"
+
+static_assert(LIB_USE_RTC > 0, "Rtc library is disabled in your configuration.");
+
+/**
+ * @brief HAL implementation for the real-time clock.
+ *
+ * This abstraction layer keeps wall-clock time in the backup domain, clocked by the 32.768kHz low-speed external
+ * oscillator. The clock keeps running across resets and in stop mode, and also in standby mode and on VBAT if the
+ * board provides a backup supply. Times are represented as Unix time, i.e. seconds since 1970-01-01 00:00:00 UTC.
+ *
+ * On STM32F1xx devices the RTC counter holds the Unix time directly. On STM32F4xx devices the calendar is converted
+ * from and to Unix time, and only years from 2000 to 2099 can be represented.
+ *
+ * The alarm wakes the device from stop mode. Since SysTick is halted in stop mode, call Suspend() before and Resume()
+ * after entering stop mode, which adds the time measured by the RTC to the System clock.
+ *
+ * Backup register 1 (STM32F1xx) or 0 (STM32F4xx) is used to remember whether the time has been set.
+ *
+ * There should only be one Rtc object.
+ */
+class Rtc {
+ public:
+  /**
+   * @brief Type definition for the alarm callback.
+   *
+   * @param context User-defined pointer, as passed to SetAlarm().
+   */
+  using Callback = void (*)(void* context);
+
+  /**
+   * @brief Data structure of an alarm, as passed to SetAlarm().
+   */
+  struct Alarm {
+    /**
+     * @brief Unix time of the alarm.
+     */
+    uint32_t time;
+    Callback callback;
+    void* context;
+  };
+
+  /**
+   * @brief Configuration for RTC.
+   */
+  struct Config {
+    /**
+     * @brief Priority of the alarm interrupt.
+     */
+    uint8_t priority = 0x80;
+  };
+
+  /**
+   * @brief Default constructor for RTC.
+   *
+   * If the RTC is not running yet (i.e. after the backup domain lost power), the low-speed oscillator is started and
+   * the RTC is initialized, which may take up to a few seconds. Otherwise the time is kept.
+   *
+   * @param config RTC configuration
+   */
+  explicit Rtc(const Config& config);
+
+  /**
+   * @brief Destructor.
+   *
+   * Disables the alarm. The RTC keeps running.
+   */
+  ~Rtc();
+
+  /**
+   * @brief Move constructor for RTC.
+   *
+   * This constructor is deleted because the interrupt handler refers to this object.
+   */
+  Rtc(Rtc&&) = delete;
+  /**
+   * @brief Move assignment operator for RTC.
+   *
+   * This operator is deleted because the interrupt handler refers to this object.
+   */
+  Rtc& operator=(Rtc&&) = delete;
+
+  /**
+   * @brief Copy constructor for RTC.
+   *
+   * This constructor is deleted because there should only be one object managing the RTC.
+   */
+  Rtc(const Rtc&) = delete;
+  /**
+   * @brief Copy assignment operator for RTC.
+   *
+   * This operator is deleted because there should only be one object managing the RTC.
+   */
+  Rtc& operator=(const Rtc&) = delete;
+
+  /**
+   * @return @c true if the time has been set since the backup domain was powered up.
+   */
+  bool IsTimeSet() const;
+
+  /**
+   * @brief Sets the time.
+   *
+   * @param time Unix time
+   */
+  void SetTime(uint32_t time);
+
+  /**
+   * @return Unix time.
+   */
+  uint32_t GetTime() const { return static_cast<uint32_t>(GetTimeUs() / 1000000); }
+  /**
+   * @return Milliseconds since 1970-01-01 00:00:00 UTC.
+   */
+  uint64_t GetTimeMs() const { return GetTimeUs() / 1000; }
+
+  /**
+   * @brief Sets the alarm, replacing the previous alarm.
+   *
+   * The alarm interrupt is also a wakeup event for stop mode. On STM32F4xx devices, the alarm must be less than 28 days
+   * in the future.
+   *
+   * @param time Unix time of the alarm
+   * @param callback Function to invoke from the alarm interrupt, or @c nullptr
+   * @param context User-defined pointer which will be passed to @p callback
+   * @return @c true if the alarm is set, @c false if @p time is not in the future, or is 28 days or more in the future
+   * on STM32F4xx devices.
+   */
+  bool SetAlarm(uint32_t time, Callback callback = nullptr, void* context = nullptr);
+
+  /**
+   * @brief Disables the alarm.
+   */
+  void CancelAlarm();
+
+  /**
+   * @return @c true if the alarm is set and has not expired.
+   */
+  bool IsAlarmPending() const { return alarm_pending_; }
+
+  /**
+   * @return The alarm if it is set and has not expired, otherwise @c std::nullopt.
+   */
+  std::optional<Alarm> GetAlarm() const;
+
+  /**
+   * @brief Records the current time before SysTick is halted.
+   *
+   * Call this function immediately before entering stop mode.
+   */
+  void Suspend();
+
+  /**
+   * @brief Advances the System clock by the time which passed since Suspend().
+   *
+   * Call this function immediately after waking up from stop mode. Only the time which was not counted by SysTick is
+   * added, so the System clock stays monotonic.
+   */
+  void Resume();
+
+  /**
+   * @brief Handles the RTC alarm interrupt.
+   *
+   * @warning This function is invoked by the RTC alarm interrupt handler. Do not call this function directly.
+   */
+  void HandleIrq();
+
+ private:
+  /**
+   * @return Microseconds since 1970-01-01 00:00:00 UTC.
+   */
+  uint64_t GetTimeUs() const;
+
+  /**
+   * @brief Waits for the RTC registers to be synchronized after a reset or a wakeup from stop mode.
+   */
+  void Synchronize() const;
+
+  volatile bool alarm_pending_ = false;
+  uint32_t alarm_time_ = 0;
+  Callback callback_ = nullptr;
+  void* context_ = nullptr;
+
+  uint64_t suspend_rtc_us_ = 0;
+  uint64_t suspend_system_us_ = 0;
+};
+
+#endif  // RTLIB_LIB_RTC_H_
@@ -0,0 +1,347 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config/config.h"
+
+#if defined(LIB_USE_SBUS) && LIB_USE_SBUS > 0
+
+#include "lib/sbus.h"
+
+#include <cassert>
+
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/usart.h>
+
+#include "lib/dma_routes.h"
+#include "lib/system.h"
+
+using CORE_NS::Dma;
+using CORE_NS::GPIO;
+
+namespace {
+constexpr uint8_t kIrqPriority = 0x40;
+
+constexpr uint32_t kBaudRate = 100000;
+constexpr uint8_t kStartByte = 0x0F;
+
+/**
+ * @brief Bits of the flags byte, which follows the channel data.
+ */
+constexpr uint8_t kFlagCh17 = 1u << 0;
+constexpr uint8_t kFlagCh18 = 1u << 1;
+constexpr uint8_t kFlagFrameLost = 1u << 2;
+constexpr uint8_t kFlagFailsafe = 1u << 3;
+
+/**
+ * @brief Peripheral resources of each supported USART.
+ */
+struct UsartInfo {
+  uint32_t usart;
+  rcc_periph_clken rcc;
+  uint8_t irq;
+};
+
+#if defined(STM32F1)
+// UART5 cannot be used since it has no DMA request
+constexpr std::array<UsartInfo, 4> kUsarts = {{
+    {USART1, RCC_USART1, NVIC_USART1_IRQ},
+    {USART2, RCC_USART2, NVIC_USART2_IRQ},
+    {USART3, RCC_USART3, NVIC_USART3_IRQ},
+    {UART4, RCC_UART4, NVIC_UART4_IRQ},
+}};
+#elif defined(STM32F4)
+constexpr std::array<UsartInfo, 6> kUsarts = {{
+    {USART1, RCC_USART1, NVIC_USART1_IRQ},
+    {USART2, RCC_USART2, NVIC_USART2_IRQ},
+    {USART3, RCC_USART3, NVIC_USART3_IRQ},
+    {UART4, RCC_UART4, NVIC_UART4_IRQ},
+    {UART5, RCC_UART5, NVIC_UART5_IRQ},
+    {USART6, RCC_USART6, NVIC_USART6_IRQ},
+}};
+#endif
+
+/**
+ * @brief SBUS object of each USART, in the same order as @c kUsarts.
+ */
+std::array<Sbus*, kUsarts.size()> instances = {};
+
+inline std::size_t GetUsartIndex(const uint32_t usart) {
+  for (std::size_t i = 0; i < kUsarts.size(); ++i) {
+    if (kUsarts[i].usart == usart) {
+      return i;
+    }
+  }
+
+  assert(false);
+  return 0;
+}
+
+/**
+ * @brief Hardware configuration of one SBUS receiver, as read from the board configuration.
+ */
+struct HwConfig {
+  uint32_t usart = 0;
+  Pinout rx = {};
+#if defined(STM32F1)
+  std::optional<GPIO::PriRemap> remap = std::nullopt;
+#elif defined(STM32F4)
+  GPIO::AltFn altfn = GPIO_AF0;
+#endif
+};
+
+inline HwConfig GetConfigHw(const uint8_t id) {
+  assert(id < LIB_USE_SBUS);
+  HwConfig hw;
+  switch (id) {
+    default:
+      // not handled, since assert will catch this error
+      assert(false);
+      break;
+#if LIB_USE_SBUS > 0
+    case 0:
+      hw.usart = LIB_SBUS0_USART;
+      hw.rx = Pinout(LIB_SBUS0_RX_PINOUT);
+#if defined(STM32F1) && defined(LIB_SBUS0_REMAP)
+      hw.remap = LIB_SBUS0_REMAP;
+#elif defined(STM32F4)
+      hw.altfn = LIB_SBUS0_ALTFN;
+#endif
+      break;
+#endif  // LIB_USE_SBUS > 0
+#if LIB_USE_SBUS > 1
+    case 1:
+      hw.usart = LIB_SBUS1_USART;
+      hw.rx = Pinout(LIB_SBUS1_RX_PINOUT);
+#if defined(STM32F1) && defined(LIB_SBUS1_REMAP)
+      hw.remap = LIB_SBUS1_REMAP;
+#elif defined(STM32F4)
+      hw.altfn = LIB_SBUS1_ALTFN;
+#endif
+      break;
+#endif  // LIB_USE_SBUS > 1
+  }
+  return hw;
+}
+
+/**
+ * @brief Converts a raw SBUS channel value to a pulse width.
+ *
+ * SBUS maps 1000us to 2000us linearly onto 172 to 1811, with 992 at the center.
+ *
+ * @param raw 11-bit channel value
+ * @return Pulse width in microseconds.
+ */
+constexpr uint16_t ToPulseUs(const uint16_t raw) {
+  return static_cast<uint16_t>(1500 + (static_cast<int32_t>(raw) - 992) * 5 / 8);
+}
+
+/**
+ * @param end_byte Last byte of a frame
+ * @return @c true if @p end_byte is valid. SBUS2 receivers send telemetry slot numbers in the upper nibble.
+ */
+constexpr bool IsValidEndByte(const uint8_t end_byte) { return end_byte == 0x00 || (end_byte & 0x0F) == 0x04; }
+}  // namespace
+
+Sbus::Sbus(const Config& config) {
+  const HwConfig hw = GetConfigHw(config.id);
+  usart_ = hw.usart;
+  const std::size_t index = GetUsartIndex(usart_);
+  irq_ = kUsarts[index].irq;
+
+#if defined(STM32F1)
+  rx_gpio_.emplace(hw.rx, GPIO::Configuration::kInputFloat, GPIO::Mode::kInput);
+  if (hw.remap) {
+    rcc_periph_clock_enable(RCC_AFIO);
+    GPIO::SetPriAltFn(GPIO::JTAGDisables::kNoDisable, *hw.remap);
+  }
+#elif defined(STM32F4)
+  rx_gpio_.emplace(hw.rx, GPIO::Mode::kAF, GPIO::Pullup::kNone, GPIO::Speed::k2MHz, GPIO::DriverType::kPushPull, hw.altfn);
+#endif
+
+  rcc_periph_clock_enable(kUsarts[index].rcc);
+
+  // Parity is counted as a data bit
+  usart_set_baudrate(usart_, kBaudRate);
+  usart_set_databits(usart_, 9);
+  usart_set_parity(usart_, USART_PARITY_EVEN);
+  usart_set_stopbits(usart_, USART_STOPBITS_2);
+  usart_set_mode(usart_, USART_MODE_RX);
+  usart_set_flow_control(usart_, USART_FLOWCONTROL_NONE);
+
+  const std::optional<Dma::Route> route = Dma::Allocate(*DmaRoutes::GetUsartRxRequest(usart_));
+  assert(route);
+  route_ = *route;
+
+  Dma::Transfer transfer;
+  transfer.direction = Dma::Direction::kPeriphToMem;
+  transfer.mode = Dma::Mode::kCircular;
+  transfer.peripheral = reinterpret_cast<uint32_t>(&USART_DR(usart_));
+  transfer.memory0 = ring_.data();
+  transfer.count = kRingSize;
+  transfer.priority = Dma::Priority::kHigh;
+  Dma::Start(route_, transfer);
+  usart_enable_rx_dma(usart_);
+
+  assert(instances[index] == nullptr);
+  instances[index] = this;
+
+  // Bytes are transferred by DMA, so only the end of each frame raises an interrupt
+  USART_CR1(usart_) |= USART_CR1_IDLEIE;
+  nvic_set_priority(irq_, kIrqPriority);
+  nvic_enable_irq(irq_);
+
+  usart_enable(usart_);
+}
+
+Sbus::~Sbus() {
+  usart_disable(usart_);
+  nvic_disable_irq(irq_);
+  USART_CR1(usart_) &= ~static_cast<uint32_t>(USART_CR1_IDLEIE);
+  usart_disable_rx_dma(usart_);
+  Dma::Release(route_);
+
+  instances[GetUsartIndex(usart_)] = nullptr;
+}
+
+void Sbus::HandleIrq() {
+  // Reading the status register followed by the data register clears the idle and error flags
+  const uint32_t status = USART_SR(usart_);
+  static_cast<void>(USART_DR(usart_));
+  if ((status & USART_SR_IDLE) == 0) {
+    return;
+  }
+
+  const std::size_t write_index = (kRingSize - Dma::GetRemaining(route_)) % kRingSize;
+  const std::size_t size = (write_index + kRingSize - read_index_) % kRingSize;
+
+  std::array<uint8_t, kFrameSize> data;
+  for (std::size_t i = 0; i < kFrameSize; ++i) {
+    data[i] = ring_[(read_index_ + i) % kRingSize];
+  }
+  read_index_ = write_index;
+
+  // Frames are delimited by the idle line, so anything else than a single frame since the last idle line is garbage
+  const bool has_error = (status & (USART_SR_ORE | USART_SR_NE | USART_SR_FE | USART_SR_PE)) != 0;
+  if (size != kFrameSize || has_error || data[0] != kStartByte || !IsValidEndByte(data[kFrameSize - 1])) {
+    errors_ = errors_ + 1;
+    return;
+  }
+
+  DecodeFrame(data);
+}
+
+void Sbus::DecodeFrame(const std::array<uint8_t, kFrameSize>& data) {
+  RcFrame frame;
+
+  // Channels are packed as 11-bit little-endian values
+  uint32_t bits = 0;
+  uint8_t num_bits = 0;
+  std::size_t byte = 1;
+  for (uint8_t i = 0; i < kNumChannels; ++i) {
+    while (num_bits < 11) {
+      bits |= uint32_t{data[byte++]} << num_bits;
+      num_bits = static_cast<uint8_t>(num_bits + 8);
+    }
+    frame.channels[i] = ToPulseUs(static_cast<uint16_t>(bits & 0x7FF));
+    bits >>= 11;
+    num_bits = static_cast<uint8_t>(num_bits - 11);
+  }
+
+  const uint8_t flags = data[kFrameSize - 2];
+  frame.channels[kNumChannels] = (flags & kFlagCh17) != 0 ? 2000 : 1000;
+  frame.channels[kNumChannels + 1] = (flags & kFlagCh18) != 0 ? 2000 : 1000;
+  frame.num_channels = kNumChannels + 2;
+  frame.frame_lost = (flags & kFlagFrameLost) != 0;
+  frame.failsafe = (flags & kFlagFailsafe) != 0;
+  frame.timestamp = System::GetMs();
+
+  frames_.Write(frame);
+}
+
+// Only the vectors of the USARTs in the board configuration are defined, so that the other USARTs remain available to
+// other drivers
+#define SBUS_USES_USART(usart) \
+  ((LIB_USE_SBUS > 0 && LIB_SBUS0_USART == (usart)) || (LIB_USE_SBUS > 1 && LIB_SBUS1_USART == (usart)))
+
+#if SBUS_USES_USART(USART1)
+extern "C" void usart1_isr();
+
+extern "C" void usart1_isr() {
+  if (instances[0] != nullptr) {
+    instances[0]->HandleIrq();
+  }
+}
+#endif
+
+#if SBUS_USES_USART(USART2)
+extern "C" void usart2_isr();
+
+extern "C" void usart2_isr() {
+  if (instances[1] != nullptr) {
+    instances[1]->HandleIrq();
+  }
+}
+#endif
+
+#if SBUS_USES_USART(USART3)
+extern "C" void usart3_isr();
+
+extern "C" void usart3_isr() {
+  if (instances[2] != nullptr) {
+    instances[2]->HandleIrq();
+  }
+}
+#endif
+
+#if SBUS_USES_USART(UART4)
+extern "C" void uart4_isr();
+
+extern "C" void uart4_isr() {
+  if (instances[3] != nullptr) {
+    instances[3]->HandleIrq();
+  }
+}
+#endif
+
+#if defined(STM32F4) && SBUS_USES_USART(UART5)
+extern "C" void uart5_isr();
+
+extern "C" void uart5_isr() {
+  if (instances[4] != nullptr) {
+    instances[4]->HandleIrq();
+  }
+}
+#endif
+
+#if defined(STM32F4) && SBUS_USES_USART(USART6)
+extern "C" void usart6_isr();
+
+extern "C" void usart6_isr() {
+  if (instances[5] != nullptr) {
+    instances[5]->HandleIrq();
+  }
+}
+#endif
+
+#undef SBUS_USES_USART
+
+#elif !defined(LIB_USE_SBUS)
+#error "LIB_USE_SBUS macro not found. (Did you define it in your board configuration?)"
+#endif
@@ -0,0 +1,170 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_LIB_SBUS_H_
+#define RTLIB_LIB_SBUS_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "config/config.h"
+#include "core/dma.h"
+#include "core/gpio.h"
+#include "lib/rc_frame.h"
+#include "util/double_buffer.h"
+
+static_assert(LIB_USE_SBUS > 0, "SBUS library is disabled in your configuration.");
+
+/**
+ * @brief HAL implementation for SBUS RC receivers.
+ *
+ * SBUS frames are 25 bytes at 100000 baud with even parity and two stop bits, sent every 7ms or 14ms. Bytes are
+ * received by circular DMA, so the CPU is only interrupted once per frame, when the line becomes idle after the last
+ * byte. The frame is then validated, decoded, and published to a double buffer, from which the latest frame is read by
+ * Read().
+ *
+ * @note SBUS uses inverted signal levels, which the USARTs of STM32F1xx and STM32F4xx devices cannot invert
+ * internally. An external inverter is required between the receiver and the RX pin.
+ *
+ * One Sbus object is designed to manage one receiver.
+ */
+class Sbus {
+ public:
+  /**
+   * @brief Size of one SBUS frame, in bytes.
+   */
+  static constexpr std::size_t kFrameSize = 25;
+  /**
+   * @brief Number of proportional channels in one SBUS frame, excluding the two digital channels.
+   */
+  static constexpr uint8_t kNumChannels = 16;
+
+  /**
+   * @brief Configuration for SBUS.
+   */
+  struct Config {
+    /**
+     * @brief ID of the SBUS receiver.
+     *
+     * See your device configuration header file to see which id corresponds to which SBUS receiver.
+     */
+    uint8_t id = 0;
+  };
+
+  /**
+   * @brief Default constructor for SBUS.
+   *
+   * Reception starts immediately.
+   *
+   * @param config SBUS configuration
+   */
+  explicit Sbus(const Config& config);
+
+  /**
+   * @brief Destructor.
+   *
+   * Stops reception, and releases the DMA stream.
+   */
+  ~Sbus();
+
+  /**
+   * @brief Move constructor for SBUS.
+   *
+   * This constructor is deleted because the interrupt handler refers to this object.
+   */
+  Sbus(Sbus&&) = delete;
+  /**
+   * @brief Move assignment operator for SBUS.
+   *
+   * This operator is deleted because the interrupt handler refers to this object.
+   */
+  Sbus& operator=(Sbus&&) = delete;
+
+  /**
+   * @brief Copy constructor for SBUS.
+   *
+   * This constructor is deleted because there should only be one object managing each SBUS receiver.
+   */
+  Sbus(const Sbus&) = delete;
+  /**
+   * @brief Copy assignment operator for SBUS.
+   *
+   * This operator is deleted because there should only be one object managing each SBUS receiver.
+   */
+  Sbus& operator=(const Sbus&) = delete;
+
+  /**
+   * @brief Reads the latest frame.
+   *
+   * Channels 17 and 18 are the digital channels of SBUS, and read as either 1000 or 2000. This function must only be
+   * called from one context.
+   *
+   * @param frame Reference to store the frame
+   * @return @c true if a new frame has been received since the last call.
+   */
+  bool Read(RcFrame& frame) { return frames_.Read(frame); }
+
+  /**
+   * @return Number of frames received since construction.
+   */
+  uint32_t GetFrameCount() const { return frames_.GetSequence(); }
+  /**
+   * @return Number of malformed frames, which were discarded.
+   */
+  uint32_t GetErrorCount() const { return errors_; }
+
+  /**
+   * @brief Handles a USART interrupt.
+   *
+   * @warning This function is invoked by the USART interrupt handler. Do not call this function directly.
+   */
+  void HandleIrq();
+
+ private:
+  /**
+   * @brief Size of the DMA ring buffer, in bytes.
+   */
+  static constexpr std::size_t kRingSize = 64;
+
+  /**
+   * @brief Decodes and publishes a frame.
+   *
+   * @param data Frame data, which must have passed validation
+   */
+  void DecodeFrame(const std::array<uint8_t, kFrameSize>& data);
+
+  uint32_t usart_;
+  uint8_t irq_;
+  CORE_NS::Dma::Route route_;
+
+  std::array<uint8_t, kRingSize> ring_;
+  /**
+   * @brief Index of the byte in @c ring_ which follows the last idle line.
+   */
+  std::size_t read_index_ = 0;
+
+  util::DoubleBuffer<RcFrame> frames_;
+  volatile uint32_t errors_ = 0;
+
+  std::optional<CORE_NS::GPIO> rx_gpio_;
+};
+
+#endif  // RTLIB_LIB_SBUS_H_
@@ -0,0 +1,268 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config/config.h"
+
+#if defined(LIB_USE_SERVO) && LIB_USE_SERVO > 0
+
+#include "lib/servo.h"
+
+#include <cassert>
+
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/timer.h>
+
+#include "core/timer.h"
+
+using CORE_NS::GPIO;
+using CORE_NS::Timer;
+
+namespace {
+constexpr tim_oc_id kOcIds[] = {TIM_OC1, TIM_OC2, TIM_OC3, TIM_OC4};
+
+/**
+ * @brief Hardware configuration of one servo timer, as read from the board configuration.
+ */
+struct HwConfig {
+  uint32_t timer = 0;
+  std::array<std::optional<Pinout>, 4> pins = {};
+#if defined(STM32F1)
+  std::optional<GPIO::PriRemap> remap = std::nullopt;
+#elif defined(STM32F4)
+  GPIO::AltFn altfn = GPIO_AF0;
+#endif
+};
+
+inline HwConfig GetConfigHw(const uint8_t id) {
+  assert(id < LIB_USE_SERVO);
+  HwConfig hw;
+  switch (id) {
+    default:
+      // not handled, since assert will catch this error
+      assert(false);
+      break;
+#if LIB_USE_SERVO > 0
+    case 0:
+      hw.timer = LIB_SERVO0_TIMER;
+#if defined(LIB_SERVO0_CH1_PINOUT)
+      hw.pins[0] = Pinout(LIB_SERVO0_CH1_PINOUT);
+#endif  // defined(LIB_SERVO0_CH1_PINOUT)
+#if defined(LIB_SERVO0_CH2_PINOUT)
+      hw.pins[1] = Pinout(LIB_SERVO0_CH2_PINOUT);
+#endif  // defined(LIB_SERVO0_CH2_PINOUT)
+#if defined(LIB_SERVO0_CH3_PINOUT)
+      hw.pins[2] = Pinout(LIB_SERVO0_CH3_PINOUT);
+#endif  // defined(LIB_SERVO0_CH3_PINOUT)
+#if defined(LIB_SERVO0_CH4_PINOUT)
+      hw.pins[3] = Pinout(LIB_SERVO0_CH4_PINOUT);
+#endif  // defined(LIB_SERVO0_CH4_PINOUT)
+#if defined(STM32F1) && defined(LIB_SERVO0_REMAP)
+      hw.remap = LIB_SERVO0_REMAP;
+#elif defined(STM32F4)
+      hw.altfn = LIB_SERVO0_ALTFN;
+#endif
+      break;
+#endif  // LIB_USE_SERVO > 0
+#if LIB_USE_SERVO > 1
+    case 1:
+      hw.timer = LIB_SERVO1_TIMER;
+#if defined(LIB_SERVO1_CH1_PINOUT)
+      hw.pins[0] = Pinout(LIB_SERVO1_CH1_PINOUT);
+#endif  // defined(LIB_SERVO1_CH1_PINOUT)
+#if defined(LIB_SERVO1_CH2_PINOUT)
+      hw.pins[1] = Pinout(LIB_SERVO1_CH2_PINOUT);
+#endif  // defined(LIB_SERVO1_CH2_PINOUT)
+#if defined(LIB_SERVO1_CH3_PINOUT)
+      hw.pins[2] = Pinout(LIB_SERVO1_CH3_PINOUT);
+#endif  // defined(LIB_SERVO1_CH3_PINOUT)
+#if defined(LIB_SERVO1_CH4_PINOUT)
+      hw.pins[3] = Pinout(LIB_SERVO1_CH4_PINOUT);
+#endif  // defined(LIB_SERVO1_CH4_PINOUT)
+#if defined(STM32F1) && defined(LIB_SERVO1_REMAP)
+      hw.remap = LIB_SERVO1_REMAP;
+#elif defined(STM32F4)
+      hw.altfn = LIB_SERVO1_ALTFN;
+#endif
+      break;
+#endif  // LIB_USE_SERVO > 1
+#if LIB_USE_SERVO > 2
+    case 2:
+      hw.timer = LIB_SERVO2_TIMER;
+#if defined(LIB_SERVO2_CH1_PINOUT)
+      hw.pins[0] = Pinout(LIB_SERVO2_CH1_PINOUT);
+#endif  // defined(LIB_SERVO2_CH1_PINOUT)
+#if defined(LIB_SERVO2_CH2_PINOUT)
+      hw.pins[1] = Pinout(LIB_SERVO2_CH2_PINOUT);
+#endif  // defined(LIB_SERVO2_CH2_PINOUT)
+#if defined(LIB_SERVO2_CH3_PINOUT)
+      hw.pins[2] = Pinout(LIB_SERVO2_CH3_PINOUT);
+#endif  // defined(LIB_SERVO2_CH3_PINOUT)
+#if defined(LIB_SERVO2_CH4_PINOUT)
+      hw.pins[3] = Pinout(LIB_SERVO2_CH4_PINOUT);
+#endif  // defined(LIB_SERVO2_CH4_PINOUT)
+#if defined(STM32F1) && defined(LIB_SERVO2_REMAP)
+      hw.remap = LIB_SERVO2_REMAP;
+#elif defined(STM32F4)
+      hw.altfn = LIB_SERVO2_ALTFN;
+#endif
+      break;
+#endif  // LIB_USE_SERVO > 2
+#if LIB_USE_SERVO > 3
+    case 3:
+      hw.timer = LIB_SERVO3_TIMER;
+#if defined(LIB_SERVO3_CH1_PINOUT)
+      hw.pins[0] = Pinout(LIB_SERVO3_CH1_PINOUT);
+#endif  // defined(LIB_SERVO3_CH1_PINOUT)
+#if defined(LIB_SERVO3_CH2_PINOUT)
+      hw.pins[1] = Pinout(LIB_SERVO3_CH2_PINOUT);
+#endif  // defined(LIB_SERVO3_CH2_PINOUT)
+#if defined(LIB_SERVO3_CH3_PINOUT)
+      hw.pins[2] = Pinout(LIB_SERVO3_CH3_PINOUT);
+#endif  // defined(LIB_SERVO3_CH3_PINOUT)
+#if defined(LIB_SERVO3_CH4_PINOUT)
+      hw.pins[3] = Pinout(LIB_SERVO3_CH4_PINOUT);
+#endif  // defined(LIB_SERVO3_CH4_PINOUT)
+#if defined(STM32F1) && defined(LIB_SERVO3_REMAP)
+      hw.remap = LIB_SERVO3_REMAP;
+#elif defined(STM32F4)
+      hw.altfn = LIB_SERVO3_ALTFN;
+#endif
+      break;
+#endif  // LIB_USE_SERVO > 3
+  }
+  return hw;
+}
+}  // namespace
+
+Servo::Servo(const Config& config) {
+  assert(config.frequency >= 50 && config.frequency <= 333);
+
+  const HwConfig hw = GetConfigHw(config.id);
+  timer_ = hw.timer;
+
+  for (std::size_t i = 0; i < gpios_.size(); ++i) {
+    if (!hw.pins[i]) {
+      continue;
+    }
+
+#if defined(STM32F1)
+    gpios_[i].emplace(*hw.pins[i], GPIO::Configuration::kOutputAltFnPushPull, GPIO::Mode::kOutput2MHz);
+#elif defined(STM32F4)
+    gpios_[i].emplace(*hw.pins[i],
+                      GPIO::Mode::kAF,
+                      GPIO::Pullup::kNone,
+                      GPIO::Speed::k2MHz,
+                      GPIO::DriverType::kPushPull,
+                      hw.altfn);
+#endif
+  }
+
+#if defined(STM32F1)
+  if (hw.remap) {
+    rcc_periph_clock_enable(RCC_AFIO);
+    GPIO::SetPriAltFn(GPIO::JTAGDisables::kNoDisable, *hw.remap);
+  }
+#endif
+
+  Timer::InitRcc(timer_);
+
+  // Use the smallest prescaler which fits one frame into a 16-bit counter, which gives the finest pulse resolution
+  // (below 0.5us at 50Hz)
+  const uint32_t clock_freq = Timer::GetClockFreq(timer_);
+  const uint32_t ticks = clock_freq / config.frequency;
+  const uint32_t prescaler = (ticks - 1) / 0x10000;
+  tick_freq_ = clock_freq / (prescaler + 1);
+  period_us_ = 1000000 / config.frequency;
+
+  timer_set_mode(timer_, TIM_CR1_CKD_CK_INT, TIM_CR1_CMS_EDGE, TIM_CR1_DIR_UP);
+  timer_set_prescaler(timer_, prescaler);
+  timer_set_period(timer_, ticks / (prescaler + 1) - 1);
+  timer_enable_preload(timer_);
+
+  for (uint8_t i = 0; i < gpios_.size(); ++i) {
+    if (!gpios_[i]) {
+      continue;
+    }
+
+    timer_set_oc_mode(timer_, kOcIds[i], TIM_OCM_PWM1);
+    timer_enable_oc_preload(timer_, kOcIds[i]);
+    timer_set_oc_polarity_high(timer_, kOcIds[i]);
+    timer_set_oc_value(timer_, kOcIds[i], 0);
+    timer_enable_oc_output(timer_, kOcIds[i]);
+  }
+
+  // Advanced-control timers gate all outputs with the main output enable bit
+  if (Timer::IsAdvanced(timer_)) {
+    timer_enable_break_main_output(timer_);
+  }
+
+  // Load the preloaded registers before starting the counter
+  timer_generate_event(timer_, TIM_EGR_UG);
+  timer_clear_flag(timer_, TIM_SR_UIF);
+  timer_enable_counter(timer_);
+}
+
+void Servo::SetPulseUs(const Channel channel, const uint32_t pulse_us) {
+  assert(HasChannel(channel));
+  timer_set_oc_value(timer_, kOcIds[static_cast<uint8_t>(channel)], ToTicks(pulse_us));
+}
+
+void Servo::SetPulseUs(const std::array<uint32_t, 4>& pulses_us) {
+  // Inhibit update events while writing, so that all channels are latched at the same update event
+  TIM_CR1(timer_) |= TIM_CR1_UDIS;
+  for (uint8_t i = 0; i < gpios_.size(); ++i) {
+    if (gpios_[i]) {
+      timer_set_oc_value(timer_, kOcIds[i], ToTicks(pulses_us[i]));
+    }
+  }
+  TIM_CR1(timer_) &= ~static_cast<uint32_t>(TIM_CR1_UDIS);
+}
+
+uint32_t Servo::GetPulseUs(const Channel channel) const {
+  assert(HasChannel(channel));
+
+  uint32_t ticks = 0;
+  switch (channel) {
+    case Channel::k1:
+      ticks = TIM_CCR1(timer_);
+      break;
+    case Channel::k2:
+      ticks = TIM_CCR2(timer_);
+      break;
+    case Channel::k3:
+      ticks = TIM_CCR3(timer_);
+      break;
+    case Channel::k4:
+      ticks = TIM_CCR4(timer_);
+      break;
+    default:
+      assert(false);
+      break;
+  }
+  return static_cast<uint32_t>((uint64_t{ticks} * 1000000 + tick_freq_ / 2) / tick_freq_);
+}
+
+uint32_t Servo::ToTicks(const uint32_t pulse_us) const {
+  assert(pulse_us <= period_us_);
+  return static_cast<uint32_t>((uint64_t{pulse_us} * tick_freq_ + 500000) / 1000000);
+}
+
+#elif !defined(LIB_USE_SERVO)
+#error "LIB_USE_SERVO macro not found. (Did you define it in your board configuration?)"
+#endif
@@ -0,0 +1,168 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_LIB_SERVO_H_
+#define RTLIB_LIB_SERVO_H_
+
+#include <array>
+#include <cstdint>
+#include <optional>
+
+#include "config/config.h"
+#include "core/gpio.h"
+
+static_assert(LIB_USE_SERVO > 0, "Servo library is disabled in your configuration.");
+
+/**
+ * @brief HAL implementation for hobby servos.
+ *
+ * This abstraction layer generates servo pulses on up to four channels of one timer, so that no CPU time is spent per
+ * pulse. All channels share the same frame rate. One Servo object is designed to manage one timer and the servos
+ * connected to its channels.
+ *
+ * Compare registers are preloaded, so new pulse widths only take effect at the start of the next frame, and a pulse is
+ * never cut short or stretched by an update.
+ */
+class Servo {
+ public:
+  /**
+   * @brief Enumeration of servo channels.
+   */
+  enum struct Channel : uint8_t {
+    k1 = 0,
+    k2,
+    k3,
+    k4
+  };
+
+  /**
+   * @brief Configuration for servo.
+   */
+  struct Config {
+    /**
+     * @brief ID of the servo timer.
+     *
+     * See your device configuration header file to see which id corresponds to which servo timer.
+     */
+    uint8_t id = 0;
+    /**
+     * @brief Frame rate, in Hz. Must be between 50 and 333Hz.
+     *
+     * Analog servos expect 50Hz. Digital servos accept higher rates, which reduce the latency of updates. Defaults to
+     * 50Hz.
+     */
+    uint32_t frequency = 50;
+  };
+
+  /**
+   * @brief Default constructor for servo.
+   *
+   * All channels output no pulses after the constructor is called, which leaves the servos unpowered.
+   *
+   * @param config Servo configuration
+   */
+  explicit Servo(const Config& config);
+
+  /**
+   * @brief Default destructor.
+   */
+  ~Servo() = default;
+
+  /**
+   * @brief Move constructor for servo.
+   *
+   * @param other Servo object to move from
+   */
+  Servo(Servo&& other) noexcept = default;
+  /**
+   * @brief Move assignment operator for servo.
+   *
+   * @param other Servo object to move from
+   * @return Reference to the moved servo.
+   */
+  Servo& operator=(Servo&& other) noexcept = default;
+
+  /**
+   * @brief Copy constructor for servo.
+   *
+   * This constructor is deleted because there should only be one object managing each servo timer, similar to @c
+   * std::unique_ptr.
+   */
+  Servo(const Servo&) = delete;
+  /**
+   * @brief Copy assignment operator for servo.
+   *
+   * This constructor is deleted because there should only be one object managing each servo timer, similar to @c
+   * std::unique_ptr.
+   */
+  Servo& operator=(const Servo&) = delete;
+
+  /**
+   * @brief Sets the pulse width of one channel.
+   *
+   * The new pulse width will be applied from the next frame.
+   *
+   * @param channel Channel to modify
+   * @param pulse_us Pulse width in microseconds, typically from 500 to 2500. 0 stops the pulses. Must not exceed the
+   * length of one frame.
+   */
+  void SetPulseUs(Channel channel, uint32_t pulse_us);
+  /**
+   * @brief Sets the pulse width of all channels.
+   *
+   * As opposed to SetPulseUs(Channel,uint32_t), this function guarantees that all channels apply their new pulse width
+   * in the same frame.
+   *
+   * @param pulses_us Pulse widths in microseconds, in the order of channels. Channels without a pin are ignored. Each
+   * pulse width must not exceed the length of one frame.
+   */
+  void SetPulseUs(const std::array<uint32_t, 4>& pulses_us);
+
+  /**
+   * @param channel Channel to query
+   * @return Pulse width of @p channel in microseconds, rounded to the nearest microsecond.
+   */
+  uint32_t GetPulseUs(Channel channel) const;
+
+  /**
+   * @param channel Channel to query
+   * @return @c true if @p channel has a pin in the board configuration.
+   */
+  bool HasChannel(Channel channel) const { return gpios_[static_cast<uint8_t>(channel)].has_value(); }
+
+ private:
+  /**
+   * @brief Converts a pulse width to timer ticks.
+   */
+  uint32_t ToTicks(uint32_t pulse_us) const;
+
+  uint32_t timer_;
+  /**
+   * @brief Frequency of the timer counter, in Hz.
+   */
+  uint32_t tick_freq_ = 0;
+  /**
+   * @brief Length of one frame, in microseconds.
+   */
+  uint32_t period_us_ = 0;
+
+  std::array<std::optional<CORE_NS::GPIO>, 4> gpios_;
+};
+
+#endif  // RTLIB_LIB_SERVO_H_
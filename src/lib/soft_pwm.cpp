@@ -0,0 +1,238 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config/config.h"
+
+#if defined(LIB_USE_SOFTPWM) && LIB_USE_SOFTPWM > 0
+
+#include "lib/soft_pwm.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/timer.h>
+
+#include "core/timer.h"
+
+using CORE_NS::GPIO;
+using CORE_NS::Timer;
+
+namespace {
+/**
+ * @brief Hardware configuration of one software PWM timer, as read from the board configuration.
+ */
+struct HwConfig {
+  uint32_t timer = 0;
+};
+
+inline HwConfig GetConfigHw(const uint8_t id) {
+  assert(id < LIB_USE_SOFTPWM);
+  HwConfig hw;
+  switch (id) {
+    default:
+      // not handled, since assert will catch this error
+      assert(false);
+      break;
+#if LIB_USE_SOFTPWM > 0
+    case 0:
+      hw.timer = LIB_SOFTPWM0_TIMER;
+      break;
+#endif  // LIB_USE_SOFTPWM > 0
+#if LIB_USE_SOFTPWM > 1
+    case 1:
+      hw.timer = LIB_SOFTPWM1_TIMER;
+      break;
+#endif  // LIB_USE_SOFTPWM > 1
+  }
+  return hw;
+}
+}  // namespace
+
+SoftPwm::SoftPwm(const Config& config) : resolution_(config.resolution) {
+  assert(config.num_pins <= kMaxChannels);
+  assert(config.frequency > 0 && config.resolution > 0);
+
+  const HwConfig hw = GetConfigHw(config.id);
+  timer_ = hw.timer;
+  // Basic timers have no compare channel
+  assert(timer_ != TIM6 && timer_ != TIM7);
+
+  for (std::size_t i = 0; i < config.num_pins; ++i) {
+    const Pinout& pin = config.pins[i];
+#if defined(STM32F1)
+    gpios_[i].emplace(pin, GPIO::Configuration::kOutputPushPull, GPIO::Mode::kOutput2MHz);
+#elif defined(STM32F4)
+    gpios_[i].emplace(pin, GPIO::Mode::kOutput, GPIO::Pullup::kNone);
+#endif
+    gpios_[i]->Reset();
+
+    std::size_t port = 0;
+    while (port < num_ports_ && ports_[port] != pin.first) {
+      ++port;
+    }
+    if (port == num_ports_) {
+      ports_[num_ports_++] = pin.first;
+    }
+    channel_ports_[i] = static_cast<uint8_t>(port);
+    channel_pins_[i] = pin.second;
+    ++num_channels_;
+  }
+
+  Timer::InitRcc(timer_);
+
+  // Each counter tick is one step of the duty cycle
+  const uint32_t clock_freq = Timer::GetClockFreq(timer_);
+  const uint32_t ticks = clock_freq / (config.frequency * resolution_);
+  assert(ticks > 0 && ticks <= 0x10000);
+  frequency_ = clock_freq / (ticks * resolution_);
+
+  timer_set_mode(timer_, TIM_CR1_CKD_CK_INT, TIM_CR1_CMS_EDGE, TIM_CR1_DIR_UP);
+  timer_set_prescaler(timer_, ticks - 1);
+  timer_set_period(timer_, resolution_ - 1u);
+  timer_enable_preload(timer_);
+  timer_generate_event(timer_, TIM_EGR_UG);
+  timer_clear_flag(timer_, TIM_SR_UIF | TIM_SR_CC1IF);
+
+  Publish();
+
+  Timer::SetIrqHandler(timer_, &HandleTimerIrq, this, config.priority);
+  timer_enable_irq(timer_, TIM_DIER_UIE | TIM_DIER_CC1IE);
+  timer_enable_counter(timer_);
+}
+
+SoftPwm::~SoftPwm() {
+  timer_disable_counter(timer_);
+  timer_disable_irq(timer_, TIM_DIER_UIE | TIM_DIER_CC1IE);
+  Timer::SetIrqHandler(timer_, nullptr);
+
+  for (std::size_t i = 0; i < num_channels_; ++i) {
+    gpios_[i]->Reset();
+  }
+}
+
+void SoftPwm::SetDuty(const std::size_t channel, const uint16_t duty) {
+  assert(channel < num_channels_);
+
+  duties_[channel] = std::min(duty, resolution_);
+  Publish();
+}
+
+void SoftPwm::SetDuties(const uint16_t* duties) {
+  for (std::size_t i = 0; i < num_channels_; ++i) {
+    duties_[i] = std::min(duties[i], resolution_);
+  }
+  Publish();
+}
+
+void SoftPwm::HandleTimerIrq(void* context) {
+  auto& self = *static_cast<SoftPwm*>(context);
+  const uint32_t status = TIM_SR(self.timer_);
+
+  if ((status & TIM_SR_UIF) != 0) {
+    timer_clear_flag(self.timer_, TIM_SR_UIF);
+    self.StartPeriod();
+  }
+  if ((status & TIM_SR_CC1IF) != 0) {
+    timer_clear_flag(self.timer_, TIM_SR_CC1IF);
+    self.ProcessEdges();
+  }
+}
+
+void SoftPwm::StartPeriod() {
+  if (pending_.load(std::memory_order_acquire)) {
+    active_ = static_cast<uint8_t>(active_ ^ 1u);
+    pending_.store(false, std::memory_order_relaxed);
+  }
+
+  const Schedule& schedule = schedules_[active_];
+  for (std::size_t i = 0; i < num_ports_; ++i) {
+    GPIO_BSRR(ports_[i]) = schedule.start[i];
+  }
+
+  next_edge_ = 0;
+  ProcessEdges();
+}
+
+void SoftPwm::ProcessEdges() {
+  const Schedule& schedule = schedules_[active_];
+
+  while (next_edge_ < schedule.num_edges) {
+    const Edge& edge = schedule.edges[next_edge_];
+    if (edge.time > timer_get_counter(timer_)) {
+      timer_set_oc_value(timer_, TIM_OC1, edge.time);
+
+      // If the counter reached the edge while the compare value was written, the compare event is missed
+      if (edge.time > timer_get_counter(timer_)) {
+        return;
+      }
+    }
+
+    GPIO_BSRR(ports_[edge.port]) = static_cast<uint32_t>(edge.mask) << 16;
+    ++next_edge_;
+  }
+}
+
+void SoftPwm::Publish() {
+  // The interrupt handler does not switch to the inactive schedule while it is being built, so the flag must be
+  // cleared before the schedule is modified
+  pending_.store(false, std::memory_order_relaxed);
+  std::atomic_signal_fence(std::memory_order_seq_cst);
+  Schedule& schedule = schedules_[active_ ^ 1u];
+
+  schedule.start = {};
+  schedule.num_edges = 0;
+  for (std::size_t i = 0; i < num_channels_; ++i) {
+    const uint8_t port = channel_ports_[i];
+    const uint16_t pin = channel_pins_[i];
+    const uint16_t duty = duties_[i];
+
+    // Pins which are always low are cleared at the start of the period, in case they were always high before
+    if (duty == 0) {
+      schedule.start[port] |= static_cast<uint32_t>(pin) << 16;
+      continue;
+    }
+    schedule.start[port] |= pin;
+    if (duty == resolution_) {
+      continue;
+    }
+
+    // Insert the falling edge after all edges which are not later, merging it with an edge of the same port and time
+    std::size_t pos = 0;
+    while (pos < schedule.num_edges && schedule.edges[pos].time <= duty &&
+           !(schedule.edges[pos].time == duty && schedule.edges[pos].port == port)) {
+      ++pos;
+    }
+    if (pos < schedule.num_edges && schedule.edges[pos].time == duty) {
+      schedule.edges[pos].mask = static_cast<uint16_t>(schedule.edges[pos].mask | pin);
+      continue;
+    }
+    std::move_backward(schedule.edges.begin() + pos,
+                       schedule.edges.begin() + schedule.num_edges,
+                       schedule.edges.begin() + schedule.num_edges + 1);
+    schedule.edges[pos] = {duty, port, pin};
+    ++schedule.num_edges;
+  }
+
+  pending_.store(true, std::memory_order_release);
+}
+
+#elif !defined(LIB_USE_SOFTPWM)
+#error "LIB_USE_SOFTPWM macro not found. (Did you define it in your board configuration?)"
+#endif
@@ -0,0 +1,244 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_LIB_SOFT_PWM_H_
+#define RTLIB_LIB_SOFT_PWM_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "config/config.h"
+#include "core/gpio.h"
+
+static_assert(LIB_USE_SOFTPWM > 0, "SoftPwm library is disabled in your configuration.");
+
+/**
+ * @brief HAL implementation for PWM on arbitrary GPIO pins.
+ *
+ * This abstraction layer generates PWM signals in software, using the update event and the first compare channel of
+ * one general-purpose timer. At the start of each period, all pins with a non-zero duty cycle are set with one @c BSRR
+ * write per port. The falling edges are then processed in the order of a precomputed schedule: the compare channel is
+ * programmed with the time of the next edge, and each compare interrupt clears all pins of a port which fall at that
+ * time with one @c BSRR write. The cost of each period is therefore proportional to the number of distinct duty cycles,
+ * not to the number of pins.
+ *
+ * The schedule is rebuilt whenever a duty cycle changes, and takes effect at the start of the next period, so every
+ * period is consistent. Edges which are too close to be served by separate interrupts are applied late within the same
+ * interrupt, so very small differences in duty cycle may be merged.
+ *
+ * Software PWM is intended for LEDs and slow actuators; its timing jitters by the latency of the timer interrupt.
+ *
+ * One SoftPwm object is designed to manage one timer on the mainboard.
+ */
+class SoftPwm {
+ public:
+  /**
+   * @brief Maximum number of pins.
+   */
+  static constexpr std::size_t kMaxChannels = 16;
+
+  /**
+   * @brief Configuration for software PWM.
+   */
+  struct Config {
+    /**
+     * @brief ID of the timer.
+     *
+     * See your device configuration header file to see which id corresponds to which timer.
+     */
+    uint8_t id = 0;
+    /**
+     * @brief Array of pins to drive. The array is only read by the constructor.
+     */
+    const Pinout* pins = nullptr;
+    /**
+     * @brief Number of elements in @c pins, up to @c kMaxChannels.
+     */
+    std::size_t num_pins = 0;
+    /**
+     * @brief PWM frequency, in Hz.
+     */
+    uint32_t frequency = 1000;
+    /**
+     * @brief Number of duty cycle steps per period. Duty cycles range from 0 to @c resolution inclusive.
+     */
+    uint16_t resolution = 256;
+    /**
+     * @brief Priority of the timer interrupt. Lower values have higher priority.
+     */
+    uint8_t priority = 0x60;
+  };
+
+  /**
+   * @brief Default constructor for software PWM.
+   *
+   * All pins start with a duty cycle of 0.
+   *
+   * @param config Software PWM configuration
+   */
+  explicit SoftPwm(const Config& config);
+
+  /**
+   * @brief Destructor.
+   *
+   * Stops the timer and drives all pins low.
+   */
+  ~SoftPwm();
+
+  /**
+   * @brief Move constructor for software PWM.
+   *
+   * This constructor is deleted because the interrupt handler refers to this object.
+   */
+  SoftPwm(SoftPwm&&) = delete;
+  /**
+   * @brief Move assignment operator for software PWM.
+   *
+   * This operator is deleted because the interrupt handler refers to this object.
+   */
+  SoftPwm& operator=(SoftPwm&&) = delete;
+
+  /**
+   * @brief Copy constructor for software PWM.
+   *
+   * This constructor is deleted because there should only be one object managing each timer.
+   */
+  SoftPwm(const SoftPwm&) = delete;
+  /**
+   * @brief Copy assignment operator for software PWM.
+   *
+   * This operator is deleted because there should only be one object managing each timer.
+   */
+  SoftPwm& operator=(const SoftPwm&) = delete;
+
+  /**
+   * @brief Sets the duty cycle of one pin.
+   *
+   * This function must only be called from one context.
+   *
+   * @param channel Index of the pin, in the order of SoftPwm#Config#pins
+   * @param duty Duty cycle, from 0 (always low) to GetResolution() (always high)
+   */
+  void SetDuty(std::size_t channel, uint16_t duty);
+
+  /**
+   * @brief Sets the duty cycles of all pins at once.
+   *
+   * This function must only be called from one context.
+   *
+   * @param duties Array of duty cycles, with GetNumChannels() elements
+   */
+  void SetDuties(const uint16_t* duties);
+
+  /**
+   * @param channel Index of the pin
+   * @return Duty cycle of the pin.
+   */
+  uint16_t GetDuty(std::size_t channel) const { return duties_[channel]; }
+
+  /**
+   * @return Number of pins.
+   */
+  std::size_t GetNumChannels() const { return num_channels_; }
+  /**
+   * @return Number of duty cycle steps per period.
+   */
+  uint16_t GetResolution() const { return resolution_; }
+  /**
+   * @return Actual PWM frequency, in Hz.
+   */
+  uint32_t GetFrequency() const { return frequency_; }
+
+ private:
+  /**
+   * @brief Pins of one port which fall at the same time.
+   */
+  struct Edge {
+    uint16_t time;
+    uint8_t port;
+    uint16_t mask;
+  };
+
+  /**
+   * @brief Pin changes of one period.
+   */
+  struct Schedule {
+    /**
+     * @brief Value to write into the @c BSRR register of each port at the start of the period.
+     */
+    std::array<uint32_t, kMaxChannels> start = {};
+    /**
+     * @brief Falling edges, sorted by time.
+     */
+    std::array<Edge, kMaxChannels> edges = {};
+    std::size_t num_edges = 0;
+  };
+
+  static void HandleTimerIrq(void* context);
+
+  /**
+   * @brief Starts a period, switching to a new schedule if one is pending.
+   */
+  void StartPeriod();
+  /**
+   * @brief Applies all edges which are due, and programs the compare channel with the time of the next edge.
+   */
+  void ProcessEdges();
+
+  /**
+   * @brief Builds the schedule from the duty cycles, and publishes it for the next period.
+   */
+  void Publish();
+
+  uint32_t timer_;
+  uint32_t frequency_ = 0;
+  uint16_t resolution_;
+  std::size_t num_channels_ = 0;
+
+  std::array<std::optional<CORE_NS::GPIO>, kMaxChannels> gpios_;
+  /**
+   * @brief Index into @c ports_ of each pin.
+   */
+  std::array<uint8_t, kMaxChannels> channel_ports_ = {};
+  std::array<uint16_t, kMaxChannels> channel_pins_ = {};
+  std::array<uint32_t, kMaxChannels> ports_ = {};
+  std::size_t num_ports_ = 0;
+
+  std::array<uint16_t, kMaxChannels> duties_ = {};
+
+  /**
+   * @brief Schedule used by the interrupt handler, and the schedule which is built for the next period.
+   */
+  std::array<Schedule, 2> schedules_ = {};
+  /**
+   * @brief Index of the schedule used by the interrupt handler.
+   */
+  volatile uint8_t active_ = 0;
+  /**
+   * @brief Whether the inactive schedule is complete, and should be used from the next period onwards. Publishing with release semantics
+   * makes the schedule visible to the interrupt handler before the flag.
+   */
+  std::atomic<bool> pending_ = false;
+  std::size_t next_edge_ = 0;
+};
+
+#endif  // RTLIB_LIB_SOFT_PWM_H_
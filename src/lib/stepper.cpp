@@ -0,0 +1,421 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config/config.h"
+
+#if defined(LIB_USE_STEPPER) && LIB_USE_STEPPER > 0
+
+#include "lib/stepper.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/timer.h>
+
+#include "core/timer.h"
+
+using CORE_NS::GPIO;
+using CORE_NS::Timer;
+
+namespace {
+/**
+ * @brief Hardware configuration of one stepper, as read from the board configuration.
+ */
+struct HwConfig {
+  uint32_t timer = 0;
+  std::array<std::optional<Pinout>, Stepper::kMaxAxes> step_pins = {};
+  std::array<std::optional<Pinout>, Stepper::kMaxAxes> dir_pins = {};
+};
+
+inline HwConfig GetConfigHw(const uint8_t id) {
+  assert(id < LIB_USE_STEPPER);
+  HwConfig hw;
+  switch (id) {
+    default:
+      // not handled, since assert will catch this error
+      assert(false);
+      break;
+#if LIB_USE_STEPPER > 0
+    case 0:
+      hw.timer = LIB_STEPPER0_TIMER;
+      hw.step_pins[0] = Pinout(LIB_STEPPER0_AXIS0_STEP_PINOUT);
+      hw.dir_pins[0] = Pinout(LIB_STEPPER0_AXIS0_DIR_PINOUT);
+#if defined(LIB_STEPPER0_AXIS1_STEP_PINOUT)
+      hw.step_pins[1] = Pinout(LIB_STEPPER0_AXIS1_STEP_PINOUT);
+      hw.dir_pins[1] = Pinout(LIB_STEPPER0_AXIS1_DIR_PINOUT);
+#endif  // defined(LIB_STEPPER0_AXIS1_STEP_PINOUT)
+#if defined(LIB_STEPPER0_AXIS2_STEP_PINOUT)
+      hw.step_pins[2] = Pinout(LIB_STEPPER0_AXIS2_STEP_PINOUT);
+      hw.dir_pins[2] = Pinout(LIB_STEPPER0_AXIS2_DIR_PINOUT);
+#endif  // defined(LIB_STEPPER0_AXIS2_STEP_PINOUT)
+#if defined(LIB_STEPPER0_AXIS3_STEP_PINOUT)
+      hw.step_pins[3] = Pinout(LIB_STEPPER0_AXIS3_STEP_PINOUT);
+      hw.dir_pins[3] = Pinout(LIB_STEPPER0_AXIS3_DIR_PINOUT);
+#endif  // defined(LIB_STEPPER0_AXIS3_STEP_PINOUT)
+      break;
+#endif  // LIB_USE_STEPPER > 0
+#if LIB_USE_STEPPER > 1
+    case 1:
+      hw.timer = LIB_STEPPER1_TIMER;
+      hw.step_pins[0] = Pinout(LIB_STEPPER1_AXIS0_STEP_PINOUT);
+      hw.dir_pins[0] = Pinout(LIB_STEPPER1_AXIS0_DIR_PINOUT);
+#if defined(LIB_STEPPER1_AXIS1_STEP_PINOUT)
+      hw.step_pins[1] = Pinout(LIB_STEPPER1_AXIS1_STEP_PINOUT);
+      hw.dir_pins[1] = Pinout(LIB_STEPPER1_AXIS1_DIR_PINOUT);
+#endif  // defined(LIB_STEPPER1_AXIS1_STEP_PINOUT)
+#if defined(LIB_STEPPER1_AXIS2_STEP_PINOUT)
+      hw.step_pins[2] = Pinout(LIB_STEPPER1_AXIS2_STEP_PINOUT);
+      hw.dir_pins[2] = Pinout(LIB_STEPPER1_AXIS2_DIR_PINOUT);
+#endif  // defined(LIB_STEPPER1_AXIS2_STEP_PINOUT)
+#if defined(LIB_STEPPER1_AXIS3_STEP_PINOUT)
+      hw.step_pins[3] = Pinout(LIB_STEPPER1_AXIS3_STEP_PINOUT);
+      hw.dir_pins[3] = Pinout(LIB_STEPPER1_AXIS3_DIR_PINOUT);
+#endif  // defined(LIB_STEPPER1_AXIS3_STEP_PINOUT)
+      break;
+#endif  // LIB_USE_STEPPER > 1
+  }
+  return hw;
+}
+
+/**
+ * @brief Converts a rate to fixed-point steps per tick.
+ *
+ * @param value Rate in steps/s^n
+ * @param ticks_per_s Tick frequency raised to the n-th power
+ */
+inline uint64_t ToFixed(const float value, const float ticks_per_s) {
+  // 2^48, which is exactly representable
+  constexpr float kScale = 281474976710656.0f;
+  return static_cast<uint64_t>(value / ticks_per_s * kScale);
+}
+}  // namespace
+
+Stepper::Stepper(const Config& config) : tick_frequency_(config.tick_frequency) {
+  assert(config.tick_frequency > 0);
+
+  const HwConfig hw = GetConfigHw(config.id);
+  timer_ = hw.timer;
+
+  for (std::size_t i = 0; i < kMaxAxes && hw.step_pins[i]; ++i) {
+    const Pinout& step = *hw.step_pins[i];
+#if defined(STM32F1)
+    step_gpios_[i].emplace(step, GPIO::Configuration::kOutputPushPull, GPIO::Mode::kOutput10MHz);
+    dir_gpios_[i].emplace(*hw.dir_pins[i], GPIO::Configuration::kOutputPushPull, GPIO::Mode::kOutput10MHz);
+#elif defined(STM32F4)
+    step_gpios_[i].emplace(step, GPIO::Mode::kOutput, GPIO::Pullup::kNone, GPIO::Speed::k25MHz);
+    dir_gpios_[i].emplace(*hw.dir_pins[i], GPIO::Mode::kOutput, GPIO::Pullup::kNone, GPIO::Speed::k25MHz);
+#endif
+    step_gpios_[i]->Reset();
+
+    // Group the step pins by port, so that all pins of one port can be written at once
+    std::size_t port = 0;
+    while (port < num_ports_ && ports_[port].port != step.first) {
+      ++port;
+    }
+    if (port == num_ports_) {
+      ports_[num_ports_++] = {step.first, 0, 0};
+    }
+    ports_[port].all = static_cast<uint16_t>(ports_[port].all | step.second);
+    step_ports_[i] = static_cast<uint8_t>(port);
+    step_pins_[i] = step.second;
+    ++num_axes_;
+  }
+
+  Timer::InitRcc(timer_);
+
+  const uint32_t clock_freq = Timer::GetClockFreq(timer_);
+  const uint32_t ticks = clock_freq / config.tick_frequency;
+  assert(ticks > 0);
+  const uint32_t prescaler = (ticks - 1) / 0x10000;
+  const uint32_t period = ticks / (prescaler + 1);
+  tick_frequency_ = clock_freq / ((prescaler + 1) * period);
+
+  timer_set_mode(timer_, TIM_CR1_CKD_CK_INT, TIM_CR1_CMS_EDGE, TIM_CR1_DIR_UP);
+  timer_set_prescaler(timer_, prescaler);
+  timer_set_period(timer_, period - 1);
+  timer_enable_preload(timer_);
+  timer_generate_event(timer_, TIM_EGR_UG);
+  timer_clear_flag(timer_, TIM_SR_UIF);
+
+  Timer::SetIrqHandler(timer_, &HandleTimerIrq, this, config.priority);
+  SetIrqEnable(true);
+}
+
+Stepper::~Stepper() {
+  Abort();
+  SetIrqEnable(false);
+  Timer::SetIrqHandler(timer_, nullptr);
+}
+
+bool Stepper::Move(const std::array<int32_t, kMaxAxes>& steps, const Profile& profile) {
+  assert(profile.max_speed > 0.0f && profile.acceleration > 0.0f && profile.jerk >= 0.0f);
+
+  if (busy_) {
+    return false;
+  }
+
+  major_steps_ = 0;
+  for (std::size_t i = 0; i < kMaxAxes; ++i) {
+    assert(i < num_axes_ || steps[i] == 0);
+
+    deltas_[i] = steps[i] < 0 ? 0u - static_cast<uint32_t>(steps[i]) : static_cast<uint32_t>(steps[i]);
+    directions_[i] = static_cast<int8_t>(steps[i] < 0 ? -1 : 1);
+    if (deltas_[i] > major_steps_) {
+      major_steps_ = deltas_[i];
+    }
+  }
+  if (major_steps_ == 0) {
+    return true;
+  }
+
+  // The direction is set well before the first step, which is at least one tick later
+  for (std::size_t i = 0; i < num_axes_; ++i) {
+    dir_gpios_[i]->Set(steps[i] >= 0);
+    errors_[i] = major_steps_ / 2;
+  }
+
+  // One step needs at least two ticks, since the step pin is cleared in the tick after the step
+  const auto ticks_per_s = static_cast<float>(tick_frequency_);
+  max_velocity_ = std::min(ToFixed(profile.max_speed, ticks_per_s), kOneStep / 2);
+  max_accel_ = std::max<uint64_t>(ToFixed(profile.acceleration, ticks_per_s * ticks_per_s), 1);
+  jerk_ = ToFixed(profile.jerk, ticks_per_s * ticks_per_s * ticks_per_s);
+
+  phase_ = Phase::kAccel;
+  if (jerk_ > 0) {
+    segment_ = Segment::kJerkUp;
+    accel_ = 0;
+  } else {
+    segment_ = Segment::kConstant;
+    accel_ = max_accel_;
+  }
+  velocity_ = 0;
+  min_velocity_ = 0;
+  phase_accumulator_ = 0;
+  jerk_velocity_ = 0;
+  segment_ticks_ = {};
+  steps_done_ = 0;
+  accel_steps_ = 0;
+  stopping_ = false;
+  busy_ = true;
+
+  timer_set_counter(timer_, 0);
+  timer_clear_flag(timer_, TIM_SR_UIF);
+  timer_enable_counter(timer_);
+
+  return true;
+}
+
+void Stepper::Stop() {
+  if (busy_) {
+    stopping_ = true;
+  }
+}
+
+void Stepper::Abort() {
+  SetIrqEnable(false);
+  timer_disable_counter(timer_);
+  for (std::size_t i = 0; i < num_ports_; ++i) {
+    GPIO_BSRR(ports_[i].port) = static_cast<uint32_t>(ports_[i].all) << 16;
+    ports_[i].pending = 0;
+  }
+  pulse_high_ = false;
+  busy_ = false;
+  stopping_ = false;
+  SetIrqEnable(true);
+}
+
+std::array<int32_t, Stepper::kMaxAxes> Stepper::GetPosition() const {
+  std::array<int32_t, kMaxAxes> position;
+  SetIrqEnable(false);
+  std::copy(position_.begin(), position_.end(), position.begin());
+  SetIrqEnable(true);
+  return position;
+}
+
+void Stepper::SetPosition(const std::array<int32_t, kMaxAxes>& position) {
+  SetIrqEnable(false);
+  std::copy(position.begin(), position.end(), position_.begin());
+  SetIrqEnable(true);
+}
+
+void Stepper::HandleTimerIrq(void* context) {
+  auto& self = *static_cast<Stepper*>(context);
+  if (!timer_get_flag(self.timer_, TIM_SR_UIF)) {
+    return;
+  }
+
+  timer_clear_flag(self.timer_, TIM_SR_UIF);
+  if (self.busy_) {
+    self.Tick();
+  }
+}
+
+void Stepper::Tick() {
+  if (pulse_high_) {
+    for (std::size_t i = 0; i < num_ports_; ++i) {
+      GPIO_BSRR(ports_[i].port) = static_cast<uint32_t>(ports_[i].pending) << 16;
+      ports_[i].pending = 0;
+    }
+    pulse_high_ = false;
+  }
+
+  if (steps_done_ == major_steps_) {
+    Finish();
+    return;
+  }
+
+  if (phase_ != Phase::kDecel && (stopping_ || major_steps_ - steps_done_ <= accel_steps_)) {
+    phase_ = Phase::kDecel;
+  }
+
+  switch (phase_) {
+    case Phase::kAccel:
+      Accelerate();
+      break;
+    case Phase::kCruise:
+      break;
+    case Phase::kDecel:
+      Decelerate();
+      break;
+    default:
+      assert(false);
+      break;
+  }
+
+  phase_accumulator_ += velocity_;
+  if (phase_accumulator_ >= kOneStep) {
+    phase_accumulator_ -= kOneStep;
+    Step();
+
+    for (std::size_t i = 0; i < num_ports_; ++i) {
+      if (ports_[i].pending != 0) {
+        GPIO_BSRR(ports_[i].port) = ports_[i].pending;
+      }
+    }
+    pulse_high_ = true;
+  }
+}
+
+void Stepper::Accelerate() {
+  // Each tick belongs to exactly one segment, so that Decelerate() can undo the ticks exactly
+  switch (segment_) {
+    case Segment::kJerkUp:
+      if (velocity_ + jerk_velocity_ >= max_velocity_) {
+        segment_ = Segment::kJerkDown;
+      } else if (accel_ + jerk_ > max_accel_) {
+        segment_ = Segment::kConstant;
+      } else {
+        accel_ += jerk_;
+        velocity_ += accel_;
+        jerk_velocity_ += accel_;
+        ++segment_ticks_[0];
+        return;
+      }
+      break;
+    case Segment::kConstant:
+      if (velocity_ + jerk_velocity_ + accel_ > max_velocity_) {
+        if (jerk_ == 0) {
+          phase_ = Phase::kCruise;
+          return;
+        }
+        segment_ = Segment::kJerkDown;
+      } else {
+        velocity_ += accel_;
+        ++segment_ticks_[1];
+        return;
+      }
+      break;
+    case Segment::kJerkDown:
+      break;
+    default:
+      assert(false);
+      break;
+  }
+
+  // Ramping the acceleration down to 0 gains the same velocity as ramping it up did
+  if (accel_ < jerk_) {
+    phase_ = Phase::kCruise;
+    return;
+  }
+  velocity_ += accel_;
+  accel_ -= jerk_;
+  ++segment_ticks_[2];
+}
+
+void Stepper::Decelerate() {
+  // Undo the segments of the acceleration phase in reverse order
+  if (segment_ticks_[2] > 0) {
+    accel_ += jerk_;
+    velocity_ = velocity_ > accel_ ? velocity_ - accel_ : 0;
+    --segment_ticks_[2];
+  } else if (segment_ticks_[1] > 0) {
+    velocity_ = velocity_ > accel_ ? velocity_ - accel_ : 0;
+    --segment_ticks_[1];
+  } else if (segment_ticks_[0] > 0) {
+    velocity_ = velocity_ > accel_ ? velocity_ - accel_ : 0;
+    accel_ -= jerk_;
+    --segment_ticks_[0];
+  } else if (stopping_) {
+    // Back at the start velocity, which is slow enough to stop without losing steps
+    major_steps_ = steps_done_;
+    return;
+  }
+
+  // Never slow down below the velocity of the first step, so that the remaining steps of the move are completed
+  velocity_ = std::max(velocity_, min_velocity_);
+}
+
+void Stepper::Step() {
+  if (steps_done_ == 0) {
+    min_velocity_ = velocity_;
+  }
+  ++steps_done_;
+  if (phase_ == Phase::kAccel) {
+    ++accel_steps_;
+  }
+
+  // The major axis steps every time, and all other axes follow with Bresenham's algorithm
+  for (std::size_t i = 0; i < num_axes_; ++i) {
+    errors_[i] += deltas_[i];
+    if (errors_[i] >= major_steps_) {
+      errors_[i] -= major_steps_;
+      ports_[step_ports_[i]].pending = static_cast<uint16_t>(ports_[step_ports_[i]].pending | step_pins_[i]);
+      position_[i] = position_[i] + directions_[i];
+    }
+  }
+}
+
+void Stepper::Finish() {
+  timer_disable_counter(timer_);
+  stopping_ = false;
+  busy_ = false;
+}
+
+void Stepper::SetIrqEnable(const bool flag) const {
+  if (flag) {
+    timer_enable_irq(timer_, TIM_DIER_UIE);
+  } else {
+    timer_disable_irq(timer_, TIM_DIER_UIE);
+  }
+}
+
+#elif !defined(LIB_USE_STEPPER)
+#error "LIB_USE_STEPPER macro not found. (Did you define it in your board configuration?)"
+#endif
@@ -0,0 +1,319 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_LIB_STEPPER_H_
+#define RTLIB_LIB_STEPPER_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "config/config.h"
+#include "core/gpio.h"
+
+static_assert(LIB_USE_STEPPER > 0, "Stepper library is disabled in your configuration.");
+
+/**
+ * @brief HAL implementation for step/direction stepper motor drivers.
+ *
+ * This abstraction layer generates step pulses for up to four axes from the update interrupt of one hardware timer,
+ * which runs at a fixed tick rate while a move is in progress. Each tick, the velocity is integrated into a phase
+ * accumulator, and a step is made whenever the accumulator overflows. The acceleration (and, for S-curve profiles,
+ * the jerk) is in turn integrated into the velocity, so every tick costs a few additions, without any division or
+ * square root.
+ *
+ * Moves are coordinated: the axis with the most steps follows the velocity profile, and all other axes are
+ * interpolated from it with Bresenham's algorithm, so all axes start and finish together on a straight line. Step
+ * pins which share a GPIO port are written together with one @c BSRR write, so all axes of a port step on the same
+ * edge. Each step pulse is one tick long, so the step rate is limited to half the tick rate.
+ *
+ * Deceleration mirrors the acceleration phase in reverse, so it starts when the remaining steps equal the steps taken
+ * while accelerating. For moves too short to reach full speed, the acceleration reverses instantly at the midpoint,
+ * i.e. the jerk limit of S-curve profiles does not apply there.
+ *
+ * One Stepper object is designed to manage one set of axes on the mainboard.
+ */
+class Stepper {
+ public:
+  /**
+   * @brief Maximum number of axes.
+   */
+  static constexpr std::size_t kMaxAxes = 4;
+
+  /**
+   * @brief Velocity profile of a move.
+   *
+   * All values refer to the axis with the most steps in a move.
+   */
+  struct Profile {
+    /**
+     * @brief Cruise speed, in steps/s. Must not exceed half of the tick frequency.
+     */
+    float max_speed = 1000.0f;
+    /**
+     * @brief Maximum acceleration and deceleration, in steps/s^2.
+     */
+    float acceleration = 10000.0f;
+    /**
+     * @brief Maximum jerk, in steps/s^3. 0 selects a trapezoidal profile, otherwise an S-curve profile is used.
+     */
+    float jerk = 0.0f;
+  };
+
+  /**
+   * @brief Configuration for stepper.
+   */
+  struct Config {
+    /**
+     * @brief ID of the stepper.
+     *
+     * See your device configuration header file to see which id corresponds to which set of axes.
+     */
+    uint8_t id = 0;
+    /**
+     * @brief Tick frequency, in Hz. Determines the maximum step rate and the resolution of step timing.
+     */
+    uint32_t tick_frequency = 50000;
+    /**
+     * @brief Priority of the timer interrupt. Lower values have higher priority.
+     *
+     * Step timing jitters by the latency of this interrupt, so it should have a high priority.
+     */
+    uint8_t priority = 0x20;
+  };
+
+  /**
+   * @brief Default constructor for stepper.
+   *
+   * @param config Stepper configuration
+   */
+  explicit Stepper(const Config& config);
+
+  /**
+   * @brief Destructor.
+   *
+   * Aborts any move in progress.
+   */
+  ~Stepper();
+
+  /**
+   * @brief Move constructor for stepper.
+   *
+   * This constructor is deleted because the interrupt handler refers to this object.
+   */
+  Stepper(Stepper&&) = delete;
+  /**
+   * @brief Move assignment operator for stepper.
+   *
+   * This operator is deleted because the interrupt handler refers to this object.
+   */
+  Stepper& operator=(Stepper&&) = delete;
+
+  /**
+   * @brief Copy constructor for stepper.
+   *
+   * This constructor is deleted because there should only be one object managing each timer.
+   */
+  Stepper(const Stepper&) = delete;
+  /**
+   * @brief Copy assignment operator for stepper.
+   *
+   * This operator is deleted because there should only be one object managing each timer.
+   */
+  Stepper& operator=(const Stepper&) = delete;
+
+  /**
+   * @brief Starts a coordinated move relative to the current position.
+   *
+   * @param steps Number of steps to move each axis. Entries beyond GetNumAxes() must be 0.
+   * @param profile Velocity profile
+   * @return @c true if the move is started, @c false if another move is in progress.
+   */
+  bool Move(const std::array<int32_t, kMaxAxes>& steps, const Profile& profile);
+
+  /**
+   * @brief Decelerates the move in progress to a stop, following its profile.
+   */
+  void Stop();
+
+  /**
+   * @brief Stops the move in progress immediately, without decelerating.
+   *
+   * Steps may be lost if the motors are moving fast.
+   */
+  void Abort();
+
+  /**
+   * @return @c true if a move is in progress.
+   */
+  bool IsBusy() const { return busy_; }
+
+  /**
+   * @return Number of axes defined by the board configuration.
+   */
+  std::size_t GetNumAxes() const { return num_axes_; }
+
+  /**
+   * @return Position of each axis, in steps.
+   */
+  std::array<int32_t, kMaxAxes> GetPosition() const;
+
+  /**
+   * @brief Redefines the current position of each axis.
+   *
+   * @param position New position of each axis, in steps
+   */
+  void SetPosition(const std::array<int32_t, kMaxAxes>& position);
+
+ private:
+  /**
+   * @brief Fixed-point representation of one step, i.e. velocities are in steps per tick with 48 fractional bits.
+   */
+  static constexpr uint64_t kOneStep = uint64_t{1} << 48;
+
+  /**
+   * @brief Enumeration of the phases of a move.
+   */
+  enum struct Phase {
+    kAccel,
+    kCruise,
+    kDecel
+  };
+
+  /**
+   * @brief Enumeration of the segments of the acceleration phase.
+   *
+   * Trapezoidal profiles only use kConstant.
+   */
+  enum struct Segment {
+    /**
+     * @brief Acceleration increases at the jerk limit.
+     */
+    kJerkUp,
+    /**
+     * @brief Acceleration is constant.
+     */
+    kConstant,
+    /**
+     * @brief Acceleration decreases at the jerk limit.
+     */
+    kJerkDown
+  };
+
+  /**
+   * @brief Step pins of one GPIO port.
+   */
+  struct Port {
+    uint32_t port;
+    /**
+     * @brief Pins of all axes on this port.
+     */
+    uint16_t all;
+    /**
+     * @brief Pins which step in the current tick.
+     */
+    uint16_t pending;
+  };
+
+  static void HandleTimerIrq(void* context);
+
+  /**
+   * @brief Advances the move by one tick.
+   */
+  void Tick();
+  /**
+   * @brief Updates the velocity for one tick of the acceleration phase.
+   */
+  void Accelerate();
+  /**
+   * @brief Updates the velocity for one tick of the deceleration phase, by undoing the acceleration phase in reverse.
+   */
+  void Decelerate();
+  /**
+   * @brief Makes one step along the profile, and the corresponding steps of the interpolated axes.
+   */
+  void Step();
+  /**
+   * @brief Stops the timer after a move.
+   */
+  void Finish();
+
+  void SetIrqEnable(bool flag) const;
+
+  uint32_t timer_;
+  uint32_t tick_frequency_;
+  std::size_t num_axes_ = 0;
+
+  std::array<std::optional<CORE_NS::GPIO>, kMaxAxes> step_gpios_;
+  std::array<std::optional<CORE_NS::GPIO>, kMaxAxes> dir_gpios_;
+  /**
+   * @brief Index into @c ports_ of the step pin of each axis.
+   */
+  std::array<uint8_t, kMaxAxes> step_ports_ = {};
+  std::array<uint16_t, kMaxAxes> step_pins_ = {};
+  std::array<Port, kMaxAxes> ports_ = {};
+  std::size_t num_ports_ = 0;
+  /**
+   * @brief Whether the step pins are high, i.e. need to be cleared in the next tick.
+   */
+  bool pulse_high_ = false;
+
+  volatile bool busy_ = false;
+  /**
+   * @brief Whether Stop() has been requested.
+   */
+  volatile bool stopping_ = false;
+  std::array<volatile int32_t, kMaxAxes> position_ = {};
+
+  // Move parameters. Velocity, acceleration and jerk are in fixed-point steps per tick (and tick^2 and tick^3).
+  std::array<int8_t, kMaxAxes> directions_ = {};
+  std::array<uint32_t, kMaxAxes> deltas_ = {};
+  std::array<uint32_t, kMaxAxes> errors_ = {};
+  uint32_t major_steps_ = 0;
+  uint64_t max_velocity_ = 0;
+  uint64_t max_accel_ = 0;
+  uint64_t jerk_ = 0;
+
+  // Move state
+  Phase phase_ = Phase::kAccel;
+  Segment segment_ = Segment::kConstant;
+  uint64_t velocity_ = 0;
+  /**
+   * @brief Velocity at the first step, which is the lowest velocity during deceleration.
+   */
+  uint64_t min_velocity_ = 0;
+  uint64_t accel_ = 0;
+  uint64_t phase_accumulator_ = 0;
+  /**
+   * @brief Velocity gained while the acceleration increased, which is also the velocity gained while it decreases.
+   */
+  uint64_t jerk_velocity_ = 0;
+  /**
+   * @brief Number of ticks spent in each segment of the acceleration phase.
+   */
+  std::array<uint32_t, 3> segment_ticks_ = {};
+  uint32_t steps_done_ = 0;
+  /**
+   * @brief Number of steps made during the acceleration phase.
+   */
+  uint32_t accel_steps_ = 0;
+};
+
+#endif  // RTLIB_LIB_STEPPER_H_
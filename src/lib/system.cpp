@@ -26,6 +26,10 @@ System::ClockResolution System::clock_res_ = System::ClockResolution::kStdRes;
 
 namespace {
 volatile uint64_t counter = 0;
+/**
+ * @brief Microseconds passed to System::Compensate() which did not add up to a full clock update.
+ */
+uint64_t compensated_remainder = 0;
 }  // namespace
 
 extern "C" void sys_tick_handler();
@@ -85,3 +89,14 @@ void System::DelayMs(uint64_t wait_ms) {
 void System::DelayS(uint64_t wait_s) {
   DelayUs(wait_s * 1000000);
 }
+
+void System::Compensate(uint64_t elapsed_us) {
+  const uint64_t us_per_update = 1000000 / clock_res_;
+  elapsed_us += compensated_remainder;
+  compensated_remainder = elapsed_us % us_per_update;
+
+  // The counter is 64-bit, so the update must not be interrupted by SysTick
+  systick_interrupt_disable();
+  counter = counter + elapsed_us / us_per_update;
+  systick_interrupt_enable();
+}
@@ -139,6 +139,16 @@ class System final {
    */
   static void DelayS(uint64_t wait_s);
 
+  /**
+   * @brief Advances the clock by time which passed while SysTick was halted.
+   *
+   * SysTick does not run in stop mode, so the time spent in stop mode must be measured by another clock (e.g. Rtc) and
+   * added back after waking up. Fractions of a clock update are carried over to the next call.
+   *
+   * @param elapsed_us Microseconds which were not counted by the clock.
+   */
+  static void Compensate(uint64_t elapsed_us);
+
  private:
   static bool has_init_;
   static ClockResolution clock_res_;
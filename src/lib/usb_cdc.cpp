@@ -0,0 +1,518 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config/config.h"
+
+#if defined(LIB_USE_USBCDC) && LIB_USE_USBCDC > 0
+
+#if defined(STM32F1) && LIB_USE_CAN > 0
+#error "USB and CAN share packet memory and interrupt vectors on STM32F1xx devices, and cannot be used together."
+#endif  // defined(STM32F1) && LIB_USE_CAN > 0
+
+#include "lib/usb_cdc.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include <libopencm3/cm3/nvic.h>
+#include <libopencm3/stm32/desig.h>
+#include <libopencm3/stm32/rcc.h>
+#if defined(STM32F4)
+#include <libopencm3/stm32/otg_fs.h>
+#endif
+
+using CORE_NS::GPIO;
+
+namespace {
+/**
+ * @brief Object which handles the USB interrupt.
+ */
+UsbCdc* instance = nullptr;
+
+constexpr uint8_t kDataOutEndpoint = 0x01;
+constexpr uint8_t kDataInEndpoint = 0x82;
+constexpr uint8_t kNotificationEndpoint = 0x83;
+
+/**
+ * @brief Device descriptor. The descriptors of this device follow the CDC-ACM example of libopencm3.
+ */
+const usb_device_descriptor kDeviceDescriptor = {
+    USB_DT_DEVICE_SIZE,  // bLength
+    USB_DT_DEVICE,  // bDescriptorType
+    0x0200,  // bcdUSB
+    USB_CLASS_CDC,  // bDeviceClass
+    0,  // bDeviceSubClass
+    0,  // bDeviceProtocol
+    64,  // bMaxPacketSize0
+    0x0483,  // idVendor: STMicroelectronics
+    0x5740,  // idProduct: Virtual COM Port
+    0x0200,  // bcdDevice
+    1,  // iManufacturer
+    2,  // iProduct
+    3,  // iSerialNumber
+    1  // bNumConfigurations
+};
+
+const std::array<usb_endpoint_descriptor, 1> kCommEndpoints = {{
+    {
+        USB_DT_ENDPOINT_SIZE,  // bLength
+        USB_DT_ENDPOINT,  // bDescriptorType
+        kNotificationEndpoint,  // bEndpointAddress
+        USB_ENDPOINT_ATTR_INTERRUPT,  // bmAttributes
+        16,  // wMaxPacketSize
+        255,  // bInterval
+        nullptr,  // extra
+        0  // extralen
+    }
+}};
+
+const std::array<usb_endpoint_descriptor, 2> kDataEndpoints = {{
+    {
+        USB_DT_ENDPOINT_SIZE,  // bLength
+        USB_DT_ENDPOINT,  // bDescriptorType
+        kDataOutEndpoint,  // bEndpointAddress
+        USB_ENDPOINT_ATTR_BULK,  // bmAttributes
+        UsbCdc::kPacketSize,  // wMaxPacketSize
+        1,  // bInterval
+        nullptr,  // extra
+        0  // extralen
+    },
+    {
+        USB_DT_ENDPOINT_SIZE,  // bLength
+        USB_DT_ENDPOINT,  // bDescriptorType
+        kDataInEndpoint,  // bEndpointAddress
+        USB_ENDPOINT_ATTR_BULK,  // bmAttributes
+        UsbCdc::kPacketSize,  // wMaxPacketSize
+        1,  // bInterval
+        nullptr,  // extra
+        0  // extralen
+    }
+}};
+
+/**
+ * @brief Class-specific descriptors of the communication interface.
+ */
+struct __attribute__((packed)) CdcAcmFunctionalDescriptors {
+  usb_cdc_header_descriptor header;
+  usb_cdc_call_management_descriptor call_mgmt;
+  usb_cdc_acm_descriptor acm;
+  usb_cdc_union_descriptor cdc_union;
+};
+
+const CdcAcmFunctionalDescriptors kFunctionalDescriptors = {
+    {sizeof(usb_cdc_header_descriptor), CS_INTERFACE, USB_CDC_TYPE_HEADER, 0x0110},
+    {sizeof(usb_cdc_call_management_descriptor), CS_INTERFACE, USB_CDC_TYPE_CALL_MANAGEMENT, 0, 1},
+    {sizeof(usb_cdc_acm_descriptor), CS_INTERFACE, USB_CDC_TYPE_ACM, 0},
+    {sizeof(usb_cdc_union_descriptor), CS_INTERFACE, USB_CDC_TYPE_UNION, 0, 1}
+};
+
+const usb_interface_descriptor kCommInterface = {
+    USB_DT_INTERFACE_SIZE,  // bLength
+    USB_DT_INTERFACE,  // bDescriptorType
+    0,  // bInterfaceNumber
+    0,  // bAlternateSetting
+    1,  // bNumEndpoints
+    USB_CLASS_CDC,  // bInterfaceClass
+    USB_CDC_SUBCLASS_ACM,  // bInterfaceSubClass
+    USB_CDC_PROTOCOL_AT,  // bInterfaceProtocol
+    0,  // iInterface
+    kCommEndpoints.data(),  // endpoint
+    &kFunctionalDescriptors,  // extra
+    sizeof(kFunctionalDescriptors)  // extralen
+};
+
+const usb_interface_descriptor kDataInterface = {
+    USB_DT_INTERFACE_SIZE,  // bLength
+    USB_DT_INTERFACE,  // bDescriptorType
+    1,  // bInterfaceNumber
+    0,  // bAlternateSetting
+    2,  // bNumEndpoints
+    USB_CLASS_DATA,  // bInterfaceClass
+    0,  // bInterfaceSubClass
+    0,  // bInterfaceProtocol
+    0,  // iInterface
+    kDataEndpoints.data(),  // endpoint
+    nullptr,  // extra
+    0  // extralen
+};
+
+const std::array<usb_interface, 2> kInterfaces = {{
+    {nullptr, 1, nullptr, &kCommInterface},
+    {nullptr, 1, nullptr, &kDataInterface}
+}};
+
+const usb_config_descriptor kConfigDescriptor = {
+    USB_DT_CONFIGURATION_SIZE,  // bLength
+    USB_DT_CONFIGURATION,  // bDescriptorType
+    0,  // wTotalLength, filled in by the USB stack
+    2,  // bNumInterfaces
+    1,  // bConfigurationValue
+    0,  // iConfiguration
+    USB_CONFIG_ATTR_DEFAULT,  // bmAttributes: bus powered
+    50,  // bMaxPower: 100mA
+    kInterfaces.data()  // interface
+};
+
+/**
+ * @brief Serial number string, generated from the unique device ID.
+ */
+std::array<char, 25> serial_string = {};
+
+const std::array<const char*, 3> kStrings = {
+    "RTLib",
+    "RTLib Virtual COM Port",
+    serial_string.data()
+};
+
+#if defined(STM32F1)
+constexpr uint8_t kIrqn = NVIC_USB_LP_CAN_RX0_IRQ;
+#elif defined(STM32F4)
+constexpr uint8_t kIrqn = NVIC_OTG_FS_IRQ;
+
+/**
+ * @brief Hardware configuration of one USB port, as read from the board configuration.
+ */
+struct HwConfig {
+  Pinout dm;
+  Pinout dp;
+  GPIO::AltFn altfn = GPIO_AF0;
+};
+
+inline HwConfig GetConfigHw(const uint8_t id) {
+  assert(id < LIB_USE_USBCDC);
+  HwConfig hw;
+  switch (id) {
+    default:
+      // not handled, since assert will catch this error
+      assert(false);
+      break;
+#if LIB_USE_USBCDC > 0
+    case 0:
+      hw.dm = Pinout(LIB_USBCDC0_DM_PINOUT);
+      hw.dp = Pinout(LIB_USBCDC0_DP_PINOUT);
+      hw.altfn = LIB_USBCDC0_ALTFN;
+      break;
+#endif  // LIB_USE_USBCDC > 0
+  }
+  return hw;
+}
+#endif
+}  // namespace
+
+#if defined(STM32F1)
+extern "C" void usb_lp_can_rx0_isr();
+
+extern "C" void usb_lp_can_rx0_isr() {
+  if (instance != nullptr) {
+    instance->HandleIrq();
+  }
+}
+#elif defined(STM32F4)
+extern "C" void otg_fs_isr();
+
+extern "C" void otg_fs_isr() {
+  if (instance != nullptr) {
+    instance->HandleIrq();
+  }
+}
+#endif
+
+UsbCdc::UsbCdc(const Config& config) :
+    line_coding_{115200, 0, 0, 8} {
+  assert(instance == nullptr);
+  instance = this;
+
+#if defined(STM32F1)
+  // USB pins are fixed to PA11/PA12, and are taken over by the peripheral once it is enabled
+  assert(config.id < LIB_USE_USBCDC);
+  static_cast<void>(config);
+  rcc_periph_clock_enable(RCC_USB);
+#elif defined(STM32F4)
+  const HwConfig hw = GetConfigHw(config.id);
+  gpios_[0].emplace(hw.dm, GPIO::Mode::kAF, GPIO::Pullup::kNone, GPIO::Speed::k100MHz, GPIO::DriverType::kPushPull,
+                    hw.altfn);
+  gpios_[1].emplace(hw.dp, GPIO::Mode::kAF, GPIO::Pullup::kNone, GPIO::Speed::k100MHz, GPIO::DriverType::kPushPull,
+                    hw.altfn);
+  rcc_periph_clock_enable(RCC_OTGFS);
+#endif
+
+  desig_get_unique_id_as_string(serial_string.data(), serial_string.size());
+
+#if defined(STM32F1)
+  dev_ = usbd_init(&st_usbfs_v1_usb_driver,
+                   &kDeviceDescriptor,
+                   &kConfigDescriptor,
+                   kStrings.data(),
+                   static_cast<int>(kStrings.size()),
+                   control_buffer_.data(),
+                   static_cast<uint16_t>(control_buffer_.size()));
+#elif defined(STM32F4)
+  dev_ = usbd_init(&otgfs_usb_driver,
+                   &kDeviceDescriptor,
+                   &kConfigDescriptor,
+                   kStrings.data(),
+                   static_cast<int>(kStrings.size()),
+                   control_buffer_.data(),
+                   static_cast<uint16_t>(control_buffer_.size()));
+
+  // VBUS is usually not routed to PA9, so assume that the device is always powered by the host
+  OTG_FS_GCCFG |= OTG_GCCFG_NOVBUSSENS;
+  OTG_FS_GCCFG &= ~static_cast<uint32_t>(OTG_GCCFG_VBUSBSEN);
+#endif
+
+  usbd_register_reset_callback(dev_, &UsbCdc::HandleReset);
+  usbd_register_set_config_callback(dev_, &UsbCdc::HandleSetConfig);
+
+  nvic_enable_irq(kIrqn);
+}
+
+UsbCdc::~UsbCdc() {
+  nvic_disable_irq(kIrqn);
+  usbd_disconnect(dev_, true);
+  instance = nullptr;
+}
+
+std::size_t UsbCdc::Write(const uint8_t* data, const std::size_t size) {
+  if (!configured_) {
+    return 0;
+  }
+
+  SetIrqEnable(false);
+
+  const std::size_t length = std::min(size, kTxBufferSize - tx_staged_length_);
+  std::memcpy(tx_buffers_[tx_staged_index_].data() + tx_staged_length_, data, length);
+  tx_staged_length_ += length;
+
+  // Otherwise the staging buffer will be sent when the current transmission completes
+  if (!tx_busy_) {
+    StartTxStaged();
+  }
+
+  SetIrqEnable(true);
+  return length;
+}
+
+bool UsbCdc::Submit(const uint8_t* data, const std::size_t size, const Callback callback, void* context) {
+  SetIrqEnable(false);
+
+  // Submissions bypass the staging buffers, so they must not overtake data which is already staged
+  const bool accepted = configured_ && !tx_busy_ && tx_staged_length_ == 0;
+  if (accepted) {
+    StartTx(data, size, callback, context);
+  }
+
+  SetIrqEnable(true);
+  return accepted;
+}
+
+std::size_t UsbCdc::Read(uint8_t* data, const std::size_t size) {
+  std::size_t count = 0;
+  while (count < size) {
+    const uint8_t length = rx_lengths_[rx_read_index_].load(std::memory_order_acquire);
+    if (length == 0) {
+      break;
+    }
+
+    const std::size_t n = std::min<std::size_t>(length - rx_read_offset_, size - count);
+    std::memcpy(data + count, rx_buffers_[rx_read_index_].data() + rx_read_offset_, n);
+    count += n;
+    rx_read_offset_ = static_cast<uint8_t>(rx_read_offset_ + n);
+
+    if (rx_read_offset_ == length) {
+      // Release the buffer to the interrupt handler, and accept packets again if they were held off
+      rx_read_offset_ = 0;
+      rx_lengths_[rx_read_index_].store(0, std::memory_order_release);
+      rx_read_index_ ^= 1;
+
+      SetIrqEnable(false);
+      if (rx_nak_) {
+        rx_nak_ = false;
+        usbd_ep_nak_set(dev_, kDataOutEndpoint, 0);
+      }
+      SetIrqEnable(true);
+    }
+  }
+  return count;
+}
+
+void UsbCdc::HandleIrq() {
+  usbd_poll(dev_);
+}
+
+void UsbCdc::HandleReset() {
+  instance->configured_ = false;
+  instance->dtr_ = false;
+}
+
+void UsbCdc::HandleSetConfig(usbd_device* dev, uint16_t) {
+  usbd_ep_setup(dev, kDataOutEndpoint, USB_ENDPOINT_ATTR_BULK, kPacketSize, &UsbCdc::HandleDataRx);
+  usbd_ep_setup(dev, kDataInEndpoint, USB_ENDPOINT_ATTR_BULK, kPacketSize, &UsbCdc::HandleDataTx);
+  usbd_ep_setup(dev, kNotificationEndpoint, USB_ENDPOINT_ATTR_INTERRUPT, 16, nullptr);
+
+  usbd_register_control_callback(dev,
+                                 USB_REQ_TYPE_CLASS | USB_REQ_TYPE_INTERFACE,
+                                 USB_REQ_TYPE_TYPE | USB_REQ_TYPE_RECIPIENT,
+                                 &UsbCdc::HandleControl);
+
+  instance->ResetState();
+  instance->configured_ = true;
+}
+
+usbd_request_return_codes UsbCdc::HandleControl(usbd_device*,
+                                                usb_setup_data* req,
+                                                uint8_t** buf,
+                                                uint16_t* len,
+                                                usbd_control_complete_callback*) {
+  switch (req->bRequest) {
+    case USB_CDC_REQ_SET_CONTROL_LINE_STATE:
+      instance->dtr_ = (req->wValue & 0x1) != 0;
+      return USBD_REQ_HANDLED;
+    case USB_CDC_REQ_SET_LINE_CODING:
+      if (*len < sizeof(usb_cdc_line_coding)) {
+        return USBD_REQ_NOTSUPP;
+      }
+      std::memcpy(&instance->line_coding_, *buf, sizeof(usb_cdc_line_coding));
+      return USBD_REQ_HANDLED;
+    case USB_CDC_REQ_GET_LINE_CODING:
+      *buf = reinterpret_cast<uint8_t*>(&instance->line_coding_);
+      *len = sizeof(usb_cdc_line_coding);
+      return USBD_REQ_HANDLED;
+    default:
+      return USBD_REQ_NOTSUPP;
+  }
+}
+
+void UsbCdc::HandleDataRx(usbd_device* dev, const uint8_t ep) {
+  UsbCdc* self = instance;
+  const uint8_t index = self->rx_write_index_;
+  assert(self->rx_lengths_[index].load(std::memory_order_acquire) == 0);
+
+  // If the other buffer has not been read yet, hold off the host before the endpoint is re-armed by the read below
+  if (self->rx_lengths_[index ^ 1].load(std::memory_order_acquire) != 0) {
+    self->rx_nak_ = true;
+    usbd_ep_nak_set(dev, ep, 1);
+  }
+
+  const uint16_t length = usbd_ep_read_packet(dev, ep, self->rx_buffers_[index].data(), kPacketSize);
+  if (length == 0) {
+    return;
+  }
+
+  self->rx_lengths_[index].store(static_cast<uint8_t>(length), std::memory_order_release);
+  self->rx_write_index_ ^= 1;
+}
+
+void UsbCdc::HandleDataTx(usbd_device* dev, const uint8_t ep) {
+  UsbCdc* self = instance;
+  if (!self->tx_busy_) {
+    return;
+  }
+
+  if (self->tx_remaining_ > 0) {
+    self->SendPacket();
+    return;
+  }
+  if (self->tx_needs_zlp_) {
+    // A transfer which ends with a full packet must be terminated by a zero-length packet
+    self->tx_needs_zlp_ = false;
+    usbd_ep_write_packet(dev, ep, nullptr, 0);
+    return;
+  }
+
+  const Callback callback = self->tx_callback_;
+  void* const context = self->tx_context_;
+  self->tx_busy_ = false;
+  self->tx_callback_ = nullptr;
+  self->tx_context_ = nullptr;
+
+  if (callback != nullptr) {
+    callback(context);
+  }
+
+  // Keep the endpoint busy with data staged during this transmission
+  if (!self->tx_busy_) {
+    self->StartTxStaged();
+  }
+}
+
+void UsbCdc::ResetState() {
+  for (auto& length : rx_lengths_) {
+    length.store(0, std::memory_order_relaxed);
+  }
+  rx_write_index_ = 0;
+  rx_read_index_ = 0;
+  rx_read_offset_ = 0;
+  rx_nak_ = false;
+
+  const Callback callback = tx_callback_;
+  void* const context = tx_context_;
+  tx_staged_length_ = 0;
+  tx_remaining_ = 0;
+  tx_needs_zlp_ = false;
+  tx_busy_ = false;
+  tx_callback_ = nullptr;
+  tx_context_ = nullptr;
+
+  if (callback != nullptr) {
+    callback(context);
+  }
+}
+
+void UsbCdc::StartTx(const uint8_t* data, const std::size_t size, const Callback callback, void* context) {
+  tx_data_ = data;
+  tx_remaining_ = size;
+  tx_callback_ = callback;
+  tx_context_ = context;
+  tx_busy_ = true;
+  SendPacket();
+}
+
+void UsbCdc::StartTxStaged() {
+  if (tx_staged_length_ == 0) {
+    return;
+  }
+
+  // Swap the staging buffers, so that new data is written into the other buffer while this one is being sent
+  const uint8_t* data = tx_buffers_[tx_staged_index_].data();
+  const std::size_t size = tx_staged_length_;
+  tx_staged_index_ ^= 1;
+  tx_staged_length_ = 0;
+  StartTx(data, size, nullptr, nullptr);
+}
+
+void UsbCdc::SendPacket() {
+  const auto length = static_cast<uint16_t>(std::min(tx_remaining_, kPacketSize));
+  usbd_ep_write_packet(dev_, kDataInEndpoint, tx_data_, length);
+  tx_data_ += length;
+  tx_remaining_ -= length;
+  tx_needs_zlp_ = tx_remaining_ == 0 && length == kPacketSize;
+}
+
+void UsbCdc::SetIrqEnable(const bool flag) {
+  if (flag) {
+    nvic_enable_irq(kIrqn);
+  } else {
+    nvic_disable_irq(kIrqn);
+  }
+}
+
+#elif !defined(LIB_USE_USBCDC)
+#error "LIB_USE_USBCDC macro not found. (Did you define it in your board configuration?)"
+#endif
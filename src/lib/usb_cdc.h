@@ -0,0 +1,258 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_LIB_USB_CDC_H_
+#define RTLIB_LIB_USB_CDC_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include <libopencm3/usb/cdc.h>
+#include <libopencm3/usb/usbd.h>
+
+#include "config/config.h"
+#include "core/gpio.h"
+
+static_assert(LIB_USE_USBCDC > 0, "UsbCdc library is disabled in your configuration.");
+
+/**
+ * @brief HAL implementation for a USB virtual COM port.
+ *
+ * This abstraction layer implements a full-speed CDC-ACM device on top of the libopencm3 USB device stack, using the
+ * USB FS device peripheral of STM32F1xx devices or the OTG_FS peripheral of STM32F4xx devices. The device appears as
+ * a serial port on the host, and is used as a plain byte stream; the baud rate set by the host is ignored.
+ *
+ * Both directions are double-buffered in RAM. Received packets are stored into one of two packet buffers while the
+ * other is being read, and the host is held off (NAKed) while both are full, so no data is ever dropped. Transmitted
+ * data is either copied into one of two staging buffers while the other is being sent (Write()), or sent directly from
+ * the caller's buffer without copying (Submit()).
+ *
+ * @note The bulk endpoints themselves are single-buffered, since the libopencm3 USB device stack does not configure
+ * the hardware double-buffered endpoint mode. The endpoint is NAKed while the CPU copies each packet between packet
+ * memory and RAM, so the throughput is below what the hardware mode would achieve.
+ *
+ * One UsbCdc object is designed to manage the USB port on the mainboard.
+ */
+class UsbCdc {
+ public:
+  /**
+   * @brief Maximum packet size of the bulk endpoints.
+   */
+  static constexpr std::size_t kPacketSize = 64;
+  /**
+   * @brief Size of each transmit staging buffer.
+   */
+  static constexpr std::size_t kTxBufferSize = 512;
+
+  /**
+   * @brief Type definition for the transmit completion callback.
+   *
+   * @param context User-defined pointer, as passed to Submit().
+   */
+  using Callback = void (*)(void* context);
+
+  /**
+   * @brief Configuration for USB CDC.
+   */
+  struct Config {
+    /**
+     * @brief ID of the USB port.
+     *
+     * See your device configuration header file to see which id corresponds to which USB port.
+     */
+    uint8_t id = 0;
+  };
+
+  /**
+   * @brief Default constructor for USB CDC.
+   *
+   * The device connects to the host immediately.
+   *
+   * @param config USB CDC configuration
+   */
+  explicit UsbCdc(const Config& config);
+
+  /**
+   * @brief Destructor.
+   *
+   * Disconnects the device from the host.
+   */
+  ~UsbCdc();
+
+  /**
+   * @brief Move constructor for USB CDC.
+   *
+   * This constructor is deleted because the USB stack refers to this object.
+   */
+  UsbCdc(UsbCdc&&) = delete;
+  /**
+   * @brief Move assignment operator for USB CDC.
+   *
+   * This operator is deleted because the USB stack refers to this object.
+   */
+  UsbCdc& operator=(UsbCdc&&) = delete;
+
+  /**
+   * @brief Copy constructor for USB CDC.
+   *
+   * This constructor is deleted because there should only be one object managing the USB port.
+   */
+  UsbCdc(const UsbCdc&) = delete;
+  /**
+   * @brief Copy assignment operator for USB CDC.
+   *
+   * This operator is deleted because there should only be one object managing the USB port.
+   */
+  UsbCdc& operator=(const UsbCdc&) = delete;
+
+  /**
+   * @return @c true if the host has configured the device.
+   */
+  bool IsConfigured() const { return configured_; }
+  /**
+   * @return @c true if the host has configured the device and opened the serial port (i.e. asserted DTR).
+   */
+  bool IsConnected() const { return configured_ && dtr_; }
+
+  /**
+   * @brief Queues data for transmission by copying it into a staging buffer.
+   *
+   * @param data Data to transmit
+   * @param size Number of bytes to transmit
+   * @return Number of bytes queued, which is less than @p size if the staging buffer is full, or 0 if the device is not
+   * configured.
+   */
+  std::size_t Write(const uint8_t* data, std::size_t size);
+
+  /**
+   * @brief Transmits data directly from a caller-owned buffer.
+   *
+   * The buffer is sent without being copied, so it must not be modified until the transfer completes, as indicated by
+   * @p callback or IsTxIdle(). A submission is only accepted when no other transmission is pending.
+   *
+   * @param data Data to transmit
+   * @param size Number of bytes to transmit
+   * @param callback Function to invoke from the USB interrupt when the buffer is no longer used, or @c nullptr
+   * @param context User-defined pointer which will be passed to @p callback
+   * @return @c true if the transfer is started.
+   */
+  bool Submit(const uint8_t* data, std::size_t size, Callback callback = nullptr, void* context = nullptr);
+
+  /**
+   * @return @c true if there is no pending transmission.
+   */
+  bool IsTxIdle() const { return !tx_busy_; }
+
+  /**
+   * @brief Reads received data.
+   *
+   * This function must only be called from one context.
+   *
+   * @param data Buffer to store the received data
+   * @param size Maximum number of bytes to read
+   * @return Number of bytes read.
+   */
+  std::size_t Read(uint8_t* data, std::size_t size);
+
+  /**
+   * @brief Handles a USB interrupt.
+   *
+   * @warning This function is invoked by the USB interrupt handler. Do not call this function directly.
+   */
+  void HandleIrq();
+
+ private:
+  static void HandleReset();
+  static void HandleSetConfig(usbd_device* dev, uint16_t value);
+  static usbd_request_return_codes HandleControl(usbd_device* dev,
+                                                 usb_setup_data* req,
+                                                 uint8_t** buf,
+                                                 uint16_t* len,
+                                                 usbd_control_complete_callback* complete);
+  static void HandleDataRx(usbd_device* dev, uint8_t ep);
+  static void HandleDataTx(usbd_device* dev, uint8_t ep);
+
+  /**
+   * @brief Discards all pending transfers.
+   *
+   * The callback of a pending Submit() is invoked, since its buffer is released.
+   */
+  void ResetState();
+
+  /**
+   * @brief Starts transmitting a buffer.
+   *
+   * @note This function must be called with the USB interrupt masked.
+   */
+  void StartTx(const uint8_t* data, std::size_t size, Callback callback, void* context);
+  /**
+   * @brief Starts transmitting the staging buffer which is being filled, if it is not empty.
+   *
+   * @note This function must be called with the USB interrupt masked.
+   */
+  void StartTxStaged();
+  /**
+   * @brief Writes the next packet of the current transmission into the endpoint.
+   */
+  void SendPacket();
+
+  /**
+   * @brief Enables or disables the USB interrupt, to protect state shared with the interrupt handler.
+   */
+  void SetIrqEnable(bool flag);
+
+  usbd_device* dev_ = nullptr;
+  std::array<uint8_t, 128> control_buffer_;
+  usb_cdc_line_coding line_coding_;
+
+  volatile bool configured_ = false;
+  volatile bool dtr_ = false;
+
+  std::array<std::array<uint8_t, kPacketSize>, 2> rx_buffers_;
+  /**
+   * @brief Number of unread bytes in each receive buffer. A buffer may only be written by the interrupt handler when
+   * its length is 0.
+   */
+  std::array<std::atomic<uint8_t>, 2> rx_lengths_ = {};
+  uint8_t rx_write_index_ = 0;
+  uint8_t rx_read_index_ = 0;
+  uint8_t rx_read_offset_ = 0;
+  /**
+   * @brief Whether the OUT endpoint is NAKed because both receive buffers are full.
+   */
+  volatile bool rx_nak_ = false;
+
+  std::array<std::array<uint8_t, kTxBufferSize>, 2> tx_buffers_;
+  std::size_t tx_staged_length_ = 0;
+  uint8_t tx_staged_index_ = 0;
+
+  const uint8_t* tx_data_ = nullptr;
+  std::size_t tx_remaining_ = 0;
+  bool tx_needs_zlp_ = false;
+  volatile bool tx_busy_ = false;
+  Callback tx_callback_ = nullptr;
+  void* tx_context_ = nullptr;
+
+  std::array<std::optional<CORE_NS::GPIO>, 2> gpios_;
+};
+
+#endif  // RTLIB_LIB_USB_CDC_H_
@@ -0,0 +1,115 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config/config.h"
+
+#if defined(LIB_USE_WATCHDOG) && LIB_USE_WATCHDOG > 0
+
+#include "lib/watchdog.h"
+
+#include <cassert>
+
+#include <libopencm3/stm32/iwdg.h>
+#include <libopencm3/stm32/pwr.h>
+#include <libopencm3/stm32/rcc.h>
+#if defined(STM32F1)
+#include <libopencm3/stm32/f1/bkp.h>
+#elif defined(STM32F4)
+#include <libopencm3/stm32/rtc.h>
+#endif
+
+#include "lib/system.h"
+
+namespace {
+/**
+ * @brief Upper byte of the backup register which indicates that the lower byte holds a missed task.
+ */
+constexpr uint32_t kRecordMagic = 0x5700;
+constexpr uint32_t kRecordMagicMask = 0xFF00;
+
+#if defined(STM32F1)
+#define RECORD_REGISTER BKP_DR2
+#elif defined(STM32F4)
+#define RECORD_REGISTER RTC_BKPXR(1)
+#endif
+}  // namespace
+
+Watchdog::Watchdog(const Config& config) :
+    refresh_period_ms_(config.timeout_ms / 2),
+    refresh_deadline_ms_(System::GetMs() + refresh_period_ms_) {
+  rcc_periph_clock_enable(RCC_PWR);
+#if defined(STM32F1)
+  rcc_periph_clock_enable(RCC_BKP);
+#endif
+  pwr_disable_backup_domain_write_protect();
+
+  // The flags also record the other reset causes, so clearing them is left to the application
+  was_reset_ = (RCC_CSR & RCC_CSR_IWDGRSTF) != 0;
+
+  const uint32_t record = RECORD_REGISTER & 0xFFFF;
+  if ((record & kRecordMagicMask) == kRecordMagic) {
+    missed_task_ = static_cast<uint8_t>(record & 0xFF);
+  }
+  RECORD_REGISTER = 0;
+
+  iwdg_set_period_ms(config.timeout_ms);
+  iwdg_start();
+}
+
+uint8_t Watchdog::AddTask(const uint32_t deadline_ms) {
+  assert(num_tasks_ < kMaxTasks);
+
+  Task& task = tasks_[num_tasks_];
+  task.deadline_ms = deadline_ms;
+  task.last_check_in_ms = System::GetMs();
+  task.checked_in.store(false, std::memory_order_relaxed);
+  return num_tasks_++;
+}
+
+void Watchdog::Service() {
+  if (missed_) {
+    return;
+  }
+
+  const uint64_t now_ms = System::GetMs();
+  for (uint8_t i = 0; i < num_tasks_; ++i) {
+    Task& task = tasks_[i];
+    if (task.checked_in.exchange(false, std::memory_order_relaxed)) {
+      task.last_check_in_ms = now_ms;
+    } else if (now_ms - task.last_check_in_ms > task.deadline_ms) {
+      // Only the first missed task is recorded, since the others may be blocked by it
+      Record(i);
+      missed_ = true;
+      return;
+    }
+  }
+
+  iwdg_reset();
+  refresh_deadline_ms_ = now_ms + refresh_period_ms_;
+}
+
+void Watchdog::Record(const uint8_t task) const {
+  RECORD_REGISTER = kRecordMagic | task;
+}
+
+#undef RECORD_REGISTER
+
+#elif !defined(LIB_USE_WATCHDOG)
+#error "LIB_USE_WATCHDOG macro not found. (Did you define it in your board configuration?)"
+#endif
@@ -0,0 +1,186 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_LIB_WATCHDOG_H_
+#define RTLIB_LIB_WATCHDOG_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "config/config.h"
+
+static_assert(LIB_USE_WATCHDOG > 0, "Watchdog library is disabled in your configuration.");
+
+/**
+ * @brief Supervisor for the independent watchdog.
+ *
+ * Each task or loop which must not stall is registered with its own deadline, and calls CheckIn() every time it makes
+ * progress. Service() refreshes the watchdog only if every task has checked in within its deadline. Otherwise the
+ * missed task is recorded into a backup register, and the watchdog is left to reset the device. The record can be
+ * read after the reset using GetMissedTask().
+ *
+ * Service() must be called periodically (e.g. from the main loop), more often than both the watchdog timeout and the
+ * shortest deadline. If Service() itself stalls, the device is reset without a record.
+ *
+ * The watchdog keeps running in stop mode. Pass the Watchdog to PowerManager, which wakes the device up in time for
+ * Service() using GetRefreshDeadline().
+ *
+ * Backup register 2 (STM32F1xx) or 1 (STM32F4xx) is used to record the missed task.
+ *
+ * There should only be one Watchdog object.
+ */
+class Watchdog {
+ public:
+  /**
+   * @brief Maximum number of tasks which can be registered.
+   */
+  static constexpr std::size_t kMaxTasks = 16;
+
+  /**
+   * @brief Configuration for the watchdog.
+   */
+  struct Config {
+    /**
+     * @brief Time after the last refresh until the device is reset, in milliseconds.
+     */
+    uint32_t timeout_ms = 500;
+  };
+
+  /**
+   * @brief Default constructor for the watchdog.
+   *
+   * Reads the record of the previous reset, and starts the watchdog. The watchdog cannot be stopped afterwards.
+   *
+   * The reset flags in RCC_CSR are left for the application to read, and must be cleared by the application (by setting
+   * RCC_CSR_RMVF) so that WasReset() reflects the cause of the next reset.
+   *
+   * @param config Watchdog configuration
+   */
+  explicit Watchdog(const Config& config);
+
+  /**
+   * @brief Default destructor.
+   *
+   * The watchdog keeps running, so the device is reset unless another object refreshes it.
+   */
+  ~Watchdog() = default;
+
+  /**
+   * @brief Move constructor for the watchdog.
+   *
+   * This constructor is deleted because tasks refer to this object when checking in.
+   */
+  Watchdog(Watchdog&&) = delete;
+  /**
+   * @brief Move assignment operator for the watchdog.
+   *
+   * This operator is deleted because tasks refer to this object when checking in.
+   */
+  Watchdog& operator=(Watchdog&&) = delete;
+
+  /**
+   * @brief Copy constructor for the watchdog.
+   *
+   * This constructor is deleted because there should only be one object managing the watchdog.
+   */
+  Watchdog(const Watchdog&) = delete;
+  /**
+   * @brief Copy assignment operator for the watchdog.
+   *
+   * This operator is deleted because there should only be one object managing the watchdog.
+   */
+  Watchdog& operator=(const Watchdog&) = delete;
+
+  /**
+   * @brief Registers a task.
+   *
+   * The deadline starts counting from the registration.
+   *
+   * @param deadline_ms Longest time allowed between two check-ins of the task, in milliseconds
+   * @return ID of the task, which is passed to CheckIn().
+   */
+  uint8_t AddTask(uint32_t deadline_ms);
+
+  /**
+   * @brief Reports that a task is making progress.
+   *
+   * This function is a single store, so it can be called from any context, including interrupt handlers.
+   *
+   * @param task ID of the task, as returned by AddTask()
+   */
+  void CheckIn(const uint8_t task) { tasks_[task].checked_in.store(true, std::memory_order_relaxed); }
+
+  /**
+   * @brief Checks the deadlines of all tasks, and refreshes the watchdog if none has been missed.
+   *
+   * Once a deadline is missed, the watchdog is never refreshed again.
+   */
+  void Service();
+
+  /**
+   * @brief Returns the System time by which Service() must refresh the watchdog again, in milliseconds.
+   *
+   * This is half the timeout after the last refresh, since the watchdog is clocked by the inaccurate low-speed internal
+   * oscillator. After a deadline is missed, this time is no longer advanced.
+   */
+  uint64_t GetRefreshDeadline() const { return refresh_deadline_ms_; }
+
+  /**
+   * @return @c true if the last reset was caused by the watchdog.
+   */
+  bool WasReset() const { return was_reset_; }
+  /**
+   * @return ID of the task which missed its deadline before the last reset, or @c std::nullopt if no task missed its
+   * deadline. If WasReset() is @c true but no task is recorded, Service() itself was not called in time.
+   */
+  std::optional<uint8_t> GetMissedTask() const { return missed_task_; }
+
+ private:
+  /**
+   * @brief Registration of one task.
+   */
+  struct Task {
+    std::atomic<bool> checked_in = false;
+    uint32_t deadline_ms = 0;
+    /**
+     * @brief System time at which the check-in was last observed by Service().
+     */
+    uint64_t last_check_in_ms = 0;
+  };
+
+  /**
+   * @brief Records a missed task into the backup register.
+   */
+  void Record(uint8_t task) const;
+
+  std::array<Task, kMaxTasks> tasks_;
+  uint8_t num_tasks_ = 0;
+  bool missed_ = false;
+
+  uint32_t refresh_period_ms_;
+  uint64_t refresh_deadline_ms_;
+
+  bool was_reset_ = false;
+  std::optional<uint8_t> missed_task_;
+};
+
+#endif  // RTLIB_LIB_WATCHDOG_H_
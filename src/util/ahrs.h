@@ -0,0 +1,336 @@
+/**
+ * @file src/util/ahrs.h
+ *
+ * @brief Attitude estimation from gyroscope and accelerometer samples.
+ */
+
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_UTIL_AHRS_H_
+#define RTLIB_UTIL_AHRS_H_
+
+#include <array>
+#include <cstdint>
+#include <type_traits>
+
+#include "util/fast_math.h"
+#include "util/fixed.h"
+
+namespace util {
+
+/**
+ * @brief Unit quaternion which represents the rotation from the sensor frame to the earth frame.
+ *
+ * @tparam T Scalar type
+ */
+template<typename T>
+struct Quaternion {
+  T w = T(1);
+  T x = T(0);
+  T y = T(0);
+  T z = T(0);
+};
+
+/**
+ * @brief Scalar type used for attitude estimation on the current device.
+ *
+ * Devices with an FPU (STM32F4xx) use @c float. Devices without an FPU (STM32F1xx) use fixed-point with 24 fractional
+ * bits, which covers angular rates up to 128 rad/s with a resolution well below the increments of one sample at 1kHz.
+ */
+#if defined(__ARM_FP)
+using AhrsScalar = float;
+#else
+using AhrsScalar = Fixed<24>;
+#endif
+
+namespace ahrs_detail {
+
+/**
+ * @brief Scales a vector to unit length.
+ *
+ * @return @c false if the vector has zero length, in which case it is left unchanged.
+ */
+template<typename T, std::size_t N>
+bool Normalize(std::array<T, N>& v) {
+  if constexpr (std::is_floating_point_v<T>) {
+    T sum = T(0);
+    for (const T& element : v) {
+      sum += element * element;
+    }
+    if (sum == T(0)) {
+      return false;
+    }
+    const T scale = math::InvSqrt(sum);
+    for (T& element : v) {
+      element *= scale;
+    }
+  } else {
+    // Sum the squares in 64 bits, so that vectors of any magnitude (e.g. raw accelerometer readings) can be normalized
+    uint64_t sum = 0;
+    for (const T& element : v) {
+      sum += static_cast<uint64_t>(int64_t{element.GetRaw()} * element.GetRaw());
+    }
+    if (sum == 0) {
+      return false;
+    }
+
+    uint64_t norm = 0;
+    for (uint64_t bit = uint64_t{1} << 62; bit != 0; bit >>= 2) {
+      if (sum >= norm + bit) {
+        sum -= norm + bit;
+        norm = (norm >> 1) + bit;
+      } else {
+        norm >>= 1;
+      }
+    }
+    for (T& element : v) {
+      element = T::FromRaw(
+          static_cast<int32_t>(int64_t{element.GetRaw()} * (int64_t{1} << T::kFracBits) / static_cast<int64_t>(norm)));
+    }
+  }
+  return true;
+}
+
+}  // namespace ahrs_detail
+
+/**
+ * @brief Madgwick's gradient-descent orientation filter, for 6-axis IMUs.
+ *
+ * Gyroscope rates are integrated into the orientation, and the orientation is corrected towards the direction of
+ * gravity measured by the accelerometer by one gradient-descent step per sample. Heading (yaw) is not observable from
+ * the accelerometer, so it is only integrated from the gyroscope.
+ *
+ * See S. Madgwick, "An efficient orientation filter for inertial and inertial/magnetic sensor arrays", 2010.
+ *
+ * @tparam T Scalar type, i.e. @c float or Fixed
+ */
+template<typename T>
+class Madgwick final {
+ public:
+  /**
+   * @brief Configuration for the Madgwick filter.
+   */
+  struct Config {
+    /**
+     * @brief Gain of the accelerometer correction, in rad/s. Higher values converge faster but follow accelerometer
+     * noise and linear accelerations more.
+     */
+    float beta = 0.1f;
+    /**
+     * @brief Time between consecutive samples, in seconds.
+     */
+    float sample_period = 0.001f;
+  };
+
+  /**
+   * @brief Constructor.
+   *
+   * @param config Filter configuration
+   */
+  explicit Madgwick(const Config& config) : beta_(config.beta), sample_period_(config.sample_period) {}
+
+  /**
+   * @brief Updates the orientation with one sample.
+   *
+   * @param gyro Angular rate around the X, Y and Z axes, in rad/s
+   * @param accel Acceleration along the X, Y and Z axes, in any unit
+   */
+  void Update(const std::array<T, 3>& gyro, std::array<T, 3> accel) {
+    Quaternion<T>& q = q_;
+    const T half(0.5f);
+
+    // Rate of change of the quaternion from the gyroscope
+    std::array<T, 4> q_dot = {
+        half * (-q.x * gyro[0] - q.y * gyro[1] - q.z * gyro[2]),
+        half * (q.w * gyro[0] + q.y * gyro[2] - q.z * gyro[1]),
+        half * (q.w * gyro[1] - q.x * gyro[2] + q.z * gyro[0]),
+        half * (q.w * gyro[2] + q.x * gyro[1] - q.y * gyro[0]),
+    };
+
+    // Skip the correction if the accelerometer reading is invalid
+    if (ahrs_detail::Normalize(accel)) {
+      const T two(2);
+      const T four(4);
+      const T eight(8);
+      const T ww = q.w * q.w;
+      const T xx = q.x * q.x;
+      const T yy = q.y * q.y;
+      const T zz = q.z * q.z;
+
+      // Gradient of the error between the measured and the estimated direction of gravity
+      std::array<T, 4> s = {
+          four * q.w * yy + two * q.y * accel[0] + four * q.w * xx - two * q.x * accel[1],
+          four * q.x * zz - two * q.z * accel[0] + four * ww * q.x - two * q.w * accel[1] - four * q.x
+              + eight * q.x * xx + eight * q.x * yy + four * q.x * accel[2],
+          four * ww * q.y + two * q.w * accel[0] + four * q.y * zz - two * q.z * accel[1] - four * q.y
+              + eight * q.y * xx + eight * q.y * yy + four * q.y * accel[2],
+          four * xx * q.z - two * q.x * accel[0] + four * yy * q.z - two * q.y * accel[1],
+      };
+      if (ahrs_detail::Normalize(s)) {
+        for (std::size_t i = 0; i < q_dot.size(); ++i) {
+          q_dot[i] -= beta_ * s[i];
+        }
+      }
+    }
+
+    std::array<T, 4> next = {q.w + q_dot[0] * sample_period_,
+                             q.x + q_dot[1] * sample_period_,
+                             q.y + q_dot[2] * sample_period_,
+                             q.z + q_dot[3] * sample_period_};
+    if (ahrs_detail::Normalize(next)) {
+      q = {next[0], next[1], next[2], next[3]};
+    }
+  }
+
+  /**
+   * @return Current orientation.
+   */
+  const Quaternion<T>& GetQuaternion() const { return q_; }
+
+  /**
+   * @brief Resets the orientation to identity.
+   */
+  void Reset() { q_ = {}; }
+
+ private:
+  T beta_;
+  T sample_period_;
+  Quaternion<T> q_;
+};
+
+/**
+ * @brief Mahony's complementary filter on SO(3), for 6-axis IMUs.
+ *
+ * The error between the measured and the estimated direction of gravity is fed back into the gyroscope rates through
+ * a PI controller, where the integral term estimates the gyroscope bias. This filter needs fewer operations than
+ * Madgwick, which makes it the cheaper choice in fixed point.
+ *
+ * See R. Mahony et al., "Nonlinear Complementary Filters on the Special Orthogonal Group", 2008.
+ *
+ * @tparam T Scalar type, i.e. @c float or Fixed
+ */
+template<typename T>
+class Mahony final {
+ public:
+  /**
+   * @brief Configuration for the Mahony filter.
+   */
+  struct Config {
+    /**
+     * @brief Proportional gain of the accelerometer correction.
+     */
+    float kp = 1.0f;
+    /**
+     * @brief Integral gain of the accelerometer correction. 0 disables gyroscope bias estimation.
+     */
+    float ki = 0.0f;
+    /**
+     * @brief Time between consecutive samples, in seconds.
+     */
+    float sample_period = 0.001f;
+  };
+
+  /**
+   * @brief Constructor.
+   *
+   * @param config Filter configuration
+   */
+  explicit Mahony(const Config& config) :
+      kp_(config.kp),
+      ki_dt_(config.ki * config.sample_period),
+      half_dt_(0.5f * config.sample_period) {}
+
+  /**
+   * @brief Updates the orientation with one sample.
+   *
+   * @param gyro Angular rate around the X, Y and Z axes, in rad/s
+   * @param accel Acceleration along the X, Y and Z axes, in any unit
+   */
+  void Update(std::array<T, 3> gyro, std::array<T, 3> accel) {
+    Quaternion<T>& q = q_;
+
+    // Skip the correction if the accelerometer reading is invalid
+    if (ahrs_detail::Normalize(accel)) {
+      const T half(0.5f);
+
+      // Estimated direction of gravity, halved
+      const T vx = q.x * q.z - q.w * q.y;
+      const T vy = q.w * q.x + q.y * q.z;
+      const T vz = q.w * q.w - half + q.z * q.z;
+
+      // Error is the cross product of the measured and the estimated direction
+      const std::array<T, 3> error = {
+          accel[1] * vz - accel[2] * vy,
+          accel[2] * vx - accel[0] * vz,
+          accel[0] * vy - accel[1] * vx,
+      };
+
+      for (std::size_t i = 0; i < gyro.size(); ++i) {
+        if (ki_dt_ != T(0)) {
+          integral_[i] += ki_dt_ * error[i];
+          gyro[i] += integral_[i];
+        }
+        gyro[i] += kp_ * error[i];
+      }
+    }
+
+    for (T& rate : gyro) {
+      rate *= half_dt_;
+    }
+    std::array<T, 4> next = {
+        q.w - q.x * gyro[0] - q.y * gyro[1] - q.z * gyro[2],
+        q.x + q.w * gyro[0] + q.y * gyro[2] - q.z * gyro[1],
+        q.y + q.w * gyro[1] - q.x * gyro[2] + q.z * gyro[0],
+        q.z + q.w * gyro[2] + q.x * gyro[1] - q.y * gyro[0],
+    };
+    if (ahrs_detail::Normalize(next)) {
+      q = {next[0], next[1], next[2], next[3]};
+    }
+  }
+
+  /**
+   * @return Current orientation.
+   */
+  const Quaternion<T>& GetQuaternion() const { return q_; }
+
+  /**
+   * @return Current estimate of the gyroscope bias, in rad/s. Subtract from raw rates to correct them.
+   */
+  std::array<T, 3> GetGyroBias() const { return {-integral_[0], -integral_[1], -integral_[2]}; }
+
+  /**
+   * @brief Resets the orientation to identity, and clears the gyroscope bias estimate.
+   */
+  void Reset() {
+    q_ = {};
+    integral_ = {};
+  }
+
+ private:
+  T kp_;
+  T ki_dt_;
+  T half_dt_;
+  Quaternion<T> q_;
+  std::array<T, 3> integral_ = {};
+};
+
+}  // namespace util
+
+#endif  // RTLIB_UTIL_AHRS_H_
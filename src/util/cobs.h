@@ -0,0 +1,121 @@
+/**
+ * @file src/util/cobs.h
+ *
+ * @brief Consistent Overhead Byte Stuffing (COBS) encoder and decoder.
+ */
+
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_UTIL_COBS_H_
+#define RTLIB_UTIL_COBS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace util {
+namespace cobs {
+
+/**
+ * @brief Computes the worst-case size of encoded data, excluding the frame delimiter.
+ *
+ * COBS adds one byte of overhead, plus one byte for every 254 bytes of data.
+ *
+ * @param size Size of the data before encoding
+ * @return Maximum size of the encoded data.
+ */
+constexpr std::size_t GetMaxEncodedSize(std::size_t size) { return size + size / 254 + 1; }
+
+/**
+ * @brief Encodes data, so that it contains no zero bytes.
+ *
+ * The frame delimiter (a zero byte) is not appended.
+ *
+ * @param data Data to encode
+ * @param size Size of @p data
+ * @param out Buffer to store the encoded data. Must be at least GetMaxEncodedSize(@p size) bytes, and must not
+ * overlap with @p data.
+ * @return Size of the encoded data.
+ */
+inline std::size_t Encode(const uint8_t* data, std::size_t size, uint8_t* out) {
+  std::size_t code_index = 0;
+  std::size_t out_index = 1;
+  uint8_t code = 1;
+
+  for (std::size_t i = 0; i < size; ++i) {
+    if (data[i] == 0) {
+      out[code_index] = code;
+      code_index = out_index++;
+      code = 1;
+      continue;
+    }
+
+    out[out_index++] = data[i];
+    if (++code == 0xFF) {
+      out[code_index] = code;
+      code_index = out_index++;
+      code = 1;
+    }
+  }
+
+  out[code_index] = code;
+  return out_index;
+}
+
+/**
+ * @brief Decodes data which was encoded by Encode().
+ *
+ * @param data Encoded data, excluding the frame delimiter
+ * @param size Size of @p data
+ * @param out Buffer to store the decoded data. Must be at least @p size bytes. May be the same as @p data, in which
+ * case the data is decoded in place.
+ * @return Size of the decoded data, or @c std::nullopt if @p data is malformed.
+ */
+inline std::optional<std::size_t> Decode(const uint8_t* data, std::size_t size, uint8_t* out) {
+  std::size_t in_index = 0;
+  std::size_t out_index = 0;
+
+  while (in_index < size) {
+    const uint8_t code = data[in_index++];
+    if (code == 0 || in_index + code - 1 > size) {
+      return std::nullopt;
+    }
+
+    for (uint8_t i = 1; i < code; ++i) {
+      const uint8_t value = data[in_index++];
+      if (value == 0) {
+        return std::nullopt;
+      }
+      out[out_index++] = value;
+    }
+
+    // Each block except the last and the full-length blocks ends with an implied zero
+    if (code != 0xFF && in_index < size) {
+      out[out_index++] = 0;
+    }
+  }
+
+  return out_index;
+}
+
+}  // namespace cobs
+}  // namespace util
+
+#endif  // RTLIB_UTIL_COBS_H_
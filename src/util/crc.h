@@ -0,0 +1,184 @@
+/**
+ * @file src/util/crc.h
+ *
+ * @brief Table-driven software CRC computations, with lookup tables generated at compile time.
+ */
+
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_UTIL_CRC_H_
+#define RTLIB_UTIL_CRC_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace util {
+
+/**
+ * @brief Software CRC computation for any polynomial of 8, 16 or 32 bits.
+ *
+ * Each instantiation owns a 256-entry lookup table which is generated at compile time and placed in flash, so each
+ * byte is processed with one table lookup instead of eight shift-and-xor steps. The table is only emitted for the
+ * variants which are actually used.
+ *
+ * All functions are @c constexpr, so checksums of constant data can be computed at compile time.
+ *
+ * @tparam T Unsigned type of the CRC register, which determines the width of the CRC
+ * @tparam kPoly Generator polynomial, in normal (MSB-first) representation
+ * @tparam kInit Initial value of the CRC register
+ * @tparam kReflect Whether input bytes and the result are bit-reflected (i.e. the CRC is computed LSB-first)
+ * @tparam kXorOut Value which is XORed with the register to produce the result
+ */
+template<typename T, T kPoly, T kInit, bool kReflect, T kXorOut>
+class Crc final {
+  static_assert(std::is_unsigned_v<T> && sizeof(T) <= 4, "CRC register must be an unsigned type of up to 32 bits");
+
+ public:
+  /**
+   * @brief Number of bits in the CRC.
+   */
+  static constexpr std::size_t kWidth = sizeof(T) * 8;
+
+  /**
+   * @brief Computes the CRC of a buffer.
+   *
+   * @param data Pointer to the buffer
+   * @param size Size of the buffer, in bytes
+   * @return CRC of the buffer.
+   */
+  static constexpr T Compute(const uint8_t* data, std::size_t size) { return Finalize(Update(Init(), data, size)); }
+
+  /**
+   * @return Initial value of the CRC register, for computing the CRC of data in multiple parts using Update().
+   */
+  static constexpr T Init() { return kReflect ? Reflect(kInit) : kInit; }
+
+  /**
+   * @brief Feeds a buffer into the CRC register.
+   *
+   * @param crc Current value of the CRC register, initially Init()
+   * @param data Pointer to the buffer
+   * @param size Size of the buffer, in bytes
+   * @return New value of the CRC register.
+   */
+  static constexpr T Update(T crc, const uint8_t* data, std::size_t size) {
+    for (std::size_t i = 0; i < size; ++i) {
+      if constexpr (kReflect) {
+        crc = static_cast<T>(kTable[(crc ^ data[i]) & 0xFF] ^ Shr8(crc));
+      } else {
+        crc = static_cast<T>(kTable[((crc >> (kWidth - 8)) ^ data[i]) & 0xFF] ^ Shl8(crc));
+      }
+    }
+    return crc;
+  }
+
+  /**
+   * @brief Converts the value of the CRC register to the result.
+   *
+   * The register of reflected variants is already held in reflected order, so only @c kXorOut is applied.
+   *
+   * @param crc Value of the CRC register after all data is fed
+   * @return CRC of the data.
+   */
+  static constexpr T Finalize(T crc) { return static_cast<T>(crc ^ kXorOut); }
+
+ private:
+  /**
+   * @brief Shifts a value left by 8 bits, discarding bits beyond the width of the CRC.
+   */
+  static constexpr T Shl8(T value) { return kWidth == 8 ? T{0} : static_cast<T>(uint32_t{value} << 8); }
+  /**
+   * @brief Shifts a value right by 8 bits.
+   */
+  static constexpr T Shr8(T value) { return kWidth == 8 ? T{0} : static_cast<T>(uint32_t{value} >> 8); }
+
+  /**
+   * @brief Reverses the order of bits of a value.
+   */
+  static constexpr T Reflect(T value) {
+    T result = 0;
+    for (std::size_t i = 0; i < kWidth; ++i) {
+      if ((value >> i) & 1u) {
+        result = static_cast<T>(result | (T{1} << (kWidth - 1 - i)));
+      }
+    }
+    return result;
+  }
+
+  static constexpr std::array<T, 256> MakeTable() {
+    std::array<T, 256> table = {};
+    constexpr T kTopBit = static_cast<T>(T{1} << (kWidth - 1));
+    for (uint32_t i = 0; i < 256; ++i) {
+      if constexpr (kReflect) {
+        // The reflected table processes the register LSB-first, using the reflected polynomial
+        T crc = static_cast<T>(i);
+        for (uint8_t bit = 0; bit < 8; ++bit) {
+          crc = static_cast<T>((crc & 1u) ? (crc >> 1) ^ Reflect(kPoly) : crc >> 1);
+        }
+        table[i] = crc;
+      } else {
+        T crc = static_cast<T>(uint32_t{i} << (kWidth - 8));
+        for (uint8_t bit = 0; bit < 8; ++bit) {
+          crc = static_cast<T>((crc & kTopBit) ? static_cast<T>(crc << 1) ^ kPoly : static_cast<T>(crc << 1));
+        }
+        table[i] = crc;
+      }
+    }
+    return table;
+  }
+
+  static constexpr std::array<T, 256> kTable = MakeTable();
+};
+
+/**
+ * @brief CRC-8 (also known as CRC-8/SMBUS), used by SMBus and many sensors.
+ */
+using Crc8 = Crc<uint8_t, 0x07, 0x00, false, 0x00>;
+/**
+ * @brief CRC-16/CCITT-FALSE, used by many serial framing protocols.
+ */
+using Crc16Ccitt = Crc<uint16_t, 0x1021, 0xFFFF, false, 0x0000>;
+/**
+ * @brief CRC-32/MPEG-2, which is the variant computed by the CRC peripheral of STM32 devices when fed with words.
+ */
+using Crc32Mpeg2 = Crc<uint32_t, 0x04C11DB7, 0xFFFFFFFF, false, 0x00000000>;
+/**
+ * @brief CRC-32 (IEEE 802.3), used by Ethernet, zlib and PNG.
+ */
+using Crc32 = Crc<uint32_t, 0x04C11DB7, 0xFFFFFFFF, true, 0xFFFFFFFF>;
+
+namespace crc_check {
+/**
+ * @brief Standard check input of the CRC catalogue, i.e. the ASCII string "123456789".
+ */
+constexpr std::array<uint8_t, 9> kCheckInput = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+
+static_assert(Crc8::Compute(kCheckInput.data(), kCheckInput.size()) == 0xF4, "CRC-8 check value mismatch");
+static_assert(Crc16Ccitt::Compute(kCheckInput.data(), kCheckInput.size()) == 0x29B1, "CRC-16 check value mismatch");
+static_assert(Crc32Mpeg2::Compute(kCheckInput.data(), kCheckInput.size()) == 0x0376E6E7,
+              "CRC-32/MPEG-2 check value mismatch");
+static_assert(Crc32::Compute(kCheckInput.data(), kCheckInput.size()) == 0xCBF43926, "CRC-32 check value mismatch");
+}  // namespace crc_check
+
+}  // namespace util
+
+#endif  // RTLIB_UTIL_CRC_H_
@@ -0,0 +1,109 @@
+/**
+ * @file src/util/double_buffer.h
+ *
+ * @brief Lock-free double buffer for publishing the latest value of a structure.
+ */
+
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_UTIL_DOUBLE_BUFFER_H_
+#define RTLIB_UTIL_DOUBLE_BUFFER_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace util {
+
+/**
+ * @brief Double buffer which publishes the latest value of a structure from one writer to one reader.
+ *
+ * This buffer is intended to pass a snapshot (e.g. the latest decoded frame) from an interrupt handler to the main
+ * loop, or vice versa, without disabling interrupts. Unlike SpscQueue, older values are overwritten, so the reader
+ * always sees the most recent value.
+ *
+ * The writer always fills the slot which is not published, then publishes it by incrementing a sequence number. The
+ * reader copies the published slot, and retries if the writer has overwritten that slot in the meantime, which can
+ * only happen if the writer has preempted the reader at least twice during the copy.
+ *
+ * Write() must only be called from one context, and Read() must only be called from one (possibly different) context.
+ *
+ * @tparam T Type of the value. Must be trivially copyable.
+ */
+template<typename T>
+class DoubleBuffer final {
+ public:
+  /**
+   * @brief Publishes a new value.
+   *
+   * @param value Value to publish
+   */
+  void Write(const T& value) {
+    const uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+    buffers_[(sequence + 1) & 1] = value;
+    sequence_.store(sequence + 1, std::memory_order_release);
+  }
+
+  /**
+   * @brief Reads the latest value.
+   *
+   * @param value Reference to store the value
+   * @return @c true if a new value has been published since the last call.
+   */
+  bool Read(T& value) {
+    uint32_t sequence = sequence_.load(std::memory_order_acquire);
+    while (true) {
+      value = buffers_[sequence & 1];
+      std::atomic_signal_fence(std::memory_order_acq_rel);
+
+      // The copied slot is only overwritten by the second write after the one which published it
+      const uint32_t latest = sequence_.load(std::memory_order_acquire);
+      if (latest - sequence < 2) {
+        break;
+      }
+      sequence = latest;
+    }
+
+    const bool updated = sequence != read_sequence_;
+    read_sequence_ = sequence;
+    return updated;
+  }
+
+  /**
+   * @return Number of values written since construction. Wraps around on overflow.
+   */
+  uint32_t GetSequence() const { return sequence_.load(std::memory_order_acquire); }
+
+ private:
+  std::array<T, 2> buffers_ = {};
+
+  /**
+   * @brief Number of values written. The published value is in slot @c sequence_ & 1. Only modified by the writer.
+   */
+  std::atomic<uint32_t> sequence_ = 0;
+  /**
+   * @brief Sequence number of the value returned by the last Read(). Only modified by the reader.
+   */
+  uint32_t read_sequence_ = 0;
+};
+
+}  // namespace util
+
+#endif  // RTLIB_UTIL_DOUBLE_BUFFER_H_
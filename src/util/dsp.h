@@ -0,0 +1,588 @@
+/**
+ * @file src/util/dsp.h
+ *
+ * @brief Fixed-point and floating-point filter kernels, using the DSP extension of Cortex-M4 where available.
+ */
+
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_UTIL_DSP_H_
+#define RTLIB_UTIL_DSP_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace util {
+namespace dsp {
+
+/**
+ * @brief Fixed-point and floating-point primitives.
+ *
+ * Q15 values are stored in @c int16_t and represent [-1, 1), Q31 values are stored in @c int32_t and represent the same
+ * range. All fixed-point arithmetic saturates instead of wrapping.
+ *
+ * On devices with the DSP extension (Cortex-M4, i.e. STM32F4xx), the SSAT, QADD, QSUB and SMLALD instructions are used.
+ * Other devices (Cortex-M3, i.e. STM32F1xx) use portable implementations with the same results. Floating-point kernels
+ * use the FPU of STM32F4xx devices; on STM32F1xx devices they are emulated in software, so the fixed-point kernels
+ * should be preferred there.
+ */
+
+/**
+ * @brief Saturates a value to a signed range.
+ *
+ * @tparam kBits Number of bits of the result, from 1 to 32
+ * @param value Value to saturate
+ * @return @p value, clamped to [-2^(kBits-1), 2^(kBits-1) - 1].
+ */
+template<unsigned kBits>
+inline int32_t Saturate(int32_t value) {
+  static_assert(kBits >= 1 && kBits <= 32, "Saturation width must be between 1 and 32 bits");
+#if defined(__ARM_FEATURE_DSP)
+  int32_t result;
+  asm("ssat %0, %1, %2" : "=r"(result) : "I"(kBits), "r"(value));
+  return result;
+#else
+  if constexpr (kBits == 32) {
+    return value;
+  } else {
+    constexpr int32_t kMax = (int32_t{1} << (kBits - 1)) - 1;
+    constexpr int32_t kMin = -kMax - 1;
+    return value > kMax ? kMax : (value < kMin ? kMin : value);
+  }
+#endif
+}
+
+/**
+ * @param value Value to saturate
+ * @return @p value, clamped to the range of @c int32_t.
+ */
+inline int32_t Saturate(int64_t value) {
+  if (value > std::numeric_limits<int32_t>::max()) {
+    return std::numeric_limits<int32_t>::max();
+  } else if (value < std::numeric_limits<int32_t>::min()) {
+    return std::numeric_limits<int32_t>::min();
+  }
+  return static_cast<int32_t>(value);
+}
+
+/**
+ * @return Saturated sum of @p a and @p b.
+ */
+inline int32_t AddSat(int32_t a, int32_t b) {
+#if defined(__ARM_FEATURE_DSP)
+  int32_t result;
+  asm("qadd %0, %1, %2" : "=r"(result) : "r"(a), "r"(b));
+  return result;
+#else
+  return Saturate(int64_t{a} + b);
+#endif
+}
+
+/**
+ * @return Saturated difference of @p a and @p b.
+ */
+inline int32_t SubSat(int32_t a, int32_t b) {
+#if defined(__ARM_FEATURE_DSP)
+  int32_t result;
+  asm("qsub %0, %1, %2" : "=r"(result) : "r"(a), "r"(b));
+  return result;
+#else
+  return Saturate(int64_t{a} - b);
+#endif
+}
+
+/**
+ * @return Saturated product of two Q15 values.
+ */
+inline int16_t MulQ15(int16_t a, int16_t b) {
+  return static_cast<int16_t>(Saturate<16>((int32_t{a} * b) >> 15));
+}
+
+/**
+ * @return Saturated product of two Q31 values.
+ */
+inline int32_t MulQ31(int32_t a, int32_t b) {
+  return Saturate((int64_t{a} * b) >> 31);
+}
+
+/**
+ * @return @p value converted to Q15, saturated to [-1, 1).
+ */
+constexpr int16_t ToQ15(float value) {
+  return value >= 1.0f ? std::numeric_limits<int16_t>::max()
+                       : (value <= -1.0f ? std::numeric_limits<int16_t>::min() : static_cast<int16_t>(value * 32768.0f));
+}
+
+/**
+ * @return @p value converted to Q31, saturated to [-1, 1).
+ */
+constexpr int32_t ToQ31(float value) {
+  return value >= 1.0f ? std::numeric_limits<int32_t>::max()
+                       : (value <= -1.0f ? std::numeric_limits<int32_t>::min()
+                                         : static_cast<int32_t>(static_cast<double>(value) * 2147483648.0));
+}
+
+/**
+ * @return Q15 @p value converted to floating-point.
+ */
+constexpr float FromQ15(int16_t value) { return static_cast<float>(value) / 32768.0f; }
+
+/**
+ * @return Q31 @p value converted to floating-point.
+ */
+constexpr float FromQ31(int32_t value) { return static_cast<float>(value) / 2147483648.0f; }
+
+namespace detail {
+
+/**
+ * @brief Packs two 16-bit values into one word, in the order they are stored in memory.
+ */
+inline uint32_t Pack(int16_t low, int16_t high) {
+  return static_cast<uint16_t>(low) | (static_cast<uint32_t>(static_cast<uint16_t>(high)) << 16);
+}
+
+/**
+ * @brief Loads two consecutive 16-bit values as one word. @p data does not need to be word-aligned.
+ */
+inline uint32_t Load2(const int16_t* data) {
+  uint32_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+/**
+ * @brief Multiplies the upper and lower halfwords of two words, and adds both products to a 64-bit accumulator.
+ */
+inline int64_t MulAddPairs(int64_t acc, uint32_t x, uint32_t y) {
+#if defined(__ARM_FEATURE_DSP)
+  asm("smlald %Q0, %R0, %1, %2" : "+r"(acc) : "r"(x), "r"(y));
+  return acc;
+#else
+  const auto lo = int32_t{static_cast<int16_t>(x)} * static_cast<int16_t>(y);
+  const auto hi = int32_t{static_cast<int16_t>(x >> 16)} * static_cast<int16_t>(y >> 16);
+  return acc + lo + hi;
+#endif
+}
+
+/**
+ * @brief Multiplies two Q31 values into a Q48 product, as accumulated by the Q31 kernels.
+ */
+inline int64_t MulQ31ToQ48(int32_t a, int32_t b) { return (int64_t{a} * b) >> 14; }
+
+}  // namespace detail
+
+/**
+ * @brief Computes the dot product of two floating-point vectors.
+ *
+ * @param a First vector
+ * @param b Second vector
+ * @param count Number of elements in each vector
+ * @return Dot product of @p a and @p b.
+ */
+inline float DotProduct(const float* a, const float* b, std::size_t count) {
+  // Four independent accumulators hide the latency of the FPU multiply-accumulate
+  std::array<float, 4> acc = {};
+  std::size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    acc[0] += a[i] * b[i];
+    acc[1] += a[i + 1] * b[i + 1];
+    acc[2] += a[i + 2] * b[i + 2];
+    acc[3] += a[i + 3] * b[i + 3];
+  }
+  for (; i < count; ++i) {
+    acc[0] += a[i] * b[i];
+  }
+  return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+}
+
+/**
+ * @brief Computes the dot product of two Q15 vectors.
+ *
+ * Two elements are multiplied and accumulated per instruction on devices with the DSP extension.
+ *
+ * @param a First vector
+ * @param b Second vector
+ * @param count Number of elements in each vector
+ * @return Dot product of @p a and @p b, in Q30 (i.e. 34.30) format. Does not overflow for any practical @p count.
+ */
+inline int64_t DotProduct(const int16_t* a, const int16_t* b, std::size_t count) {
+  int64_t acc = 0;
+  std::size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    acc = detail::MulAddPairs(acc, detail::Load2(&a[i]), detail::Load2(&b[i]));
+    acc = detail::MulAddPairs(acc, detail::Load2(&a[i + 2]), detail::Load2(&b[i + 2]));
+  }
+  for (; i < count; ++i) {
+    acc += int32_t{a[i]} * b[i];
+  }
+  return acc;
+}
+
+/**
+ * @brief Computes the dot product of two Q31 vectors.
+ *
+ * The lowest 14 bits of each product are discarded, leaving 15 guard bits in the accumulator.
+ *
+ * @param a First vector
+ * @param b Second vector
+ * @param count Number of elements in each vector
+ * @return Dot product of @p a and @p b, in Q48 (i.e. 16.48) format.
+ */
+inline int64_t DotProduct(const int32_t* a, const int32_t* b, std::size_t count) {
+  int64_t acc = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    acc += detail::MulQ31ToQ48(a[i], b[i]);
+  }
+  return acc;
+}
+
+/**
+ * @brief Finite impulse response filter.
+ *
+ * Each output is the dot product of the coefficients and the latest @p kTaps inputs, i.e.
+ * <tt>y[n] = h[0] * x[n] + h[1] * x[n - 1] + ... + h[kTaps - 1] * x[n - kTaps + 1]</tt>.
+ *
+ * The input history is stored twice in a buffer of twice the number of taps, so that the latest @p kTaps inputs are
+ * always contiguous in memory and each output is computed by a single call to DotProduct().
+ *
+ * For fixed-point filters, the coefficients are in the same format as the samples, and the output saturates.
+ *
+ * @tparam T Sample type. One of @c float, @c int16_t (Q15) or @c int32_t (Q31).
+ * @tparam kTaps Number of coefficients
+ */
+template<typename T, std::size_t kTaps>
+class Fir final {
+  static_assert(std::is_same_v<T, float> || std::is_same_v<T, int16_t> || std::is_same_v<T, int32_t>,
+                "FIR sample type must be float, int16_t (Q15) or int32_t (Q31)");
+  static_assert(kTaps > 0, "FIR filter must have at least one tap");
+
+ public:
+  /**
+   * @brief Constructor.
+   *
+   * @param coefficients Filter coefficients, where @c coefficients[0] is applied to the latest input
+   */
+  explicit Fir(const std::array<T, kTaps>& coefficients) : coefficients_(coefficients) {}
+
+  /**
+   * @brief Filters one sample.
+   *
+   * @param input Input sample
+   * @return Output sample.
+   */
+  T Update(T input) {
+    index_ = index_ == 0 ? kTaps - 1 : index_ - 1;
+    history_[index_] = input;
+    history_[index_ + kTaps] = input;
+
+    const auto acc = DotProduct(coefficients_.data(), &history_[index_], kTaps);
+    if constexpr (std::is_same_v<T, float>) {
+      return acc;
+    } else if constexpr (std::is_same_v<T, int16_t>) {
+      return static_cast<int16_t>(Saturate<16>(Saturate(acc >> 15)));
+    } else {
+      return Saturate(acc >> 17);
+    }
+  }
+
+  /**
+   * @brief Filters a block of samples, e.g. one half of a circular DMA buffer.
+   *
+   * @param input Input samples
+   * @param output Buffer to store the output samples. May be the same as @p input.
+   * @param count Number of samples
+   */
+  void Process(const T* input, T* output, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+      output[i] = Update(input[i]);
+    }
+  }
+
+  /**
+   * @brief Clears the input history.
+   */
+  void Reset() {
+    history_ = {};
+    index_ = 0;
+  }
+
+ private:
+  std::array<T, kTaps> coefficients_;
+  std::array<T, kTaps * 2> history_ = {};
+  /**
+   * @brief Index of the latest input in @c history_.
+   */
+  std::size_t index_ = 0;
+};
+
+/**
+ * @brief Cascade of second-order IIR sections.
+ *
+ * Each section computes <tt>y[n] = b0 * x[n] + b1 * x[n - 1] + b2 * x[n - 2] - a1 * y[n - 1] - a2 * y[n - 2]</tt>, and
+ * the output of each section is the input of the next.
+ *
+ * Floating-point sections use the transposed direct form II, which needs the least state. Fixed-point sections use the
+ * direct form I, which cannot overflow internally. Since stable sections commonly have coefficients outside of [-1, 1),
+ * fixed-point coefficients are scaled down by 2^@c post_shift, and the output of each section is scaled up by the same
+ * amount. Intermediate results of Q15 sections are accumulated with full precision, and Q31 sections accumulate Q48
+ * products.
+ *
+ * @tparam T Sample type. One of @c float, @c int16_t (Q15) or @c int32_t (Q31).
+ * @tparam kStages Number of sections
+ */
+template<typename T, std::size_t kStages>
+class Biquad final {
+  static_assert(std::is_same_v<T, float> || std::is_same_v<T, int16_t> || std::is_same_v<T, int32_t>,
+                "Biquad sample type must be float, int16_t (Q15) or int32_t (Q31)");
+  static_assert(kStages > 0, "Biquad filter must have at least one stage");
+
+ public:
+  /**
+   * @brief Coefficients of one section.
+   *
+   * The feedback coefficients are normalized such that @c a0 is 1.
+   */
+  struct Coefficients {
+    T b0;
+    T b1;
+    T b2;
+    T a1;
+    T a2;
+  };
+
+  /**
+   * @brief Constructor.
+   *
+   * @param coefficients Coefficients of each section, in the order the input passes through them
+   * @param post_shift Number of bits the fixed-point coefficients are scaled down by. Ignored for floating-point
+   * filters.
+   */
+  explicit Biquad(const std::array<Coefficients, kStages>& coefficients, uint8_t post_shift = 0) :
+      post_shift_(std::is_same_v<T, float> ? 0 : post_shift) {
+    for (std::size_t i = 0; i < kStages; ++i) {
+      const Coefficients& c = coefficients[i];
+      if constexpr (std::is_same_v<T, int16_t>) {
+        // Feedback coefficients are negated, so that all five products are accumulated
+        stages_[i].b0b1 = detail::Pack(c.b0, c.b1);
+        stages_[i].b2a1 = detail::Pack(c.b2, static_cast<int16_t>(Saturate<16>(-int32_t{c.a1})));
+        stages_[i].a2 = static_cast<int16_t>(Saturate<16>(-int32_t{c.a2}));
+      } else {
+        stages_[i].coefficients = c;
+      }
+    }
+  }
+
+  /**
+   * @brief Filters one sample.
+   *
+   * @param input Input sample
+   * @return Output sample.
+   */
+  T Update(T input) {
+    T x = input;
+    for (Stage& s : stages_) {
+      if constexpr (std::is_same_v<T, float>) {
+        const Coefficients& c = s.coefficients;
+        const float y = c.b0 * x + s.state[0];
+        s.state[0] = c.b1 * x - c.a1 * y + s.state[1];
+        s.state[1] = c.b2 * x - c.a2 * y;
+        x = y;
+      } else if constexpr (std::is_same_v<T, int16_t>) {
+        int64_t acc = detail::MulAddPairs(0, detail::Pack(x, s.x1), s.b0b1);
+        acc = detail::MulAddPairs(acc, detail::Pack(s.x2, s.y1), s.b2a1);
+        acc += int32_t{s.y2} * s.a2;
+        const auto y = static_cast<int16_t>(Saturate<16>(Saturate(acc >> (15 - post_shift_))));
+        s.x2 = s.x1;
+        s.x1 = x;
+        s.y2 = s.y1;
+        s.y1 = y;
+        x = y;
+      } else {
+        const Coefficients& c = s.coefficients;
+        const int64_t acc = detail::MulQ31ToQ48(c.b0, x) + detail::MulQ31ToQ48(c.b1, s.x1)
+            + detail::MulQ31ToQ48(c.b2, s.x2) - detail::MulQ31ToQ48(c.a1, s.y1) - detail::MulQ31ToQ48(c.a2, s.y2);
+        const int32_t y = Saturate(acc >> (17 - post_shift_));
+        s.x2 = s.x1;
+        s.x1 = x;
+        s.y2 = s.y1;
+        s.y1 = y;
+        x = y;
+      }
+    }
+    return x;
+  }
+
+  /**
+   * @brief Filters a block of samples, e.g. one half of a circular DMA buffer.
+   *
+   * @param input Input samples
+   * @param output Buffer to store the output samples. May be the same as @p input.
+   * @param count Number of samples
+   */
+  void Process(const T* input, T* output, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+      output[i] = Update(input[i]);
+    }
+  }
+
+  /**
+   * @brief Clears the state of all sections.
+   */
+  void Reset() {
+    for (Stage& s : stages_) {
+      if constexpr (std::is_same_v<T, float>) {
+        s.state = {};
+      } else {
+        s.x1 = s.x2 = s.y1 = s.y2 = 0;
+      }
+    }
+  }
+
+ private:
+  /**
+   * @brief Coefficients and state of a floating-point section.
+   */
+  struct FloatStage {
+    Coefficients coefficients;
+    std::array<float, 2> state = {};
+  };
+
+  /**
+   * @brief Coefficients and state of a Q15 section, packed for dual multiply-accumulate instructions.
+   */
+  struct Q15Stage {
+    uint32_t b0b1;
+    uint32_t b2a1;
+    int16_t a2;
+    int16_t x1 = 0;
+    int16_t x2 = 0;
+    int16_t y1 = 0;
+    int16_t y2 = 0;
+  };
+
+  /**
+   * @brief Coefficients and state of a Q31 section.
+   */
+  struct Q31Stage {
+    Coefficients coefficients;
+    int32_t x1 = 0;
+    int32_t x2 = 0;
+    int32_t y1 = 0;
+    int32_t y2 = 0;
+  };
+
+  using Stage = std::conditional_t<std::is_same_v<T, float>,
+                                   FloatStage,
+                                   std::conditional_t<std::is_same_v<T, int16_t>, Q15Stage, Q31Stage>>;
+
+  std::array<Stage, kStages> stages_ = {};
+  uint8_t post_shift_;
+};
+
+/**
+ * @brief Moving average over a fixed number of samples.
+ *
+ * The sum of the window is updated incrementally, so each sample takes constant time regardless of @p kLength. Integer
+ * sums are exact; floating-point sums are recomputed once per window to prevent rounding errors from accumulating.
+ *
+ * @tparam T Sample type. One of @c float, @c int16_t or @c int32_t.
+ * @tparam kLength Number of samples to average. Division is cheapest if this is a power of 2.
+ */
+template<typename T, std::size_t kLength>
+class MovingAverage final {
+  static_assert(std::is_same_v<T, float> || std::is_same_v<T, int16_t> || std::is_same_v<T, int32_t>,
+                "Moving average sample type must be float, int16_t or int32_t");
+  static_assert(kLength > 0, "Moving average must have at least one sample");
+
+ public:
+  /**
+   * @brief Adds a sample to the window.
+   *
+   * Until @p kLength samples are added, the missing samples are treated as 0.
+   *
+   * @param input Input sample
+   * @return Average of the latest @p kLength samples.
+   */
+  T Update(T input) {
+    sum_ += static_cast<Sum>(input) - window_[index_];
+    window_[index_] = input;
+    if (++index_ == kLength) {
+      index_ = 0;
+      if constexpr (std::is_same_v<T, float>) {
+        sum_ = 0.0f;
+        for (float sample : window_) {
+          sum_ += sample;
+        }
+      }
+    }
+    return GetAverage();
+  }
+
+  /**
+   * @brief Filters a block of samples, e.g. one half of a circular DMA buffer.
+   *
+   * @param input Input samples
+   * @param output Buffer to store the output samples. May be the same as @p input.
+   * @param count Number of samples
+   */
+  void Process(const T* input, T* output, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+      output[i] = Update(input[i]);
+    }
+  }
+
+  /**
+   * @return Average of the latest @p kLength samples.
+   */
+  T GetAverage() const {
+    if constexpr (std::is_same_v<T, float>) {
+      return sum_ / static_cast<float>(kLength);
+    } else {
+      return static_cast<T>(sum_ / static_cast<Sum>(kLength));
+    }
+  }
+
+  /**
+   * @brief Clears the window.
+   */
+  void Reset() {
+    window_ = {};
+    sum_ = 0;
+    index_ = 0;
+  }
+
+ private:
+  using Sum = std::conditional_t<std::is_same_v<T, float>,
+                                 float,
+                                 std::conditional_t<std::is_same_v<T, int16_t>, int32_t, int64_t>>;
+
+  std::array<T, kLength> window_ = {};
+  Sum sum_ = 0;
+  std::size_t index_ = 0;
+};
+
+}  // namespace dsp
+}  // namespace util
+
+#endif  // RTLIB_UTIL_DSP_H_
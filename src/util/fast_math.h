@@ -0,0 +1,588 @@
+/**
+ * @file src/util/fast_math.h
+ *
+ * @brief Table-based trigonometry, square roots and sensor linearization, with tables generated at compile time.
+ */
+
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_UTIL_FAST_MATH_H_
+#define RTLIB_UTIL_FAST_MATH_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace util {
+namespace math {
+
+/**
+ * @brief Value of pi.
+ */
+constexpr float kPi = 3.14159265358979323846f;
+
+/**
+ * @brief Whether the float functions use floating-point tables.
+ *
+ * Devices with an FPU (STM32F4xx) interpolate floating-point tables directly. Devices without an FPU (STM32F1xx, built
+ * with @c -msoft-float) convert the argument to fixed-point once and interpolate Q15 tables with integer arithmetic,
+ * which avoids most of the emulated floating-point operations.
+ */
+#if defined(__ARM_FP)
+constexpr bool kUseFloatTables = true;
+#else
+constexpr bool kUseFloatTables = false;
+#endif
+
+/**
+ * @brief Compile-time implementations of math functions, for generating tables.
+ *
+ * These functions are much slower than their libm counterparts at runtime, and should only be used in constant
+ * expressions.
+ */
+namespace constant {
+
+/**
+ * @return Square root of @p x.
+ */
+constexpr double Sqrt(double x) {
+  if (x <= 0.0) {
+    return 0.0;
+  }
+  double r = x > 1.0 ? x : 1.0;
+  for (int i = 0; i < 64; ++i) {
+    r = (r + x / r) / 2.0;
+  }
+  return r;
+}
+
+/**
+ * @return Sine of @p x, in radians.
+ */
+constexpr double Sin(double x) {
+  constexpr double kTwoPi = 6.283185307179586476925;
+  x -= kTwoPi * static_cast<double>(static_cast<int64_t>(x / kTwoPi));
+  if (x > kTwoPi / 2) {
+    x -= kTwoPi;
+  } else if (x < -kTwoPi / 2) {
+    x += kTwoPi;
+  }
+
+  double term = x;
+  double sum = x;
+  for (int i = 1; i < 20; ++i) {
+    term *= -x * x / ((2 * i) * (2 * i + 1));
+    sum += term;
+  }
+  return sum;
+}
+
+/**
+ * @return Cosine of @p x, in radians.
+ */
+constexpr double Cos(double x) { return Sin(x + 1.570796326794896619231); }
+
+/**
+ * @return Arctangent of @p x, in radians.
+ */
+constexpr double Atan(double x) {
+  if (x < 0.0) {
+    return -Atan(-x);
+  } else if (x > 1.0) {
+    return 1.570796326794896619231 - Atan(1.0 / x);
+  }
+
+  // atan(x) = 2 * atan(x / (1 + sqrt(1 + x^2))), which reduces x to at most tan(pi / 8)
+  const double t = x / (1.0 + Sqrt(1.0 + x * x));
+  double term = t;
+  double sum = t;
+  for (int i = 1; i < 40; ++i) {
+    term *= -t * t;
+    sum += term / (2 * i + 1);
+  }
+  return 2.0 * sum;
+}
+
+/**
+ * @return Exponential of @p x.
+ */
+constexpr double Exp(double x) {
+  if (x < 0.0) {
+    return 1.0 / Exp(-x);
+  }
+
+  // Halve x until the series converges quickly, then square the result back
+  int halvings = 0;
+  while (x > 0.5) {
+    x /= 2.0;
+    ++halvings;
+  }
+  double term = 1.0;
+  double sum = 1.0;
+  for (int i = 1; i < 20; ++i) {
+    term *= x / i;
+    sum += term;
+  }
+  for (int i = 0; i < halvings; ++i) {
+    sum *= sum;
+  }
+  return sum;
+}
+
+/**
+ * @return Natural logarithm of @p x. @p x must be positive.
+ */
+constexpr double Log(double x) {
+  constexpr double kLn2 = 0.693147180559945309417;
+  if (x <= 0.0) {
+    return 0.0;
+  }
+
+  // Scale x into [0.5, 1], then use ln(x) = 2 * atanh((x - 1) / (x + 1))
+  int exponent = 0;
+  while (x > 1.0) {
+    x /= 2.0;
+    ++exponent;
+  }
+  while (x < 0.5) {
+    x *= 2.0;
+    --exponent;
+  }
+  const double t = (x - 1.0) / (x + 1.0);
+  double term = t;
+  double sum = t;
+  for (int i = 1; i < 30; ++i) {
+    term *= t * t;
+    sum += term / (2 * i + 1);
+  }
+  return 2.0 * sum + exponent * kLn2;
+}
+
+}  // namespace constant
+
+/**
+ * @brief Generates a table by sampling a function at evenly spaced points.
+ *
+ * @tparam T Type of the table entries. Integral values are rounded to the nearest integer.
+ * @tparam N Number of entries
+ * @param x_min Input of the first entry
+ * @param x_max Input of the last entry
+ * @param f Function to sample. Must be usable in constant expressions if the table is @c constexpr.
+ * @return Table of @c f(x), where x ranges from @p x_min to @p x_max inclusive.
+ */
+template<typename T, std::size_t N, typename F>
+constexpr std::array<T, N> MakeTable(double x_min, double x_max, F f) {
+  static_assert(N >= 2, "Table must have at least two entries");
+
+  std::array<T, N> table = {};
+  for (std::size_t i = 0; i < N; ++i) {
+    const double value = f(x_min + (x_max - x_min) * static_cast<double>(i) / static_cast<double>(N - 1));
+    if constexpr (std::is_integral_v<T>) {
+      table[i] = static_cast<T>(value < 0.0 ? value - 0.5 : value + 0.5);
+    } else {
+      table[i] = static_cast<T>(value);
+    }
+  }
+  return table;
+}
+
+/**
+ * @brief Lookup table of a function over an interval, with linear interpolation between entries.
+ *
+ * This is intended for linearizing sensors with nonlinear transfer functions, e.g. thermistors. The table is generated
+ * at compile time and stored in flash if the object is declared @c constexpr:
+ *
+ * @code
+ * // 10k NTC (B = 3950) in a divider with a 10k resistor to 3.3V, read by a 12-bit ADC
+ * constexpr util::math::Lut<float, 65> kNtcCelsius(1.0, 4094.0, [](double adc) {
+ *   const double r = 10000.0 * adc / (4095.0 - adc);
+ *   return 1.0 / (1.0 / 298.15 + util::math::constant::Log(r / 10000.0) / 3950.0) - 273.15;
+ * });
+ *
+ * float temperature = kNtcCelsius(adc_value);
+ * @endcode
+ *
+ * Inputs outside of the interval are clamped to the first or last entry.
+ *
+ * @tparam T Type of the table entries
+ * @tparam N Number of entries
+ */
+template<typename T, std::size_t N>
+class Lut final {
+  static_assert(std::is_arithmetic_v<T>, "Lookup table entries must be arithmetic");
+
+ public:
+  /**
+   * @brief Constructor.
+   *
+   * @param x_min Lower bound of the interval
+   * @param x_max Upper bound of the interval
+   * @param f Function to sample
+   */
+  template<typename F>
+  constexpr Lut(double x_min, double x_max, F f) :
+      table_(MakeTable<T, N>(x_min, x_max, f)),
+      x_min_(static_cast<float>(x_min)),
+      scale_(static_cast<float>((N - 1) / (x_max - x_min))) {}
+
+  /**
+   * @param x Input value
+   * @return Interpolated value of the function at @p x.
+   */
+  T operator()(float x) const {
+    const float position = (x - x_min_) * scale_;
+    if (!(position > 0.0f)) {
+      return table_.front();
+    } else if (position >= static_cast<float>(N - 1)) {
+      return table_.back();
+    }
+
+    const auto index = static_cast<std::size_t>(position);
+    const float fraction = position - static_cast<float>(index);
+    const float a = static_cast<float>(table_[index]);
+    const float b = static_cast<float>(table_[index + 1]);
+    return static_cast<T>(a + (b - a) * fraction);
+  }
+
+  /**
+   * @return Underlying table.
+   */
+  constexpr const std::array<T, N>& GetTable() const { return table_; }
+
+ private:
+  std::array<T, N> table_;
+  float x_min_;
+  float scale_;
+};
+
+namespace detail {
+
+/**
+ * @brief Number of intervals of the sine table over one full turn.
+ */
+constexpr std::size_t kSinTableSize = 256;
+/**
+ * @brief Number of intervals of the arctangent table over [0, 1].
+ */
+constexpr std::size_t kAtanTableSize = 128;
+
+inline constexpr auto kSinTableF = MakeTable<float, kSinTableSize + 1>(0.0, 6.283185307179586476925, constant::Sin);
+inline constexpr auto kSinTableQ15 = MakeTable<int16_t, kSinTableSize + 1>(0.0, 6.283185307179586476925, [](double x) {
+  const double value = constant::Sin(x) * 32768.0;
+  return value > 32767.0 ? 32767.0 : value;
+});
+
+inline constexpr auto kAtanTableF = MakeTable<float, kAtanTableSize + 1>(0.0, 1.0, constant::Atan);
+/**
+ * @brief Arctangent table in binary angle units (65536 per turn).
+ */
+inline constexpr auto kAtanTableAngle = MakeTable<uint16_t, kAtanTableSize + 1>(0.0, 1.0, [](double x) {
+  return constant::Atan(x) * 32768.0 / 3.141592653589793238463;
+});
+
+/**
+ * @brief Conversion factor from radians to binary angle units.
+ */
+constexpr float kRadToAngle = 32768.0f / kPi;
+
+/**
+ * @return Interpolated sine of @p x, in radians, using the floating-point table.
+ */
+inline float SinF(float x) {
+  constexpr float kScale = static_cast<float>(kSinTableSize) / (2 * kPi);
+  const float position = x * kScale;
+  auto whole = static_cast<int32_t>(position);
+  if (position < static_cast<float>(whole)) {
+    --whole;
+  }
+  const float fraction = position - static_cast<float>(whole);
+  const std::size_t index = static_cast<uint32_t>(whole) & (kSinTableSize - 1);
+  return kSinTableF[index] + (kSinTableF[index + 1] - kSinTableF[index]) * fraction;
+}
+
+/**
+ * @return Interpolated arctangent of @p x in [0, 1], in radians, using the floating-point table.
+ */
+inline float AtanUnitF(float x) {
+  const float position = x * static_cast<float>(kAtanTableSize);
+  const auto index = static_cast<std::size_t>(position);
+  if (index >= kAtanTableSize) {
+    return kAtanTableF.back();
+  }
+  const float fraction = position - static_cast<float>(index);
+  return kAtanTableF[index] + (kAtanTableF[index + 1] - kAtanTableF[index]) * fraction;
+}
+
+/**
+ * @return Binary angle of @p x in radians. Angles are wrapped to one turn.
+ */
+inline uint16_t ToAngle(float x) {
+  // Wrap in floating point first, so that the conversion to an integer cannot overflow
+  constexpr float kTurn = 65536.0f;
+  float angle = x * kRadToAngle;
+  if (angle >= kTurn || angle <= -kTurn) {
+    angle -= kTurn * static_cast<float>(static_cast<int32_t>(angle / kTurn));
+  }
+  return static_cast<uint16_t>(static_cast<int32_t>(angle));
+}
+
+/**
+ * @return Unbiased exponent of @p x, i.e. floor(log2(|x|)), or a large negative number if @p x is 0.
+ */
+inline int GetExponent(float x) {
+  uint32_t bits;
+  std::memcpy(&bits, &x, sizeof(bits));
+  return static_cast<int>((bits >> 23) & 0xFF) - 127;
+}
+
+/**
+ * @brief Multiplies @p x by 2^@p shift by adjusting its exponent, without any floating-point operations.
+ *
+ * Results which would be subnormal are flushed to 0.
+ */
+inline float ScaleByPowerOf2(float x, int shift) {
+  uint32_t bits;
+  std::memcpy(&bits, &x, sizeof(bits));
+  const int exponent = static_cast<int>((bits >> 23) & 0xFF);
+  if (exponent == 0) {
+    return 0.0f;
+  } else if (exponent + shift <= 0) {
+    return x < 0.0f ? -0.0f : 0.0f;
+  }
+  bits = (bits & ~(uint32_t{0xFF} << 23)) | (static_cast<uint32_t>(exponent + shift) << 23);
+  float result;
+  std::memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+}  // namespace detail
+
+/**
+ * @brief Computes the sine of a binary angle.
+ *
+ * @param angle Angle in binary angle units, where 65536 is one turn
+ * @return Sine of @p angle, in Q15.
+ */
+inline int16_t SinQ15(uint16_t angle) {
+  const std::size_t index = angle >> 8;
+  const int32_t fraction = angle & 0xFF;
+  const int32_t a = detail::kSinTableQ15[index];
+  const int32_t b = detail::kSinTableQ15[index + 1];
+  return static_cast<int16_t>(a + (((b - a) * fraction) >> 8));
+}
+
+/**
+ * @brief Computes the cosine of a binary angle.
+ *
+ * @param angle Angle in binary angle units, where 65536 is one turn
+ * @return Cosine of @p angle, in Q15.
+ */
+inline int16_t CosQ15(uint16_t angle) { return SinQ15(static_cast<uint16_t>(angle + 16384)); }
+
+/**
+ * @brief Computes the angle of a vector using integer arithmetic only.
+ *
+ * @param y Y component of the vector
+ * @param x X component of the vector
+ * @return Angle of the vector from the positive X axis, in binary angle units (65536 per turn, counterclockwise). 0 if
+ * both components are 0.
+ */
+inline uint16_t Atan2Angle(int32_t y, int32_t x) {
+  uint32_t ay = y < 0 ? 0u - static_cast<uint32_t>(y) : static_cast<uint32_t>(y);
+  uint32_t ax = x < 0 ? 0u - static_cast<uint32_t>(x) : static_cast<uint32_t>(x);
+  const bool swapped = ay > ax;
+  uint32_t num = swapped ? ax : ay;
+  uint32_t den = swapped ? ay : ax;
+  if (den == 0) {
+    return 0;
+  }
+
+  // Reduce both to 16 bits, so that the ratio can be computed in Q15 with a 32-bit division
+  while (den > 0xFFFF) {
+    num >>= 1;
+    den >>= 1;
+  }
+  const uint32_t ratio = (num << 15) / den;
+  const std::size_t index = ratio >> 8;
+  uint32_t angle;
+  if (index >= detail::kAtanTableSize) {
+    angle = detail::kAtanTableAngle.back();
+  } else {
+    const uint32_t a = detail::kAtanTableAngle[index];
+    const uint32_t b = detail::kAtanTableAngle[index + 1];
+    angle = a + (((b - a) * (ratio & 0xFF)) >> 8);
+  }
+
+  if (swapped) {
+    angle = 16384 - angle;
+  }
+  if (x < 0) {
+    angle = 32768 - angle;
+  }
+  if (y < 0) {
+    angle = 0u - angle;
+  }
+  return static_cast<uint16_t>(angle);
+}
+
+/**
+ * @brief Computes the sine of an angle.
+ *
+ * The maximum error is below 2e-4.
+ *
+ * @param x Angle in radians
+ * @return Sine of @p x.
+ */
+inline float Sin(float x) {
+  if constexpr (kUseFloatTables) {
+    return detail::SinF(x);
+  } else {
+    return static_cast<float>(SinQ15(detail::ToAngle(x))) / 32768.0f;
+  }
+}
+
+/**
+ * @brief Computes the cosine of an angle.
+ *
+ * The maximum error is below 2e-4.
+ *
+ * @param x Angle in radians
+ * @return Cosine of @p x.
+ */
+inline float Cos(float x) {
+  if constexpr (kUseFloatTables) {
+    return detail::SinF(x + kPi / 2);
+  } else {
+    return static_cast<float>(CosQ15(detail::ToAngle(x))) / 32768.0f;
+  }
+}
+
+/**
+ * @brief Computes the angle of a vector.
+ *
+ * The maximum error is below 2e-4 radians.
+ *
+ * @param y Y component of the vector
+ * @param x X component of the vector
+ * @return Angle of the vector from the positive X axis, in radians within [-pi, pi]. 0 if both components are 0.
+ */
+inline float Atan2(float y, float x) {
+  if constexpr (kUseFloatTables) {
+    const float ay = y < 0.0f ? -y : y;
+    const float ax = x < 0.0f ? -x : x;
+    if (ax == 0.0f && ay == 0.0f) {
+      return 0.0f;
+    }
+
+    float angle = ay > ax ? kPi / 2 - detail::AtanUnitF(ax / ay) : detail::AtanUnitF(ay / ax);
+    if (x < 0.0f) {
+      angle = kPi - angle;
+    }
+    return y < 0.0f ? -angle : angle;
+  } else {
+    // Scale both components by the same power of 2 into the range of int32_t, keeping all 24 bits of precision
+    const int exponent_y = detail::GetExponent(y);
+    const int exponent_x = detail::GetExponent(x);
+    const int shift = 30 - (exponent_y > exponent_x ? exponent_y : exponent_x);
+    const auto iy = static_cast<int32_t>(detail::ScaleByPowerOf2(y, shift));
+    const auto ix = static_cast<int32_t>(detail::ScaleByPowerOf2(x, shift));
+    return static_cast<float>(static_cast<int16_t>(Atan2Angle(iy, ix))) / detail::kRadToAngle;
+  }
+}
+
+/**
+ * @brief Computes the reciprocal of the square root of a number.
+ *
+ * On devices without an FPU, an initial estimate is taken from the exponent bits and refined by two Newton-Raphson
+ * iterations, giving a relative error below 5e-6.
+ *
+ * @param x Positive number
+ * @return <tt>1 / sqrt(x)</tt>.
+ */
+inline float InvSqrt(float x) {
+#if defined(__ARM_FP)
+  float root;
+  asm("vsqrt.f32 %0, %1" : "=t"(root) : "t"(x));
+  return 1.0f / root;
+#else
+  uint32_t bits;
+  std::memcpy(&bits, &x, sizeof(bits));
+  bits = 0x5F375A86 - (bits >> 1);
+  float y;
+  std::memcpy(&y, &bits, sizeof(y));
+
+  const float half_x = 0.5f * x;
+  y *= 1.5f - half_x * y * y;
+  y *= 1.5f - half_x * y * y;
+  return y;
+#endif
+}
+
+/**
+ * @brief Computes the square root of a number.
+ *
+ * On devices with an FPU, this is a single VSQRT instruction. Otherwise, this is computed from InvSqrt().
+ *
+ * @param x Non-negative number
+ * @return Square root of @p x. 0 if @p x is not positive.
+ */
+inline float Sqrt(float x) {
+  if (!(x > 0.0f)) {
+    return 0.0f;
+  }
+#if defined(__ARM_FP)
+  float result;
+  asm("vsqrt.f32 %0, %1" : "=t"(result) : "t"(x));
+  return result;
+#else
+  return x * InvSqrt(x);
+#endif
+}
+
+/**
+ * @brief Computes the integer square root of a number.
+ *
+ * @param x Number
+ * @return Largest integer whose square is not greater than @p x.
+ */
+inline uint32_t ISqrt(uint32_t x) {
+  uint32_t result = 0;
+  uint32_t bit = uint32_t{1} << 30;
+  while (bit > x) {
+    bit >>= 2;
+  }
+  while (bit != 0) {
+    if (x >= result + bit) {
+      x -= result + bit;
+      result = (result >> 1) + bit;
+    } else {
+      result >>= 1;
+    }
+    bit >>= 2;
+  }
+  return result;
+}
+
+}  // namespace math
+}  // namespace util
+
+#endif  // RTLIB_UTIL_FAST_MATH_H_
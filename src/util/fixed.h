@@ -0,0 +1,128 @@
+/**
+ * @file src/util/fixed.h
+ *
+ * @brief Fixed-point number type with arithmetic operators.
+ */
+
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_UTIL_FIXED_H_
+#define RTLIB_UTIL_FIXED_H_
+
+#include <cstdint>
+
+namespace util {
+
+/**
+ * @brief Signed 32-bit fixed-point number.
+ *
+ * This type provides the arithmetic operators of @c float, so that algorithms can be written once as templates and
+ * instantiated with @c float on devices with an FPU, and with Fixed on devices without one. Multiplications and
+ * divisions use 64-bit intermediates, so no precision is lost before the final shift. Results are truncated and not
+ * saturated, so the range of @p kFrac must cover all intermediate values of the algorithm.
+ *
+ * @tparam kFrac Number of fractional bits. The range is [-2^(31-kFrac), 2^(31-kFrac)).
+ */
+template<int kFrac>
+class Fixed final {
+  static_assert(kFrac > 0 && kFrac < 31, "Fixed must have between 1 and 30 fractional bits");
+
+ public:
+  /**
+   * @brief Number of fractional bits.
+   */
+  static constexpr int kFracBits = kFrac;
+
+  /**
+   * @brief Constructs zero.
+   */
+  constexpr Fixed() = default;
+
+  /**
+   * @brief Converts a floating-point value, rounding to the nearest representable value.
+   *
+   * Conversions are emulated in software on devices without an FPU, so they should only be used for constants or in
+   * code which is not time-critical.
+   */
+  constexpr explicit Fixed(float value) :
+      raw_(static_cast<int32_t>(value * static_cast<float>(int32_t{1} << kFrac) + (value < 0.0f ? -0.5f : 0.5f))) {}
+
+  /**
+   * @brief Converts an integer value.
+   */
+  constexpr explicit Fixed(int value) : raw_(static_cast<int32_t>(value) * (int32_t{1} << kFrac)) {}
+
+  /**
+   * @param raw Raw value, i.e. the value multiplied by 2^kFrac
+   * @return Fixed-point number with the raw value @p raw.
+   */
+  static constexpr Fixed FromRaw(int32_t raw) {
+    Fixed f;
+    f.raw_ = raw;
+    return f;
+  }
+
+  /**
+   * @return Raw value, i.e. the value multiplied by 2^kFrac.
+   */
+  constexpr int32_t GetRaw() const { return raw_; }
+
+  /**
+   * @return Value converted to floating-point.
+   */
+  constexpr float ToFloat() const { return static_cast<float>(raw_) / static_cast<float>(int32_t{1} << kFrac); }
+
+  constexpr Fixed& operator+=(Fixed other) {
+    raw_ += other.raw_;
+    return *this;
+  }
+  constexpr Fixed& operator-=(Fixed other) {
+    raw_ -= other.raw_;
+    return *this;
+  }
+  constexpr Fixed& operator*=(Fixed other) {
+    raw_ = static_cast<int32_t>((int64_t{raw_} * other.raw_) >> kFrac);
+    return *this;
+  }
+  constexpr Fixed& operator/=(Fixed other) {
+    raw_ = static_cast<int32_t>((int64_t{raw_} * (int64_t{1} << kFrac)) / other.raw_);
+    return *this;
+  }
+
+  friend constexpr Fixed operator+(Fixed a, Fixed b) { return a += b; }
+  friend constexpr Fixed operator-(Fixed a, Fixed b) { return a -= b; }
+  friend constexpr Fixed operator*(Fixed a, Fixed b) { return a *= b; }
+  friend constexpr Fixed operator/(Fixed a, Fixed b) { return a /= b; }
+  friend constexpr Fixed operator-(Fixed a) { return FromRaw(-a.raw_); }
+
+  friend constexpr bool operator==(Fixed a, Fixed b) { return a.raw_ == b.raw_; }
+  friend constexpr bool operator!=(Fixed a, Fixed b) { return a.raw_ != b.raw_; }
+  friend constexpr bool operator<(Fixed a, Fixed b) { return a.raw_ < b.raw_; }
+  friend constexpr bool operator>(Fixed a, Fixed b) { return a.raw_ > b.raw_; }
+  friend constexpr bool operator<=(Fixed a, Fixed b) { return a.raw_ <= b.raw_; }
+  friend constexpr bool operator>=(Fixed a, Fixed b) { return a.raw_ >= b.raw_; }
+
+ private:
+  int32_t raw_ = 0;
+};
+
+}  // namespace util
+
+#endif  // RTLIB_UTIL_FIXED_H_
@@ -0,0 +1,162 @@
+/**
+ * @file src/util/kalman.h
+ *
+ * @brief Linear and extended Kalman filter on fixed-size matrices.
+ */
+
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_UTIL_KALMAN_H_
+#define RTLIB_UTIL_KALMAN_H_
+
+#include <cstddef>
+
+#include "util/matrix.h"
+
+namespace util {
+
+/**
+ * @brief Kalman filter with a fixed number of states.
+ *
+ * The filter is generic over the process and measurement models, which are passed to each call, so one filter can
+ * fuse several sensors with different measurement sizes and rates.
+ *
+ * For a linear filter, use Predict(F, Q) and Update(z, H, R). For an extended Kalman filter, evaluate the nonlinear
+ * models outside the filter, then use Predict(x, F, Q) with the predicted state and the Jacobian of the process model,
+ * and UpdateInnovation(y, H, R) with the innovation <tt>z - h(x)</tt> and the Jacobian of the measurement model.
+ *
+ * The covariance is updated in Joseph form, which keeps it symmetric and positive definite in single precision.
+ *
+ * @tparam T Element type, usually @c float
+ * @tparam N Number of states
+ */
+template<typename T, std::size_t N>
+class KalmanFilter final {
+ public:
+  using StateVector = Vector<T, N>;
+  using StateMatrix = Matrix<T, N, N>;
+
+  /**
+   * @brief Constructor.
+   *
+   * @param x Initial state estimate
+   * @param p Initial covariance of the state estimate
+   */
+  KalmanFilter(const StateVector& x, const StateMatrix& p) : x_(x), p_(p) {}
+
+  /**
+   * @brief Predicts the state with a linear process model.
+   *
+   * @param f State transition matrix
+   * @param q Process noise covariance
+   */
+  void Predict(const StateMatrix& f, const StateMatrix& q) { Predict(f * x_, f, q); }
+
+  /**
+   * @brief Predicts the state with a linear process model and a control input.
+   *
+   * @tparam U Number of control inputs
+   * @param f State transition matrix
+   * @param b Control input matrix
+   * @param u Control input
+   * @param q Process noise covariance
+   */
+  template<std::size_t U>
+  void Predict(const StateMatrix& f, const Matrix<T, N, U>& b, const Vector<T, U>& u, const StateMatrix& q) {
+    Predict(f * x_ + b * u, f, q);
+  }
+
+  /**
+   * @brief Predicts the state with a nonlinear process model.
+   *
+   * @param x Predicted state, i.e. the process model evaluated at the current state
+   * @param f Jacobian of the process model at the current state
+   * @param q Process noise covariance
+   */
+  void Predict(const StateVector& x, const StateMatrix& f, const StateMatrix& q) {
+    x_ = x;
+    p_ = f * p_ * f.Transpose() + q;
+  }
+
+  /**
+   * @brief Corrects the state with a measurement and a linear measurement model.
+   *
+   * @tparam M Number of measured values
+   * @param z Measurement
+   * @param h Measurement matrix
+   * @param r Measurement noise covariance
+   * @return @c true if the state is updated, @c false if the innovation covariance is singular.
+   */
+  template<std::size_t M>
+  bool Update(const Vector<T, M>& z, const Matrix<T, M, N>& h, const Matrix<T, M, M>& r) {
+    return UpdateInnovation(z - h * x_, h, r);
+  }
+
+  /**
+   * @brief Corrects the state with the innovation of a measurement.
+   *
+   * @tparam M Number of measured values
+   * @param y Innovation, i.e. the measurement minus the measurement model evaluated at the current state
+   * @param h Measurement matrix, or the Jacobian of the measurement model at the current state
+   * @param r Measurement noise covariance
+   * @return @c true if the state is updated, @c false if the innovation covariance is singular.
+   */
+  template<std::size_t M>
+  bool UpdateInnovation(const Vector<T, M>& y, const Matrix<T, M, N>& h, const Matrix<T, M, M>& r) {
+    const Matrix<T, N, M> pht = p_ * h.Transpose();
+    const auto s_inv = (h * pht + r).Inverse();
+    if (!s_inv) {
+      return false;
+    }
+
+    const Matrix<T, N, M> k = pht * *s_inv;
+    x_ += k * y;
+
+    const StateMatrix i_kh = StateMatrix::Identity() - k * h;
+    p_ = i_kh * p_ * i_kh.Transpose() + k * r * k.Transpose();
+    return true;
+  }
+
+  /**
+   * @return Current state estimate.
+   */
+  const StateVector& GetState() const { return x_; }
+  /**
+   * @return Covariance of the current state estimate.
+   */
+  const StateMatrix& GetCovariance() const { return p_; }
+
+  /**
+   * @brief Overrides the state estimate, e.g. to normalize a quaternion after an update.
+   */
+  void SetState(const StateVector& x) { x_ = x; }
+  /**
+   * @brief Overrides the covariance of the state estimate.
+   */
+  void SetCovariance(const StateMatrix& p) { p_ = p; }
+
+ private:
+  StateVector x_;
+  StateMatrix p_;
+};
+
+}  // namespace util
+
+#endif  // RTLIB_UTIL_KALMAN_H_
@@ -0,0 +1,342 @@
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "util/kv_store.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "util/crc.h"
+
+namespace util {
+
+namespace {
+/**
+ * @brief Magic number at the start of each sector header.
+ */
+constexpr uint32_t kSectorMagic = 0x4B565331;
+/**
+ * @brief Size of the sector header, consisting of the magic number, the sequence number and its complement.
+ */
+constexpr uint32_t kHeaderSize = 12;
+/**
+ * @brief Size of the largest record in flash.
+ */
+constexpr uint32_t kMaxRecordSize = 8 + KvStore::kMaxValueSize;
+
+constexpr uint32_t MakeAddress(uint8_t sector, uint32_t offset) {
+  return static_cast<uint32_t>(sector) << 24 | offset;
+}
+constexpr uint8_t GetAddressSector(uint32_t address) { return static_cast<uint8_t>(address >> 24); }
+constexpr uint32_t GetAddressOffset(uint32_t address) { return address & 0x00FFFFFF; }
+}  // namespace
+
+KvStore::KvStore(Backend& backend) :
+    backend_(backend),
+    num_sectors_(backend.GetNumSectors()),
+    sector_size_(backend.GetSectorSize()),
+    reclaim_offset_(kHeaderSize) {
+  assert(num_sectors_ >= 2 && num_sectors_ <= kMaxSectors);
+  assert(sector_size_ % 4 == 0 && sector_size_ >= kHeaderSize + kMaxRecordSize && sector_size_ <= 0x01000000);
+
+  std::array<uint8_t, kMaxSectors> order;
+  uint8_t num_used = 0;
+
+  for (uint8_t i = 0; i < num_sectors_; ++i) {
+    const uint32_t magic = ReadWord(i, 0);
+    const uint32_t sequence = ReadWord(i, 4);
+    if (magic == kSectorMagic && sequence == ~ReadWord(i, 8) && sequence != 0) {
+      sectors_[i].sequence = sequence;
+      order[num_used++] = i;
+      continue;
+    }
+
+    // sectors without a valid header were being erased or formatted when power was lost
+    const uint8_t* data = backend_.GetSector(i);
+    sectors_[i].blank = std::all_of(data, data + sector_size_, [](uint8_t b) { return b == 0xFF; });
+    if (!sectors_[i].blank) {
+      backend_.Erase(i);
+      sectors_[i].blank = true;
+    }
+  }
+
+  // replay from the oldest sector, so that newer records replace older ones in the index
+  std::sort(order.begin(), order.begin() + num_used, [this](uint8_t lhs, uint8_t rhs) {
+    return sectors_[lhs].sequence < sectors_[rhs].sequence;
+  });
+  for (uint8_t i = 0; i < num_used; ++i) {
+    head_ = order[i];
+    head_offset_ = ScanSector(head_);
+    next_sequence_ = sectors_[head_].sequence + 1;
+  }
+
+  if (num_used == 0) {
+    head_ = num_sectors_ - 1;
+    OpenSpareSector();
+  }
+}
+
+bool KvStore::Read(uint16_t key, void* data, std::size_t size) const {
+  if (!Contains(key)) {
+    return false;
+  }
+
+  const IndexEntry& entry = index_[key];
+  const uint8_t* value = backend_.GetSector(GetAddressSector(entry.address)) + GetAddressOffset(entry.address) + 4;
+  const std::size_t count = std::min<std::size_t>(size, entry.size);
+  if (count > 0) {
+    std::memcpy(data, value, count);
+  }
+  return true;
+}
+
+bool KvStore::Write(uint16_t key, const void* data, std::size_t size) {
+  if (key >= kMaxKeys || size > kMaxValueSize) {
+    return false;
+  }
+
+  const IndexEntry& entry = index_[key];
+  if (Contains(key) && entry.size == size) {
+    const uint8_t* value = backend_.GetSector(GetAddressSector(entry.address)) + GetAddressOffset(entry.address) + 4;
+    if (size == 0 || std::memcmp(value, data, size) == 0) {
+      return true;
+    }
+  }
+
+  // all live records must fit into one sector, otherwise the oldest sector cannot be reclaimed
+  const uint32_t old_size = Contains(key) ? GetRecordSize(entry.size) : 0;
+  if (live_bytes_ - old_size + GetRecordSize(static_cast<uint16_t>(size)) > sector_size_ - kHeaderSize) {
+    return false;
+  }
+
+  const uint32_t address = AppendRecord(key, data, static_cast<uint16_t>(size), false);
+  if (address == kNoAddress) {
+    return false;
+  }
+  SetIndex(key, address, static_cast<uint16_t>(size));
+  return true;
+}
+
+bool KvStore::Remove(uint16_t key) {
+  if (!Contains(key)) {
+    return true;
+  }
+
+  if (AppendRecord(key, nullptr, kTombstone, false) == kNoAddress) {
+    return false;
+  }
+  SetIndex(key, kNoAddress, 0);
+  return true;
+}
+
+bool KvStore::IsMaintenanceNeeded() const {
+  // one erased sector is always kept in reserve, so that the oldest sector can be reclaimed
+  if (GetNumBlankSectors() >= 2) {
+    return false;
+  }
+  if (GetOldestSector() != kMaxSectors) {
+    return true;
+  }
+  // the head sector is the only sector in use, and is nearly full
+  return head_offset_ + kMaxRecordSize > sector_size_;
+}
+
+bool KvStore::Maintain() {
+  uint8_t sector = GetOldestSector();
+  if (sector == kMaxSectors) {
+    if (!IsMaintenanceNeeded()) {
+      return false;
+    }
+
+    // move on to the reserved sector, so that the current head sector can be reclaimed
+    if (!OpenSpareSector()) {
+      return false;
+    }
+    sector = GetOldestSector();
+  }
+
+  while (reclaim_offset_ < sector_size_) {
+    Record record;
+    const RecordStatus status = ReadRecord(sector, reclaim_offset_, record);
+    if (status == RecordStatus::kBlank || status == RecordStatus::kCorrupt) {
+      break;
+    }
+
+    const uint32_t address = MakeAddress(sector, reclaim_offset_);
+    reclaim_offset_ += record.size;
+
+    // removal records are dropped, since all older records of the same key are in this sector as well
+    if (status != RecordStatus::kValid || index_[record.key].address != address) {
+      continue;
+    }
+
+    const uint8_t* value = backend_.GetSector(sector) + GetAddressOffset(address) + 4;
+    const uint32_t new_address = AppendRecord(record.key, value, record.length, true);
+    if (new_address == kNoAddress) {
+      // only happens if the live records do not fit into one sector
+      return false;
+    }
+    SetIndex(record.key, new_address, record.length);
+    return true;
+  }
+
+  backend_.Erase(sector);
+  sectors_[sector] = {0, true};
+  reclaim_offset_ = kHeaderSize;
+
+  return IsMaintenanceNeeded();
+}
+
+uint32_t KvStore::ReadWord(uint8_t sector, uint32_t offset) const {
+  uint32_t word;
+  std::memcpy(&word, backend_.GetSector(sector) + offset, sizeof(word));
+  return word;
+}
+
+KvStore::RecordStatus KvStore::ReadRecord(uint8_t sector, uint32_t offset, Record& record) const {
+  if (offset + 4 > sector_size_) {
+    return RecordStatus::kCorrupt;
+  }
+
+  const uint32_t header = ReadWord(sector, offset);
+  if (header == 0xFFFFFFFF) {
+    return RecordStatus::kBlank;
+  }
+
+  record.key = static_cast<uint16_t>(header);
+  record.length = static_cast<uint16_t>(header >> 16);
+  record.size = GetRecordSize(record.length);
+  if (record.key >= kMaxKeys || (record.length > kMaxValueSize && record.length != kTombstone) ||
+      offset + record.size > sector_size_) {
+    return RecordStatus::kCorrupt;
+  }
+
+  const uint8_t* data = backend_.GetSector(sector) + offset;
+  if (Crc32::Compute(data, record.size - 4) != ReadWord(sector, offset + record.size - 4)) {
+    return RecordStatus::kUncommitted;
+  }
+  return RecordStatus::kValid;
+}
+
+uint32_t KvStore::ScanSector(uint8_t sector) {
+  uint32_t offset = kHeaderSize;
+  while (offset < sector_size_) {
+    Record record;
+    switch (ReadRecord(sector, offset, record)) {
+      case RecordStatus::kBlank:
+        return offset;
+      case RecordStatus::kCorrupt:
+        // the rest of the sector cannot be parsed, so it must not be written to either
+        return sector_size_;
+      case RecordStatus::kUncommitted:
+        break;
+      case RecordStatus::kValid:
+        if (record.length == kTombstone) {
+          SetIndex(record.key, kNoAddress, 0);
+        } else {
+          SetIndex(record.key, MakeAddress(sector, offset), record.length);
+        }
+        break;
+      default:
+        assert(false);
+        break;
+    }
+    offset += record.size;
+  }
+  return offset;
+}
+
+void KvStore::SetIndex(uint16_t key, uint32_t address, uint16_t size) {
+  IndexEntry& entry = index_[key];
+  if (entry.address != kNoAddress) {
+    live_bytes_ -= GetRecordSize(entry.size);
+  }
+  entry = {address, size};
+  if (address != kNoAddress) {
+    live_bytes_ += GetRecordSize(size);
+  }
+}
+
+uint32_t KvStore::AppendRecord(uint16_t key, const void* data, uint16_t length, bool use_reserve) {
+  const uint32_t size = GetRecordSize(length);
+
+  // while no sector is erased, keep enough space in the head sector to copy all live records out of the oldest sector
+  const uint32_t reserved = (use_reserve || GetNumBlankSectors() > 0) ? 0 : live_bytes_;
+  if (head_offset_ + size + reserved > sector_size_) {
+    if (GetNumBlankSectors() < (use_reserve ? 1 : 2) || !OpenSpareSector()) {
+      return kNoAddress;
+    }
+  }
+
+  std::array<uint32_t, kMaxRecordSize / 4> words;
+  const std::size_t num_words = size / 4;
+  words[0] = static_cast<uint32_t>(key) | static_cast<uint32_t>(length) << 16;
+  if (length != kTombstone && length > 0) {
+    words[num_words - 2] = 0xFFFFFFFF;
+    std::memcpy(&words[1], data, length);
+  }
+  words[num_words - 1] = Crc32::Compute(reinterpret_cast<const uint8_t*>(words.data()), size - 4);
+
+  // the checksum is programmed last, so that the record only becomes valid once it is completely written
+  backend_.Program(head_, head_offset_, words.data(), num_words - 1);
+  backend_.Program(head_, head_offset_ + size - 4, &words[num_words - 1], 1);
+
+  const uint32_t address = MakeAddress(head_, head_offset_);
+  head_offset_ += size;
+  return address;
+}
+
+bool KvStore::OpenSpareSector() {
+  for (uint8_t i = 1; i <= num_sectors_; ++i) {
+    const uint8_t sector = static_cast<uint8_t>((head_ + i) % num_sectors_);
+    if (!sectors_[sector].blank) {
+      continue;
+    }
+
+    const uint32_t header[] = {kSectorMagic, next_sequence_, ~next_sequence_};
+    backend_.Program(sector, 0, header, 3);
+
+    sectors_[sector] = {next_sequence_++, false};
+    head_ = sector;
+    head_offset_ = kHeaderSize;
+    return true;
+  }
+  return false;
+}
+
+uint8_t KvStore::GetNumBlankSectors() const {
+  const auto end = sectors_.begin() + num_sectors_;
+  return static_cast<uint8_t>(std::count_if(sectors_.begin(), end, [](const SectorState& s) { return s.blank; }));
+}
+
+uint8_t KvStore::GetOldestSector() const {
+  uint8_t oldest = kMaxSectors;
+  for (uint8_t i = 0; i < num_sectors_; ++i) {
+    if (i == head_ || sectors_[i].sequence == 0) {
+      continue;
+    }
+    if (oldest == kMaxSectors || sectors_[i].sequence < sectors_[oldest].sequence) {
+      oldest = i;
+    }
+  }
+  return oldest;
+}
+
+}  // namespace util
@@ -0,0 +1,390 @@
+/**
+ * @file src/util/kv_store.h
+ *
+ * @brief Log-structured key/value store for NOR flash.
+ */
+
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_UTIL_KV_STORE_H_
+#define RTLIB_UTIL_KV_STORE_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace util {
+
+/**
+ * @brief Wear-levelled key/value store on top of erasable flash sectors.
+ *
+ * Values are appended to a log which rotates through all sectors, so every sector is erased equally often. A RAM index
+ * points to the latest record of each key, so reads are a single copy from flash.
+ *
+ * When the sector being written is full, writing continues in an erased spare sector. The oldest sector is then
+ * reclaimed by Maintain(), which copies its live records to the head of the log and erases it. Since erasing stalls
+ * the CPU for a long time on some devices, this never happens inside Write(); the application decides when to call
+ * Maintain().
+ *
+ * Each record is committed by programming its checksum last, so a record interrupted by a power loss is ignored on the
+ * next boot, and the previous value of the key is used instead.
+ *
+ * The size of all live records must not exceed one sector. At least two sectors are required.
+ */
+class KvStore {
+ public:
+  /**
+   * @brief Number of keys supported. Keys range from 0 to @c kMaxKeys - 1.
+   */
+  static constexpr uint16_t kMaxKeys = 64;
+  /**
+   * @brief Maximum size of a value, in bytes.
+   */
+  static constexpr uint16_t kMaxValueSize = 256;
+  /**
+   * @brief Maximum number of sectors supported.
+   */
+  static constexpr uint8_t kMaxSectors = 8;
+
+  /**
+   * @brief Interface to the flash which holds the store.
+   *
+   * All sectors must have the same size, and must be memory-mapped for reading. Erased bytes read as @c 0xFF, and
+   * programming can only clear bits.
+   */
+  class Backend {
+   public:
+    virtual ~Backend() = default;
+
+    /**
+     * @return Number of sectors.
+     */
+    virtual uint8_t GetNumSectors() const = 0;
+    /**
+     * @return Size of each sector, in bytes. Must be a multiple of 4.
+     */
+    virtual uint32_t GetSectorSize() const = 0;
+    /**
+     * @param sector Sector index
+     * @return Pointer to the contents of @p sector.
+     */
+    virtual const uint8_t* GetSector(uint8_t sector) const = 0;
+    /**
+     * @brief Programs words into an erased region of a sector.
+     *
+     * @param sector Sector index
+     * @param offset Word-aligned offset into the sector
+     * @param data Words to program
+     * @param count Number of words to program
+     */
+    virtual void Program(uint8_t sector, uint32_t offset, const uint32_t* data, std::size_t count) = 0;
+    /**
+     * @brief Erases a sector.
+     *
+     * @param sector Sector index
+     */
+    virtual void Erase(uint8_t sector) = 0;
+  };
+
+  /**
+   * @brief Constructor.
+   *
+   * Scans all sectors to rebuild the index. Sectors which were being erased when power was lost are erased again, and
+   * blank flash is formatted.
+   *
+   * @param backend Flash which holds the store. Must outlive this object.
+   */
+  explicit KvStore(Backend& backend);
+
+  /**
+   * @brief Default destructor.
+   */
+  ~KvStore() = default;
+
+  /**
+   * @brief Move constructor for KvStore.
+   *
+   * This constructor is deleted because the store refers to its backend.
+   */
+  KvStore(KvStore&&) = delete;
+  /**
+   * @brief Move assignment operator for KvStore.
+   *
+   * This operator is deleted because the store refers to its backend.
+   */
+  KvStore& operator=(KvStore&&) = delete;
+
+  /**
+   * @brief Copy constructor for KvStore.
+   *
+   * This constructor is deleted because there should only be one object managing each flash region.
+   */
+  KvStore(const KvStore&) = delete;
+  /**
+   * @brief Copy assignment operator for KvStore.
+   *
+   * This operator is deleted because there should only be one object managing each flash region.
+   */
+  KvStore& operator=(const KvStore&) = delete;
+
+  /**
+   * @param key Key to query
+   * @return @c true if @p key has a value.
+   */
+  bool Contains(uint16_t key) const { return key < kMaxKeys && index_[key].address != kNoAddress; }
+
+  /**
+   * @param key Key to query
+   * @return Size of the value of @p key, or 0 if @p key has no value.
+   */
+  uint16_t GetSize(uint16_t key) const { return Contains(key) ? index_[key].size : 0; }
+
+  /**
+   * @brief Reads the value of a key.
+   *
+   * @param key Key to read
+   * @param data Buffer to store the value
+   * @param size Size of @p data. If the value is larger, only the first @p size bytes are read.
+   * @return @c true if @p key has a value.
+   */
+  bool Read(uint16_t key, void* data, std::size_t size) const;
+
+  /**
+   * @brief Reads the value of a key into an object.
+   *
+   * @tparam T Trivially copyable type
+   * @param key Key to read
+   * @param value Object to store the value
+   * @return @c true if @p key has a value of the same size as @p T.
+   */
+  template<typename T>
+  bool Read(uint16_t key, T& value) const {
+    static_assert(std::is_trivially_copyable_v<T>, "Values must be trivially copyable");
+    return GetSize(key) == sizeof(T) && Read(key, &value, sizeof(T));
+  }
+
+  /**
+   * @brief Writes the value of a key.
+   *
+   * Nothing is written if the value is unchanged.
+   *
+   * @param key Key to write
+   * @param data Value to write
+   * @param size Size of the value, up to @c kMaxValueSize
+   * @return @c true if the value is written. @c false if the store is out of space, in which case Maintain() should be
+   * called before retrying.
+   */
+  bool Write(uint16_t key, const void* data, std::size_t size);
+
+  /**
+   * @brief Writes the value of a key from an object.
+   *
+   * @tparam T Trivially copyable type
+   * @param key Key to write
+   * @param value Object to write
+   * @return @c true if the value is written.
+   */
+  template<typename T>
+  bool Write(uint16_t key, const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>, "Values must be trivially copyable");
+    static_assert(sizeof(T) <= kMaxValueSize, "Value is too large");
+    return Write(key, &value, sizeof(T));
+  }
+
+  /**
+   * @brief Removes the value of a key.
+   *
+   * @param key Key to remove
+   * @return @c true if the key is removed or has no value.
+   */
+  bool Remove(uint16_t key);
+
+  /**
+   * @return @c true if there is no erased spare sector, i.e. Maintain() should be called.
+   */
+  bool IsMaintenanceNeeded() const;
+
+  /**
+   * @brief Performs one step of reclaiming the oldest sector.
+   *
+   * Each call either copies one live record out of the oldest sector, or erases a sector once it has no live records.
+   * Erasing stalls the CPU on devices which execute from the same flash, so only call this function when a stall is
+   * acceptable.
+   *
+   * @return @c true if more maintenance is needed.
+   */
+  bool Maintain();
+
+ private:
+  /**
+   * @brief Address value which indicates that a key has no value.
+   */
+  static constexpr uint32_t kNoAddress = 0xFFFFFFFF;
+
+  /**
+   * @brief Location of the latest value of one key.
+   */
+  struct IndexEntry {
+    /**
+     * @brief Location of the record, with the sector index in the upper 8 bits and the offset in the lower 24 bits.
+     */
+    uint32_t address = kNoAddress;
+    /**
+     * @brief Size of the value.
+     */
+    uint16_t size = 0;
+  };
+
+  /**
+   * @brief State of each sector.
+   */
+  struct SectorState {
+    /**
+     * @brief Sequence number of the sector, or 0 if the sector has no valid header.
+     */
+    uint32_t sequence = 0;
+    /**
+     * @brief Whether the sector is fully erased.
+     */
+    bool blank = false;
+  };
+
+  /**
+   * @brief Enumeration of the states of a record in flash.
+   */
+  enum struct RecordStatus {
+    /**
+     * @brief No record has been written at this offset.
+     */
+    kBlank,
+    /**
+     * @brief The record header is damaged, so the end of the record is unknown.
+     */
+    kCorrupt,
+    /**
+     * @brief The record was not completely written.
+     */
+    kUncommitted,
+    /**
+     * @brief The record is valid.
+     */
+    kValid
+  };
+
+  /**
+   * @brief Decoded header of a record.
+   */
+  struct Record {
+    /**
+     * @brief Key of the record.
+     */
+    uint16_t key;
+    /**
+     * @brief Size of the value, or @c kTombstone for removal records.
+     */
+    uint16_t length;
+    /**
+     * @brief Size of the whole record in flash.
+     */
+    uint32_t size;
+  };
+
+  /**
+   * @brief Length value which marks a removal record.
+   */
+  static constexpr uint16_t kTombstone = 0xFFFF;
+
+  /**
+   * @param length Size of the value, or @c kTombstone
+   * @return Size of a record in flash.
+   */
+  static constexpr uint32_t GetRecordSize(uint16_t length) {
+    return length == kTombstone ? 8 : 8 + ((static_cast<uint32_t>(length) + 3) & ~uint32_t{3});
+  }
+
+  uint32_t ReadWord(uint8_t sector, uint32_t offset) const;
+  RecordStatus ReadRecord(uint8_t sector, uint32_t offset, Record& record) const;
+
+  /**
+   * @brief Replays the records of one sector into the index.
+   *
+   * @param sector Sector to scan
+   * @return Offset of the first unused byte in @p sector.
+   */
+  uint32_t ScanSector(uint8_t sector);
+
+  /**
+   * @brief Points a key to a record, keeping track of the total size of live records.
+   */
+  void SetIndex(uint16_t key, uint32_t address, uint16_t size);
+
+  /**
+   * @brief Appends a record to the head of the log.
+   *
+   * @param key Key of the record
+   * @param data Value of the record
+   * @param length Size of the value, or @c kTombstone
+   * @param use_reserve Whether the last erased sector may be used. Only used for copying records out of the oldest
+   * sector, since this sector must always be available to do so.
+   * @return Address of the record, or @c kNoAddress if there is no space.
+   */
+  uint32_t AppendRecord(uint16_t key, const void* data, uint16_t length, bool use_reserve);
+
+  /**
+   * @brief Starts writing to the next erased sector.
+   *
+   * @return @c true if an erased sector is available.
+   */
+  bool OpenSpareSector();
+
+  /**
+   * @return Number of erased sectors.
+   */
+  uint8_t GetNumBlankSectors() const;
+  /**
+   * @return Oldest sector which holds records, excluding the head sector, or @c kMaxSectors if there is none.
+   */
+  uint8_t GetOldestSector() const;
+
+  Backend& backend_;
+  uint8_t num_sectors_;
+  uint32_t sector_size_;
+
+  std::array<IndexEntry, kMaxKeys> index_ = {};
+  std::array<SectorState, kMaxSectors> sectors_ = {};
+  /**
+   * @brief Total size of the records which hold the latest value of each key.
+   */
+  uint32_t live_bytes_ = 0;
+
+  uint8_t head_ = 0;
+  uint32_t head_offset_ = 0;
+  uint32_t next_sequence_ = 1;
+
+  /**
+   * @brief Offset of the next record to inspect in the oldest sector.
+   */
+  uint32_t reclaim_offset_;
+};
+
+}  // namespace util
+
+#endif  // RTLIB_UTIL_KV_STORE_H_
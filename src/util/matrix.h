@@ -0,0 +1,357 @@
+/**
+ * @file src/util/matrix.h
+ *
+ * @brief Fixed-size matrix and vector templates.
+ */
+
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_UTIL_MATRIX_H_
+#define RTLIB_UTIL_MATRIX_H_
+
+#include <array>
+#include <cstddef>
+#include <initializer_list>
+#include <optional>
+#include <type_traits>
+
+namespace util {
+
+/**
+ * @brief Matrix with dimensions fixed at compile time.
+ *
+ * Elements are stored in row-major order inside the object, so matrices never allocate and can be placed on the stack
+ * or in static storage. All loops have compile-time bounds, so the compiler fully unrolls operations on small matrices.
+ * Dimension mismatches are compile-time errors.
+ *
+ * Functions which can fail (i.e. Inverse()) return @c std::optional instead of throwing.
+ *
+ * @tparam T Element type, usually @c float
+ * @tparam R Number of rows
+ * @tparam C Number of columns
+ */
+template<typename T, std::size_t R, std::size_t C>
+class Matrix final {
+  static_assert(R > 0 && C > 0, "Matrix must have at least one row and one column");
+  static_assert(std::is_arithmetic_v<T>, "Matrix elements must be arithmetic");
+
+ public:
+  /**
+   * @brief Number of rows.
+   */
+  static constexpr std::size_t kRows = R;
+  /**
+   * @brief Number of columns.
+   */
+  static constexpr std::size_t kCols = C;
+
+  /**
+   * @brief Constructs a zero matrix.
+   */
+  constexpr Matrix() = default;
+
+  /**
+   * @brief Constructs a matrix from its elements, in row-major order.
+   *
+   * Missing elements are zero.
+   *
+   * @param elements Elements of the matrix
+   */
+  constexpr Matrix(std::initializer_list<T> elements) {
+    std::size_t i = 0;
+    for (const T& element : elements) {
+      if (i == R * C) {
+        break;
+      }
+      data_[i++] = element;
+    }
+  }
+
+  /**
+   * @return Zero matrix.
+   */
+  static constexpr Matrix Zeros() { return Matrix(); }
+
+  /**
+   * @return Identity matrix.
+   */
+  static constexpr Matrix Identity() {
+    static_assert(R == C, "Identity matrix must be square");
+    Matrix m;
+    for (std::size_t i = 0; i < R; ++i) {
+      m(i, i) = T(1);
+    }
+    return m;
+  }
+
+  /**
+   * @param diagonal Elements of the diagonal
+   * @return Diagonal matrix.
+   */
+  static constexpr Matrix Diagonal(const Matrix<T, R, 1>& diagonal) {
+    static_assert(R == C, "Diagonal matrix must be square");
+    Matrix m;
+    for (std::size_t i = 0; i < R; ++i) {
+      m(i, i) = diagonal[i];
+    }
+    return m;
+  }
+
+  constexpr T& operator()(std::size_t row, std::size_t col) { return data_[row * C + col]; }
+  constexpr const T& operator()(std::size_t row, std::size_t col) const { return data_[row * C + col]; }
+
+  /**
+   * @brief Accesses elements by their row-major index, which is the element index for vectors.
+   */
+  constexpr T& operator[](std::size_t index) { return data_[index]; }
+  constexpr const T& operator[](std::size_t index) const { return data_[index]; }
+
+  /**
+   * @return Pointer to the elements, in row-major order.
+   */
+  constexpr T* GetData() { return data_.data(); }
+  constexpr const T* GetData() const { return data_.data(); }
+
+  constexpr Matrix& operator+=(const Matrix& other) {
+    for (std::size_t i = 0; i < R * C; ++i) {
+      data_[i] += other.data_[i];
+    }
+    return *this;
+  }
+
+  constexpr Matrix& operator-=(const Matrix& other) {
+    for (std::size_t i = 0; i < R * C; ++i) {
+      data_[i] -= other.data_[i];
+    }
+    return *this;
+  }
+
+  constexpr Matrix& operator*=(T scalar) {
+    for (T& element : data_) {
+      element *= scalar;
+    }
+    return *this;
+  }
+
+  friend constexpr Matrix operator+(Matrix a, const Matrix& b) { return a += b; }
+  friend constexpr Matrix operator-(Matrix a, const Matrix& b) { return a -= b; }
+  friend constexpr Matrix operator*(Matrix a, T scalar) { return a *= scalar; }
+  friend constexpr Matrix operator*(T scalar, Matrix a) { return a *= scalar; }
+  friend constexpr Matrix operator-(Matrix a) { return a *= T(-1); }
+
+  /**
+   * @return Product of this matrix and @p other.
+   */
+  template<std::size_t K>
+  constexpr Matrix<T, R, K> operator*(const Matrix<T, C, K>& other) const {
+    Matrix<T, R, K> result;
+    for (std::size_t i = 0; i < R; ++i) {
+      for (std::size_t j = 0; j < K; ++j) {
+        T sum = T(0);
+        for (std::size_t k = 0; k < C; ++k) {
+          sum += (*this)(i, k) * other(k, j);
+        }
+        result(i, j) = sum;
+      }
+    }
+    return result;
+  }
+
+  /**
+   * @return Transpose of this matrix.
+   */
+  constexpr Matrix<T, C, R> Transpose() const {
+    Matrix<T, C, R> result;
+    for (std::size_t i = 0; i < R; ++i) {
+      for (std::size_t j = 0; j < C; ++j) {
+        result(j, i) = (*this)(i, j);
+      }
+    }
+    return result;
+  }
+
+  /**
+   * @return Dot product of this vector and @p other.
+   */
+  constexpr T Dot(const Matrix& other) const {
+    static_assert(C == 1, "Dot product is only defined for column vectors");
+    T sum = T(0);
+    for (std::size_t i = 0; i < R; ++i) {
+      sum += data_[i] * other.data_[i];
+    }
+    return sum;
+  }
+
+  /**
+   * @return Sum of the diagonal elements.
+   */
+  constexpr T Trace() const {
+    static_assert(R == C, "Trace is only defined for square matrices");
+    T sum = T(0);
+    for (std::size_t i = 0; i < R; ++i) {
+      sum += (*this)(i, i);
+    }
+    return sum;
+  }
+
+  /**
+   * @brief Computes the determinant.
+   *
+   * Matrices up to 3x3 use the closed-form expressions; larger matrices use Gaussian elimination.
+   *
+   * @return Determinant of this matrix.
+   */
+  constexpr T Determinant() const {
+    static_assert(R == C, "Determinant is only defined for square matrices");
+    const Matrix& m = *this;
+    if constexpr (R == 1) {
+      return m[0];
+    } else if constexpr (R == 2) {
+      return m(0, 0) * m(1, 1) - m(0, 1) * m(1, 0);
+    } else if constexpr (R == 3) {
+      return m(0, 0) * (m(1, 1) * m(2, 2) - m(1, 2) * m(2, 1)) - m(0, 1) * (m(1, 0) * m(2, 2) - m(1, 2) * m(2, 0))
+          + m(0, 2) * (m(1, 0) * m(2, 1) - m(1, 1) * m(2, 0));
+    } else {
+      Matrix a = m;
+      T det = T(1);
+      for (std::size_t col = 0; col < R; ++col) {
+        const std::size_t pivot = a.FindPivot(col);
+        if (a(pivot, col) == T(0)) {
+          return T(0);
+        }
+        if (pivot != col) {
+          a.SwapRows(pivot, col);
+          det = -det;
+        }
+        det *= a(col, col);
+        for (std::size_t row = col + 1; row < R; ++row) {
+          const T factor = a(row, col) / a(col, col);
+          for (std::size_t k = col; k < R; ++k) {
+            a(row, k) -= factor * a(col, k);
+          }
+        }
+      }
+      return det;
+    }
+  }
+
+  /**
+   * @brief Computes the inverse.
+   *
+   * Matrices up to 3x3 use the adjugate; larger matrices use Gauss-Jordan elimination with partial pivoting.
+   *
+   * @return Inverse of this matrix, or @c std::nullopt if this matrix is singular.
+   */
+  constexpr std::optional<Matrix> Inverse() const {
+    static_assert(R == C, "Inverse is only defined for square matrices");
+    static_assert(std::is_floating_point_v<T>, "Inverse is only defined for floating-point matrices");
+    const Matrix& m = *this;
+    if constexpr (R <= 3) {
+      const T det = Determinant();
+      if (det == T(0)) {
+        return std::nullopt;
+      }
+      const T inv_det = T(1) / det;
+      if constexpr (R == 1) {
+        return Matrix{inv_det};
+      } else if constexpr (R == 2) {
+        return Matrix{m(1, 1), -m(0, 1), -m(1, 0), m(0, 0)} * inv_det;
+      } else {
+        return Matrix{m(1, 1) * m(2, 2) - m(1, 2) * m(2, 1),
+                      m(0, 2) * m(2, 1) - m(0, 1) * m(2, 2),
+                      m(0, 1) * m(1, 2) - m(0, 2) * m(1, 1),
+                      m(1, 2) * m(2, 0) - m(1, 0) * m(2, 2),
+                      m(0, 0) * m(2, 2) - m(0, 2) * m(2, 0),
+                      m(0, 2) * m(1, 0) - m(0, 0) * m(1, 2),
+                      m(1, 0) * m(2, 1) - m(1, 1) * m(2, 0),
+                      m(0, 1) * m(2, 0) - m(0, 0) * m(2, 1),
+                      m(0, 0) * m(1, 1) - m(0, 1) * m(1, 0)} * inv_det;
+      }
+    } else {
+      Matrix a = m;
+      Matrix inv = Identity();
+      for (std::size_t col = 0; col < R; ++col) {
+        const std::size_t pivot = a.FindPivot(col);
+        if (a(pivot, col) == T(0)) {
+          return std::nullopt;
+        }
+        a.SwapRows(pivot, col);
+        inv.SwapRows(pivot, col);
+
+        const T scale = T(1) / a(col, col);
+        for (std::size_t k = 0; k < R; ++k) {
+          a(col, k) *= scale;
+          inv(col, k) *= scale;
+        }
+        for (std::size_t row = 0; row < R; ++row) {
+          if (row == col) {
+            continue;
+          }
+          const T factor = a(row, col);
+          for (std::size_t k = 0; k < R; ++k) {
+            a(row, k) -= factor * a(col, k);
+            inv(row, k) -= factor * inv(col, k);
+          }
+        }
+      }
+      return inv;
+    }
+  }
+
+ private:
+  /**
+   * @return Row at or below @p col with the largest absolute value in column @p col.
+   */
+  constexpr std::size_t FindPivot(std::size_t col) const {
+    std::size_t pivot = col;
+    T max = T(0);
+    for (std::size_t row = col; row < R; ++row) {
+      const T value = (*this)(row, col) < T(0) ? -(*this)(row, col) : (*this)(row, col);
+      if (value > max) {
+        max = value;
+        pivot = row;
+      }
+    }
+    return pivot;
+  }
+
+  constexpr void SwapRows(std::size_t a, std::size_t b) {
+    if (a == b) {
+      return;
+    }
+    for (std::size_t k = 0; k < C; ++k) {
+      const T temp = (*this)(a, k);
+      (*this)(a, k) = (*this)(b, k);
+      (*this)(b, k) = temp;
+    }
+  }
+
+  std::array<T, R * C> data_ = {};
+};
+
+/**
+ * @brief Column vector with a size fixed at compile time.
+ */
+template<typename T, std::size_t N>
+using Vector = Matrix<T, N, 1>;
+
+}  // namespace util
+
+#endif  // RTLIB_UTIL_MATRIX_H_
@@ -0,0 +1,264 @@
+/**
+ * @file src/util/pid.h
+ *
+ * @brief Discrete PID controller with anti-windup and feed-forward.
+ */
+
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_UTIL_PID_H_
+#define RTLIB_UTIL_PID_H_
+
+namespace util {
+
+/**
+ * @brief Discrete PID controller for loops running at a fixed rate.
+ *
+ * The controller computes <tt>kp * e + ki * integral(e) + kd * d(-measurement)/dt + kff * setpoint + feed_forward</tt>,
+ * clamped to the output limits.
+ *
+ * - The derivative term acts on the measurement instead of the error, so setpoint steps do not cause output spikes. It
+ *   can be low-pass filtered to attenuate measurement noise.
+ * - The integral is stored after multiplication by @c ki, so that gains can be changed while running without a bump in
+ *   the output.
+ * - The integral stops accumulating while the output is saturated in the direction of the error (conditional
+ *   integration), so that the controller recovers immediately once the error changes sign.
+ *
+ * Cascade loops are built by feeding the output of an outer controller as the setpoint of an inner controller (see
+ * CascadePid). The inner controller usually runs at a higher rate than the outer controller.
+ */
+class Pid final {
+ public:
+  /**
+   * @brief Configuration for a PID controller.
+   */
+  struct Config {
+    /**
+     * @brief Proportional gain.
+     */
+    float kp = 0.0f;
+    /**
+     * @brief Integral gain, per second.
+     */
+    float ki = 0.0f;
+    /**
+     * @brief Derivative gain, in seconds.
+     */
+    float kd = 0.0f;
+    /**
+     * @brief Feed-forward gain applied to the setpoint.
+     */
+    float kff = 0.0f;
+    /**
+     * @brief Time between consecutive calls to Update(), in seconds.
+     */
+    float period = 0.001f;
+    /**
+     * @brief Time constant of the low-pass filter on the derivative term, in seconds. 0 disables the filter.
+     */
+    float derivative_filter = 0.0f;
+    /**
+     * @brief Minimum output.
+     */
+    float output_min = -1.0f;
+    /**
+     * @brief Maximum output.
+     */
+    float output_max = 1.0f;
+  };
+
+  /**
+   * @brief Constructor.
+   *
+   * @param config PID configuration
+   */
+  explicit Pid(const Config& config) : config_(config) { SetDerivativeFilter(config.derivative_filter); }
+
+  /**
+   * @brief Computes the output for one period.
+   *
+   * @param setpoint Desired value of the measurement
+   * @param measurement Current value of the measurement
+   * @param feed_forward Additional term added to the output, e.g. a model-based estimate of the required output
+   * @return Output of the controller.
+   */
+  float Update(float setpoint, float measurement, float feed_forward = 0.0f) {
+    const float error = setpoint - measurement;
+
+    if (!has_measurement_) {
+      last_measurement_ = measurement;
+      has_measurement_ = true;
+    }
+    const float rate = (last_measurement_ - measurement) / config_.period;
+    last_measurement_ = measurement;
+    derivative_ += derivative_alpha_ * (rate - derivative_);
+
+    const float unclamped = config_.kp * error + integral_ + config_.kd * derivative_ + config_.kff * setpoint
+        + feed_forward;
+    output_ = Clamp(unclamped);
+
+    // Only integrate when the output is not saturated, or when the error drives the output out of saturation
+    const bool saturated_high = unclamped > config_.output_max && error > 0.0f;
+    const bool saturated_low = unclamped < config_.output_min && error < 0.0f;
+    if (!saturated_high && !saturated_low) {
+      integral_ = Clamp(integral_ + config_.ki * config_.period * error);
+    }
+
+    return output_;
+  }
+
+  /**
+   * @brief Resets the state of the controller.
+   *
+   * @param output Initial value of the integral term, e.g. the current actuator output for a bumpless transfer from
+   * manual control
+   */
+  void Reset(float output = 0.0f) {
+    integral_ = Clamp(output);
+    derivative_ = 0.0f;
+    has_measurement_ = false;
+    output_ = integral_;
+  }
+
+  /**
+   * @brief Changes the gains of the controller, without resetting its state.
+   */
+  void SetGains(float kp, float ki, float kd) {
+    config_.kp = kp;
+    config_.ki = ki;
+    config_.kd = kd;
+  }
+
+  /**
+   * @brief Changes the output limits of the controller.
+   */
+  void SetOutputLimits(float output_min, float output_max) {
+    config_.output_min = output_min;
+    config_.output_max = output_max;
+    integral_ = Clamp(integral_);
+  }
+
+  /**
+   * @brief Changes the time constant of the derivative low-pass filter.
+   *
+   * @param time_constant Time constant in seconds. 0 disables the filter.
+   */
+  void SetDerivativeFilter(float time_constant) {
+    config_.derivative_filter = time_constant;
+    derivative_alpha_ = config_.period / (time_constant + config_.period);
+  }
+
+  /**
+   * @return Output of the last call to Update().
+   */
+  float GetOutput() const { return output_; }
+  /**
+   * @return Current value of the integral term.
+   */
+  float GetIntegral() const { return integral_; }
+
+  /**
+   * @return Configuration of the controller, including any changes made after construction.
+   */
+  const Config& GetConfig() const { return config_; }
+
+ private:
+  float Clamp(float value) const {
+    return value > config_.output_max ? config_.output_max : (value < config_.output_min ? config_.output_min : value);
+  }
+
+  Config config_;
+  float derivative_alpha_ = 1.0f;
+
+  float integral_ = 0.0f;
+  float derivative_ = 0.0f;
+  float last_measurement_ = 0.0f;
+  bool has_measurement_ = false;
+  float output_ = 0.0f;
+};
+
+/**
+ * @brief Two PID controllers in cascade, where the outer controller provides the setpoint of the inner controller.
+ *
+ * For example, a position controller (outer) can command a velocity controller (inner). The output limits of the outer
+ * controller limit the setpoint of the inner controller, e.g. the maximum velocity.
+ *
+ * If the inner controller runs at a higher rate, call UpdateOuter() and UpdateInner() at their respective rates
+ * instead of Update().
+ */
+class CascadePid final {
+ public:
+  /**
+   * @brief Constructor.
+   *
+   * @param outer Configuration of the outer controller
+   * @param inner Configuration of the inner controller
+   */
+  CascadePid(const Pid::Config& outer, const Pid::Config& inner) : outer_(outer), inner_(inner) {}
+
+  /**
+   * @brief Updates both controllers.
+   *
+   * @param setpoint Setpoint of the outer controller
+   * @param outer_measurement Measurement of the outer controller
+   * @param inner_measurement Measurement of the inner controller
+   * @param feed_forward Feed-forward term of the inner controller
+   * @return Output of the inner controller.
+   */
+  float Update(float setpoint, float outer_measurement, float inner_measurement, float feed_forward = 0.0f) {
+    UpdateOuter(setpoint, outer_measurement);
+    return UpdateInner(inner_measurement, feed_forward);
+  }
+
+  /**
+   * @brief Updates the outer controller only.
+   *
+   * @return Setpoint of the inner controller.
+   */
+  float UpdateOuter(float setpoint, float outer_measurement) { return outer_.Update(setpoint, outer_measurement); }
+
+  /**
+   * @brief Updates the inner controller only, using the latest output of the outer controller as its setpoint.
+   *
+   * @return Output of the inner controller.
+   */
+  float UpdateInner(float inner_measurement, float feed_forward = 0.0f) {
+    return inner_.Update(outer_.GetOutput(), inner_measurement, feed_forward);
+  }
+
+  /**
+   * @brief Resets both controllers.
+   */
+  void Reset() {
+    outer_.Reset();
+    inner_.Reset();
+  }
+
+  Pid& GetOuter() { return outer_; }
+  Pid& GetInner() { return inner_; }
+
+ private:
+  Pid outer_;
+  Pid inner_;
+};
+
+}  // namespace util
+
+#endif  // RTLIB_UTIL_PID_H_
@@ -0,0 +1,159 @@
+/**
+ * @file src/util/ram_flash.h
+ *
+ * @brief Flash simulator for testing KvStore.
+ */
+
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_UTIL_RAM_FLASH_H_
+#define RTLIB_UTIL_RAM_FLASH_H_
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "util/kv_store.h"
+
+namespace util {
+
+/**
+ * @brief Flash simulator in RAM, for running KvStore off-target or without wearing the internal flash.
+ *
+ * Programming follows the semantics of NOR flash, i.e. bits can only be cleared, and erasing sets all bits of a sector.
+ * A budget of operations can be set to simulate a power loss: once the budget is exhausted, further operations are
+ * ignored, and the contents can be inspected by constructing a new KvStore on the same object.
+ *
+ * Repeating a sequence of operations with every budget from 0 upwards interrupts it at every flash operation, including
+ * those of compaction, and checks that the store stays consistent after each power loss:
+ *
+ * @code
+ * for (uint32_t budget = 0;; ++budget) {
+ *   RamFlash<1024, 3> flash;
+ *   {
+ *     KvStore store(flash);
+ *     flash.SetBudget(budget);
+ *     RunSequence(store);  // Write() and Maintain() calls under test
+ *   }
+ *   const bool completed = !flash.IsPowerLost();
+ *
+ *   flash.SetBudget(RamFlash<1024, 3>::kUnlimited);
+ *   KvStore recovered(flash);
+ *   CheckConsistent(recovered);  // every key holds its value from before or after the interrupted write
+ *   if (completed) {
+ *     break;
+ *   }
+ * }
+ * @endcode
+ *
+ * @tparam kSectorSize Size of each sector, in bytes
+ * @tparam kNumSectors Number of sectors
+ */
+template<uint32_t kSectorSize, uint8_t kNumSectors>
+class RamFlash final : public KvStore::Backend {
+ public:
+  static_assert(kSectorSize % 4 == 0, "Sector size must be a multiple of 4");
+  static_assert(kNumSectors >= 2 && kNumSectors <= KvStore::kMaxSectors, "Unsupported number of sectors");
+
+  /**
+   * @brief Value of the operation budget which disables power loss simulation.
+   */
+  static constexpr uint32_t kUnlimited = 0xFFFFFFFF;
+
+  /**
+   * @brief Default constructor.
+   *
+   * All sectors are initially erased.
+   */
+  RamFlash() { memory_.fill(0xFF); }
+
+  uint8_t GetNumSectors() const override { return kNumSectors; }
+  uint32_t GetSectorSize() const override { return kSectorSize; }
+  const uint8_t* GetSector(uint8_t sector) const override { return &memory_[sector * kSectorSize]; }
+
+  void Program(uint8_t sector, uint32_t offset, const uint32_t* data, std::size_t count) override {
+    assert(sector < kNumSectors && offset % 4 == 0 && offset + count * 4 <= kSectorSize);
+
+    for (std::size_t i = 0; i < count; ++i) {
+      if (!Consume()) {
+        return;
+      }
+
+      uint8_t bytes[4];
+      std::memcpy(bytes, &data[i], sizeof(bytes));
+      for (std::size_t j = 0; j < sizeof(bytes); ++j) {
+        memory_[sector * kSectorSize + offset + i * 4 + j] &= bytes[j];
+      }
+    }
+  }
+
+  void Erase(uint8_t sector) override {
+    assert(sector < kNumSectors);
+
+    if (!Consume()) {
+      return;
+    }
+    ++erase_counts_[sector];
+    std::memset(&memory_[sector * kSectorSize], 0xFF, kSectorSize);
+  }
+
+  /**
+   * @brief Sets the number of word programming and sector erase operations to perform before simulating a power loss.
+   *
+   * @param budget Number of operations, or @c kUnlimited
+   */
+  void SetBudget(uint32_t budget) { budget_ = budget; }
+
+  /**
+   * @return @c true if the operation budget is exhausted, i.e. power has been lost.
+   */
+  bool IsPowerLost() const { return budget_ == 0; }
+
+  /**
+   * @param sector Sector index
+   * @return Number of times @p sector has been erased.
+   */
+  uint32_t GetEraseCount(uint8_t sector) const { return erase_counts_[sector]; }
+
+ private:
+  /**
+   * @return @c true if the budget allows one more operation.
+   */
+  bool Consume() {
+    if (budget_ == kUnlimited) {
+      return true;
+    }
+    if (budget_ == 0) {
+      return false;
+    }
+    --budget_;
+    return true;
+  }
+
+  std::array<uint8_t, kSectorSize * kNumSectors> memory_;
+  std::array<uint32_t, kNumSectors> erase_counts_ = {};
+  uint32_t budget_ = kUnlimited;
+};
+
+}  // namespace util
+
+#endif  // RTLIB_UTIL_RAM_FLASH_H_
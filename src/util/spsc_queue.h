@@ -0,0 +1,117 @@
+/**
+ * @file src/util/spsc_queue.h
+ *
+ * @brief Lock-free single-producer single-consumer queue.
+ */
+
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_UTIL_SPSC_QUEUE_H_
+#define RTLIB_UTIL_SPSC_QUEUE_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace util {
+
+/**
+ * @brief Fixed-capacity lock-free queue for one producer and one consumer.
+ *
+ * This queue is intended to pass data between an interrupt handler and the main loop (or vice versa) without
+ * disabling interrupts. Push() must only be called from one context, and Pop() must only be called from one
+ * (possibly different) context.
+ *
+ * @tparam T Type of elements. Must be copy-assignable.
+ * @tparam N Capacity of the queue. Must be a power of 2.
+ */
+template<typename T, std::size_t N>
+class SpscQueue final {
+  static_assert(N > 1 && (N & (N - 1)) == 0, "Capacity of SpscQueue must be a power of 2");
+
+ public:
+  /**
+   * @brief Appends an element to the back of the queue.
+   *
+   * @param value Element to append
+   * @return @c true if the element is appended, @c false if the queue is full.
+   */
+  bool Push(const T& value) {
+    const uint32_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) >= N) {
+      return false;
+    }
+
+    buffer_[head & (N - 1)] = value;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Removes an element from the front of the queue.
+   *
+   * @param value Reference to store the removed element
+   * @return @c true if an element is removed, @c false if the queue is empty.
+   */
+  bool Pop(T& value) {
+    const uint32_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    value = buffer_[tail & (N - 1)];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @return Number of elements in the queue.
+   */
+  std::size_t GetSize() const {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @return @c true if the queue has no elements.
+   */
+  bool IsEmpty() const { return GetSize() == 0; }
+
+  /**
+   * @return Maximum number of elements in the queue.
+   */
+  static constexpr std::size_t GetCapacity() { return N; }
+
+ private:
+  std::array<T, N> buffer_ = {};
+
+  /**
+   * @brief Free-running index of the next element to write. Only modified by the producer.
+   */
+  std::atomic<uint32_t> head_ = 0;
+  /**
+   * @brief Free-running index of the next element to read. Only modified by the consumer.
+   */
+  std::atomic<uint32_t> tail_ = 0;
+};
+
+}  // namespace util
+
+#endif  // RTLIB_UTIL_SPSC_QUEUE_H_
@@ -0,0 +1,278 @@
+/**
+ * @file src/util/telemetry.h
+ *
+ * @brief Binary telemetry framing with COBS and CRC, transmitted directly from a ring buffer.
+ */
+
+/*
+ * This file is part of RTLib.
+ *
+ * Copyright (C) 2018 Derppening <david.18.19.21@gmail.com>
+ *
+ * RTLib is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * RTLib is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with RTLib.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTLIB_UTIL_TELEMETRY_H_
+#define RTLIB_UTIL_TELEMETRY_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "util/cobs.h"
+#include "util/crc.h"
+
+namespace util {
+
+/**
+ * @brief Binary telemetry channel which serializes fixed-layout structures into COBS frames.
+ *
+ * Each message type is a trivially copyable structure with a compile-time schema ID, for example:
+ *
+ * @code
+ * struct MotorStatus {
+ *   static constexpr uint8_t kSchemaId = 1;
+ *   uint32_t timestamp;
+ *   int16_t speed[2];
+ *   float current;
+ * };
+ * @endcode
+ *
+ * Each frame consists of the schema ID, the raw bytes of the structure, and the CRC-16/CCITT of both (little-endian).
+ * The frame is COBS-encoded and terminated by a zero byte, so the receiver can resynchronize after any lost byte.
+ *
+ * Send() encodes the structure directly into a ring buffer, without any intermediate copies. Flush() then submits the
+ * contiguous encoded bytes to the transport straight from the ring buffer, so the transport does not copy them either.
+ *
+ * Schema headers should only contain such structures, with members of fixed-width integer types, @c float, @c double,
+ * @c bool, or one-dimensional arrays of these. The host-side decoder (scripts/telemetry_decode.py) parses the same
+ * header to decode frames. Host C++ programs can instead include the schema header together with util/cobs.h and
+ * util/crc.h.
+ *
+ * Send() must only be called from one context. Flush(), Peek() and Consume() must only be called from one (possibly
+ * different) context, except that completed submissions are consumed from the transport's callback.
+ *
+ * @tparam N Size of the ring buffer, in bytes. Must be a power of 2.
+ */
+template<std::size_t N>
+class Telemetry final {
+  static_assert(N > 1 && (N & (N - 1)) == 0, "Size of Telemetry buffer must be a power of 2");
+
+ public:
+  /**
+   * @brief Frames and queues a message.
+   *
+   * @tparam T Message type, which must have a @c kSchemaId member
+   * @param message Message to send
+   * @return @c true if the message is queued, @c false if the ring buffer has insufficient space.
+   */
+  template<typename T>
+  bool Send(const T& message) {
+    static_assert(std::is_trivially_copyable_v<T>, "Telemetry messages must be trivially copyable");
+    static_assert(std::is_same_v<std::remove_cv_t<decltype(T::kSchemaId)>, uint8_t>, "kSchemaId must be a uint8_t");
+    return Send(T::kSchemaId, &message, sizeof(T));
+  }
+
+  /**
+   * @brief Frames and queues a raw payload.
+   *
+   * @param schema_id Schema ID of the payload
+   * @param payload Payload to send
+   * @param size Size of @p payload
+   * @return @c true if the payload is queued, @c false if the ring buffer has insufficient space.
+   */
+  bool Send(uint8_t schema_id, const void* payload, std::size_t size) {
+    const uint32_t head = head_.load(std::memory_order_relaxed);
+    const uint32_t free = N - (head - tail_.load(std::memory_order_acquire));
+
+    // Schema ID and CRC, plus the frame delimiter
+    if (cobs::GetMaxEncodedSize(size + 3) + 1 > free) {
+      ++dropped_;
+      return false;
+    }
+
+    const auto* bytes = static_cast<const uint8_t*>(payload);
+    Encoder encoder(buffer_, head);
+    encoder.Put(schema_id);
+    uint16_t crc = Crc16Ccitt::Update(Crc16Ccitt::Init(), &schema_id, 1);
+    for (std::size_t i = 0; i < size; ++i) {
+      encoder.Put(bytes[i]);
+    }
+    crc = Crc16Ccitt::Finalize(Crc16Ccitt::Update(crc, bytes, size));
+    encoder.Put(static_cast<uint8_t>(crc));
+    encoder.Put(static_cast<uint8_t>(crc >> 8));
+
+    head_.store(encoder.Finish(), std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Retrieves the oldest contiguous block of encoded bytes.
+   *
+   * @param data Reference to store the pointer to the block
+   * @param size Reference to store the size of the block
+   * @return @c true if there are pending bytes.
+   */
+  bool Peek(const uint8_t*& data, std::size_t& size) const {
+    const uint32_t tail = tail_.load(std::memory_order_relaxed);
+    const uint32_t pending = head_.load(std::memory_order_acquire) - tail;
+    if (pending == 0) {
+      return false;
+    }
+
+    const std::size_t offset = tail & (N - 1);
+    data = &buffer_[offset];
+    size = pending < N - offset ? pending : N - offset;
+    return true;
+  }
+
+  /**
+   * @brief Releases bytes which were retrieved by Peek() and are no longer used by the transport.
+   *
+   * @param size Number of bytes to release
+   */
+  void Consume(std::size_t size) {
+    tail_.store(tail_.load(std::memory_order_relaxed) + static_cast<uint32_t>(size), std::memory_order_release);
+  }
+
+  /**
+   * @brief Submits pending bytes to a transport, if the transport is not busy with a previous submission.
+   *
+   * The transport must provide a function with the signature of UsbCdc::Submit(), i.e.
+   * <tt>bool Submit(const uint8_t* data, std::size_t size, void (*callback)(void*), void* context)</tt>, which
+   * transmits @p data without copying and invokes @p callback once the data is no longer used. The bytes are released
+   * from the callback, so this function should be called periodically to keep the transport busy.
+   *
+   * @tparam Transport Type of the transport
+   * @param transport Transport to submit to. Must outlive all pending submissions.
+   */
+  template<typename Transport>
+  void Flush(Transport& transport) {
+    if (in_flight_ != 0) {
+      return;
+    }
+
+    transport_ = &transport;
+    submit_ = &SubmitTo<Transport>;
+    Submit();
+  }
+
+  /**
+   * @return Number of bytes pending to be transmitted.
+   */
+  std::size_t GetPending() const {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @return Number of messages which were dropped because the ring buffer was full.
+   */
+  uint32_t GetDropped() const { return dropped_; }
+
+ private:
+  using SubmitFunction = bool (*)(void* transport, const uint8_t* data, std::size_t size, void* context);
+
+  /**
+   * @brief COBS encoder which writes directly into the ring buffer.
+   *
+   * The code byte of each block is written once the length of the block is known.
+   */
+  class Encoder {
+   public:
+    Encoder(std::array<uint8_t, N>& buffer, uint32_t head) : buffer_(buffer), code_index_(head), index_(head + 1) {}
+
+    void Put(uint8_t value) {
+      if (value == 0) {
+        EndBlock();
+        return;
+      }
+
+      buffer_[index_++ & (N - 1)] = value;
+      if (++code_ == 0xFF) {
+        EndBlock();
+      }
+    }
+
+    /**
+     * @return New head of the ring buffer, after the frame delimiter.
+     */
+    uint32_t Finish() {
+      buffer_[code_index_ & (N - 1)] = code_;
+      buffer_[index_++ & (N - 1)] = 0;
+      return index_;
+    }
+
+   private:
+    void EndBlock() {
+      buffer_[code_index_ & (N - 1)] = code_;
+      code_index_ = index_++;
+      code_ = 1;
+    }
+
+    std::array<uint8_t, N>& buffer_;
+    uint32_t code_index_;
+    uint32_t index_;
+    uint8_t code_ = 1;
+  };
+
+  template<typename Transport>
+  static bool SubmitTo(void* transport, const uint8_t* data, std::size_t size, void* context) {
+    return static_cast<Transport*>(transport)->Submit(data, size, &HandleSubmitted, context);
+  }
+
+  static void HandleSubmitted(void* context) {
+    auto& self = *static_cast<Telemetry*>(context);
+    self.Consume(self.in_flight_);
+    self.in_flight_ = 0;
+  }
+
+  void Submit() {
+    const uint8_t* data;
+    std::size_t size;
+    if (!Peek(data, size)) {
+      return;
+    }
+
+    in_flight_ = size;
+    if (!submit_(transport_, data, size, this)) {
+      in_flight_ = 0;
+    }
+  }
+
+  std::array<uint8_t, N> buffer_ = {};
+
+  /**
+   * @brief Free-running index of the next byte to write. Only modified by Send().
+   */
+  std::atomic<uint32_t> head_ = 0;
+  /**
+   * @brief Free-running index of the next byte to transmit. Only modified by the consumer.
+   */
+  std::atomic<uint32_t> tail_ = 0;
+
+  /**
+   * @brief Number of bytes submitted to the transport and not yet released.
+   */
+  volatile std::size_t in_flight_ = 0;
+  void* transport_ = nullptr;
+  SubmitFunction submit_ = nullptr;
+
+  uint32_t dropped_ = 0;
+};
+
+}  // namespace util
+
+#endif  // RTLIB_UTIL_TELEMETRY_H_